@@ -1,6 +1,3 @@
-/* CHIBIOS FIX */
-#include "ch.h"
-
 /*---------------------------------------------------------------------------/
    /  FatFs - FAT file system module configuration file  R0.10b (C)ChaN, 2014
    /---------------------------------------------------------------------------*/
@@ -40,7 +37,9 @@
 /* To enable string functions, set _USE_STRFUNC to 1 or 2. */
 
 
+#ifndef _USE_MKFS /* Only enabled by the unit tests, to format RAM images. */
 #define _USE_MKFS       0   /* 0:Disable or 1:Enable */
+#endif
 /* To enable f_mkfs() function, set _USE_MKFS to 1 and set _FS_READONLY to 0 */
 
 
@@ -191,9 +190,11 @@
    /  with file lock control. This feature uses bss _FS_LOCK * 12 bytes. */
 
 
-#define _FS_REENTRANT   0               /* 0:Disable or 1:Enable */
+#define _FS_REENTRANT   1               /* 0:Disable or 1:Enable */
 #define _FS_TIMEOUT     MS2ST(1000)     /* Timeout period in unit of time tick */
-#define _SYNC_t         semaphore_t *    /* O/S dependent sync object type. e.g. HANDLE, OS_EVENT*, ID, SemaphoreHandle_t and etc.. */
+/* CHIBIOS FIX, a semaphore_t * in fatfs_syscall.c. Not declared as such so
+ * that the unit tests can build FatFs without ChibiOS. */
+#define _SYNC_t         void *          /* O/S dependent sync object type. e.g. HANDLE, OS_EVENT*, ID, SemaphoreHandle_t and etc.. */
 /* The _FS_REENTRANT option switches the re-entrancy (thread safe) of the FatFs module.
    /
    /   0: Disable re-entrancy. _FS_TIMEOUT and _SYNC_t have no effect.
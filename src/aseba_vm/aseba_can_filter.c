@@ -0,0 +1,100 @@
+#include "aseba_can_filter.h"
+
+#define FILTER_STID(sid) ((uint32_t)(sid) << 21)
+#define FILTER_IDE (1 << 2)
+#define FILTER_RTR (1 << 1)
+
+/* Bit 10 of the identifier is always cleared by Aseba. */
+#define FILTER_TYPE_MASK (FILTER_STID(0x700) | FILTER_IDE | FILTER_RTR)
+
+/* Also matches stop frames, whose type differs only by bit 9. */
+#define FILTER_CONTINUATION_MASK (FILTER_STID(0x500) | FILTER_IDE | FILTER_RTR)
+
+void aseba_can_filter_banks(aseba_can_filter_t banks[ASEBA_CAN_FILTER_COUNT])
+{
+    banks[ASEBA_CAN_FILTER_SMALL].id = FILTER_STID(ASEBA_CAN_TYPE_SMALL << 8);
+    banks[ASEBA_CAN_FILTER_SMALL].mask = FILTER_TYPE_MASK;
+
+    banks[ASEBA_CAN_FILTER_START].id = FILTER_STID(ASEBA_CAN_TYPE_START << 8);
+    banks[ASEBA_CAN_FILTER_START].mask = FILTER_TYPE_MASK;
+
+    banks[ASEBA_CAN_FILTER_CONTINUATION].id = FILTER_STID(ASEBA_CAN_TYPE_NORMAL << 8);
+    banks[ASEBA_CAN_FILTER_CONTINUATION].mask = FILTER_CONTINUATION_MASK;
+}
+
+int aseba_can_filter_match(const aseba_can_filter_t *banks, size_t count, uint16_t sid,
+                           bool ide, bool rtr)
+{
+    uint32_t reg = FILTER_STID(sid) | (ide ? FILTER_IDE : 0) | (rtr ? FILTER_RTR : 0);
+    size_t i;
+
+    for (i = 0; i < count; i++) {
+        if (((reg ^ banks[i].id) & banks[i].mask) == 0) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+void aseba_can_demux_init(aseba_can_demux_t *demux, aseba_can_drop_fn_t should_drop, void *arg)
+{
+    size_t i;
+
+    for (i = 0; i < sizeof(demux->dropping) / sizeof(demux->dropping[0]); i++) {
+        demux->dropping[i] = 0;
+    }
+    for (i = 0; i < ASEBA_CAN_FILTER_COUNT; i++) {
+        demux->stats.filter_hits[i] = 0;
+    }
+    demux->stats.accepted = 0;
+    demux->stats.dropped = 0;
+    demux->should_drop = should_drop;
+    demux->arg = arg;
+}
+
+bool aseba_can_demux_accept(aseba_can_demux_t *demux, unsigned filter, uint16_t id,
+                            const uint8_t *data, uint8_t len)
+{
+    uint16_t source = ASEBA_CAN_ID_SOURCE(id);
+    uint32_t *word = &demux->dropping[source / 32];
+    uint32_t bit = 1UL << (source % 32);
+    bool drop;
+
+    if (filter < ASEBA_CAN_FILTER_COUNT) {
+        demux->stats.filter_hits[filter]++;
+    }
+
+    switch (ASEBA_CAN_ID_TYPE(id)) {
+        case ASEBA_CAN_TYPE_SMALL:
+            /* Frames too short to hold a message type are left to Aseba. */
+            drop = len >= 2 && demux->should_drop(demux->arg, source, data);
+            break;
+
+        case ASEBA_CAN_TYPE_START:
+            drop = len >= 2 && demux->should_drop(demux->arg, source, data);
+            if (drop) {
+                *word |= bit;
+            } else {
+                *word &= ~bit;
+            }
+            break;
+
+        case ASEBA_CAN_TYPE_STOP:
+            drop = (*word & bit) != 0;
+            *word &= ~bit;
+            break;
+
+        default:
+            drop = (*word & bit) != 0;
+            break;
+    }
+
+    if (drop) {
+        demux->stats.dropped++;
+    } else {
+        demux->stats.accepted++;
+    }
+
+    return !drop;
+}
@@ -0,0 +1,89 @@
+#ifndef ASEBA_CAN_FILTER_H
+#define ASEBA_CAN_FILTER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** Aseba CAN identifiers hold the frame type in bits 9-8 and the source node
+ * in bits 7-0. A packet is either a single small frame, or a start frame
+ * followed by normal frames and a stop frame. The message type, and the
+ * destination of debug messages, are in the first data bytes of the packet. */
+#define ASEBA_CAN_ID_TYPE(id) (((id) >> 8) & 0x7)
+#define ASEBA_CAN_ID_SOURCE(id) ((id) & 0xff)
+
+#define ASEBA_CAN_TYPE_NORMAL 0x0
+#define ASEBA_CAN_TYPE_START 0x1
+#define ASEBA_CAN_TYPE_STOP 0x2
+#define ASEBA_CAN_TYPE_SMALL 0x3
+
+/** Filter banks, in the order of their filter match index. */
+enum {
+    ASEBA_CAN_FILTER_SMALL = 0,
+    ASEBA_CAN_FILTER_START,
+    ASEBA_CAN_FILTER_CONTINUATION, /**< Normal and stop frames. */
+    ASEBA_CAN_FILTER_COUNT
+};
+
+/** bxCAN filter bank in 32 bit mask mode.
+ *
+ * Both registers hold STID in bits 31-21, EXID in bits 20-3, IDE in bit 2
+ * and RTR in bit 1. A frame matches if its bits equal id wherever mask is
+ * set.
+ */
+typedef struct {
+    uint32_t id;
+    uint32_t mask;
+} aseba_can_filter_t;
+
+/** Fills the filter banks accepting Aseba frames.
+ *
+ * Only standard data frames with an Aseba frame type are accepted, one bank
+ * per kind of frame so that the filter match index tells them apart.
+ */
+void aseba_can_filter_banks(aseba_can_filter_t banks[ASEBA_CAN_FILTER_COUNT]);
+
+/** Returns the first bank accepting a frame, as the controller does, -1 if
+ * the frame is rejected. */
+int aseba_can_filter_match(const aseba_can_filter_t *banks, size_t count, uint16_t sid,
+                           bool ide, bool rtr);
+
+/** Returns non zero if a packet starting with data, sent by source, is not
+ * for this node, like AsebaShouldDropPacket(). */
+typedef uint16_t (*aseba_can_drop_fn_t)(void *arg, uint16_t source, const uint8_t *data);
+
+typedef struct {
+    uint32_t filter_hits[ASEBA_CAN_FILTER_COUNT]; /**< Frames by filter match index. */
+    uint32_t accepted; /**< Frames passed to Aseba. */
+    uint32_t dropped; /**< Frames of packets which are not for this node. */
+} aseba_can_demux_stats_t;
+
+/** Drops the frames of packets which are not for this node.
+ *
+ * The packet is checked on its first frame, the following frames of the
+ * same source then get the same fate without being looked at, nor copied
+ * to the Aseba receive queue.
+ */
+typedef struct {
+    uint32_t dropping[256 / 32]; /**< Sources whose current packet is dropped. */
+    aseba_can_drop_fn_t should_drop;
+    void *arg;
+    aseba_can_demux_stats_t stats;
+} aseba_can_demux_t;
+
+void aseba_can_demux_init(aseba_can_demux_t *demux, aseba_can_drop_fn_t should_drop, void *arg);
+
+/** Returns true if a frame received through the given filter must be passed
+ * to Aseba. */
+bool aseba_can_demux_accept(aseba_can_demux_t *demux, unsigned filter, uint16_t id,
+                            const uint8_t *data, uint8_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ASEBA_CAN_FILTER_H */
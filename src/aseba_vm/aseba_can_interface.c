@@ -1,19 +1,96 @@
+#include <string.h>
 #include "ch.h"
 #include "hal.h"
+#include "chprintf.h"
 
 #include "transport/can/can-net.h"
 #include "vm/vm.h"
 
 #include "aseba_can_interface.h"
-
-#define ASEBA_CAN_SEND_QUEUE_SIZE       1024
-#define ASEBA_CAN_RECEIVE_QUEUE_SIZE    1024
-
+#include "can_tx_queue.h"
+#include "aseba_can_filter.h"
+
+/* Queue sizes in frames, which can be set from the Makefile. Only packets
+ * for this node get to the receive queue, which must hold the largest one
+ * until it is complete. Use the "can" shell command to check that nothing
+ * gets dropped. */
+#ifndef ASEBA_CAN_SEND_QUEUE_SIZE
+#define ASEBA_CAN_SEND_QUEUE_SIZE       256
+#endif
+#ifndef ASEBA_CAN_RECEIVE_QUEUE_SIZE
+#define ASEBA_CAN_RECEIVE_QUEUE_SIZE    256
+#endif
+
+/* Frames handed over by Aseba, waiting for a hardware mailbox. */
+#ifndef CAN_TX_QUEUE_SIZE
+#define CAN_TX_QUEUE_SIZE               32
+#endif
 
 
 CanFrame aseba_can_send_queue[ASEBA_CAN_SEND_QUEUE_SIZE];
 CanFrame aseba_can_receive_queue[ASEBA_CAN_RECEIVE_QUEUE_SIZE];
 
+static can_tx_frame_t can_tx_frames[CAN_TX_QUEUE_SIZE];
+static can_tx_queue_t can_tx_queue;
+static aseba_can_demux_t can_rx_demux;
+
+static struct {
+    uint32_t rx_dropped; /**< Times Aseba had no room left in its queues. */
+    uint32_t tx_dropped;
+} aseba_can_stats;
+
+static uint16_t can_should_drop(void *arg, uint16_t source, const uint8_t *data)
+{
+    (void)arg;
+    return AsebaShouldDropPacket(source, data);
+}
+
+/* Called with the system locked. */
+static bool can_transmit_frame(void *arg, const can_tx_frame_t *frame)
+{
+    (void)arg;
+    CANTxFrame txf;
+
+    if (!can_lld_is_tx_empty(&CAND1, CAN_ANY_MAILBOX)) {
+        return false;
+    }
+
+    txf.DLC = frame->len;
+    txf.RTR = 0;
+    txf.IDE = 0;
+    txf.SID = frame->id;
+
+    int i;
+    for (i = 0; i < frame->len; i++) {
+        txf.data8[i] = frame->data[i];
+    }
+
+    can_lld_transmit(&CAND1, CAN_ANY_MAILBOX, &txf);
+    return true;
+}
+
+/* Refills the mailboxes as soon as one is empty, then lets Aseba queue the
+ * next frames. */
+static THD_WORKING_AREA(can_tx_thd_wa, 256);
+static THD_FUNCTION(can_tx_thd, arg)
+{
+    (void)arg;
+    chRegSetThreadName(__FUNCTION__);
+    event_listener_t txempty;
+    chEvtRegister(&CAND1.txempty_event, &txempty, 0);
+    while (1) {
+        chEvtWaitAny(EVENT_MASK(0));
+
+        chSysLock();
+        can_tx_queue_drain(&can_tx_queue);
+        chSysUnlock();
+
+        aseba_can_lock();
+        AsebaCanFrameSent();
+        aseba_can_unlock();
+    }
+}
+
 static THD_WORKING_AREA(can_rx_thd_wa, 256);
 static THD_FUNCTION(can_rx_thd, arg)
 {
@@ -26,18 +103,14 @@ static THD_FUNCTION(can_rx_thd, arg)
         if (m != MSG_OK) {
             continue;
         }
-        if (rxf.IDE) {
-            continue; // no extended id frames
-        }
-        if (rxf.RTR) {
-            continue; // no remote transmission request frames
+        // Extended id and remote transmission request frames are rejected
+        // by the filters.
+        if (!aseba_can_demux_accept(&can_rx_demux, rxf.FMI, rxf.SID, rxf.data8, rxf.DLC)) {
+            continue; // packet not for us
         }
         aseba_can_frame.id = rxf.SID;
         aseba_can_frame.len = rxf.DLC;
-        int i;
-        for (i = 0; i < aseba_can_frame.len; i++) {
-            aseba_can_frame.data[i] = rxf.data8[i];
-        }
+        memcpy(aseba_can_frame.data, rxf.data32, sizeof(rxf.data32));
         AsebaCanFrameReceived(&aseba_can_frame);
     }
 }
@@ -57,47 +130,68 @@ void can_init(void)
                | (0 << 24) /* Resync jump width (2 bits) */
     };
 
+    /* Only Aseba frames reach the receive FIFO, sorted by type. */
+    aseba_can_filter_t banks[ASEBA_CAN_FILTER_COUNT];
+    CANFilter filters[ASEBA_CAN_FILTER_COUNT];
+    int i;
+
+    aseba_can_filter_banks(banks);
+    for (i = 0; i < ASEBA_CAN_FILTER_COUNT; i++) {
+        filters[i].filter = i;
+        filters[i].mode = 0; /* Mask mode. */
+        filters[i].scale = 1; /* 32 bits. */
+        filters[i].assignment = 0; /* FIFO 0. */
+        filters[i].register1 = banks[i].id;
+        filters[i].register2 = banks[i].mask;
+    }
+
+    /* Must be done while the driver is stopped. */
+    canSTM32SetFilters(STM32_CAN_MAX_FILTERS / 2, ASEBA_CAN_FILTER_COUNT, filters);
+
     canStart(&CAND1, &can1_config);
 }
 
 void aseba_can_rx_dropped(void)
 {
+    aseba_can_stats.rx_dropped++;
 }
 
 void aseba_can_tx_dropped(void)
 {
+    aseba_can_stats.tx_dropped++;
 }
 
+// Does not wait for the frame to be sent, the TX thread calls
+// AsebaCanFrameSent() once a mailbox is free again.
 void aseba_can_send_frame(const CanFrame *frame)
 {
     aseba_can_lock();
-    CANTxFrame txf;
-    txf.DLC = frame->len;
-    txf.RTR = 0;
-    txf.IDE = 0;
-    txf.SID = frame->id;
+    can_tx_frame_t txf;
+    txf.id = frame->id;
+    txf.len = frame->len;
 
     int i;
     for (i = 0; i < frame->len; i++) {
-        txf.data8[i] = frame->data[i];
+        txf.data[i] = frame->data[i];
     }
 
-    canTransmit(&CAND1, CAN_ANY_MAILBOX, &txf, MS2ST(100));
-    chThdSleepMilliseconds(1);
-
-    AsebaCanFrameSent();
+    chSysLock();
+    can_tx_queue_push(&can_tx_queue, &txf);
+    chSysUnlock();
     aseba_can_unlock();
 }
 
 // Returns true if there is enough space to send the frame
 int aseba_can_is_frame_room(void)
 {
-    return can_lld_is_tx_empty(&CAND1, CAN_ANY_MAILBOX);
+    return can_tx_queue_space(&can_tx_queue) > 0;
 }
 
 void aseba_can_start(AsebaVMState *vm_state)
 {
+    aseba_can_demux_init(&can_rx_demux, can_should_drop, NULL);
     can_init();
+    can_tx_queue_init(&can_tx_queue, can_tx_frames, CAN_TX_QUEUE_SIZE, can_transmit_frame, NULL);
     AsebaCanInit(vm_state->nodeId, aseba_can_send_frame, aseba_can_is_frame_room,
                  aseba_can_rx_dropped, aseba_can_tx_dropped,
                  aseba_can_send_queue, ASEBA_CAN_SEND_QUEUE_SIZE,
@@ -108,6 +202,43 @@ void aseba_can_start(AsebaVMState *vm_state)
                       NORMALPRIO + 1,
                       can_rx_thd,
                       NULL);
+
+    chThdCreateStatic(can_tx_thd_wa,
+                      sizeof(can_tx_thd_wa),
+                      NORMALPRIO + 2,
+                      can_tx_thd,
+                      NULL);
+}
+
+void aseba_can_print_stats(BaseSequentialStream *chp)
+{
+    static const char *filter_names[ASEBA_CAN_FILTER_COUNT] = {
+        [ASEBA_CAN_FILTER_SMALL] = "small",
+        [ASEBA_CAN_FILTER_START] = "start",
+        [ASEBA_CAN_FILTER_CONTINUATION] = "continuation",
+    };
+    int i;
+
+    chprintf(chp, "rx frames by filter:\r\n");
+    for (i = 0; i < ASEBA_CAN_FILTER_COUNT; i++) {
+        chprintf(chp, "  %-13s %lu\r\n", filter_names[i],
+                 (unsigned long)can_rx_demux.stats.filter_hits[i]);
+    }
+    chprintf(chp, "rx passed to aseba: %lu\r\n", (unsigned long)can_rx_demux.stats.accepted);
+    chprintf(chp, "rx not for us:      %lu\r\n", (unsigned long)can_rx_demux.stats.dropped);
+    chprintf(chp, "rx overflows:       %lu\r\n", (unsigned long)aseba_can_stats.rx_dropped);
+    chprintf(chp, "tx sent:            %lu\r\n", (unsigned long)can_tx_queue.stats.sent);
+    chprintf(chp, "tx overflows:       %lu\r\n",
+             (unsigned long)(aseba_can_stats.tx_dropped + can_tx_queue.stats.dropped));
+
+    chprintf(chp, "queues:\r\n");
+    chprintf(chp, "  aseba send    %4u frames, %5u bytes\r\n",
+             ASEBA_CAN_SEND_QUEUE_SIZE, (unsigned int)sizeof(aseba_can_send_queue));
+    chprintf(chp, "  aseba receive %4u frames, %5u bytes\r\n",
+             ASEBA_CAN_RECEIVE_QUEUE_SIZE, (unsigned int)sizeof(aseba_can_receive_queue));
+    chprintf(chp, "  mailboxes     %4u frames, %5u bytes, %u used at most\r\n",
+             CAN_TX_QUEUE_SIZE, (unsigned int)sizeof(can_tx_frames),
+             (unsigned int)can_tx_queue.stats.high_water);
 }
 
 static MUTEX_DECL(can_lock);
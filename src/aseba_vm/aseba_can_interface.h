@@ -1,6 +1,7 @@
 #ifndef ASEBA_CAN_INTERFACE_H
 #define ASEBA_CAN_INTERFACE_H
 
+#include <hal.h>
 #include "vm/vm.h"
 
 #ifdef __cplusplus
@@ -12,6 +13,10 @@ void aseba_can_start(AsebaVMState *vm_state);
 void aseba_can_lock(void);
 void aseba_can_unlock(void);
 
+/** Prints the received frames by filter, the packets dropped because they
+ * are not for this node, and the sent frames. */
+void aseba_can_print_stats(BaseSequentialStream *chp);
+
 #ifdef __cplusplus
 }
 #endif
@@ -9,7 +9,10 @@
 #include "transport/buffer/vm-buffer.h"
 #include "aseba_vm/skel_user.h"
 #include "aseba_vm/aseba_node.h"
-#include "flash/flash.h"
+#include "flash/flash_service.h"
+#include "bytecode_store.h"
+
+#define BYTECODE_SECTOR_SIZE (128 * 1024)
 
 void update_aseba_variables_read(void);
 void update_aseba_variables_write(void);
@@ -20,6 +23,7 @@ static uint16 vmBytecode[VM_BYTECODE_SIZE];
 static sint16 vmStack[VM_STACK_SIZE];
 
 static parameter_t nodeId_param;
+static bytecode_store_t bytecode_store;
 
 AsebaVMState vmState = {
     .nodeId = 0, /* changed by aseba_vm_init() */
@@ -86,27 +90,51 @@ static THD_FUNCTION(aseba_vm_thd, arg)
     }
 }
 
-void aseba_vm_init(void)
+struct write_bytecode_args {
+    AsebaVMState *vm;
+    bool success;
+};
+
+static void write_bytecode_job(void *arg)
 {
-    uint16_t bytecode_size;
+    struct write_bytecode_args *args = (struct write_bytecode_args *)arg;
+    AsebaVMState *vm = args->vm;
 
-    vmState.nodeId = parameter_integer_get(&nodeId_param);
+    /* The size is in words. */
+    args->success = bytecode_store_save(&bytecode_store, vm->bytecode,
+                                        vm->bytecodeSize * sizeof(uint16));
+}
 
-    AsebaVMInit(&vmState);
+static void bytecode_store_setup(void)
+{
+    extern uint8_t _aseba_bytecode_start, _aseba_bytecode_end;
 
-    extern uint8_t _aseba_bytecode_start;
-    uint8_t *pos = &_aseba_bytecode_start;
+    bytecode_store_init(&bytecode_store, &_aseba_bytecode_start, BYTECODE_SECTOR_SIZE,
+                        (&_aseba_bytecode_end - &_aseba_bytecode_start) / BYTECODE_SECTOR_SIZE);
+}
 
-    memcpy(&bytecode_size, pos, sizeof(bytecode_size));
+void aseba_vm_migrate_legacy_bytecode(const void *legacy)
+{
+    struct write_bytecode_args args = {.vm = &vmState, .success = false};
 
-    pos += sizeof(uint16_t);
+    bytecode_store_setup();
 
-    // Check if the bytecode page was erased
-    if (bytecode_size != 0xffff) {
-        memcpy(vmState.bytecode, pos, bytecode_size);
+    if (bytecode_store_active_sector(&bytecode_store) >= 0 ||
+        !bytecode_store_legacy_load(legacy, vmState.bytecode, vmState.bytecodeSize)) {
+        return;
     }
 
-    chThdSleepMilliseconds(500);
+    flash_service_run(write_bytecode_job, &args);
+}
+
+void aseba_vm_init(void)
+{
+    vmState.nodeId = parameter_integer_get(&nodeId_param);
+
+    AsebaVMInit(&vmState);
+
+    bytecode_store_setup();
+    bytecode_store_load(&bytecode_store, vmState.bytecode, vmState.bytecodeSize * sizeof(uint16));
 }
 
 void aseba_declare_parameters(parameter_namespace_t *aseba_ns)
@@ -175,11 +203,12 @@ uint16 AsebaShouldDropPacket(uint16 source, const uint8* data)
 
 void AsebaWriteBytecode(AsebaVMState *vm)
 {
-    extern uint8_t _aseba_bytecode_start;
+    struct write_bytecode_args args = {.vm = vm, .success = false};
 
-    flash_unlock();
-    flash_sector_erase(&_aseba_bytecode_start);
-    flash_write(&_aseba_bytecode_start, &vm->bytecodeSize, sizeof(uint16));
-    flash_write(&_aseba_bytecode_start + sizeof(uint16), vm->bytecode, vm->bytecodeSize);
-    flash_lock();
+    flash_service_run(write_bytecode_job, &args);
+
+    /* The previous bytecode is still loaded on the next boot. */
+    if (!args.success) {
+        AsebaVMEmitNodeSpecificError(vm, "Bytecode save failed!");
+    }
 }
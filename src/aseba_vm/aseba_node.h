@@ -31,6 +31,13 @@ extern AsebaVMState vmState;
 void aseba_vm_start(void);
 void aseba_vm_init(void);
 
+/** Moves the bytecode saved at legacy by firmwares older than the bytecode
+ * store into the store, unless it already holds an image.
+ *
+ * Must run before anything erases legacy, and uses the flash service.
+ */
+void aseba_vm_migrate_legacy_bytecode(const void *legacy);
+
 /** Declares all the parameters used by the Aseba subsystem. */
 void aseba_declare_parameters(parameter_namespace_t *aseba_ns);
 
@@ -0,0 +1,63 @@
+#include "can_tx_queue.h"
+
+void can_tx_queue_init(can_tx_queue_t *queue, can_tx_frame_t *frames, size_t size,
+                       can_tx_queue_transmit_fn_t transmit, void *arg)
+{
+    queue->frames = frames;
+    queue->size = size;
+    queue->head = 0;
+    queue->count = 0;
+    queue->transmit = transmit;
+    queue->arg = arg;
+    queue->stats.sent = 0;
+    queue->stats.dropped = 0;
+    queue->stats.high_water = 0;
+}
+
+bool can_tx_queue_push(can_tx_queue_t *queue, const can_tx_frame_t *frame)
+{
+    size_t tail;
+
+    if (queue->count == queue->size) {
+        queue->stats.dropped++;
+        return false;
+    }
+
+    tail = queue->head + queue->count;
+    if (tail >= queue->size) {
+        tail -= queue->size;
+    }
+    queue->frames[tail] = *frame;
+    queue->count++;
+
+    can_tx_queue_drain(queue);
+
+    if (queue->count > queue->stats.high_water) {
+        queue->stats.high_water = queue->count;
+    }
+
+    return true;
+}
+
+size_t can_tx_queue_drain(can_tx_queue_t *queue)
+{
+    size_t moved = 0;
+
+    while (queue->count > 0 && queue->transmit(queue->arg, &queue->frames[queue->head])) {
+        queue->head++;
+        if (queue->head == queue->size) {
+            queue->head = 0;
+        }
+        queue->count--;
+        moved++;
+    }
+
+    queue->stats.sent += moved;
+
+    return moved;
+}
+
+size_t can_tx_queue_space(const can_tx_queue_t *queue)
+{
+    return queue->size - queue->count;
+}
@@ -0,0 +1,75 @@
+#ifndef CAN_TX_QUEUE_H
+#define CAN_TX_QUEUE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** Standard identifier data frame. */
+typedef struct {
+    uint16_t id;
+    uint8_t len;
+    uint8_t data[8];
+} can_tx_frame_t;
+
+/** Loads a frame into a free transmit mailbox of the controller.
+ *
+ * @returns false if every mailbox is busy.
+ */
+typedef bool (*can_tx_queue_transmit_fn_t)(void *arg, const can_tx_frame_t *frame);
+
+typedef struct {
+    uint32_t sent; /**< Frames loaded into a mailbox. */
+    uint32_t dropped; /**< Frames pushed while the queue was full. */
+    uint32_t high_water; /**< Most frames waiting at once. */
+} can_tx_queue_stats_t;
+
+/** Frames waiting for a transmit mailbox.
+ *
+ * Instead of waiting for each frame to be on the bus, frames are queued and
+ * moved into the mailboxes as soon as they are free, which keeps every
+ * mailbox of the controller busy and the bus saturated. Frames keep their
+ * order as long as the controller sends its mailboxes by order of arrival.
+ *
+ * The queue is not locked, pushing and draining must not be done
+ * concurrently.
+ */
+typedef struct {
+    can_tx_frame_t *frames;
+    size_t size;
+    size_t head; /**< Index of the oldest frame. */
+    size_t count;
+    can_tx_queue_transmit_fn_t transmit;
+    void *arg;
+    can_tx_queue_stats_t stats;
+} can_tx_queue_t;
+
+/** Initializes an empty queue of size frames sent with transmit. */
+void can_tx_queue_init(can_tx_queue_t *queue, can_tx_frame_t *frames, size_t size,
+                       can_tx_queue_transmit_fn_t transmit, void *arg);
+
+/** Queues a frame and moves as many frames as possible to the mailboxes.
+ *
+ * @returns false if the queue is full, in which case the frame is dropped.
+ */
+bool can_tx_queue_push(can_tx_queue_t *queue, const can_tx_frame_t *frame);
+
+/** Moves queued frames to the free mailboxes, to be called once a mailbox
+ * is empty.
+ *
+ * @returns the number of frames moved.
+ */
+size_t can_tx_queue_drain(can_tx_queue_t *queue);
+
+/** Returns the number of frames which can still be pushed. */
+size_t can_tx_queue_space(const can_tx_queue_t *queue);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CAN_TX_QUEUE_H */
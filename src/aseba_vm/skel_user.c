@@ -12,7 +12,8 @@
 #include "common/productids.h"
 #include "common/consts.h"
 #include "main.h"
-#include "config_flash_storage.h"
+#include "config_journal.h"
+#include "flash/flash_service.h"
 #include "motor_pwm.h"
 
 #include "sensors/range.h"
@@ -20,7 +21,10 @@
 #include "sensors/encoder.h"
 #include "sensors/motor_current.h"
 #include "sensors/imu.h"
+#include "audio/audio_synth.h"
 #include "audio/audio_thread.h"
+#include "led_animation.h"
+#include "vector_math.h"
 #include "madgwick.h"
 
 #include "motor_pid_thread.h"
@@ -39,8 +43,12 @@ struct _vmVariables previous_vars;
 /* Test if an Aseba variable changed during the VM step. */
 #define VM_VAR_CHANGED(var) (vmVariables.var != previous_vars.var)
 
+/* Parameters are never undeclared, so each one is only looked up once. */
 #define READ_PARAM_TO_VM(var, param) do { \
-        parameter_t *p = parameter_find(&parameter_root, param); \
+        static parameter_t *p = NULL; \
+        if (p == NULL) { \
+            p = parameter_index_find(&parameter_index, param); \
+        } \
         if (p == NULL) { \
             chSysHalt("Cannot find " param); \
         } \
@@ -48,8 +56,11 @@ struct _vmVariables previous_vars;
 } while (0);
 
 #define WRITE_PARAM_FROM_VM(var, param) do { \
+        static parameter_t *p = NULL; \
         if (VM_VAR_CHANGED(var)) { \
-            parameter_t *p = parameter_find(&parameter_root, param); \
+            if (p == NULL) { \
+                p = parameter_index_find(&parameter_index, param); \
+            } \
             if (p == NULL) { \
                 chSysHalt("Cannot find " param); \
             } \
@@ -236,19 +247,23 @@ static THD_FUNCTION(aseba_audio_thd, p)
 {
     (void) p;
     chRegSetThreadName(__FUNCTION__);
-    messagebus_topic_t *topic;
-    audio_play_result_t res;
+    event_listener_t listener;
+    eventflags_t flags;
 
-    topic = messagebus_find_topic_blocking(&bus, "/audio/play/result");
+    /* Several sounds can end at once, none is missed. */
+    chEvtRegisterMaskWithFlags(&audio_events, &listener, EVENT_MASK(0),
+                               AUDIO_EVENT_FINISHED | AUDIO_EVENT_ERROR);
 
     while (true) {
-        messagebus_topic_wait(topic, &res, sizeof(res));
+        chEvtWaitAny(EVENT_MASK(0));
+        flags = chEvtGetAndClearFlags(&listener);
 
-        if (res.status == AUDIO_OK) {
+        if (flags & AUDIO_EVENT_FINISHED) {
             chSysLock();
             SET_EVENT(EVENT_SOUND_PLAY_FINISHED);
             chSysUnlock();
-        } else {
+        }
+        if (flags & AUDIO_EVENT_ERROR) {
             chSysLock();
             SET_EVENT(EVENT_SOUND_ERROR);
             chSysUnlock();
@@ -676,15 +691,13 @@ static AsebaNativeFunctionDescription AsebaNativeDescription_settings_save =
 
 void AsebaNative_settings_save(AsebaVMState *vm)
 {
-    extern uint32_t _config_start, _config_end;
-    size_t len = (size_t)(&_config_end - &_config_start);
     bool success;
 
     // First write the config to flash
-    config_save(&_config_start, len, &parameter_root);
+    success = flash_service_config_save(&config_journal, &parameter_root);
 
     // Second try to read it back, see if we failed
-    success = config_load(&parameter_root, &_config_start);
+    success = success && config_journal_load(&config_journal, &parameter_root);
 
     if (!success) {
         AsebaVMEmitNodeSpecificError(vm, "Config save failed!");
@@ -705,9 +718,7 @@ void AsebaNative_settings_erase(AsebaVMState *vm)
 {
     ASEBA_UNUSED(vm);
 
-    extern uint32_t _config_start;
-
-    config_erase(&_config_start);
+    flash_service_config_erase(&config_journal);
 }
 
 static AsebaNativeFunctionDescription AsebaNativeDescription_sound_play =
@@ -724,20 +735,351 @@ void AsebaNative_sound_play(AsebaVMState *vm)
 {
     uint16 sound_id = vm->variables[AsebaNativePopArg(vm)];
 
-    messagebus_topic_t *req_topic, *res_topic;
-    req_topic = messagebus_find_topic(&bus, "/audio/play/request");
-    res_topic = messagebus_find_topic(&bus, "/audio/play/result");
+    /* Queue the request, the sound is mixed with the ones playing. */
+    audio_play_request_t request;
+    memset(&request, 0, sizeof(request));
+    snprintf(request.path, sizeof(request.path) - 1, "/p%d.wav", sound_id);
+    request.id = sound_id;
+
+    if (!audio_play(&request)) {
+        AsebaVMEmitNodeSpecificError(vm, "Too many sounds queued.");
+    }
+}
+
+static AsebaNativeFunctionDescription AsebaNativeDescription_sound_notes =
+{
+    "sound.notes",
+    "Play notes, each key * 256 + length / 10 ms, key 0 being a rest "
+    "(instrument 0: beep, 1: chime, 2: organ, 3: buzz)",
+    {
+        {-1, "notes"},
+        {1, "instrument"},
+        {0, 0}
+    }
+};
+
+void AsebaNative_sound_notes(AsebaVMState *vm)
+{
+    uint16 notes = AsebaNativePopArg(vm);
+    uint16 instrument = vm->variables[AsebaNativePopArg(vm)];
+    uint16 length = AsebaNativePopArg(vm);
 
-    if (req_topic == NULL || res_topic == NULL) {
-        AsebaVMEmitNodeSpecificError(vm, "Cannot find topics. Is audio thread running?");
+    if (length > AUDIO_PLAY_MAX_NOTES) {
+        AsebaVMEmitNodeSpecificError(vm, "Too many notes.");
         return;
     }
 
-    /* Send the request */
+    if (audio_synth_instrument_builtin(instrument) == NULL) {
+        AsebaVMEmitNodeSpecificError(vm, "Invalid instrument index.");
+        return;
+    }
+
+    /* Generated on the robot, so it plays even without a card. */
     audio_play_request_t request;
     memset(&request, 0, sizeof(request));
-    snprintf(request.path, sizeof(request.path) - 1, "/p%d.wav", sound_id);
-    messagebus_topic_publish(req_topic, &request, sizeof(request));
+    memcpy(request.notes, &vm->variables[notes], length * sizeof(uint16_t));
+    request.note_count = length;
+    request.instrument = instrument;
+
+    if (!audio_play(&request)) {
+        AsebaVMEmitNodeSpecificError(vm, "Too many sounds queued.");
+    }
+}
+
+static AsebaNativeFunctionDescription AsebaNativeDescription_leds_animation =
+{
+    "leds.animation",
+    "Play a builtin LED animation (0: stop, 1: breathing, 2: chase, 3: blink)",
+    {
+        {1, "Index of the animation to play"},
+        {0, 0}
+    }
+};
+
+void AsebaNative_leds_animation(AsebaVMState *vm)
+{
+    uint16 animation_id = vm->variables[AsebaNativePopArg(vm)];
+
+    if (animation_id == LED_ANIMATION_NONE) {
+        body_leds_animation_stop();
+        return;
+    }
+
+    const led_animation_desc_t *desc = led_animation_builtin(animation_id);
+
+    if (desc == NULL) {
+        AsebaVMEmitNodeSpecificError(vm, "Invalid animation index.");
+        return;
+    }
+
+    body_leds_animation_start(desc);
+}
+
+// Vector natives, which saturate unlike the math ones of the standard library
+static bool vec_check_shift(AsebaVMState *vm, uint16 shift)
+{
+    if (shift >= 32) {
+        AsebaVMEmitNodeSpecificError(vm, "Invalid shift.");
+        return false;
+    }
+    return true;
+}
+
+static AsebaNativeFunctionDescription AsebaNativeDescription_vec_fill =
+{
+    "vec.fill",
+    "Fill an array with a value",
+    {
+        {-1, "dest"},
+        {1, "value"},
+        {0, 0}
+    }
+};
+
+void AsebaNative_vec_fill(AsebaVMState *vm)
+{
+    uint16 dest = AsebaNativePopArg(vm);
+    sint16 value = vm->variables[AsebaNativePopArg(vm)];
+    uint16 length = AsebaNativePopArg(vm);
+
+    vector_math_fill(&vm->variables[dest], value, length);
+}
+
+static AsebaNativeFunctionDescription AsebaNativeDescription_vec_copy =
+{
+    "vec.copy",
+    "Copy an array",
+    {
+        {-1, "dest"},
+        {-1, "src"},
+        {0, 0}
+    }
+};
+
+void AsebaNative_vec_copy(AsebaVMState *vm)
+{
+    uint16 dest = AsebaNativePopArg(vm);
+    uint16 src = AsebaNativePopArg(vm);
+    uint16 length = AsebaNativePopArg(vm);
+
+    vector_math_copy(&vm->variables[dest], &vm->variables[src], length);
+}
+
+static AsebaNativeFunctionDescription AsebaNativeDescription_vec_add =
+{
+    "vec.add",
+    "dest = a + b, saturated",
+    {
+        {-1, "dest"},
+        {-1, "a"},
+        {-1, "b"},
+        {0, 0}
+    }
+};
+
+void AsebaNative_vec_add(AsebaVMState *vm)
+{
+    uint16 dest = AsebaNativePopArg(vm);
+    uint16 a = AsebaNativePopArg(vm);
+    uint16 b = AsebaNativePopArg(vm);
+    uint16 length = AsebaNativePopArg(vm);
+
+    vector_math_add(&vm->variables[dest], &vm->variables[a], &vm->variables[b], length);
+}
+
+static AsebaNativeFunctionDescription AsebaNativeDescription_vec_sub =
+{
+    "vec.sub",
+    "dest = a - b, saturated",
+    {
+        {-1, "dest"},
+        {-1, "a"},
+        {-1, "b"},
+        {0, 0}
+    }
+};
+
+void AsebaNative_vec_sub(AsebaVMState *vm)
+{
+    uint16 dest = AsebaNativePopArg(vm);
+    uint16 a = AsebaNativePopArg(vm);
+    uint16 b = AsebaNativePopArg(vm);
+    uint16 length = AsebaNativePopArg(vm);
+
+    vector_math_sub(&vm->variables[dest], &vm->variables[a], &vm->variables[b], length);
+}
+
+static AsebaNativeFunctionDescription AsebaNativeDescription_vec_mul =
+{
+    "vec.mul",
+    "dest = (a * b) >> shift, saturated",
+    {
+        {-1, "dest"},
+        {-1, "a"},
+        {-1, "b"},
+        {1, "shift"},
+        {0, 0}
+    }
+};
+
+void AsebaNative_vec_mul(AsebaVMState *vm)
+{
+    uint16 dest = AsebaNativePopArg(vm);
+    uint16 a = AsebaNativePopArg(vm);
+    uint16 b = AsebaNativePopArg(vm);
+    uint16 shift = vm->variables[AsebaNativePopArg(vm)];
+    uint16 length = AsebaNativePopArg(vm);
+
+    if (vec_check_shift(vm, shift)) {
+        vector_math_mul(&vm->variables[dest], &vm->variables[a], &vm->variables[b], shift,
+                        length);
+    }
+}
+
+static AsebaNativeFunctionDescription AsebaNativeDescription_vec_dot =
+{
+    "vec.dot",
+    "Scalar product of a and b, shifted right by shift, saturated",
+    {
+        {1, "dest"},
+        {-1, "a"},
+        {-1, "b"},
+        {1, "shift"},
+        {0, 0}
+    }
+};
+
+void AsebaNative_vec_dot(AsebaVMState *vm)
+{
+    uint16 dest = AsebaNativePopArg(vm);
+    uint16 a = AsebaNativePopArg(vm);
+    uint16 b = AsebaNativePopArg(vm);
+    uint16 shift = vm->variables[AsebaNativePopArg(vm)];
+    uint16 length = AsebaNativePopArg(vm);
+
+    if (vec_check_shift(vm, shift)) {
+        vm->variables[dest] = vector_math_dot(&vm->variables[a], &vm->variables[b], shift,
+                                              length);
+    }
+}
+
+static AsebaNativeFunctionDescription AsebaNativeDescription_vec_min =
+{
+    "vec.min",
+    "dest = min(a, b), element by element",
+    {
+        {-1, "dest"},
+        {-1, "a"},
+        {-1, "b"},
+        {0, 0}
+    }
+};
+
+void AsebaNative_vec_min(AsebaVMState *vm)
+{
+    uint16 dest = AsebaNativePopArg(vm);
+    uint16 a = AsebaNativePopArg(vm);
+    uint16 b = AsebaNativePopArg(vm);
+    uint16 length = AsebaNativePopArg(vm);
+
+    vector_math_min(&vm->variables[dest], &vm->variables[a], &vm->variables[b], length);
+}
+
+static AsebaNativeFunctionDescription AsebaNativeDescription_vec_max =
+{
+    "vec.max",
+    "dest = max(a, b), element by element",
+    {
+        {-1, "dest"},
+        {-1, "a"},
+        {-1, "b"},
+        {0, 0}
+    }
+};
+
+void AsebaNative_vec_max(AsebaVMState *vm)
+{
+    uint16 dest = AsebaNativePopArg(vm);
+    uint16 a = AsebaNativePopArg(vm);
+    uint16 b = AsebaNativePopArg(vm);
+    uint16 length = AsebaNativePopArg(vm);
+
+    vector_math_max(&vm->variables[dest], &vm->variables[a], &vm->variables[b], length);
+}
+
+static AsebaNativeFunctionDescription AsebaNativeDescription_vec_argmax =
+{
+    "vec.argmax",
+    "Index of the largest element, the first one if there are several",
+    {
+        {1, "dest"},
+        {-1, "a"},
+        {0, 0}
+    }
+};
+
+void AsebaNative_vec_argmax(AsebaVMState *vm)
+{
+    uint16 dest = AsebaNativePopArg(vm);
+    uint16 a = AsebaNativePopArg(vm);
+    uint16 length = AsebaNativePopArg(vm);
+
+    vm->variables[dest] = vector_math_argmax(&vm->variables[a], length);
+}
+
+static AsebaNativeFunctionDescription AsebaNativeDescription_vec_wsum =
+{
+    "vec.wsum",
+    "dest = (a * weight_a + b * weight_b) >> shift, saturated",
+    {
+        {-1, "dest"},
+        {-1, "a"},
+        {-1, "b"},
+        {1, "weight_a"},
+        {1, "weight_b"},
+        {1, "shift"},
+        {0, 0}
+    }
+};
+
+void AsebaNative_vec_wsum(AsebaVMState *vm)
+{
+    uint16 dest = AsebaNativePopArg(vm);
+    uint16 a = AsebaNativePopArg(vm);
+    uint16 b = AsebaNativePopArg(vm);
+    sint16 weight_a = vm->variables[AsebaNativePopArg(vm)];
+    sint16 weight_b = vm->variables[AsebaNativePopArg(vm)];
+    uint16 shift = vm->variables[AsebaNativePopArg(vm)];
+    uint16 length = AsebaNativePopArg(vm);
+
+    if (vec_check_shift(vm, shift)) {
+        vector_math_weighted_sum(&vm->variables[dest], &vm->variables[a], &vm->variables[b],
+                                 weight_a, weight_b, shift, length);
+    }
+}
+
+static AsebaNativeFunctionDescription AsebaNativeDescription_vec_clamp =
+{
+    "vec.clamp",
+    "dest = a, limited to [low, high]",
+    {
+        {-1, "dest"},
+        {-1, "a"},
+        {1, "low"},
+        {1, "high"},
+        {0, 0}
+    }
+};
+
+void AsebaNative_vec_clamp(AsebaVMState *vm)
+{
+    uint16 dest = AsebaNativePopArg(vm);
+    uint16 a = AsebaNativePopArg(vm);
+    sint16 low = vm->variables[AsebaNativePopArg(vm)];
+    sint16 high = vm->variables[AsebaNativePopArg(vm)];
+    uint16 length = AsebaNativePopArg(vm);
+
+    vector_math_clamp(&vm->variables[dest], &vm->variables[a], low, high, length);
 }
 
 // Native function descriptions
@@ -749,6 +1091,19 @@ const AsebaNativeFunctionDescription* nativeFunctionsDescription[] = {
     &AsebaNativeDescription_settings_erase,
     &AsebaNativeDescription_sound_play,
     ASEBA_NATIVES_STD_DESCRIPTIONS,
+    &AsebaNativeDescription_vec_fill,
+    &AsebaNativeDescription_vec_copy,
+    &AsebaNativeDescription_vec_add,
+    &AsebaNativeDescription_vec_sub,
+    &AsebaNativeDescription_vec_mul,
+    &AsebaNativeDescription_vec_dot,
+    &AsebaNativeDescription_vec_min,
+    &AsebaNativeDescription_vec_max,
+    &AsebaNativeDescription_vec_argmax,
+    &AsebaNativeDescription_vec_wsum,
+    &AsebaNativeDescription_vec_clamp,
+    &AsebaNativeDescription_leds_animation,
+    &AsebaNativeDescription_sound_notes,
     0
 };
 
@@ -761,6 +1116,19 @@ AsebaNativeFunctionPointer nativeFunctions[] = {
     AsebaNative_settings_erase,
     AsebaNative_sound_play,
     ASEBA_NATIVES_STD_FUNCTIONS,
+    AsebaNative_vec_fill,
+    AsebaNative_vec_copy,
+    AsebaNative_vec_add,
+    AsebaNative_vec_sub,
+    AsebaNative_vec_mul,
+    AsebaNative_vec_dot,
+    AsebaNative_vec_min,
+    AsebaNative_vec_max,
+    AsebaNative_vec_argmax,
+    AsebaNative_vec_wsum,
+    AsebaNative_vec_clamp,
+    AsebaNative_leds_animation,
+    AsebaNative_sound_notes,
 };
 
 const int nativeFunctions_length = sizeof(nativeFunctions) / sizeof(nativeFunctions[0]);
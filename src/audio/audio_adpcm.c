@@ -0,0 +1,197 @@
+#include "audio_adpcm.h"
+
+/* Compressed bytes read at once. */
+#define AUDIO_ADPCM_CHUNK 64
+
+#define AUDIO_ADPCM_MAX_STEP_INDEX 88
+
+/* Quantizer step for each step index. */
+static const int16_t step_table[AUDIO_ADPCM_MAX_STEP_INDEX + 1] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45, 50, 55, 60,
+    66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230, 253, 279, 307, 337, 371,
+    408, 449, 494, 544, 598, 658, 724, 796, 876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878,
+    2066, 2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845,
+    8630, 9493, 10442, 11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086,
+    29794, 32767,
+};
+
+/* Step index change for each code. */
+static const int8_t index_table[16] = {
+    -1, -1, -1, -1, 2, 4, 6, 8,
+    -1, -1, -1, -1, 2, 4, 6, 8,
+};
+
+static inline int16_t decode_code(int32_t *predictor, int32_t *step_index, uint32_t code)
+{
+    int32_t step = step_table[*step_index];
+    int32_t diff = step >> 3;
+
+    /* diff = ((code & 7) + 1/2) * step / 4, truncating each term like the
+     * reference decoder, so that the output is bit exact. */
+    if (code & 4) {
+        diff += step;
+    }
+    if (code & 2) {
+        diff += step >> 1;
+    }
+    if (code & 1) {
+        diff += step >> 2;
+    }
+
+    if (code & 8) {
+        *predictor -= diff;
+        if (*predictor < INT16_MIN) {
+            *predictor = INT16_MIN;
+        }
+    } else {
+        *predictor += diff;
+        if (*predictor > INT16_MAX) {
+            *predictor = INT16_MAX;
+        }
+    }
+
+    *step_index += index_table[code];
+    if (*step_index < 0) {
+        *step_index = 0;
+    } else if (*step_index > AUDIO_ADPCM_MAX_STEP_INDEX) {
+        *step_index = AUDIO_ADPCM_MAX_STEP_INDEX;
+    }
+
+    return *predictor;
+}
+
+void audio_adpcm_decode(audio_adpcm_state_t *state, const uint8_t *codes, int16_t *out,
+                        size_t count)
+{
+    /* Kept in registers for the whole loop. */
+    int32_t predictor = state->predictor;
+    int32_t step_index = state->step_index;
+    size_t i;
+
+    for (i = 0; i < count / 2; i++) {
+        out[2 * i] = decode_code(&predictor, &step_index, codes[i] & 0xf);
+        out[2 * i + 1] = decode_code(&predictor, &step_index, codes[i] >> 4);
+    }
+
+    state->predictor = predictor;
+    state->step_index = step_index;
+}
+
+void audio_adpcm_decoder_init(audio_adpcm_decoder_t *decoder, uint32_t block_align, uint32_t size,
+                              audio_adpcm_read_fn_t read, void *arg)
+{
+    decoder->read = read;
+    decoder->arg = arg;
+    decoder->block_align = block_align;
+    decoder->block_left = 0;
+    decoder->left = size;
+    decoder->has_pending = false;
+}
+
+/* Reads the header of the next block, returns false if it is invalid or
+ * there is no complete one. */
+static bool audio_adpcm_start_block(audio_adpcm_decoder_t *decoder)
+{
+    uint8_t header[AUDIO_ADPCM_BLOCK_HEADER];
+
+    if (decoder->left < AUDIO_ADPCM_BLOCK_HEADER ||
+        decoder->block_align <= AUDIO_ADPCM_BLOCK_HEADER ||
+        decoder->read(decoder->arg, header, sizeof(header)) != sizeof(header)) {
+        return false;
+    }
+
+    decoder->state.predictor = (int16_t)(header[0] | header[1] << 8);
+    decoder->state.step_index = header[2];
+    if (decoder->state.step_index > AUDIO_ADPCM_MAX_STEP_INDEX) {
+        return false;
+    }
+
+    decoder->left -= AUDIO_ADPCM_BLOCK_HEADER;
+    decoder->block_left = decoder->block_align - AUDIO_ADPCM_BLOCK_HEADER;
+    if (decoder->block_left > decoder->left) {
+        decoder->block_left = decoder->left;
+    }
+
+    return true;
+}
+
+bool audio_adpcm_decoder_read(void *arg, int16_t *buffer, size_t len, size_t *samples_read)
+{
+    audio_adpcm_decoder_t *decoder = (audio_adpcm_decoder_t *)arg;
+    uint8_t chunk[AUDIO_ADPCM_CHUNK];
+    int16_t pair[2];
+    size_t n = 0, bytes;
+
+    while (n < len) {
+        if (decoder->has_pending) {
+            buffer[n++] = decoder->pending;
+            decoder->has_pending = false;
+            continue;
+        }
+
+        if (decoder->left == 0) {
+            break;
+        }
+
+        /* The header holds the first sample of the block. */
+        if (decoder->block_left == 0) {
+            if (!audio_adpcm_start_block(decoder)) {
+                decoder->left = 0;
+                break;
+            }
+            buffer[n++] = decoder->state.predictor;
+            continue;
+        }
+
+        bytes = (len - n) / 2;
+        if (bytes == 0) {
+            bytes = 1;
+        }
+        if (bytes > decoder->block_left) {
+            bytes = decoder->block_left;
+        }
+        if (bytes > AUDIO_ADPCM_CHUNK) {
+            bytes = AUDIO_ADPCM_CHUNK;
+        }
+
+        bytes = decoder->read(decoder->arg, chunk, bytes);
+        if (bytes == 0) {
+            decoder->left = 0;
+            break;
+        }
+        decoder->block_left -= bytes;
+        decoder->left -= bytes;
+
+        /* Room for a single sample, the other one is kept for later. */
+        if (n + 1 == len) {
+            audio_adpcm_decode(&decoder->state, chunk, pair, 2);
+            buffer[n++] = pair[0];
+            decoder->pending = pair[1];
+            decoder->has_pending = true;
+            continue;
+        }
+
+        audio_adpcm_decode(&decoder->state, chunk, &buffer[n], 2 * bytes);
+        n += 2 * bytes;
+    }
+
+    *samples_read = n;
+    return decoder->left == 0 && !decoder->has_pending;
+}
+
+uint32_t audio_adpcm_sample_count(uint32_t block_align, uint32_t size)
+{
+    uint32_t count, rest;
+
+    if (block_align <= AUDIO_ADPCM_BLOCK_HEADER) {
+        return 0;
+    }
+
+    count = size / block_align * AUDIO_ADPCM_SAMPLES_PER_BLOCK(block_align);
+    rest = size % block_align;
+    if (rest >= AUDIO_ADPCM_BLOCK_HEADER) {
+        count += AUDIO_ADPCM_SAMPLES_PER_BLOCK(rest);
+    }
+
+    return count;
+}
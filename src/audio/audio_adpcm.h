@@ -0,0 +1,70 @@
+#ifndef AUDIO_ADPCM_H
+#define AUDIO_ADPCM_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+/** Size of the header starting each block of an IMA ADPCM WAV file. */
+#define AUDIO_ADPCM_BLOCK_HEADER 4
+
+/** Number of samples in a mono block of the given size in bytes. */
+#define AUDIO_ADPCM_SAMPLES_PER_BLOCK(block_align) \
+    (((block_align) - AUDIO_ADPCM_BLOCK_HEADER) * 2 + 1)
+
+typedef struct {
+    int32_t predictor;
+    int32_t step_index;
+} audio_adpcm_state_t;
+
+/** Decodes count samples from 4 bit IMA ADPCM codes, two per byte with the
+ * low nibble first as in WAV files. count must be even. */
+void audio_adpcm_decode(audio_adpcm_state_t *state, const uint8_t *codes, int16_t *out,
+                        size_t count);
+
+/** Reads up to len bytes of compressed data.
+ *
+ * @returns the number of bytes read, 0 at the end or on error.
+ */
+typedef size_t (*audio_adpcm_read_fn_t)(void *arg, uint8_t *buffer, size_t len);
+
+/** Decodes the data chunk of a mono IMA ADPCM WAV file as it is read.
+ *
+ * The data is a sequence of blocks, each starting with a header which holds
+ * the first sample and the decoder state, so a block does not depend on the
+ * previous ones.
+ */
+typedef struct {
+    audio_adpcm_read_fn_t read;
+    void *arg;
+    audio_adpcm_state_t state;
+    uint32_t block_align; /**< Size of a block in bytes. */
+    uint32_t block_left; /**< Bytes left in the current block. */
+    uint32_t left; /**< Bytes left in the data. */
+    int16_t pending; /**< Second sample of a byte of which one was output. */
+    bool has_pending;
+} audio_adpcm_decoder_t;
+
+/** Initializes a decoder for size bytes of data made of blocks of block_align
+ * bytes, read with the given function. */
+void audio_adpcm_decoder_init(audio_adpcm_decoder_t *decoder, uint32_t block_align, uint32_t size,
+                              audio_adpcm_read_fn_t read, void *arg);
+
+/** Audio source decoding the data, see audio_source_t.
+ *
+ * Ends early if the data cannot be read or a block header is invalid.
+ */
+bool audio_adpcm_decoder_read(void *arg, int16_t *buffer, size_t len, size_t *samples_read);
+
+/** Returns the number of samples in size bytes of data. */
+uint32_t audio_adpcm_sample_count(uint32_t block_align, uint32_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AUDIO_ADPCM_H */
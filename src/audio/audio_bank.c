@@ -0,0 +1,133 @@
+#include <ctype.h>
+#include <string.h>
+#include "audio_bank.h"
+
+/* Bytes read at once while loading. */
+#define AUDIO_BANK_CHUNK 512
+
+void audio_bank_init(audio_bank_t *bank, uint8_t *pool, size_t pool_size,
+                     audio_bank_entry_t *entries, size_t max_entries)
+{
+    bank->pool = pool;
+    bank->pool_size = pool_size;
+    bank->entries = entries;
+    bank->max_entries = max_entries;
+    audio_bank_clear(bank);
+}
+
+void audio_bank_clear(audio_bank_t *bank)
+{
+    bank->count = 0;
+    bank->used = 0;
+}
+
+bool audio_bank_load(audio_bank_t *bank, const char *name, uint32_t sample_rate,
+                     uint32_t block_align, size_t size, audio_adpcm_read_fn_t read, void *arg)
+{
+    uint8_t chunk[AUDIO_BANK_CHUNK];
+    audio_bank_entry_t *entry;
+    size_t done, len, n;
+
+    if (bank->count == bank->max_entries || size > bank->pool_size - bank->used ||
+        strlen(name) >= AUDIO_BANK_NAME_LEN || sample_rate == 0) {
+        return false;
+    }
+
+    for (done = 0; done < size; done += n) {
+        len = size - done;
+        if (len > AUDIO_BANK_CHUNK) {
+            len = AUDIO_BANK_CHUNK;
+        }
+
+        n = read(arg, chunk, len);
+        if (n == 0) {
+            return false;
+        }
+        memcpy(&bank->pool[bank->used + done], chunk, n);
+    }
+
+    entry = &bank->entries[bank->count];
+    strcpy(entry->name, name);
+    entry->sample_rate = sample_rate;
+    entry->block_align = block_align;
+    entry->offset = bank->used;
+    entry->size = size;
+
+    /* The next clip starts word aligned. */
+    bank->used += (size + 3) & ~3u;
+    if (bank->used > bank->pool_size) {
+        bank->used = bank->pool_size;
+    }
+
+    /* The entry must be complete before readers see it. */
+    __sync_synchronize();
+    bank->count++;
+
+    return true;
+}
+
+static bool name_equal(const char *a, const char *b)
+{
+    while (*a != '\0' && tolower((unsigned char)*a) == tolower((unsigned char)*b)) {
+        a++;
+        b++;
+    }
+
+    return *a == *b;
+}
+
+const audio_bank_entry_t *audio_bank_find(audio_bank_t *bank, const char *name)
+{
+    size_t count = bank->count;
+    size_t i;
+
+    for (i = 0; i < count; i++) {
+        if (name_equal(bank->entries[i].name, name)) {
+            return &bank->entries[i];
+        }
+    }
+
+    return NULL;
+}
+
+/* Reads the compressed data of a clip, see audio_adpcm_read_fn_t. */
+static size_t audio_clip_read_data(void *arg, uint8_t *buffer, size_t len)
+{
+    audio_clip_t *clip = (audio_clip_t *)arg;
+
+    if (len > clip->left) {
+        len = clip->left;
+    }
+
+    memcpy(buffer, clip->data, len);
+    clip->data += len;
+    clip->left -= len;
+
+    return len;
+}
+
+void audio_clip_init(audio_clip_t *clip, audio_bank_t *bank, const audio_bank_entry_t *entry)
+{
+    clip->data = &bank->pool[entry->offset];
+    clip->left = entry->size;
+    clip->compressed = entry->block_align != 0;
+
+    if (clip->compressed) {
+        audio_adpcm_decoder_init(&clip->adpcm, entry->block_align, entry->size,
+                                 audio_clip_read_data, clip);
+    }
+}
+
+bool audio_clip_read(void *arg, int16_t *buffer, size_t len, size_t *samples_read)
+{
+    audio_clip_t *clip = (audio_clip_t *)arg;
+
+    if (clip->compressed) {
+        return audio_adpcm_decoder_read(&clip->adpcm, buffer, len, samples_read);
+    }
+
+    len = audio_clip_read_data(clip, (uint8_t *)buffer, len * sizeof(int16_t));
+
+    *samples_read = len / sizeof(int16_t);
+    return clip->left < sizeof(int16_t);
+}
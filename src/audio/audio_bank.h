@@ -0,0 +1,83 @@
+#ifndef AUDIO_BANK_H
+#define AUDIO_BANK_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "audio_adpcm.h"
+#include "audio_stream.h"
+
+/** Longest path of a clip, like "/p12.wav". */
+#define AUDIO_BANK_NAME_LEN 13
+
+typedef struct {
+    char name[AUDIO_BANK_NAME_LEN]; /**< Path of the file it was loaded from. */
+    uint32_t sample_rate;
+    uint32_t block_align; /**< 0 for 16 bit PCM, size of the blocks of IMA ADPCM data. */
+    uint32_t offset; /**< First byte in the pool. */
+    uint32_t size; /**< In bytes. */
+} audio_bank_entry_t;
+
+/** Short sounds kept in RAM, so that they start without accessing the card.
+ *
+ * Clips are packed one after the other in a pool and looked up by the path of
+ * their file. They are kept as they are stored in the file, so compressed
+ * ones take less room and are decoded while playing. There is a single writer, loading the clips, while
+ * other threads can look them up: entries become visible once loaded.
+ */
+typedef struct {
+    uint8_t *pool;
+    size_t pool_size; /**< In bytes. */
+    size_t used; /**< Bytes of the pool holding clips. */
+    audio_bank_entry_t *entries;
+    size_t max_entries;
+    volatile size_t count;
+} audio_bank_t;
+
+/** Plays a clip of the bank, used as audio_source_t. */
+typedef struct {
+    const uint8_t *data;
+    size_t left; /**< In bytes. */
+    bool compressed;
+    audio_adpcm_decoder_t adpcm;
+} audio_clip_t;
+
+/** Initializes an empty bank storing up to pool_size bytes in pool, which
+ * must be word aligned. */
+void audio_bank_init(audio_bank_t *bank, uint8_t *pool, size_t pool_size,
+                     audio_bank_entry_t *entries, size_t max_entries);
+
+/** Removes all clips. */
+void audio_bank_clear(audio_bank_t *bank);
+
+/** Stores size bytes of samples as a new clip, either 16 bit PCM if
+ * block_align is 0, or IMA ADPCM blocks.
+ *
+ * The data is read through a small buffer on the stack, so that the read
+ * function can use DMA even if the pool is in memory the DMA cannot reach.
+ *
+ * @returns false if the bank is full, the sample rate is 0 or the data ended
+ * early, in which case nothing was added.
+ */
+bool audio_bank_load(audio_bank_t *bank, const char *name, uint32_t sample_rate,
+                     uint32_t block_align, size_t size, audio_adpcm_read_fn_t read, void *arg);
+
+/** Returns the clip loaded from the given path, ignoring case like FAT does,
+ * or NULL. */
+const audio_bank_entry_t *audio_bank_find(audio_bank_t *bank, const char *name);
+
+/** Sets a clip up to play the given entry. */
+void audio_clip_init(audio_clip_t *clip, audio_bank_t *bank, const audio_bank_entry_t *entry);
+
+/** Audio source playing a clip, see audio_source_t. */
+bool audio_clip_read(void *arg, int16_t *buffer, size_t len, size_t *samples_read);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AUDIO_BANK_H */
@@ -0,0 +1,191 @@
+#include <string.h>
+#include "audio_pcm.h"
+#include "audio_mixer.h"
+
+void audio_mixer_init(audio_mixer_t *mixer, uint32_t sample_rate)
+{
+    memset(mixer, 0, sizeof(*mixer));
+    mixer->sample_rate = sample_rate;
+}
+
+audio_voice_t *audio_mixer_reserve(audio_mixer_t *mixer)
+{
+    int i;
+
+    for (i = 0; i < AUDIO_MIXER_VOICES; i++) {
+        if (mixer->voices[i].state == AUDIO_VOICE_IDLE) {
+            mixer->voices[i].state = AUDIO_VOICE_RESERVED;
+            return &mixer->voices[i];
+        }
+    }
+
+    return NULL;
+}
+
+bool audio_mixer_play(audio_mixer_t *mixer, audio_voice_t *voice, uint32_t id,
+                      uint32_t sample_rate, audio_stream_t *stream, audio_source_t source,
+                      void *arg)
+{
+    if (!audio_resampler_init(&voice->resampler, sample_rate, mixer->sample_rate)) {
+        return false;
+    }
+
+    voice->input_end = false;
+    voice->id = id;
+    voice->stream = stream;
+    voice->source = source;
+    voice->arg = arg;
+    voice->underruns = 0;
+    voice->position = 0;
+
+    /* The voice must be set up before the mixer sees it. */
+    __sync_synchronize();
+    voice->state = AUDIO_VOICE_PLAYING;
+
+    return true;
+}
+
+void audio_mixer_release(audio_voice_t *voice)
+{
+    voice->state = AUDIO_VOICE_IDLE;
+}
+
+bool audio_mixer_is_playing(audio_mixer_t *mixer)
+{
+    int i;
+
+    for (i = 0; i < AUDIO_MIXER_VOICES; i++) {
+        if (mixer->voices[i].state == AUDIO_VOICE_PLAYING) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/* Reads up to len samples of the voice, at its own rate.
+ *
+ * Returns true if the voice has no more samples after those. */
+static bool audio_mixer_voice_read(audio_voice_t *voice, int16_t *buffer, size_t len,
+                                   size_t *count)
+{
+    audio_stream_t *stream = voice->stream;
+    size_t available;
+    bool end;
+
+    if (stream == NULL) {
+        *count = 0;
+        return voice->source(voice->arg, buffer, len, count);
+    }
+
+    /* end is read before the samples, so none can be missed. */
+    end = stream->end;
+    available = audio_stream_available(stream);
+    *count = audio_stream_read(stream, buffer, len);
+
+    return end && *count == available;
+}
+
+/* Renders a voice at another rate than the mixer through its resampler,
+ * returns true once the voice has no more samples. */
+static bool audio_mixer_voice_resample(audio_mixer_t *mixer, audio_voice_t *voice,
+                                       int16_t *buffer, size_t len)
+{
+    audio_resampler_t *resampler = &voice->resampler;
+    size_t done, n, space, count;
+    int16_t *input;
+
+    for (done = 0; done < len; done += n) {
+        n = len - done;
+        if (n > AUDIO_MIXER_BLOCK) {
+            n = AUDIO_MIXER_BLOCK;
+        }
+
+        n = audio_resampler_process(resampler, mixer->scratch, n);
+        audio_pcm_mix(&buffer[done], mixer->scratch, n);
+        voice->position += n;
+
+        if (n > 0) {
+            continue;
+        }
+
+        if (voice->input_end) {
+            return true;
+        }
+
+        input = audio_resampler_input(resampler, &space);
+        if (audio_mixer_voice_read(voice, input, space, &count)) {
+            voice->input_end = true;
+        }
+        audio_resampler_push(resampler, count);
+
+        if (voice->input_end) {
+            audio_resampler_flush(resampler);
+        } else if (count == 0) {
+            /* The stream is late, the rest stays silent. */
+            voice->underruns++;
+            break;
+        }
+    }
+
+    return false;
+}
+
+/* Returns true once the voice has no more samples. */
+static bool audio_mixer_voice_render(audio_mixer_t *mixer, audio_voice_t *voice,
+                                     int16_t *buffer, size_t len)
+{
+    size_t done, n, count;
+
+    if (!audio_resampler_is_unity(&voice->resampler)) {
+        return audio_mixer_voice_resample(mixer, voice, buffer, len);
+    }
+
+    for (done = 0; done < len; done += n) {
+        n = len - done;
+        if (n > AUDIO_MIXER_BLOCK) {
+            n = AUDIO_MIXER_BLOCK;
+        }
+
+        if (audio_mixer_voice_read(voice, mixer->scratch, n, &count)) {
+            audio_pcm_mix(&buffer[done], mixer->scratch, count);
+            voice->position += count;
+            return true;
+        }
+
+        audio_pcm_mix(&buffer[done], mixer->scratch, count);
+        voice->position += count;
+
+        /* The rest stays silent, the voice resumes where it was next time. */
+        if (count < n) {
+            voice->underruns++;
+            break;
+        }
+    }
+
+    return false;
+}
+
+uint32_t audio_mixer_render(audio_mixer_t *mixer, int16_t *buffer, size_t len)
+{
+    audio_voice_t *voice;
+    uint32_t finished = 0;
+    int i;
+
+    memset(buffer, 0, len * sizeof(int16_t));
+
+    for (i = 0; i < AUDIO_MIXER_VOICES; i++) {
+        voice = &mixer->voices[i];
+
+        if (voice->state != AUDIO_VOICE_PLAYING) {
+            continue;
+        }
+
+        if (audio_mixer_voice_render(mixer, voice, buffer, len)) {
+            voice->state = AUDIO_VOICE_FINISHED;
+            finished |= 1 << i;
+        }
+    }
+
+    return finished;
+}
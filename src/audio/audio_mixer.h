@@ -0,0 +1,92 @@
+#ifndef AUDIO_MIXER_H
+#define AUDIO_MIXER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "audio_resampler.h"
+#include "audio_stream.h"
+
+/** Number of sounds which can play at the same time. */
+#define AUDIO_MIXER_VOICES 3
+
+/** Samples rendered from each voice at once. */
+#define AUDIO_MIXER_BLOCK 128
+
+typedef enum {
+    AUDIO_VOICE_IDLE = 0,
+    AUDIO_VOICE_RESERVED, /**< Being prepared by the thread which starts it. */
+    AUDIO_VOICE_PLAYING, /**< Owned by the mixer. */
+    AUDIO_VOICE_FINISHED, /**< Done, to be released by the thread which started it. */
+} audio_voice_state_t;
+
+/** A sound played by the mixer.
+ *
+ * Samples come either from a stream, filled by another thread because the
+ * source is slow like a file on the card, or straight from a source which is
+ * fast enough to be called while refilling the DAC, like a tone. They are
+ * resampled to the rate of the mixer if needed.
+ */
+typedef struct {
+    volatile audio_voice_state_t state;
+    uint32_t id; /**< Identifies the request which started the voice. */
+    audio_stream_t *stream;
+    audio_source_t source;
+    void *arg;
+    uint32_t underruns; /**< Blocks where the stream was late. */
+    uint32_t position; /**< Samples mixed so far, at the rate of the mixer. */
+    audio_resampler_t resampler;
+    bool input_end; /**< All samples were passed to the resampler. */
+} audio_voice_t;
+
+typedef struct {
+    audio_voice_t voices[AUDIO_MIXER_VOICES];
+    uint32_t sample_rate; /**< Of the output, voices can be at lower rates. */
+    int16_t scratch[AUDIO_MIXER_BLOCK];
+} audio_mixer_t;
+
+/** Initializes a mixer with all voices idle, outputting sample_rate. */
+void audio_mixer_init(audio_mixer_t *mixer, uint32_t sample_rate);
+
+/** Reserves an idle voice.
+ *
+ * @returns NULL if all voices are in use.
+ */
+audio_voice_t *audio_mixer_reserve(audio_mixer_t *mixer);
+
+/** Hands a reserved voice over to the mixer.
+ *
+ * If stream is not NULL, samples are read from it and source is ignored,
+ * otherwise source is called from audio_mixer_render().
+ *
+ * @returns false if sample_rate is 0 or higher than the rate of the mixer,
+ * the voice stays reserved then.
+ */
+bool audio_mixer_play(audio_mixer_t *mixer, audio_voice_t *voice, uint32_t id,
+                      uint32_t sample_rate, audio_stream_t *stream, audio_source_t source,
+                      void *arg);
+
+/** Makes a reserved or finished voice idle again. */
+void audio_mixer_release(audio_voice_t *voice);
+
+/** Returns true if any voice is playing. */
+bool audio_mixer_is_playing(audio_mixer_t *mixer);
+
+/** Sums len samples of every playing voice into buffer, with saturation.
+ *
+ * Voices whose samples are exhausted become finished. A stream which is late
+ * is completed with silence and an underrun is counted for its voice.
+ *
+ * @returns a mask with bit i set if voice i finished.
+ */
+uint32_t audio_mixer_render(audio_mixer_t *mixer, int16_t *buffer, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AUDIO_MIXER_H */
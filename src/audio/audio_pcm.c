@@ -0,0 +1,62 @@
+#include <string.h>
+#include "audio_pcm.h"
+
+void audio_pcm_to_dac(audio_sample_t *dst, const int16_t *src, size_t len)
+{
+    uint32_t pair;
+    size_t i;
+
+    /* Adding 0x8000 modulo 2^16 only flips the sign bit, so a XOR on a word
+     * converts two samples. memcpy compiles to single loads and stores. */
+    for (i = 0; i + 2 <= len; i += 2) {
+        memcpy(&pair, &src[i], sizeof(pair));
+        pair ^= 0x80008000;
+        memcpy(&dst[i], &pair, sizeof(pair));
+    }
+
+    for (; i < len; i++) {
+        dst[i] = (uint16_t)src[i] ^ 0x8000;
+    }
+}
+
+static int16_t saturate(int32_t x)
+{
+    if (x > INT16_MAX) {
+        return INT16_MAX;
+    }
+    if (x < INT16_MIN) {
+        return INT16_MIN;
+    }
+    return x;
+}
+
+/* Saturating addition of two pairs of samples. */
+static inline uint32_t qadd16(uint32_t a, uint32_t b)
+{
+#if defined(__ARM_FEATURE_DSP) && __ARM_FEATURE_DSP
+    uint32_t sum;
+    __asm__("qadd16 %0, %1, %2" : "=r"(sum) : "r"(a), "r"(b));
+    return sum;
+#else
+    uint16_t low = saturate((int16_t)a + (int16_t)b);
+    uint16_t high = saturate((int16_t)(a >> 16) + (int16_t)(b >> 16));
+    return (uint32_t)high << 16 | low;
+#endif
+}
+
+void audio_pcm_mix(int16_t *dst, const int16_t *src, size_t len)
+{
+    uint32_t a, b;
+    size_t i;
+
+    for (i = 0; i + 2 <= len; i += 2) {
+        memcpy(&a, &dst[i], sizeof(a));
+        memcpy(&b, &src[i], sizeof(b));
+        a = qadd16(a, b);
+        memcpy(&dst[i], &a, sizeof(a));
+    }
+
+    for (; i < len; i++) {
+        dst[i] = saturate(dst[i] + src[i]);
+    }
+}
@@ -0,0 +1,33 @@
+#ifndef AUDIO_PCM_H
+#define AUDIO_PCM_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+#include "audio_dac.h"
+
+/** DAC value for silence. */
+#define AUDIO_DAC_MIDSCALE 0x8000
+
+/** Converts signed 16 bit PCM to DAC samples, dst and src can be the same.
+ *
+ * The samples are offset by -INT16_MIN two at a time, using word accesses
+ * which do not need to be aligned on the Cortex-M4.
+ */
+void audio_pcm_to_dac(audio_sample_t *dst, const int16_t *src, size_t len);
+
+/** Adds src to dst, saturating instead of wrapping around.
+ *
+ * Uses the QADD16 instruction, adding two samples at a time, on cores which
+ * have the DSP extension like the Cortex-M4.
+ */
+void audio_pcm_mix(int16_t *dst, const int16_t *src, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AUDIO_PCM_H */
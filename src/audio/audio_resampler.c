@@ -0,0 +1,383 @@
+#include <string.h>
+#include "audio_resampler.h"
+
+/* Fraction bits of the position which are not used to select the phase. */
+#define AUDIO_RESAMPLER_PHASE_SHIFT 8
+
+#define AUDIO_RESAMPLER_COEFFICIENT_BITS 14
+
+/* Input samples before the one at which the output falls. */
+#define AUDIO_RESAMPLER_DELAY (AUDIO_RESAMPLER_TAPS / 2 - 1)
+
+/* Kaiser windowed sinc (beta = 6) with a cutoff at 0.9 times the Nyquist
+ * frequency of the input, so that the images of the input spectrum are
+ * removed when upsampling. Row p is the filter for an output sample falling
+ * p / AUDIO_RESAMPLER_PHASES after input sample AUDIO_RESAMPLER_DELAY, scaled
+ * for a gain of exactly 1 at DC. */
+static const int16_t coefficients[AUDIO_RESAMPLER_PHASES][AUDIO_RESAMPLER_TAPS] = {
+    {40, -135, 319, -598, 944, -1288, 1543, 14734, 1543, -1288, 944, -598, 319, -135, 40, 0},
+    {41, -135, 318, -595, 934, -1265, 1484, 14740, 1602, -1311, 954, -602, 320, -135, 40, -6},
+    {41, -135, 317, -591, 925, -1242, 1426, 14737, 1662, -1334, 964, -606, 321, -135, 40, -6},
+    {41, -135, 316, -587, 915, -1219, 1368, 14736, 1722, -1357, 973, -609, 321, -135, 40, -6},
+    {41, -135, 315, -584, 904, -1196, 1310, 14736, 1782, -1380, 983, -613, 322, -135, 40, -6},
+    {41, -135, 314, -580, 894, -1173, 1252, 14733, 1842, -1402, 992, -616, 323, -135, 40, -6},
+    {41, -135, 313, -576, 884, -1149, 1195, 14726, 1903, -1425, 1002, -619, 324, -135, 40, -5},
+    {41, -135, 312, -572, 874, -1126, 1138, 14725, 1964, -1448, 1011, -623, 324, -135, 39, -5},
+    {41, -135, 310, -568, 864, -1103, 1081, 14721, 2025, -1470, 1020, -626, 325, -135, 39, -5},
+    {41, -135, 309, -564, 853, -1080, 1025, 14716, 2086, -1493, 1030, -629, 325, -134, 39, -5},
+    {41, -134, 308, -559, 843, -1057, 969, 14707, 2148, -1515, 1039, -632, 326, -134, 39, -5},
+    {41, -134, 307, -555, 832, -1033, 913, 14701, 2210, -1538, 1048, -635, 327, -134, 39, -5},
+    {42, -134, 305, -551, 822, -1010, 858, 14696, 2272, -1560, 1056, -638, 327, -134, 38, -5},
+    {42, -134, 304, -547, 811, -987, 803, 14688, 2335, -1582, 1065, -641, 327, -133, 38, -5},
+    {42, -134, 303, -542, 800, -964, 749, 14677, 2398, -1604, 1074, -643, 328, -133, 38, -5},
+    {42, -133, 301, -538, 790, -940, 694, 14669, 2461, -1626, 1082, -646, 328, -133, 38, -5},
+    {42, -133, 300, -533, 779, -917, 640, 14661, 2524, -1648, 1091, -649, 328, -133, 37, -5},
+    {42, -133, 298, -529, 768, -894, 587, 14650, 2588, -1670, 1099, -651, 329, -132, 37, -5},
+    {42, -132, 297, -524, 757, -870, 534, 14637, 2652, -1692, 1108, -654, 329, -132, 37, -5},
+    {42, -132, 295, -520, 746, -847, 481, 14627, 2716, -1714, 1116, -656, 329, -131, 37, -5},
+    {42, -132, 294, -515, 735, -824, 428, 14617, 2780, -1735, 1124, -659, 329, -131, 36, -5},
+    {42, -131, 292, -510, 724, -801, 376, 14604, 2845, -1757, 1132, -661, 329, -131, 36, -5},
+    {42, -131, 290, -506, 713, -778, 325, 14590, 2909, -1778, 1140, -663, 329, -130, 36, -4},
+    {42, -131, 289, -501, 702, -754, 273, 14577, 2974, -1799, 1147, -665, 329, -130, 35, -4},
+    {42, -130, 287, -496, 691, -731, 222, 14560, 3040, -1820, 1155, -667, 329, -129, 35, -4},
+    {42, -130, 285, -491, 680, -708, 172, 14545, 3105, -1841, 1163, -669, 329, -129, 35, -4},
+    {42, -130, 284, -486, 669, -685, 121, 14530, 3171, -1862, 1170, -671, 329, -128, 34, -4},
+    {41, -129, 282, -481, 658, -662, 71, 14515, 3237, -1883, 1177, -673, 329, -128, 34, -4},
+    {41, -129, 280, -476, 646, -639, 22, 14498, 3303, -1904, 1185, -675, 329, -127, 34, -4},
+    {41, -128, 278, -471, 635, -616, -27, 14480, 3369, -1924, 1192, -676, 329, -127, 33, -4},
+    {41, -128, 276, -466, 624, -593, -76, 14463, 3436, -1945, 1199, -678, 328, -126, 33, -4},
+    {41, -127, 275, -461, 612, -570, -124, 14443, 3502, -1965, 1205, -679, 328, -125, 33, -4},
+    {41, -127, 273, -456, 601, -547, -172, 14425, 3569, -1985, 1212, -681, 327, -125, 32, -3},
+    {41, -126, 271, -451, 590, -524, -220, 14403, 3636, -2005, 1219, -682, 327, -124, 32, -3},
+    {41, -126, 269, -446, 578, -502, -267, 14383, 3704, -2025, 1225, -683, 327, -123, 32, -3},
+    {41, -125, 267, -441, 567, -479, -314, 14364, 3771, -2045, 1232, -685, 326, -123, 31, -3},
+    {41, -125, 265, -435, 555, -456, -360, 14341, 3839, -2064, 1238, -686, 325, -122, 31, -3},
+    {41, -124, 263, -430, 544, -434, -406, 14320, 3906, -2084, 1244, -687, 325, -121, 30, -3},
+    {41, -123, 261, -425, 533, -411, -452, 14296, 3974, -2103, 1250, -688, 324, -120, 30, -3},
+    {40, -123, 259, -419, 521, -389, -497, 14276, 4042, -2122, 1256, -689, 323, -120, 29, -3},
+    {40, -122, 257, -414, 510, -366, -542, 14249, 4111, -2141, 1261, -689, 323, -119, 29, -3},
+    {40, -122, 255, -409, 498, -344, -586, 14225, 4179, -2160, 1267, -690, 322, -118, 29, -2},
+    {40, -121, 252, -403, 487, -322, -630, 14200, 4248, -2178, 1272, -691, 321, -117, 28, -2},
+    {40, -120, 250, -398, 475, -299, -674, 14174, 4316, -2197, 1278, -691, 320, -116, 28, -2},
+    {40, -120, 248, -392, 463, -277, -717, 14148, 4385, -2215, 1283, -691, 319, -115, 27, -2},
+    {40, -119, 246, -387, 452, -255, -760, 14121, 4454, -2233, 1288, -692, 318, -114, 27, -2},
+    {39, -118, 244, -382, 440, -233, -802, 14095, 4523, -2251, 1293, -692, 317, -113, 26, -2},
+    {39, -118, 241, -376, 429, -211, -844, 14065, 4593, -2268, 1298, -692, 316, -112, 26, -2},
+    {39, -117, 239, -370, 417, -190, -885, 14037, 4662, -2286, 1302, -692, 315, -111, 25, -1},
+    {39, -116, 237, -365, 406, -168, -927, 14006, 4732, -2303, 1307, -692, 314, -110, 25, -1},
+    {39, -115, 235, -359, 394, -146, -967, 13977, 4801, -2320, 1311, -692, 312, -109, 24, -1},
+    {39, -115, 232, -354, 383, -125, -1007, 13949, 4871, -2337, 1315, -692, 311, -108, 23, -1},
+    {39, -114, 230, -348, 371, -103, -1047, 13917, 4941, -2354, 1319, -692, 310, -107, 23, -1},
+    {38, -113, 228, -342, 360, -82, -1087, 13886, 5011, -2370, 1323, -691, 308, -106, 22, -1},
+    {38, -112, 225, -337, 348, -61, -1126, 13855, 5081, -2387, 1327, -691, 307, -105, 22, 0},
+    {38, -112, 223, -331, 337, -40, -1164, 13822, 5151, -2403, 1330, -690, 306, -104, 21, 0},
+    {38, -111, 221, -326, 325, -19, -1202, 13790, 5221, -2419, 1334, -690, 304, -103, 21, 0},
+    {38, -110, 218, -320, 314, 2, -1240, 13756, 5291, -2434, 1337, -689, 302, -101, 20, 0},
+    {37, -109, 216, -314, 302, 23, -1277, 13722, 5362, -2450, 1340, -688, 301, -100, 19, 0},
+    {37, -108, 213, -308, 291, 44, -1314, 13687, 5432, -2465, 1343, -687, 299, -99, 19, 0},
+    {37, -107, 211, -303, 280, 64, -1351, 13652, 5503, -2480, 1346, -686, 297, -98, 18, 1},
+    {37, -107, 209, -297, 268, 85, -1387, 13616, 5573, -2495, 1348, -685, 296, -96, 18, 1},
+    {37, -106, 206, -291, 257, 105, -1422, 13579, 5644, -2509, 1351, -684, 294, -95, 17, 1},
+    {36, -105, 204, -285, 245, 126, -1458, 13543, 5715, -2523, 1353, -682, 292, -94, 16, 1},
+    {36, -104, 201, -280, 234, 146, -1492, 13506, 5785, -2537, 1355, -681, 290, -92, 16, 1},
+    {36, -103, 199, -274, 223, 166, -1527, 13468, 5856, -2551, 1357, -679, 288, -91, 15, 1},
+    {36, -102, 196, -268, 211, 186, -1560, 13430, 5927, -2565, 1359, -678, 286, -90, 14, 2},
+    {35, -101, 194, -262, 200, 206, -1594, 13389, 5998, -2578, 1361, -676, 284, -88, 14, 2},
+    {35, -101, 191, -257, 189, 225, -1627, 13353, 6069, -2591, 1362, -674, 282, -87, 13, 2},
+    {35, -100, 188, -251, 178, 245, -1659, 13311, 6140, -2604, 1364, -672, 280, -85, 12, 2},
+    {35, -99, 186, -245, 167, 264, -1691, 13271, 6210, -2616, 1365, -671, 278, -84, 12, 2},
+    {34, -98, 183, -239, 155, 283, -1723, 13232, 6281, -2629, 1366, -668, 275, -82, 11, 3},
+    {34, -97, 181, -234, 144, 303, -1754, 13191, 6352, -2641, 1366, -666, 273, -81, 10, 3},
+    {34, -96, 178, -228, 133, 322, -1785, 13148, 6423, -2652, 1367, -664, 271, -79, 9, 3},
+    {34, -95, 176, -222, 122, 340, -1815, 13106, 6494, -2664, 1368, -662, 268, -78, 9, 3},
+    {33, -94, 173, -216, 111, 359, -1845, 13062, 6565, -2675, 1368, -659, 266, -76, 8, 4},
+    {33, -93, 170, -210, 100, 378, -1875, 13021, 6636, -2686, 1368, -657, 263, -75, 7, 4},
+    {33, -92, 168, -205, 89, 396, -1904, 12976, 6707, -2697, 1368, -654, 261, -73, 7, 4},
+    {33, -91, 165, -199, 78, 415, -1933, 12931, 6778, -2707, 1368, -651, 258, -71, 6, 4},
+    {32, -90, 163, -193, 68, 433, -1961, 12887, 6849, -2717, 1367, -648, 255, -70, 5, 4},
+    {32, -89, 160, -187, 57, 451, -1988, 12839, 6920, -2727, 1367, -645, 253, -68, 4, 5},
+    {32, -88, 157, -181, 46, 469, -2016, 12795, 6990, -2736, 1366, -642, 250, -66, 3, 5},
+    {32, -87, 155, -176, 35, 486, -2043, 12751, 7061, -2746, 1365, -639, 247, -65, 3, 5},
+    {31, -86, 152, -170, 25, 504, -2069, 12704, 7132, -2755, 1364, -636, 244, -63, 2, 5},
+    {31, -85, 149, -164, 14, 521, -2095, 12655, 7203, -2763, 1363, -633, 242, -61, 1, 6},
+    {31, -84, 147, -159, 4, 539, -2120, 12607, 7273, -2772, 1361, -629, 239, -59, 0, 6},
+    {30, -83, 144, -153, -7, 556, -2146, 12561, 7344, -2780, 1360, -626, 236, -57, -1, 6},
+    {30, -82, 141, -147, -17, 573, -2170, 12511, 7414, -2787, 1358, -622, 233, -56, -1, 6},
+    {30, -81, 139, -141, -28, 590, -2194, 12460, 7485, -2795, 1356, -618, 230, -54, -2, 7},
+    {30, -80, 136, -136, -38, 606, -2218, 12414, 7555, -2802, 1354, -615, 226, -52, -3, 7},
+    {29, -79, 133, -130, -49, 623, -2242, 12367, 7625, -2809, 1351, -611, 223, -50, -4, 7},
+    {29, -78, 131, -124, -59, 639, -2264, 12313, 7696, -2815, 1349, -607, 220, -48, -5, 7},
+    {29, -77, 128, -119, -69, 655, -2287, 12262, 7766, -2821, 1346, -602, 217, -46, -6, 8},
+    {28, -76, 125, -113, -79, 671, -2309, 12212, 7836, -2827, 1343, -598, 213, -44, -6, 8},
+    {28, -75, 123, -107, -89, 687, -2331, 12160, 7906, -2833, 1340, -594, 210, -42, -7, 8},
+    {28, -74, 120, -102, -99, 703, -2352, 12109, 7975, -2838, 1337, -590, 207, -40, -8, 8},
+    {28, -73, 117, -96, -109, 718, -2372, 12056, 8045, -2843, 1333, -585, 203, -38, -9, 9},
+    {27, -72, 115, -91, -119, 734, -2393, 12002, 8115, -2847, 1330, -580, 200, -36, -10, 9},
+    {27, -71, 112, -85, -129, 749, -2413, 11951, 8184, -2851, 1326, -576, 196, -34, -11, 9},
+    {27, -70, 109, -79, -139, 764, -2432, 11896, 8254, -2855, 1322, -571, 193, -32, -12, 9},
+    {26, -69, 107, -74, -148, 779, -2451, 11843, 8323, -2859, 1317, -566, 189, -30, -13, 10},
+    {26, -68, 104, -68, -158, 793, -2470, 11790, 8392, -2862, 1313, -561, 185, -28, -14, 10},
+    {26, -67, 101, -63, -168, 808, -2488, 11735, 8461, -2865, 1308, -556, 182, -26, -14, 10},
+    {25, -66, 99, -57, -177, 822, -2505, 11678, 8530, -2867, 1304, -551, 178, -24, -15, 10},
+    {25, -65, 96, -52, -187, 836, -2523, 11624, 8598, -2869, 1299, -545, 174, -22, -16, 11},
+    {25, -64, 93, -47, -196, 850, -2539, 11569, 8667, -2871, 1293, -540, 170, -20, -17, 11},
+    {24, -63, 91, -41, -205, 864, -2556, 11513, 8735, -2873, 1288, -535, 166, -17, -18, 11},
+    {24, -62, 88, -36, -214, 878, -2572, 11454, 8803, -2874, 1283, -529, 163, -15, -19, 12},
+    {24, -61, 85, -30, -224, 891, -2587, 11397, 8871, -2874, 1277, -523, 159, -13, -20, 12},
+    {24, -60, 83, -25, -233, 905, -2602, 11340, 8939, -2875, 1271, -518, 155, -11, -21, 12},
+    {23, -59, 80, -20, -242, 918, -2617, 11284, 9007, -2875, 1265, -512, 151, -9, -22, 12},
+    {23, -58, 77, -15, -251, 931, -2631, 11226, 9074, -2874, 1258, -506, 146, -6, -23, 13},
+    {23, -57, 75, -9, -260, 943, -2645, 11167, 9142, -2874, 1252, -500, 142, -4, -24, 13},
+    {22, -55, 72, -4, -268, 956, -2659, 11109, 9209, -2873, 1245, -494, 138, -2, -25, 13},
+    {22, -54, 70, 1, -277, 968, -2672, 11047, 9276, -2871, 1238, -487, 134, 1, -26, 14},
+    {22, -53, 67, 6, -286, 980, -2684, 10989, 9342, -2869, 1231, -481, 130, 3, -27, 14},
+    {21, -52, 64, 11, -294, 992, -2696, 10931, 9409, -2867, 1224, -475, 125, 5, -28, 14},
+    {21, -51, 62, 17, -303, 1004, -2708, 10870, 9475, -2864, 1216, -468, 121, 7, -29, 14},
+    {21, -50, 59, 22, -311, 1016, -2720, 10808, 9541, -2861, 1209, -462, 117, 10, -30, 15},
+    {20, -49, 57, 27, -319, 1027, -2731, 10749, 9607, -2858, 1201, -455, 112, 12, -31, 15},
+    {20, -48, 54, 32, -328, 1038, -2741, 10687, 9673, -2854, 1193, -448, 108, 15, -32, 15},
+    {20, -47, 52, 37, -336, 1050, -2751, 10624, 9738, -2850, 1185, -441, 103, 17, -33, 16},
+    {20, -46, 49, 42, -344, 1060, -2761, 10565, 9803, -2846, 1176, -434, 99, 19, -34, 16},
+    {19, -45, 47, 47, -352, 1071, -2770, 10502, 9868, -2841, 1168, -427, 94, 22, -35, 16},
+    {19, -44, 44, 52, -360, 1082, -2779, 10439, 9933, -2836, 1159, -420, 90, 24, -36, 17},
+    {19, -43, 41, 56, -368, 1092, -2787, 10378, 9997, -2830, 1150, -413, 85, 27, -37, 17},
+    {18, -42, 39, 61, -375, 1102, -2796, 10317, 10061, -2824, 1141, -406, 80, 29, -38, 17},
+    {18, -41, 36, 66, -383, 1112, -2803, 10252, 10125, -2817, 1131, -398, 76, 32, -39, 17},
+    {18, -40, 34, 71, -391, 1122, -2810, 10187, 10189, -2810, 1122, -391, 71, 34, -40, 18},
+    {17, -39, 32, 76, -398, 1131, -2817, 10125, 10252, -2803, 1112, -383, 66, 36, -41, 18},
+    {17, -38, 29, 80, -406, 1141, -2824, 10061, 10317, -2796, 1102, -375, 61, 39, -42, 18},
+    {17, -37, 27, 85, -413, 1150, -2830, 9997, 10378, -2787, 1092, -368, 56, 41, -43, 19},
+    {17, -36, 24, 90, -420, 1159, -2836, 9933, 10439, -2779, 1082, -360, 52, 44, -44, 19},
+    {16, -35, 22, 94, -427, 1168, -2841, 9868, 10502, -2770, 1071, -352, 47, 47, -45, 19},
+    {16, -34, 19, 99, -434, 1176, -2846, 9803, 10565, -2761, 1060, -344, 42, 49, -46, 20},
+    {16, -33, 17, 103, -441, 1185, -2850, 9738, 10624, -2751, 1050, -336, 37, 52, -47, 20},
+    {15, -32, 15, 108, -448, 1193, -2854, 9673, 10687, -2741, 1038, -328, 32, 54, -48, 20},
+    {15, -31, 12, 112, -455, 1201, -2858, 9607, 10749, -2731, 1027, -319, 27, 57, -49, 20},
+    {15, -30, 10, 117, -462, 1209, -2861, 9541, 10808, -2720, 1016, -311, 22, 59, -50, 21},
+    {14, -29, 7, 121, -468, 1216, -2864, 9475, 10870, -2708, 1004, -303, 17, 62, -51, 21},
+    {14, -28, 5, 125, -475, 1224, -2867, 9409, 10931, -2696, 992, -294, 11, 64, -52, 21},
+    {14, -27, 3, 130, -481, 1231, -2869, 9342, 10989, -2684, 980, -286, 6, 67, -53, 22},
+    {14, -26, 1, 134, -487, 1238, -2871, 9276, 11047, -2672, 968, -277, 1, 70, -54, 22},
+    {13, -25, -2, 138, -494, 1245, -2873, 9209, 11109, -2659, 956, -268, -4, 72, -55, 22},
+    {13, -24, -4, 142, -500, 1252, -2874, 9142, 11167, -2645, 943, -260, -9, 75, -57, 23},
+    {13, -23, -6, 146, -506, 1258, -2874, 9074, 11226, -2631, 931, -251, -15, 77, -58, 23},
+    {12, -22, -9, 151, -512, 1265, -2875, 9007, 11284, -2617, 918, -242, -20, 80, -59, 23},
+    {12, -21, -11, 155, -518, 1271, -2875, 8939, 11340, -2602, 905, -233, -25, 83, -60, 24},
+    {12, -20, -13, 159, -523, 1277, -2874, 8871, 11397, -2587, 891, -224, -30, 85, -61, 24},
+    {12, -19, -15, 163, -529, 1283, -2874, 8803, 11454, -2572, 878, -214, -36, 88, -62, 24},
+    {11, -18, -17, 166, -535, 1288, -2873, 8735, 11513, -2556, 864, -205, -41, 91, -63, 24},
+    {11, -17, -20, 170, -540, 1293, -2871, 8667, 11569, -2539, 850, -196, -47, 93, -64, 25},
+    {11, -16, -22, 174, -545, 1299, -2869, 8598, 11624, -2523, 836, -187, -52, 96, -65, 25},
+    {10, -15, -24, 178, -551, 1304, -2867, 8530, 11678, -2505, 822, -177, -57, 99, -66, 25},
+    {10, -14, -26, 182, -556, 1308, -2865, 8461, 11735, -2488, 808, -168, -63, 101, -67, 26},
+    {10, -14, -28, 185, -561, 1313, -2862, 8392, 11790, -2470, 793, -158, -68, 104, -68, 26},
+    {10, -13, -30, 189, -566, 1317, -2859, 8323, 11843, -2451, 779, -148, -74, 107, -69, 26},
+    {9, -12, -32, 193, -571, 1322, -2855, 8254, 11896, -2432, 764, -139, -79, 109, -70, 27},
+    {9, -11, -34, 196, -576, 1326, -2851, 8184, 11951, -2413, 749, -129, -85, 112, -71, 27},
+    {9, -10, -36, 200, -580, 1330, -2847, 8115, 12002, -2393, 734, -119, -91, 115, -72, 27},
+    {9, -9, -38, 203, -585, 1333, -2843, 8045, 12056, -2372, 718, -109, -96, 117, -73, 28},
+    {8, -8, -40, 207, -590, 1337, -2838, 7975, 12109, -2352, 703, -99, -102, 120, -74, 28},
+    {8, -7, -42, 210, -594, 1340, -2833, 7906, 12160, -2331, 687, -89, -107, 123, -75, 28},
+    {8, -6, -44, 213, -598, 1343, -2827, 7836, 12212, -2309, 671, -79, -113, 125, -76, 28},
+    {8, -6, -46, 217, -602, 1346, -2821, 7766, 12262, -2287, 655, -69, -119, 128, -77, 29},
+    {7, -5, -48, 220, -607, 1349, -2815, 7696, 12313, -2264, 639, -59, -124, 131, -78, 29},
+    {7, -4, -50, 223, -611, 1351, -2809, 7625, 12367, -2242, 623, -49, -130, 133, -79, 29},
+    {7, -3, -52, 226, -615, 1354, -2802, 7555, 12414, -2218, 606, -38, -136, 136, -80, 30},
+    {7, -2, -54, 230, -618, 1356, -2795, 7485, 12460, -2194, 590, -28, -141, 139, -81, 30},
+    {6, -1, -56, 233, -622, 1358, -2787, 7414, 12511, -2170, 573, -17, -147, 141, -82, 30},
+    {6, -1, -57, 236, -626, 1360, -2780, 7344, 12561, -2146, 556, -7, -153, 144, -83, 30},
+    {6, 0, -59, 239, -629, 1361, -2772, 7273, 12607, -2120, 539, 4, -159, 147, -84, 31},
+    {6, 1, -61, 242, -633, 1363, -2763, 7203, 12655, -2095, 521, 14, -164, 149, -85, 31},
+    {5, 2, -63, 244, -636, 1364, -2755, 7132, 12704, -2069, 504, 25, -170, 152, -86, 31},
+    {5, 3, -65, 247, -639, 1365, -2746, 7061, 12751, -2043, 486, 35, -176, 155, -87, 32},
+    {5, 3, -66, 250, -642, 1366, -2736, 6990, 12795, -2016, 469, 46, -181, 157, -88, 32},
+    {5, 4, -68, 253, -645, 1367, -2727, 6920, 12839, -1988, 451, 57, -187, 160, -89, 32},
+    {4, 5, -70, 255, -648, 1367, -2717, 6849, 12887, -1961, 433, 68, -193, 163, -90, 32},
+    {4, 6, -71, 258, -651, 1368, -2707, 6778, 12931, -1933, 415, 78, -199, 165, -91, 33},
+    {4, 7, -73, 261, -654, 1368, -2697, 6707, 12976, -1904, 396, 89, -205, 168, -92, 33},
+    {4, 7, -75, 263, -657, 1368, -2686, 6636, 13021, -1875, 378, 100, -210, 170, -93, 33},
+    {4, 8, -76, 266, -659, 1368, -2675, 6565, 13062, -1845, 359, 111, -216, 173, -94, 33},
+    {3, 9, -78, 268, -662, 1368, -2664, 6494, 13106, -1815, 340, 122, -222, 176, -95, 34},
+    {3, 9, -79, 271, -664, 1367, -2652, 6423, 13148, -1785, 322, 133, -228, 178, -96, 34},
+    {3, 10, -81, 273, -666, 1366, -2641, 6352, 13191, -1754, 303, 144, -234, 181, -97, 34},
+    {3, 11, -82, 275, -668, 1366, -2629, 6281, 13232, -1723, 283, 155, -239, 183, -98, 34},
+    {2, 12, -84, 278, -671, 1365, -2616, 6210, 13271, -1691, 264, 167, -245, 186, -99, 35},
+    {2, 12, -85, 280, -672, 1364, -2604, 6140, 13311, -1659, 245, 178, -251, 188, -100, 35},
+    {2, 13, -87, 282, -674, 1362, -2591, 6069, 13353, -1627, 225, 189, -257, 191, -101, 35},
+    {2, 14, -88, 284, -676, 1361, -2578, 5998, 13389, -1594, 206, 200, -262, 194, -101, 35},
+    {2, 14, -90, 286, -678, 1359, -2565, 5927, 13430, -1560, 186, 211, -268, 196, -102, 36},
+    {1, 15, -91, 288, -679, 1357, -2551, 5856, 13468, -1527, 166, 223, -274, 199, -103, 36},
+    {1, 16, -92, 290, -681, 1355, -2537, 5785, 13506, -1492, 146, 234, -280, 201, -104, 36},
+    {1, 16, -94, 292, -682, 1353, -2523, 5715, 13543, -1458, 126, 245, -285, 204, -105, 36},
+    {1, 17, -95, 294, -684, 1351, -2509, 5644, 13579, -1422, 105, 257, -291, 206, -106, 37},
+    {1, 18, -96, 296, -685, 1348, -2495, 5573, 13616, -1387, 85, 268, -297, 209, -107, 37},
+    {1, 18, -98, 297, -686, 1346, -2480, 5503, 13652, -1351, 64, 280, -303, 211, -107, 37},
+    {0, 19, -99, 299, -687, 1343, -2465, 5432, 13687, -1314, 44, 291, -308, 213, -108, 37},
+    {0, 19, -100, 301, -688, 1340, -2450, 5362, 13722, -1277, 23, 302, -314, 216, -109, 37},
+    {0, 20, -101, 302, -689, 1337, -2434, 5291, 13756, -1240, 2, 314, -320, 218, -110, 38},
+    {0, 21, -103, 304, -690, 1334, -2419, 5221, 13790, -1202, -19, 325, -326, 221, -111, 38},
+    {0, 21, -104, 306, -690, 1330, -2403, 5151, 13822, -1164, -40, 337, -331, 223, -112, 38},
+    {0, 22, -105, 307, -691, 1327, -2387, 5081, 13855, -1126, -61, 348, -337, 225, -112, 38},
+    {-1, 22, -106, 308, -691, 1323, -2370, 5011, 13886, -1087, -82, 360, -342, 228, -113, 38},
+    {-1, 23, -107, 310, -692, 1319, -2354, 4941, 13917, -1047, -103, 371, -348, 230, -114, 39},
+    {-1, 23, -108, 311, -692, 1315, -2337, 4871, 13949, -1007, -125, 383, -354, 232, -115, 39},
+    {-1, 24, -109, 312, -692, 1311, -2320, 4801, 13977, -967, -146, 394, -359, 235, -115, 39},
+    {-1, 25, -110, 314, -692, 1307, -2303, 4732, 14006, -927, -168, 406, -365, 237, -116, 39},
+    {-1, 25, -111, 315, -692, 1302, -2286, 4662, 14037, -885, -190, 417, -370, 239, -117, 39},
+    {-2, 26, -112, 316, -692, 1298, -2268, 4593, 14065, -844, -211, 429, -376, 241, -118, 39},
+    {-2, 26, -113, 317, -692, 1293, -2251, 4523, 14095, -802, -233, 440, -382, 244, -118, 39},
+    {-2, 27, -114, 318, -692, 1288, -2233, 4454, 14121, -760, -255, 452, -387, 246, -119, 40},
+    {-2, 27, -115, 319, -691, 1283, -2215, 4385, 14148, -717, -277, 463, -392, 248, -120, 40},
+    {-2, 28, -116, 320, -691, 1278, -2197, 4316, 14174, -674, -299, 475, -398, 250, -120, 40},
+    {-2, 28, -117, 321, -691, 1272, -2178, 4248, 14200, -630, -322, 487, -403, 252, -121, 40},
+    {-2, 29, -118, 322, -690, 1267, -2160, 4179, 14225, -586, -344, 498, -409, 255, -122, 40},
+    {-3, 29, -119, 323, -689, 1261, -2141, 4111, 14249, -542, -366, 510, -414, 257, -122, 40},
+    {-3, 29, -120, 323, -689, 1256, -2122, 4042, 14276, -497, -389, 521, -419, 259, -123, 40},
+    {-3, 30, -120, 324, -688, 1250, -2103, 3974, 14296, -452, -411, 533, -425, 261, -123, 41},
+    {-3, 30, -121, 325, -687, 1244, -2084, 3906, 14320, -406, -434, 544, -430, 263, -124, 41},
+    {-3, 31, -122, 325, -686, 1238, -2064, 3839, 14341, -360, -456, 555, -435, 265, -125, 41},
+    {-3, 31, -123, 326, -685, 1232, -2045, 3771, 14364, -314, -479, 567, -441, 267, -125, 41},
+    {-3, 32, -123, 327, -683, 1225, -2025, 3704, 14383, -267, -502, 578, -446, 269, -126, 41},
+    {-3, 32, -124, 327, -682, 1219, -2005, 3636, 14403, -220, -524, 590, -451, 271, -126, 41},
+    {-3, 32, -125, 327, -681, 1212, -1985, 3569, 14425, -172, -547, 601, -456, 273, -127, 41},
+    {-4, 33, -125, 328, -679, 1205, -1965, 3502, 14443, -124, -570, 612, -461, 275, -127, 41},
+    {-4, 33, -126, 328, -678, 1199, -1945, 3436, 14463, -76, -593, 624, -466, 276, -128, 41},
+    {-4, 33, -127, 329, -676, 1192, -1924, 3369, 14480, -27, -616, 635, -471, 278, -128, 41},
+    {-4, 34, -127, 329, -675, 1185, -1904, 3303, 14498, 22, -639, 646, -476, 280, -129, 41},
+    {-4, 34, -128, 329, -673, 1177, -1883, 3237, 14515, 71, -662, 658, -481, 282, -129, 41},
+    {-4, 34, -128, 329, -671, 1170, -1862, 3171, 14530, 121, -685, 669, -486, 284, -130, 42},
+    {-4, 35, -129, 329, -669, 1163, -1841, 3105, 14545, 172, -708, 680, -491, 285, -130, 42},
+    {-4, 35, -129, 329, -667, 1155, -1820, 3040, 14560, 222, -731, 691, -496, 287, -130, 42},
+    {-4, 35, -130, 329, -665, 1147, -1799, 2974, 14577, 273, -754, 702, -501, 289, -131, 42},
+    {-4, 36, -130, 329, -663, 1140, -1778, 2909, 14590, 325, -778, 713, -506, 290, -131, 42},
+    {-5, 36, -131, 329, -661, 1132, -1757, 2845, 14604, 376, -801, 724, -510, 292, -131, 42},
+    {-5, 36, -131, 329, -659, 1124, -1735, 2780, 14617, 428, -824, 735, -515, 294, -132, 42},
+    {-5, 37, -131, 329, -656, 1116, -1714, 2716, 14627, 481, -847, 746, -520, 295, -132, 42},
+    {-5, 37, -132, 329, -654, 1108, -1692, 2652, 14637, 534, -870, 757, -524, 297, -132, 42},
+    {-5, 37, -132, 329, -651, 1099, -1670, 2588, 14650, 587, -894, 768, -529, 298, -133, 42},
+    {-5, 37, -133, 328, -649, 1091, -1648, 2524, 14661, 640, -917, 779, -533, 300, -133, 42},
+    {-5, 38, -133, 328, -646, 1082, -1626, 2461, 14669, 694, -940, 790, -538, 301, -133, 42},
+    {-5, 38, -133, 328, -643, 1074, -1604, 2398, 14677, 749, -964, 800, -542, 303, -134, 42},
+    {-5, 38, -133, 327, -641, 1065, -1582, 2335, 14688, 803, -987, 811, -547, 304, -134, 42},
+    {-5, 38, -134, 327, -638, 1056, -1560, 2272, 14696, 858, -1010, 822, -551, 305, -134, 42},
+    {-5, 39, -134, 327, -635, 1048, -1538, 2210, 14701, 913, -1033, 832, -555, 307, -134, 41},
+    {-5, 39, -134, 326, -632, 1039, -1515, 2148, 14707, 969, -1057, 843, -559, 308, -134, 41},
+    {-5, 39, -134, 325, -629, 1030, -1493, 2086, 14716, 1025, -1080, 853, -564, 309, -135, 41},
+    {-5, 39, -135, 325, -626, 1020, -1470, 2025, 14721, 1081, -1103, 864, -568, 310, -135, 41},
+    {-5, 39, -135, 324, -623, 1011, -1448, 1964, 14725, 1138, -1126, 874, -572, 312, -135, 41},
+    {-5, 40, -135, 324, -619, 1002, -1425, 1903, 14726, 1195, -1149, 884, -576, 313, -135, 41},
+    {-6, 40, -135, 323, -616, 992, -1402, 1842, 14733, 1252, -1173, 894, -580, 314, -135, 41},
+    {-6, 40, -135, 322, -613, 983, -1380, 1782, 14736, 1310, -1196, 904, -584, 315, -135, 41},
+    {-6, 40, -135, 321, -609, 973, -1357, 1722, 14736, 1368, -1219, 915, -587, 316, -135, 41},
+    {-6, 40, -135, 321, -606, 964, -1334, 1662, 14737, 1426, -1242, 925, -591, 317, -135, 41},
+    {-6, 40, -135, 320, -602, 954, -1311, 1602, 14740, 1484, -1265, 934, -595, 318, -135, 41},
+};
+
+static int16_t saturate(int32_t x)
+{
+    if (x > INT16_MAX) {
+        return INT16_MAX;
+    }
+    if (x < INT16_MIN) {
+        return INT16_MIN;
+    }
+    return x;
+}
+
+/* Adds the products of two pairs of samples to acc. */
+static inline int32_t smlad(uint32_t a, uint32_t b, int32_t acc)
+{
+#if defined(__ARM_FEATURE_DSP) && __ARM_FEATURE_DSP
+    int32_t sum;
+    __asm__("smlad %0, %1, %2, %3" : "=r"(sum) : "r"(a), "r"(b), "r"(acc));
+    return sum;
+#else
+    return acc + (int16_t)a * (int16_t)b + (int16_t)(a >> 16) * (int16_t)(b >> 16);
+#endif
+}
+
+static inline int16_t audio_resampler_fir(const int16_t *input, const int16_t *h)
+{
+    int32_t acc = 1 << (AUDIO_RESAMPLER_COEFFICIENT_BITS - 1);
+    uint32_t a, b;
+    int k;
+
+    /* Two taps at a time, memcpy compiles to single loads. */
+    for (k = 0; k < AUDIO_RESAMPLER_TAPS; k += 2) {
+        memcpy(&a, &input[k], sizeof(a));
+        memcpy(&b, &h[k], sizeof(b));
+        acc = smlad(a, b, acc);
+    }
+
+    return saturate(acc >> AUDIO_RESAMPLER_COEFFICIENT_BITS);
+}
+
+bool audio_resampler_init(audio_resampler_t *resampler, uint32_t in_rate, uint32_t out_rate)
+{
+    if (in_rate == 0 || in_rate > out_rate) {
+        return false;
+    }
+
+    resampler->step = ((uint64_t)in_rate << 16) / out_rate;
+    resampler->position = 0;
+
+    /* Silence before the first sample, which is output as is. */
+    resampler->count = AUDIO_RESAMPLER_DELAY;
+    memset(resampler->input, 0, resampler->count * sizeof(int16_t));
+
+    return true;
+}
+
+bool audio_resampler_is_unity(const audio_resampler_t *resampler)
+{
+    return resampler->step == AUDIO_RESAMPLER_UNITY;
+}
+
+int16_t *audio_resampler_input(audio_resampler_t *resampler, size_t *len)
+{
+    /* Room is kept for the silence added by audio_resampler_flush(). */
+    *len = AUDIO_RESAMPLER_TAPS + AUDIO_RESAMPLER_INPUT - AUDIO_RESAMPLER_DELAY -
+           resampler->count;
+    return &resampler->input[resampler->count];
+}
+
+void audio_resampler_push(audio_resampler_t *resampler, size_t count)
+{
+    resampler->count += count;
+}
+
+void audio_resampler_flush(audio_resampler_t *resampler)
+{
+    /* The filter of the last output sample ends AUDIO_RESAMPLER_DELAY + 1
+     * samples after it, which is past the last input sample. */
+    memset(&resampler->input[resampler->count], 0, AUDIO_RESAMPLER_DELAY * sizeof(int16_t));
+    resampler->count += AUDIO_RESAMPLER_DELAY;
+}
+
+size_t audio_resampler_process(audio_resampler_t *resampler, int16_t *out, size_t len)
+{
+    uint32_t position = resampler->position;
+    uint32_t first;
+    size_t n;
+
+    for (n = 0; n < len; n++) {
+        first = position >> 16;
+        if (first + AUDIO_RESAMPLER_TAPS > resampler->count) {
+            break;
+        }
+
+        out[n] = audio_resampler_fir(&resampler->input[first],
+                                     coefficients[(position & 0xffff) >>
+                                                  AUDIO_RESAMPLER_PHASE_SHIFT]);
+        position += resampler->step;
+    }
+
+    /* Drops the input samples which are not needed anymore. */
+    first = position >> 16;
+    memmove(resampler->input, &resampler->input[first],
+            (resampler->count - first) * sizeof(int16_t));
+    resampler->count -= first;
+    resampler->position = position - (first << 16);
+
+    return n;
+}
@@ -0,0 +1,69 @@
+#ifndef AUDIO_RESAMPLER_H
+#define AUDIO_RESAMPLER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+/** Input samples weighted for each output sample. */
+#define AUDIO_RESAMPLER_TAPS 16
+
+/** Positions between two input samples for which the filter is tabulated. */
+#define AUDIO_RESAMPLER_PHASES 256
+
+/** Input samples buffered in addition to the filter history. */
+#define AUDIO_RESAMPLER_INPUT 64
+
+/** Step between output samples when the rates are equal. */
+#define AUDIO_RESAMPLER_UNITY (1 << 16)
+
+/** Converts a sound to a higher or equal sample rate.
+ *
+ * Each output sample is computed by a FIR low-pass filter at the input rate,
+ * whose coefficients depend on where the output sample falls between two
+ * input samples. They are precomputed for AUDIO_RESAMPLER_PHASES positions
+ * in Q14 fixed point, which makes this a polyphase filter for any ratio.
+ */
+typedef struct {
+    uint32_t step; /**< Input samples per output sample, 16.16 fixed point. */
+    uint32_t position; /**< Of the next output sample in input[], 16.16 fixed point. */
+    uint32_t count; /**< Samples in input[]. */
+    int16_t input[AUDIO_RESAMPLER_TAPS + AUDIO_RESAMPLER_INPUT];
+} audio_resampler_t;
+
+/** Initializes a resampler from in_rate to out_rate.
+ *
+ * @returns false if in_rate is higher than out_rate, which is not supported.
+ */
+bool audio_resampler_init(audio_resampler_t *resampler, uint32_t in_rate, uint32_t out_rate);
+
+/** Returns true if the rates are equal, in which case samples can be used
+ * as is. */
+bool audio_resampler_is_unity(const audio_resampler_t *resampler);
+
+/** Returns where the next input samples go, and how many fit in *len. */
+int16_t *audio_resampler_input(audio_resampler_t *resampler, size_t *len);
+
+/** Adds count samples written to audio_resampler_input(). */
+void audio_resampler_push(audio_resampler_t *resampler, size_t count);
+
+/** Adds the silence needed to output the last input samples, once the input
+ * ended. There is always room for it. */
+void audio_resampler_flush(audio_resampler_t *resampler);
+
+/** Computes up to len output samples from the input samples pushed so far.
+ *
+ * @returns the number of output samples, less than len once more input is
+ * needed.
+ */
+size_t audio_resampler_process(audio_resampler_t *resampler, int16_t *out, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AUDIO_RESAMPLER_H */
@@ -0,0 +1,114 @@
+#include <string.h>
+#include "audio_pcm.h"
+#include "audio_stream.h"
+
+void audio_stream_init(audio_stream_t *stream, int16_t *buffer, size_t size)
+{
+    stream->buffer = buffer;
+    stream->size = size;
+    stream->underruns = 0;
+    audio_stream_reset(stream);
+}
+
+void audio_stream_reset(audio_stream_t *stream)
+{
+    stream->head = 0;
+    stream->tail = 0;
+    stream->end = false;
+}
+
+size_t audio_stream_available(audio_stream_t *stream)
+{
+    return stream->head - stream->tail;
+}
+
+size_t audio_stream_space(audio_stream_t *stream)
+{
+    return stream->size - (stream->head - stream->tail);
+}
+
+size_t audio_stream_fill(audio_stream_t *stream, audio_source_t source, void *arg, size_t max)
+{
+    size_t done = 0, len, n;
+    uint32_t offset;
+    bool end;
+
+    while (done < max && !stream->end) {
+        offset = stream->head & (stream->size - 1);
+
+        /* Contiguous free space, up to the end of the buffer. */
+        len = audio_stream_space(stream);
+        if (len > stream->size - offset) {
+            len = stream->size - offset;
+        }
+        if (len > max - done) {
+            len = max - done;
+        }
+        if (len == 0) {
+            break;
+        }
+
+        n = 0;
+        end = source(arg, &stream->buffer[offset], len, &n);
+
+        /* The samples must be written before the consumer sees them. */
+        __sync_synchronize();
+        stream->head += n;
+        done += n;
+
+        if (end) {
+            stream->end = true;
+        } else if (n < len) {
+            break;
+        }
+    }
+
+    return done;
+}
+
+size_t audio_stream_read(audio_stream_t *stream, int16_t *buffer, size_t len)
+{
+    size_t available = audio_stream_available(stream);
+    size_t n = available < len ? available : len;
+    uint32_t offset = stream->tail & (stream->size - 1);
+    size_t first = stream->size - offset;
+
+    if (first > n) {
+        first = n;
+    }
+    memcpy(buffer, &stream->buffer[offset], first * sizeof(int16_t));
+    memcpy(&buffer[first], stream->buffer, (n - first) * sizeof(int16_t));
+
+    /* The samples must be read before the producer overwrites them. */
+    __sync_synchronize();
+    stream->tail += n;
+
+    return n;
+}
+
+bool audio_stream_read_cb(void *arg, audio_sample_t *buffer, size_t len, size_t *samples_written)
+{
+    audio_stream_t *stream = (audio_stream_t *)arg;
+    bool end = stream->end;
+    size_t available = audio_stream_available(stream);
+    size_t n = audio_stream_read(stream, (int16_t *)buffer, len);
+    size_t i;
+
+    audio_pcm_to_dac(buffer, (int16_t *)buffer, n);
+
+    /* end was read before the samples, so none can be missed. */
+    if (end && n == available) {
+        *samples_written = n;
+        return true;
+    }
+
+    if (n < len) {
+        for (i = n; i < len; i++) {
+            buffer[i] = AUDIO_DAC_MIDSCALE;
+        }
+        stream->underruns++;
+    }
+
+    *samples_written = len;
+    return false;
+}
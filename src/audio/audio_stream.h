@@ -0,0 +1,76 @@
+#ifndef AUDIO_STREAM_H
+#define AUDIO_STREAM_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "audio_dac.h"
+
+/** Produces signed 16 bit samples, for example by reading a file.
+ *
+ * @param [in] arg Argument pointer.
+ * @param [in] buffer Sample buffer.
+ * @param [in] len Buffer length.
+ * @param [out] samples_read The number of samples written to the buffer.
+ * @returns true at the end of the source.
+ */
+typedef bool (*audio_source_t)(void *arg, int16_t *buffer, size_t len, size_t *samples_read);
+
+/** Queue of samples between a thread reading a source and the DAC.
+ *
+ * There is a single producer, calling audio_stream_fill(), and a single
+ * consumer, the DAC callback audio_stream_read_cb(), so no locking is needed.
+ * head and tail are free running, head - tail samples are queued.
+ */
+typedef struct {
+    int16_t *buffer;
+    uint32_t size; /**< Power of two. */
+    volatile uint32_t head;
+    volatile uint32_t tail;
+    volatile bool end; /**< The source has no more samples. */
+    volatile uint32_t underruns; /**< DAC buffers which were padded with silence. */
+} audio_stream_t;
+
+/** Initializes an empty stream using a buffer of size samples, a power of
+ * two. */
+void audio_stream_init(audio_stream_t *stream, int16_t *buffer, size_t size);
+
+/** Empties the stream before playing a new source, which must not be done
+ * while it is being filled. The underrun count is kept. */
+void audio_stream_reset(audio_stream_t *stream);
+
+/** Returns the number of queued samples. */
+size_t audio_stream_available(audio_stream_t *stream);
+
+/** Returns the number of samples which can be queued. */
+size_t audio_stream_space(audio_stream_t *stream);
+
+/** Queues up to max samples from the source, less if there is not enough
+ * space or the source ends.
+ *
+ * @returns the number of samples queued.
+ */
+size_t audio_stream_fill(audio_stream_t *stream, audio_source_t source, void *arg, size_t max);
+
+/** Moves up to len queued samples to buffer.
+ *
+ * @returns the number of samples moved.
+ */
+size_t audio_stream_read(audio_stream_t *stream, int16_t *buffer, size_t len);
+
+/** DAC callback moving queued samples to the DAC buffer, see audio_callback_t.
+ *
+ * If the producer is late, the buffer is completed with silence and an
+ * underrun is counted, so that playback does not stop.
+ */
+bool audio_stream_read_cb(void *arg, audio_sample_t *buffer, size_t len, size_t *samples_written);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AUDIO_STREAM_H */
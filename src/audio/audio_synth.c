@@ -0,0 +1,281 @@
+#include <string.h>
+#include "audio_synth.h"
+
+#define ARRAY_LEN(a) (sizeof(a) / sizeof(a[0]))
+
+/* Entries of the sine table, indexed by the top bits of the phase. */
+#define AUDIO_SYNTH_TABLE_BITS 8
+
+/* One period of a sine at full scale. */
+static const int16_t sine_table[1 << AUDIO_SYNTH_TABLE_BITS] = {
+    0, 804, 1608, 2410, 3212, 4011, 4808, 5602, 6393, 7179, 7962, 8739,
+    9512, 10278, 11039, 11793, 12539, 13279, 14010, 14732, 15446, 16151, 16846, 17530,
+    18204, 18868, 19519, 20159, 20787, 21403, 22005, 22594, 23170, 23731, 24279, 24811,
+    25329, 25832, 26319, 26790, 27245, 27683, 28105, 28510, 28898, 29268, 29621, 29956,
+    30273, 30571, 30852, 31113, 31356, 31580, 31785, 31971, 32137, 32285, 32412, 32521,
+    32609, 32678, 32728, 32757, 32767, 32757, 32728, 32678, 32609, 32521, 32412, 32285,
+    32137, 31971, 31785, 31580, 31356, 31113, 30852, 30571, 30273, 29956, 29621, 29268,
+    28898, 28510, 28105, 27683, 27245, 26790, 26319, 25832, 25329, 24811, 24279, 23731,
+    23170, 22594, 22005, 21403, 20787, 20159, 19519, 18868, 18204, 17530, 16846, 16151,
+    15446, 14732, 14010, 13279, 12539, 11793, 11039, 10278, 9512, 8739, 7962, 7179,
+    6393, 5602, 4808, 4011, 3212, 2410, 1608, 804, 0, -804, -1608, -2410,
+    -3212, -4011, -4808, -5602, -6393, -7179, -7962, -8739, -9512, -10278, -11039, -11793,
+    -12539, -13279, -14010, -14732, -15446, -16151, -16846, -17530, -18204, -18868, -19519, -20159,
+    -20787, -21403, -22005, -22594, -23170, -23731, -24279, -24811, -25329, -25832, -26319, -26790,
+    -27245, -27683, -28105, -28510, -28898, -29268, -29621, -29956, -30273, -30571, -30852, -31113,
+    -31356, -31580, -31785, -31971, -32137, -32285, -32412, -32521, -32609, -32678, -32728, -32757,
+    -32767, -32757, -32728, -32678, -32609, -32521, -32412, -32285, -32137, -31971, -31785, -31580,
+    -31356, -31113, -30852, -30571, -30273, -29956, -29621, -29268, -28898, -28510, -28105, -27683,
+    -27245, -26790, -26319, -25832, -25329, -24811, -24279, -23731, -23170, -22594, -22005, -21403,
+    -20787, -20159, -19519, -18868, -18204, -17530, -16846, -16151, -15446, -14732, -14010, -13279,
+    -12539, -11793, -11039, -10278, -9512, -8739, -7962, -7179, -6393, -5602, -4808, -4011,
+    -3212, -2410, -1608, -804,
+};
+
+/* Frequencies of the keys of the lowest octave in mHz, higher octaves are
+ * obtained by doubling them. */
+static const uint32_t key_frequency_mhz[12] = {
+    8176, 8662, 9177, 9723, 10301, 10913, 11562, 12250, 12978, 13750, 14568, 15434,
+};
+
+static const audio_synth_instrument_t builtin_instruments[] = {
+    [AUDIO_SYNTH_BEEP] = {
+        .waveform = AUDIO_SYNTH_SQUARE,
+        .amplitude = 8000,
+        .attack_ms = 2,
+        .decay_ms = 0,
+        .sustain = 100,
+        .release_ms = 10,
+    },
+    /* Struck, fading out even while held. */
+    [AUDIO_SYNTH_CHIME] = {
+        .waveform = AUDIO_SYNTH_SINE,
+        .amplitude = 16000,
+        .attack_ms = 2,
+        .decay_ms = 400,
+        .sustain = 0,
+        .release_ms = 50,
+    },
+    [AUDIO_SYNTH_ORGAN] = {
+        .waveform = AUDIO_SYNTH_TRIANGLE,
+        .amplitude = 14000,
+        .attack_ms = 20,
+        .decay_ms = 100,
+        .sustain = 70,
+        .release_ms = 80,
+    },
+    [AUDIO_SYNTH_BUZZ] = {
+        .waveform = AUDIO_SYNTH_SAWTOOTH,
+        .amplitude = 6000,
+        .attack_ms = 5,
+        .decay_ms = 50,
+        .sustain = 60,
+        .release_ms = 20,
+    },
+};
+
+static const char *builtin_names[] = {
+    [AUDIO_SYNTH_BEEP] = "beep",
+    [AUDIO_SYNTH_CHIME] = "chime",
+    [AUDIO_SYNTH_ORGAN] = "organ",
+    [AUDIO_SYNTH_BUZZ] = "buzz",
+};
+
+static uint32_t ms_to_samples(audio_synth_t *synth, uint32_t ms)
+{
+    return ms * synth->sample_rate / 1000;
+}
+
+void audio_synth_init(audio_synth_t *synth, const audio_synth_instrument_t *instrument,
+                      const uint16_t *notes, size_t note_count, uint32_t sample_rate)
+{
+    memset(synth, 0, sizeof(*synth));
+    synth->instrument = instrument;
+    synth->notes = notes;
+    synth->note_count = note_count;
+    synth->sample_rate = sample_rate;
+}
+
+/* Returns false once all notes were played. */
+static bool audio_synth_next_note(audio_synth_t *synth)
+{
+    uint16_t note;
+    uint32_t key, release;
+
+    if (synth->next_note == synth->note_count) {
+        return false;
+    }
+
+    note = synth->notes[synth->next_note++];
+    key = AUDIO_SYNTH_NOTE_KEY(note);
+    if (key > AUDIO_SYNTH_KEY_MAX) {
+        key = AUDIO_SYNTH_REST;
+    }
+
+    synth->note_left = ms_to_samples(synth, AUDIO_SYNTH_NOTE_LENGTH_MS(note));
+    synth->rest = key == AUDIO_SYNTH_REST;
+    synth->increment = (((uint64_t)key_frequency_mhz[key % 12] << (key / 12)) << 32) /
+                       ((uint64_t)synth->sample_rate * 1000);
+
+    release = ms_to_samples(synth, synth->instrument->release_ms);
+    if (release > synth->note_left) {
+        release = synth->note_left;
+    }
+    synth->gate_left = synth->note_left - release;
+
+    /* The phase goes on, so that notes follow each other without clicks. */
+    synth->level = 0;
+    synth->stage = AUDIO_SYNTH_ATTACK;
+    synth->stage_left = ms_to_samples(synth, synth->instrument->attack_ms);
+    if (synth->stage_left == 0) {
+        synth->stage_left = 1;
+    }
+    synth->level_step = ((int32_t)synth->instrument->amplitude << 15) / synth->stage_left;
+    if (synth->stage_left > synth->gate_left) {
+        synth->stage_left = synth->gate_left;
+    }
+
+    return true;
+}
+
+static void audio_synth_next_stage(audio_synth_t *synth)
+{
+    const audio_synth_instrument_t *instrument = synth->instrument;
+    int32_t sustain = ((int32_t)instrument->amplitude << 15) / 100 * instrument->sustain;
+
+    /* The release is computed from the current level, so that it always
+     * ends at 0. */
+    if (synth->gate_left == 0) {
+        synth->stage = AUDIO_SYNTH_RELEASE;
+        synth->stage_left = synth->note_left;
+        synth->level_step = synth->stage_left ? -synth->level / (int32_t)synth->stage_left : 0;
+        return;
+    }
+
+    if (synth->stage == AUDIO_SYNTH_ATTACK) {
+        synth->stage = AUDIO_SYNTH_DECAY;
+        synth->stage_left = ms_to_samples(synth, instrument->decay_ms);
+        if (synth->stage_left > 0) {
+            synth->level_step = (sustain - synth->level) / (int32_t)synth->stage_left;
+        }
+        if (synth->stage_left > synth->gate_left) {
+            synth->stage_left = synth->gate_left;
+        }
+    } else {
+        synth->stage = AUDIO_SYNTH_SUSTAIN;
+        synth->stage_left = synth->gate_left;
+        synth->level = sustain;
+        synth->level_step = 0;
+    }
+}
+
+/* Value of the waveform at the given phase, at full scale. */
+static inline int32_t audio_synth_wave(audio_synth_waveform_t waveform, uint32_t phase)
+{
+    uint32_t index, fraction;
+    int32_t a, b, saw;
+
+    switch (waveform) {
+        case AUDIO_SYNTH_SQUARE:
+            return (phase & 0x80000000) ? -INT16_MAX : INT16_MAX;
+
+        case AUDIO_SYNTH_TRIANGLE:
+            /* Folded sawtooth, peaking after a quarter period. */
+            saw = (int32_t)(phase + 0x40000000) >> 15;
+            return (saw < 0 ? -saw : saw) - 0x8000;
+
+        case AUDIO_SYNTH_SAWTOOTH:
+            return (int32_t)phase >> 16;
+
+        default:
+            /* Linear interpolation between the entries of the table. */
+            index = phase >> (32 - AUDIO_SYNTH_TABLE_BITS);
+            fraction = (phase >> (16 - AUDIO_SYNTH_TABLE_BITS)) & 0xffff;
+            a = sine_table[index];
+            b = sine_table[(index + 1) & ((1 << AUDIO_SYNTH_TABLE_BITS) - 1)];
+            return a + (((b - a) * (int32_t)fraction) >> 16);
+    }
+}
+
+static void audio_synth_render(audio_synth_t *synth, int16_t *buffer, size_t len)
+{
+    audio_synth_waveform_t waveform = synth->instrument->waveform;
+    uint32_t phase = synth->phase;
+    uint32_t increment = synth->increment;
+    int32_t level = synth->level;
+    int32_t step = synth->level_step;
+    size_t i;
+
+    if (synth->rest) {
+        memset(buffer, 0, len * sizeof(int16_t));
+        return;
+    }
+
+    for (i = 0; i < len; i++) {
+        buffer[i] = (audio_synth_wave(waveform, phase) * (level >> 15)) >> 15;
+        phase += increment;
+        level += step;
+    }
+
+    synth->phase = phase;
+    synth->level = level;
+}
+
+bool audio_synth_read(void *arg, int16_t *buffer, size_t len, size_t *samples_read)
+{
+    audio_synth_t *synth = (audio_synth_t *)arg;
+    size_t n = 0, count;
+
+    while (n < len) {
+        if (synth->note_left == 0) {
+            if (!audio_synth_next_note(synth)) {
+                break;
+            }
+            continue;
+        }
+
+        if (synth->stage_left == 0) {
+            audio_synth_next_stage(synth);
+            continue;
+        }
+
+        count = len - n;
+        if (count > synth->stage_left) {
+            count = synth->stage_left;
+        }
+
+        audio_synth_render(synth, &buffer[n], count);
+
+        n += count;
+        synth->stage_left -= count;
+        synth->note_left -= count;
+        if (synth->stage != AUDIO_SYNTH_RELEASE) {
+            synth->gate_left -= count;
+        }
+    }
+
+    *samples_read = n;
+    return synth->note_left == 0 && synth->next_note == synth->note_count;
+}
+
+const audio_synth_instrument_t *audio_synth_instrument_builtin(int id)
+{
+    if (id < 0 || id >= AUDIO_SYNTH_INSTRUMENT_COUNT) {
+        return NULL;
+    }
+
+    return &builtin_instruments[id];
+}
+
+int audio_synth_instrument_find(const char *name)
+{
+    size_t i;
+
+    for (i = 0; i < ARRAY_LEN(builtin_names); i++) {
+        if (!strcmp(name, builtin_names[i])) {
+            return i;
+        }
+    }
+
+    return -1;
+}
@@ -0,0 +1,99 @@
+#ifndef AUDIO_SYNTH_H
+#define AUDIO_SYNTH_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+/** Notes are 16 bit words holding a MIDI key, 69 being A4 at 440Hz, and a
+ * length in units of AUDIO_SYNTH_NOTE_UNIT_MS. Key 0 is a rest. */
+#define AUDIO_SYNTH_NOTE(key, length_ms) \
+    ((uint16_t)((key) << 8 | (length_ms) / AUDIO_SYNTH_NOTE_UNIT_MS))
+#define AUDIO_SYNTH_NOTE_KEY(note) ((note) >> 8)
+#define AUDIO_SYNTH_NOTE_LENGTH_MS(note) (((note) & 0xff) * AUDIO_SYNTH_NOTE_UNIT_MS)
+
+#define AUDIO_SYNTH_NOTE_UNIT_MS 10
+#define AUDIO_SYNTH_NOTE_LENGTH_MAX_MS (0xff * AUDIO_SYNTH_NOTE_UNIT_MS)
+#define AUDIO_SYNTH_REST 0
+#define AUDIO_SYNTH_KEY_MAX 127
+
+typedef enum {
+    AUDIO_SYNTH_SINE = 0,
+    AUDIO_SYNTH_SQUARE,
+    AUDIO_SYNTH_TRIANGLE,
+    AUDIO_SYNTH_SAWTOOTH,
+} audio_synth_waveform_t;
+
+/** Builtin instruments, usable from the shell and from Aseba. */
+enum {
+    AUDIO_SYNTH_BEEP = 0,
+    AUDIO_SYNTH_CHIME,
+    AUDIO_SYNTH_ORGAN,
+    AUDIO_SYNTH_BUZZ,
+    AUDIO_SYNTH_INSTRUMENT_COUNT
+};
+
+/** Waveform and ADSR envelope of the notes.
+ *
+ * The level rises to amplitude during the attack, falls to the sustain
+ * level during the decay and is held until the release, which ends with the
+ * note. A note shorter than the release is released from its start.
+ */
+typedef struct {
+    audio_synth_waveform_t waveform;
+    int16_t amplitude;
+    uint16_t attack_ms;
+    uint16_t decay_ms;
+    uint8_t sustain; /**< Level held after the decay, in percent of amplitude. */
+    uint16_t release_ms;
+} audio_synth_instrument_t;
+
+typedef enum {
+    AUDIO_SYNTH_ATTACK = 0,
+    AUDIO_SYNTH_DECAY,
+    AUDIO_SYNTH_SUSTAIN,
+    AUDIO_SYNTH_RELEASE,
+} audio_synth_stage_t;
+
+/** Plays a sequence of notes with an instrument. */
+typedef struct {
+    const audio_synth_instrument_t *instrument;
+    const uint16_t *notes;
+    size_t note_count;
+    size_t next_note;
+    uint32_t sample_rate;
+    uint32_t phase; /**< Of the oscillator, a full period is 2^32. */
+    uint32_t increment; /**< Added to phase for each sample. */
+    bool rest;
+    audio_synth_stage_t stage;
+    uint32_t stage_left; /**< Samples before the next stage. */
+    uint32_t gate_left; /**< Samples before the release. */
+    uint32_t note_left; /**< Samples before the next note. */
+    int32_t level; /**< Of the envelope, amplitude << 15 at the peak. */
+    int32_t level_step; /**< Added to level for each sample. */
+} audio_synth_t;
+
+/** Initializes a synthesizer playing note_count notes at sample_rate. The
+ * notes are not copied. */
+void audio_synth_init(audio_synth_t *synth, const audio_synth_instrument_t *instrument,
+                      const uint16_t *notes, size_t note_count, uint32_t sample_rate);
+
+/** Audio source rendering the notes, see audio_source_t. */
+bool audio_synth_read(void *arg, int16_t *buffer, size_t len, size_t *samples_read);
+
+/** Returns a builtin instrument, NULL if it does not exist. */
+const audio_synth_instrument_t *audio_synth_instrument_builtin(int id);
+
+/** Returns the id of the builtin instrument with the given name, -1 if not
+ * found. */
+int audio_synth_instrument_find(const char *name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AUDIO_SYNTH_H */
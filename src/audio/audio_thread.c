@@ -2,63 +2,613 @@
 #include <hal.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
 #include <ff.h>
 #include <sdcard.h>
 #include <main.h>
 
+#include "audio_bank.h"
 #include "audio_dac.h"
+#include "audio_mixer.h"
+#include "audio_pcm.h"
+#include "audio_stream.h"
+#include "audio_synth.h"
+#include "audio_tone.h"
 #include "audio_wav.h"
 #include "audio_thread.h"
 
 #define DAC_BUFFER_SIZE 1000
 static audio_sample_t buffer[DAC_BUFFER_SIZE];
 
-void audio_thd_main(void *arg)
+/* Rate of the DAC, sounds at lower rates are resampled to it. */
+#define AUDIO_SAMPLE_RATE 44100
+
+/* Samples queued between the card and the DAC for each file, 256ms at 16kHz.
+ * Deep enough to hide the latency spikes of the card. */
+#define AUDIO_STREAM_SIZE 4096
+
+/* Samples read from the card at once. */
+#define AUDIO_READ_SIZE 1024
+
+/* Requests waiting for a voice. */
+#define AUDIO_QUEUE_SIZE 8
+
+#define AUDIO_TONE_AMPLITUDE 8000
+
+/* Sounds kept in RAM, loaded from /p0.wav to /p15.wav when a card is
+ * mounted. Those up to 0.5s at 16kHz fit, 1s of them in total, four times
+ * more if they are IMA ADPCM. */
+#define AUDIO_BANK_SOUNDS 16
+#define AUDIO_BANK_MAX_CLIP 16384
+#define AUDIO_BANK_POOL_SIZE 32768
+
+#define READER_EVENT_REQUEST EVENT_MASK(0)
+#define READER_EVENT_REFILL EVENT_MASK(1)
+#define READER_EVENT_CARD EVENT_MASK(2)
+
+EVENTSOURCE_DECL(audio_events);
+
+static audio_mixer_t mixer;
+
+/* Reserving a voice is done both by the reader thread and by the threads
+ * playing sounds from the bank. */
+static MUTEX_DECL(voice_lock);
+
+/* What each voice plays, accessed by the thread which reserved it. */
+static struct {
+    uint32_t id;
+    uint32_t sample_rate;
+    bool is_file;
+    audio_source_t source;
+    void *arg;
+    systime_t request_time;
+    bool measured; /**< The latency was recorded. */
+    FIL file;
+    struct wav_data wav;
+    audio_stream_t stream;
+    audio_tone_t tone;
+    audio_synth_t synth;
+    uint16_t notes[AUDIO_PLAY_MAX_NOTES];
+    audio_clip_t clip;
+    int16_t stream_buffer[AUDIO_STREAM_SIZE];
+} voice_data[AUDIO_MIXER_VOICES];
+
+/* Only accessed by the CPU, so it can be in the core coupled memory. */
+static uint8_t bank_pool[AUDIO_BANK_POOL_SIZE] __attribute__((section(".ram4"), aligned(4)));
+static audio_bank_entry_t bank_entries[AUDIO_BANK_SOUNDS];
+static audio_bank_t bank;
+static volatile sdcard_state_t card_state;
+
+/* Set by the reader thread from the mount or removal of a card until the
+ * bank was reloaded, under voice_lock. No clip is started meanwhile. */
+static bool bank_reloading;
+
+typedef struct {
+    audio_play_request_t request;
+    systime_t time;
+} audio_queued_request_t;
+
+static audio_queued_request_t request_buffer[AUDIO_QUEUE_SIZE];
+static MEMORYPOOL_DECL(request_pool, sizeof(audio_queued_request_t), NULL);
+static msg_t request_mailbox_buffer[AUDIO_QUEUE_SIZE];
+static MAILBOX_DECL(request_mailbox, request_mailbox_buffer, AUDIO_QUEUE_SIZE);
+
+static TOPIC_DECL(result_topic, audio_play_result_t);
+
+static thread_t *reader_thread;
+static BSEMAPHORE_DECL(playback_wakeup, true);
+
+static uint32_t underruns;
+static audio_latency_t ram_latency, card_latency;
+
+static void audio_report(uint32_t id, audio_play_status_t status)
 {
-    (void) arg;
-    static TOPIC_DECL(request_topic, audio_play_request_t);
-    static TOPIC_DECL(result_topic, audio_play_result_t);
+    audio_play_result_t res;
 
-    messagebus_advertise_topic(&bus, &request_topic.topic, "/audio/play/request");
-    messagebus_advertise_topic(&bus, &result_topic.topic, "/audio/play/result");
+    res.status = status;
+    res.id = id;
+    messagebus_topic_publish(&result_topic.topic, &res, sizeof(res));
 
-    while (1) {
-        /* Wait for a request to play a file. */
-        audio_play_request_t req;
-        messagebus_topic_wait(&request_topic.topic, &req, sizeof(req));
-
-        /* If the file was not found, reply with appropriate status. */
-        static FIL file;
-        if (f_open(&file, req.path, FA_READ) != FR_OK) {
-            audio_play_result_t res;
-            res.status = AUDIO_FILE_NOT_FOUND;
-            messagebus_topic_publish(&result_topic.topic, &res, sizeof(res));
+    if (status == AUDIO_OK) {
+        chEvtBroadcastFlags(&audio_events, AUDIO_EVENT_FINISHED);
+    } else {
+        chEvtBroadcastFlags(&audio_events, AUDIO_EVENT_ERROR);
+    }
+}
+
+static audio_voice_t *audio_reserve(void)
+{
+    audio_voice_t *voice;
+
+    chMtxLock(&voice_lock);
+    voice = audio_mixer_reserve(&mixer);
+    chMtxUnlock(&voice_lock);
+
+    return voice;
+}
+
+/* Same as audio_reserve(), for a clip of the bank. */
+static audio_voice_t *audio_reserve_clip(void)
+{
+    audio_voice_t *voice = NULL;
+
+    chMtxLock(&voice_lock);
+    if (!bank_reloading) {
+        voice = audio_mixer_reserve(&mixer);
+    }
+    chMtxUnlock(&voice_lock);
+
+    return voice;
+}
+
+static void audio_release(audio_voice_t *voice)
+{
+    chMtxLock(&voice_lock);
+    audio_mixer_release(voice);
+    chMtxUnlock(&voice_lock);
+}
+
+/* Sets a reserved voice up to play a sound which does not need the card: a
+ * tone or notes, which are generated at the rate of the DAC, or a clip of the
+ * bank.
+ *
+ * Returns false if the sound is a file which is not in the bank. */
+static bool audio_prepare_from_ram(int i, const audio_play_request_t *req, systime_t time)
+{
+    const audio_bank_entry_t *entry;
+
+    voice_data[i].id = req->id;
+    voice_data[i].request_time = time;
+    voice_data[i].measured = false;
+    voice_data[i].is_file = false;
+    voice_data[i].sample_rate = AUDIO_SAMPLE_RATE;
+
+    if (req->path[0] == '\0' && req->note_count > 0) {
+        memcpy(voice_data[i].notes, req->notes, req->note_count * sizeof(uint16_t));
+        audio_synth_init(&voice_data[i].synth, audio_synth_instrument_builtin(req->instrument),
+                         voice_data[i].notes, req->note_count, voice_data[i].sample_rate);
+        voice_data[i].source = audio_synth_read;
+        voice_data[i].arg = &voice_data[i].synth;
+        return true;
+    }
+
+    if (req->path[0] == '\0') {
+        audio_tone_init(&voice_data[i].tone, req->frequency, req->duration,
+                        voice_data[i].sample_rate, AUDIO_TONE_AMPLITUDE);
+        voice_data[i].source = audio_tone_read;
+        voice_data[i].arg = &voice_data[i].tone;
+        return true;
+    }
+
+    entry = audio_bank_find(&bank, req->path);
+    if (entry == NULL) {
+        return false;
+    }
+
+    voice_data[i].sample_rate = entry->sample_rate;
+    audio_clip_init(&voice_data[i].clip, &bank, entry);
+    voice_data[i].source = audio_clip_read;
+    voice_data[i].arg = &voice_data[i].clip;
+    return true;
+}
+
+/* Sets the request up in a reserved voice, opening the file if it is not in
+ * RAM. Files are read until their stream is full, so that playback starts
+ * without waiting for the card.
+ *
+ * Returns false if the request failed, which was reported. */
+static bool audio_prepare(int i, const audio_play_request_t *req, systime_t time)
+{
+    audio_voice_t *voice = &mixer.voices[i];
+
+    /* Queued because no voice was free when it was requested. */
+    if (audio_prepare_from_ram(i, req, time)) {
+        return true;
+    }
+
+    voice_data[i].is_file = true;
+
+    if (!sdcard_wait_for_mount() || f_open(&voice_data[i].file, req->path, FA_READ) != FR_OK) {
+        audio_release(voice);
+        audio_report(req->id, AUDIO_FILE_NOT_FOUND);
+        return false;
+    }
+
+    if (wav_read_header(&voice_data[i].wav, &voice_data[i].file) != 0 ||
+        voice_data[i].wav.sample_rate > AUDIO_SAMPLE_RATE) {
+        f_close(&voice_data[i].file);
+        audio_release(voice);
+        audio_report(req->id, AUDIO_WAV_DECODE);
+        return false;
+    }
+
+    voice_data[i].sample_rate = voice_data[i].wav.sample_rate;
+
+    audio_stream_reset(&voice_data[i].stream);
+    while (!voice_data[i].stream.end &&
+           audio_stream_space(&voice_data[i].stream) >= AUDIO_READ_SIZE) {
+        audio_stream_fill(&voice_data[i].stream, wav_read_cb, &voice_data[i].wav,
+                          AUDIO_READ_SIZE);
+    }
+
+    return true;
+}
+
+/* Hands a prepared voice to the mixer, whatever the rate of the others.
+ *
+ * Returns false if the mixer refused its rate, in which case the voice was
+ * freed and the failure reported. */
+static bool audio_start_voice(int i)
+{
+    audio_stream_t *stream = NULL;
+
+    if (voice_data[i].is_file) {
+        stream = &voice_data[i].stream;
+    }
+
+    if (!audio_mixer_play(&mixer, &mixer.voices[i], voice_data[i].id, voice_data[i].sample_rate,
+                          stream, voice_data[i].source, voice_data[i].arg)) {
+        if (voice_data[i].is_file) {
+            f_close(&voice_data[i].file);
+        }
+        audio_release(&mixer.voices[i]);
+        audio_report(voice_data[i].id, AUDIO_WAV_DECODE);
+        return false;
+    }
+
+    chBSemSignal(&playback_wakeup);
+    return true;
+}
+
+/* Reports and frees the voices the mixer is done with. */
+static void audio_release_finished(void)
+{
+    audio_voice_t *voice;
+    int i;
+
+    for (i = 0; i < AUDIO_MIXER_VOICES; i++) {
+        voice = &mixer.voices[i];
+
+        if (voice->state != AUDIO_VOICE_FINISHED) {
             continue;
         }
 
-        /* WAV decodede error. */
-        static struct wav_data wav;
-        if (wav_read_header(&wav, &file) != 0) {
-            audio_play_result_t res;
-            res.status = AUDIO_WAV_DECODE;
-            messagebus_topic_publish(&result_topic.topic, &res, sizeof(res));
-            f_close(&file);
+        if (voice_data[i].is_file) {
+            f_close(&voice_data[i].file);
+        }
+
+        underruns += voice->underruns;
+        audio_release(voice);
+        audio_report(voice_data[i].id, AUDIO_OK);
+    }
+}
+
+static void audio_refill(void)
+{
+    audio_stream_t *stream;
+    int i;
+
+    for (i = 0; i < AUDIO_MIXER_VOICES; i++) {
+        stream = &voice_data[i].stream;
+
+        if (mixer.voices[i].state != AUDIO_VOICE_PLAYING || !voice_data[i].is_file) {
             continue;
         }
 
-        /* Play the file. */
-        audio_dac_convert(wav_read_cb, &wav, wav.sample_rate, buffer, DAC_BUFFER_SIZE);
+        while (!stream->end && audio_stream_space(stream) >= AUDIO_READ_SIZE) {
+            audio_stream_fill(stream, wav_read_cb, &voice_data[i].wav, AUDIO_READ_SIZE);
+        }
+    }
+}
+
+/* Returns true while a voice may read from the bank. Those reserved by
+ * other threads count, as they may be preparing a clip. */
+static bool audio_bank_in_use(void)
+{
+    audio_voice_state_t state;
+    bool in_use = false;
+    int i;
+
+    chMtxLock(&voice_lock);
+    for (i = 0; i < AUDIO_MIXER_VOICES; i++) {
+        state = mixer.voices[i].state;
+        if (state == AUDIO_VOICE_RESERVED ||
+            (state == AUDIO_VOICE_PLAYING && voice_data[i].source == audio_clip_read)) {
+            in_use = true;
+        }
+    }
+    chMtxUnlock(&voice_lock);
+
+    return in_use;
+}
+
+/* Keeps the streams of the files playing fed while the bank is loaded. */
+static size_t audio_bank_read_cb(void *arg, uint8_t *buf, size_t len)
+{
+    audio_refill();
+    return wav_read_data(arg, buf, len);
+}
+
+/* Loads the short sounds of the card into the bank, which no voice may read
+ * meanwhile. */
+static void audio_bank_reload(void)
+{
+    static FIL file;
+    static struct wav_data wav;
+    char path[AUDIO_BANK_NAME_LEN];
+    uint32_t block_align;
+    int n;
+
+    audio_bank_clear(&bank);
+
+    if (card_state != SDCARD_MOUNTED) {
+        return;
+    }
+
+    for (n = 0; n < AUDIO_BANK_SOUNDS; n++) {
+        snprintf(path, sizeof(path), "/p%d.wav", n);
+
+        if (f_open(&file, path, FA_READ) != FR_OK) {
+            continue;
+        }
+
+        if (wav_read_header(&wav, &file) == 0 && wav.data_len <= AUDIO_BANK_MAX_CLIP &&
+            wav.sample_rate <= AUDIO_SAMPLE_RATE) {
+            block_align = wav.format == WAV_FORMAT_IMA_ADPCM ? wav.block_align : 0;
+            audio_bank_load(&bank, path, wav.sample_rate, block_align, wav.data_len,
+                            audio_bank_read_cb, &wav);
+        }
+
         f_close(&file);
+    }
+}
+
+/* Starts the queued requests and reads the files into their streams, in its
+ * own thread so that the DAC buffers are refilled on time even when the card
+ * is slow. */
+static THD_FUNCTION(audio_reader_thd, arg)
+{
+    (void)arg;
+    chRegSetThreadName(__FUNCTION__);
+
+    audio_queued_request_t *request = NULL;
+    audio_voice_t *voice;
+    eventmask_t events;
+    msg_t msg;
+
+    while (1) {
+        events = chEvtWaitAny(READER_EVENT_REQUEST | READER_EVENT_REFILL | READER_EVENT_CARD);
+
+        audio_release_finished();
+
+        if (events & READER_EVENT_CARD) {
+            chMtxLock(&voice_lock);
+            bank_reloading = true;
+            chMtxUnlock(&voice_lock);
+        }
+
+        /* Clips last 0.5s at most, so the reload is not delayed for long. */
+        if (bank_reloading && !audio_bank_in_use()) {
+            audio_bank_reload();
+
+            chMtxLock(&voice_lock);
+            bank_reloading = false;
+            chMtxUnlock(&voice_lock);
+        }
+
+        /* Requests are started in order, as long as voices are free. They
+         * wait for the reload, as they may be clips of the new bank. */
+        while (!bank_reloading) {
+            if (request == NULL) {
+                if (chMBFetch(&request_mailbox, &msg, TIME_IMMEDIATE) != MSG_OK) {
+                    break;
+                }
+                request = (audio_queued_request_t *)msg;
+            }
+
+            voice = audio_reserve();
+            if (voice == NULL) {
+                break;
+            }
+
+            if (audio_prepare(voice - mixer.voices, &request->request, request->time)) {
+                audio_start_voice(voice - mixer.voices);
+            }
+            chPoolFree(&request_pool, request);
+            request = NULL;
+        }
+
+        audio_refill();
+    }
+}
+
+static void audio_latency_update(audio_latency_t *latency, systime_t elapsed)
+{
+    latency->last_us = ST2US(elapsed);
+    if (latency->last_us > latency->max_us) {
+        latency->max_us = latency->last_us;
+    }
+    latency->count++;
+}
+
+/* Records the time from the request to the first samples of each voice in
+ * the DAC buffer. */
+static void audio_measure_latency(void)
+{
+    systime_t now = chVTGetSystemTimeX();
+    audio_voice_t *voice;
+    int i;
+
+    for (i = 0; i < AUDIO_MIXER_VOICES; i++) {
+        voice = &mixer.voices[i];
+
+        if ((voice->state != AUDIO_VOICE_PLAYING && voice->state != AUDIO_VOICE_FINISHED) ||
+            voice->position == 0 || voice_data[i].measured) {
+            continue;
+        }
+
+        voice_data[i].measured = true;
+        audio_latency_update(voice_data[i].is_file ? &card_latency : &ram_latency,
+                             now - voice_data[i].request_time);
+    }
+}
+
+/* DAC callback, wakes the reader up once samples were consumed. */
+static bool audio_dac_read_cb(void *arg, audio_sample_t *buf, size_t len, size_t *samples_written)
+{
+    (void)arg;
+
+    audio_mixer_render(&mixer, (int16_t *)buf, len);
+    audio_pcm_to_dac(buf, (int16_t *)buf, len);
+    audio_measure_latency();
+
+    chEvtSignal(reader_thread, READER_EVENT_REFILL);
+
+    *samples_written = len;
+    return !audio_mixer_is_playing(&mixer);
+}
+
+void audio_thd_main(void *arg)
+{
+    (void)arg;
+    chRegSetThreadName(__FUNCTION__);
+
+    while (1) {
+        /* Wait for a voice to start, the semaphore may have been signaled by
+         * one which played already. */
+        chBSemWait(&playback_wakeup);
+        if (!audio_mixer_is_playing(&mixer)) {
+            continue;
+        }
+
+        audio_dac_convert(audio_dac_read_cb, NULL, mixer.sample_rate, buffer, DAC_BUFFER_SIZE);
+    }
+}
+
+/* Reloads the bank whenever a card is mounted or removed. */
+static THD_FUNCTION(audio_card_thd, arg)
+{
+    (void)arg;
+    chRegSetThreadName(__FUNCTION__);
+    messagebus_topic_t *topic;
+    sdcard_state_msg_t msg;
+
+    topic = messagebus_find_topic_blocking(&bus, "/sdcard/state");
+
+    /* The card may have been mounted before. */
+    if (!messagebus_topic_read(topic, &msg, sizeof(msg))) {
+        messagebus_topic_wait(topic, &msg, sizeof(msg));
+    }
+
+    while (true) {
+        if (msg.state == SDCARD_MOUNTED || msg.state == SDCARD_REMOVED) {
+            card_state = msg.state;
+            chEvtSignal(reader_thread, READER_EVENT_CARD);
+        }
 
-        /* Signal success. */
-        audio_play_result_t res;
-        res.status = AUDIO_OK;
-        messagebus_topic_publish(&result_topic.topic, &res, sizeof(res));
+        messagebus_topic_wait(topic, &msg, sizeof(msg));
     }
 }
 
 void audio_start(void)
 {
-    static THD_WORKING_AREA(audio_thd, 2000);
-    chThdCreateStatic(audio_thd, sizeof(audio_thd), LOWPRIO, audio_thd_main, NULL);
+    static THD_WORKING_AREA(audio_thd, 1024);
+    static THD_WORKING_AREA(audio_reader_thd_wa, 2000);
+    static THD_WORKING_AREA(audio_card_thd_wa, 256);
+    int i;
+
+    audio_mixer_init(&mixer, AUDIO_SAMPLE_RATE);
+    audio_bank_init(&bank, bank_pool, AUDIO_BANK_POOL_SIZE, bank_entries, AUDIO_BANK_SOUNDS);
+    for (i = 0; i < AUDIO_MIXER_VOICES; i++) {
+        audio_stream_init(&voice_data[i].stream, voice_data[i].stream_buffer, AUDIO_STREAM_SIZE);
+    }
+
+    chPoolLoadArray(&request_pool, request_buffer, AUDIO_QUEUE_SIZE);
+    messagebus_advertise_topic(&bus, &result_topic.topic, "/audio/play/result");
+
+    /* Refilling the DAC buffers only takes mixing, but must be on time. */
+    reader_thread = chThdCreateStatic(audio_reader_thd_wa, sizeof(audio_reader_thd_wa),
+                                      LOWPRIO, audio_reader_thd, NULL);
+    chThdCreateStatic(audio_thd, sizeof(audio_thd), NORMALPRIO, audio_thd_main, NULL);
+    chThdCreateStatic(audio_card_thd_wa, sizeof(audio_card_thd_wa), LOWPRIO,
+                      audio_card_thd, NULL);
+}
+
+/* Starts a sound which does not need the card right away from the calling
+ * thread, so that it plays from the next DAC buffer on. */
+static bool audio_play_from_ram(const audio_play_request_t *request, systime_t time)
+{
+    audio_voice_t *voice;
+    int i;
+
+    if (request->path[0] != '\0' && audio_bank_find(&bank, request->path) == NULL) {
+        return false;
+    }
+
+    if (request->path[0] != '\0') {
+        voice = audio_reserve_clip();
+    } else {
+        voice = audio_reserve();
+    }
+    if (voice == NULL) {
+        return false;
+    }
+
+    /* The bank may have been reloaded in between. */
+    i = voice - mixer.voices;
+    if (!audio_prepare_from_ram(i, request, time)) {
+        audio_release(voice);
+        return false;
+    }
+
+    /* A failure to start was already reported. */
+    audio_start_voice(i);
+
+    return true;
+}
+
+bool audio_play(const audio_play_request_t *request)
+{
+    audio_queued_request_t *queued;
+    systime_t time = chVTGetSystemTimeX();
+
+    if (reader_thread == NULL || request->note_count > AUDIO_PLAY_MAX_NOTES ||
+        audio_synth_instrument_builtin(request->instrument) == NULL) {
+        return false;
+    }
+
+    if (audio_play_from_ram(request, time)) {
+        return true;
+    }
+
+    queued = chPoolAlloc(&request_pool);
+    if (queued == NULL) {
+        return false;
+    }
+
+    /* The mailbox has room for every request of the pool. */
+    queued->request = *request;
+    queued->time = time;
+    chMBPost(&request_mailbox, (msg_t)queued, TIME_IMMEDIATE);
+    chEvtSignal(reader_thread, READER_EVENT_REQUEST);
+
+    return true;
+}
+
+uint32_t audio_underrun_count(void)
+{
+    return underruns;
+}
+
+void audio_latency_get(audio_latency_t *ram, audio_latency_t *card)
+{
+    *ram = ram_latency;
+    *card = card_latency;
+}
+
+void audio_latency_reset(void)
+{
+    memset(&ram_latency, 0, sizeof(ram_latency));
+    memset(&card_latency, 0, sizeof(card_latency));
 }
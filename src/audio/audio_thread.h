@@ -5,6 +5,17 @@
 extern "C" {
 #endif
 
+#include <ch.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/** Longest sequence of notes which can be requested. */
+#define AUDIO_PLAY_MAX_NOTES 32
+
+/** Flags broadcast on audio_events when a sound ends. */
+#define AUDIO_EVENT_FINISHED 1
+#define AUDIO_EVENT_ERROR 2
+
 typedef enum {
     AUDIO_OK = 0,
     AUDIO_FILE_NOT_FOUND,
@@ -12,16 +23,55 @@ typedef enum {
 } audio_play_status_t;
 
 typedef struct {
-    char path[64];
+    char path[64]; /**< WAV file to play, or empty for a tone or notes. */
+    uint16_t frequency; /**< Tone frequency [Hz]. */
+    uint16_t duration; /**< Tone duration [ms]. */
+    uint16_t notes[AUDIO_PLAY_MAX_NOTES]; /**< Played instead of the tone, see audio_synth.h. */
+    uint8_t note_count;
+    uint8_t instrument; /**< Builtin instrument playing the notes. */
+    uint32_t id; /**< Passed back in the result. */
 } audio_play_request_t;
 
+/** Published on /audio/play/result for each request. */
 typedef struct {
     audio_play_status_t status;
+    uint32_t id;
 } audio_play_result_t;
 
+extern event_source_t audio_events;
+
+/** Time from audio_play() until the first samples of a sound are written to
+ * the DAC buffer. */
+typedef struct {
+    uint32_t last_us;
+    uint32_t max_us;
+    uint32_t count; /**< Number of sounds measured. */
+} audio_latency_t;
+
 /** Starts the audio services thread. */
 void audio_start(void);
 
+/** Queues a sound, which is mixed with the ones already playing.
+ *
+ * Does not block. Tones, notes and short sounds which were loaded in RAM when
+ * the card was mounted start right away if a voice is free, others are
+ * queued. The end of the sound is signaled on audio_events and its result
+ * published on /audio/play/result.
+ *
+ * @returns false if the queue is full or the request is invalid.
+ */
+bool audio_play(const audio_play_request_t *request);
+
+/** Returns the latencies of sounds played from RAM, clips of the bank, tones
+ * and notes, and of files streamed from the card. */
+void audio_latency_get(audio_latency_t *ram, audio_latency_t *card);
+
+void audio_latency_reset(void);
+
+/** Returns the number of DAC buffers in which a file was not played on time,
+ * because the card was too slow. */
+uint32_t audio_underrun_count(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,29 @@
+#include "audio_tone.h"
+
+void audio_tone_init(audio_tone_t *tone, uint32_t frequency, uint32_t duration,
+                     uint32_t sample_rate, int16_t amplitude)
+{
+    tone->phase = 0;
+    tone->increment = ((uint64_t)frequency << 32) / sample_rate;
+    tone->left = (uint64_t)duration * sample_rate / 1000;
+    tone->amplitude = amplitude;
+}
+
+bool audio_tone_read(void *arg, int16_t *buffer, size_t len, size_t *samples_read)
+{
+    audio_tone_t *tone = (audio_tone_t *)arg;
+    size_t i;
+
+    if (len > tone->left) {
+        len = tone->left;
+    }
+
+    for (i = 0; i < len; i++) {
+        buffer[i] = (tone->phase & 0x80000000) ? -tone->amplitude : tone->amplitude;
+        tone->phase += tone->increment;
+    }
+
+    tone->left -= len;
+    *samples_read = len;
+    return tone->left == 0;
+}
@@ -0,0 +1,32 @@
+#ifndef AUDIO_TONE_H
+#define AUDIO_TONE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+/** Square wave of a given frequency and duration. */
+typedef struct {
+    uint32_t phase; /**< Fraction of a period, over 2^32. */
+    uint32_t increment; /**< Phase increment per sample. */
+    uint32_t left; /**< Samples left to play. */
+    int16_t amplitude;
+} audio_tone_t;
+
+/** Initializes a tone of frequency [Hz] lasting duration [ms] at the given
+ * sample rate [Hz]. */
+void audio_tone_init(audio_tone_t *tone, uint32_t frequency, uint32_t duration,
+                     uint32_t sample_rate, int16_t amplitude);
+
+/** Audio source rendering the tone, see audio_source_t. */
+bool audio_tone_read(void *arg, int16_t *buffer, size_t len, size_t *samples_read);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AUDIO_TONE_H */
@@ -1,7 +1,8 @@
 #include <string.h>
 #include "audio_wav.h"
 
-#define WAV_HEADER_LEN 44
+/* Longest format chunk which is supported. */
+#define WAV_FORMAT_MAX_LEN 20
 
 static uint32_t u32_little_endian(uint8_t *buf)
 {
@@ -13,68 +14,154 @@ static uint16_t u16_little_endian(uint8_t *buf)
     return (uint16_t) buf[0] | buf[1] << 8;
 }
 
-int wav_read_header(struct wav_data *d, FIL *file)
+/* Reads exactly len bytes. */
+static int wav_read(FIL *file, uint8_t *buf, size_t len)
 {
-    static uint8_t buf[WAV_HEADER_LEN];
-
-    d->file = file;
-
     UINT n;
-    FRESULT res = f_read(file, buf, WAV_HEADER_LEN, &n);
-    if (res != FR_OK || n != WAV_HEADER_LEN) {
-        return -1;
-    }
+    FRESULT res = f_read(file, buf, len, &n);
 
-    /* file type */
-    if (memcmp(&buf[0], "RIFF", 4) ||
-        memcmp(&buf[8], "WAVE", 4)) {
+    if (res != FR_OK || n != len) {
         return -1;
     }
 
-    /* subchunk ID */
-    if (memcmp(&buf[12], "fmt ", 4)) {
+    return 0;
+}
+
+/* Checks the format chunk, which was read into buf. */
+static int wav_read_format(struct wav_data *d, uint8_t *buf, uint32_t size)
+{
+    if (size < 16) {
         return -1;
     }
 
-    /* subchunk size */
-    if (u32_little_endian(&buf[16]) != 16) {
+    d->format = u16_little_endian(&buf[0]);
+
+    /* number of channels, only support mono */
+    if (u16_little_endian(&buf[2]) != 1) {
         return -1;
     }
 
-    /* audio format, 1 = PCM */
-    if (u16_little_endian(&buf[20]) != 1) {
+    d->sample_rate = u32_little_endian(&buf[4]);
+    d->block_align = u16_little_endian(&buf[12]);
+    d->sample_size = u16_little_endian(&buf[14]);
+
+    /* It could not be resampled. */
+    if (d->sample_rate == 0) {
         return -1;
     }
 
-    /* number of channels, only support mono */
-    if (u16_little_endian(&buf[22]) != 1) {
-        return -1;
+    switch (d->format) {
+        case WAV_FORMAT_PCM:
+            if (d->sample_size != 16) {
+                return -1;
+            }
+            break;
+
+        case WAV_FORMAT_IMA_ADPCM:
+            if (d->sample_size != 4 || d->block_align <= AUDIO_ADPCM_BLOCK_HEADER) {
+                return -1;
+            }
+            break;
+
+        default:
+            return -1;
     }
 
-    d->sample_rate = u32_little_endian(&buf[24]);
+    return 0;
+}
 
-    d->sample_size = u16_little_endian(&buf[34]) / 8;
-    if (d->sample_size != 2) {
+int wav_read_header(struct wav_data *d, FIL *file)
+{
+    static uint8_t buf[WAV_FORMAT_MAX_LEN];
+    uint32_t size;
+    bool format_found = false;
+
+    d->file = file;
+
+    /* file type */
+    if (wav_read(file, buf, 12) != 0 ||
+        memcmp(&buf[0], "RIFF", 4) ||
+        memcmp(&buf[8], "WAVE", 4)) {
         return -1;
     }
 
-    /* check for data chunk */
-    if (memcmp(&buf[36], "data", 4)) {
+    /* Chunks up to the data, compressed formats have a longer format chunk
+     * and a fact chunk before the data. */
+    while (true) {
+        if (wav_read(file, buf, 8) != 0) {
+            return -1;
+        }
+        size = u32_little_endian(&buf[4]);
+
+        if (!memcmp(&buf[0], "data", 4)) {
+            break;
+        }
+
+        if (!memcmp(&buf[0], "fmt ", 4) && size <= WAV_FORMAT_MAX_LEN) {
+            if (wav_read(file, buf, size) != 0 || wav_read_format(d, buf, size) != 0) {
+                return -1;
+            }
+            format_found = true;
+        } else if (f_lseek(file, f_tell(file) + size) != FR_OK) {
+            return -1;
+        }
+
+        /* Chunks are word aligned. */
+        if (size & 1) {
+            f_lseek(file, f_tell(file) + 1);
+        }
+    }
+
+    if (!format_found) {
         return -1;
     }
 
-    d->data_len = u32_little_endian(&buf[40]);
+    d->data_len = size;
     d->data_pos = 0;
 
+    if (d->format == WAV_FORMAT_IMA_ADPCM) {
+        audio_adpcm_decoder_init(&d->adpcm, d->block_align, d->data_len, wav_read_data, d);
+    }
+
     return 0;
 }
 
-bool wav_read_cb(void *arg, audio_sample_t *buffer, size_t buf_len, size_t *samples_written)
+uint32_t wav_sample_count(struct wav_data *d)
+{
+    if (d->format == WAV_FORMAT_IMA_ADPCM) {
+        return audio_adpcm_sample_count(d->block_align, d->data_len);
+    }
+
+    return d->data_len / sizeof(int16_t);
+}
+
+size_t wav_read_data(void *arg, uint8_t *buffer, size_t len)
+{
+    struct wav_data *wav = (struct wav_data *)arg;
+    UINT n;
+
+    if (len > wav->data_len - wav->data_pos) {
+        len = wav->data_len - wav->data_pos;
+    }
+
+    if (f_read(wav->file, buffer, len, &n) != FR_OK) {
+        return 0;
+    }
+
+    wav->data_pos += n;
+    return n;
+}
+
+bool wav_read_cb(void *arg, int16_t *buffer, size_t buf_len, size_t *samples_read)
 {
     struct wav_data *wav = (struct wav_data *)arg;
 
+    if (wav->format == WAV_FORMAT_IMA_ADPCM) {
+        return audio_adpcm_decoder_read(&wav->adpcm, buffer, buf_len, samples_read);
+    }
+
     /* Determine bytes to be read */
-    size_t len = buf_len * sizeof(audio_sample_t);
+    size_t len = buf_len * sizeof(int16_t);
     if (len > wav->data_len - wav->data_pos) {
         len = wav->data_len - wav->data_pos;
     }
@@ -83,18 +170,12 @@ bool wav_read_cb(void *arg, audio_sample_t *buffer, size_t buf_len, size_t *samp
     FRESULT res = f_read(wav->file, buffer, len, &n);
     /* If read error then stop the conversion. */
     if (res != FR_OK) {
-        *samples_written = 0;
+        *samples_read = 0;
         return true;
     }
 
-    /* Add offset to obtain positive integer for DAC.  */
-    size_t i;
-    for (i = 0; i < n / sizeof(audio_sample_t); i++) {
-        buffer[i] += -INT16_MIN;
-    }
-
     wav->data_pos += n;
-    *samples_written = n / sizeof(audio_sample_t);
+    *samples_read = n / sizeof(int16_t);
     if (n != len || wav->data_pos == wav->data_len) {
         /* end of file */
         return true;
@@ -8,19 +8,39 @@ extern "C" {
 #include <ff.h>
 #include <stdint.h>
 #include <stddef.h>
-#include "audio_dac.h"
+#include "audio_adpcm.h"
+#include "audio_stream.h"
+
+#define WAV_FORMAT_PCM 1
+#define WAV_FORMAT_IMA_ADPCM 0x11
 
 struct wav_data {
     FIL *file;
+    uint16_t format;
     uint32_t sample_rate;
-    uint8_t sample_size;
+    uint8_t sample_size; /**< In bits. */
+    uint16_t block_align; /**< Size of a compressed block in bytes. */
     uint32_t data_len;
     uint32_t data_pos;
+    audio_adpcm_decoder_t adpcm;
 };
 
+/** Reads the header of a mono file, either 16 bit PCM or 4 bit IMA ADPCM,
+ * and leaves the file at the start of the samples.
+ *
+ * @returns 0 if successful, -1 if the format is not supported.
+ */
 int wav_read_header(struct wav_data *d, FIL *f);
 
-bool wav_read_cb(void *arg, audio_sample_t *buffer, size_t buf_len, size_t *samples_written);
+/** Returns the number of samples in the file. */
+uint32_t wav_sample_count(struct wav_data *d);
+
+/** Reads the raw bytes of the data, see audio_adpcm_read_fn_t. */
+size_t wav_read_data(void *arg, uint8_t *buffer, size_t len);
+
+/** Audio source reading the samples of the file, decoding them if they are
+ * compressed, see audio_source_t. */
+bool wav_read_cb(void *arg, int16_t *buffer, size_t buf_len, size_t *samples_read);
 
 #ifdef __cplusplus
 }
@@ -1,6 +1,9 @@
 #include <ch.h>
 #include <hal.h>
+#include <string.h>
 #include "sensors/battery_level.h"
+#include "audio/audio_synth.h"
+#include "audio/audio_thread.h"
 #include "main.h"
 
 /** Level at which the warning led will start blinking. */
@@ -11,6 +14,29 @@
 
 #define WARNING_BLINK_FREQUENCY 2
 
+/** Seconds between two low battery alarms. */
+#define WARNING_SOUND_PERIOD_S 30
+
+/* Two falling beeps, generated on the robot so that no SD card is needed. */
+static const uint16_t warning_notes[] = {
+    AUDIO_SYNTH_NOTE(81, 150),
+    AUDIO_SYNTH_NOTE(AUDIO_SYNTH_REST, 50),
+    AUDIO_SYNTH_NOTE(76, 300),
+};
+
+static void battery_warning_sound(void)
+{
+    audio_play_request_t request;
+
+    memset(&request, 0, sizeof(request));
+    memcpy(request.notes, warning_notes, sizeof(warning_notes));
+    request.note_count = sizeof(warning_notes) / sizeof(warning_notes[0]);
+    request.instrument = AUDIO_SYNTH_BEEP;
+
+    /* If the queue is full the alarm is simply heard next time. */
+    audio_play(&request);
+}
+
 static THD_FUNCTION(battery_protection_thd, arg)
 {
     (void) arg;
@@ -18,6 +44,7 @@ static THD_FUNCTION(battery_protection_thd, arg)
 
     battery_msg_t msg;
     messagebus_topic_t *topic;
+    unsigned warning_count = 0;
 
     /* Waits for the topic to appear. */
     topic = messagebus_find_topic_blocking(&bus, "/battery_level");
@@ -30,6 +57,14 @@ static THD_FUNCTION(battery_protection_thd, arg)
 
         if (msg.voltage < WARNING_LEVEL_V) {
             palTogglePad(GPIOD, GPIOD_LED_ERROR);
+
+            if (warning_count == 0) {
+                battery_warning_sound();
+            }
+            warning_count = (warning_count + 1) % (WARNING_SOUND_PERIOD_S * 2 *
+                                                   WARNING_BLINK_FREQUENCY);
+        } else {
+            warning_count = 0;
         }
 
         if (msg.voltage < SHUTDOWN_LEVEL_V) {
@@ -0,0 +1,203 @@
+#include <string.h>
+#include "cmp_mem_access/cmp_mem_access.h"
+#include "blackbox.h"
+
+/* Bytes preallocated per seek. Each seek takes the FatFs volume lock once, so
+ * the audio reader gets the card between them instead of waiting for the
+ * whole file and timing out (_FS_TIMEOUT). */
+#define BLACKBOX_PREALLOCATION_STEP (1024 * 1024)
+
+void blackbox_ring_init(blackbox_ring_t *ring, void *buffer, size_t size)
+{
+    ring->buffer = (uint8_t *)buffer;
+    ring->size = size;
+    ring->head = 0;
+    ring->tail = 0;
+    ring->dropped = 0;
+}
+
+size_t blackbox_ring_used(blackbox_ring_t *ring)
+{
+    return ring->head - ring->tail;
+}
+
+bool blackbox_ring_push(blackbox_ring_t *ring, const void *data, size_t len)
+{
+    uint32_t head = ring->head;
+    uint32_t offset = head & (ring->size - 1);
+    size_t first;
+
+    if (len > ring->size - (head - ring->tail)) {
+        ring->dropped++;
+        return false;
+    }
+
+    first = ring->size - offset;
+    if (first > len) {
+        first = len;
+    }
+    memcpy(&ring->buffer[offset], data, first);
+    memcpy(ring->buffer, (const uint8_t *)data + first, len - first);
+
+    /* The record must be complete before the consumer can see it. */
+    __sync_synchronize();
+    ring->head = head + len;
+
+    return true;
+}
+
+bool blackbox_record(blackbox_ring_t *ring, uint32_t timestamp, uint8_t id,
+                     blackbox_serializer_t serialize, const void *msg)
+{
+    uint8_t buf[BLACKBOX_RECORD_MAX];
+    cmp_ctx_t cmp;
+    cmp_mem_access_t mem;
+
+    cmp_mem_access_init(&cmp, &mem, buf, sizeof(buf));
+
+    if (!cmp_write_array(&cmp, 3) || !cmp_write_uint(&cmp, timestamp)
+        || !cmp_write_uint(&cmp, id) || !serialize(&cmp, msg)) {
+        ring->dropped++;
+        return false;
+    }
+
+    return blackbox_ring_push(ring, buf, cmp_mem_access_get_pos(&mem));
+}
+
+FRESULT blackbox_file_open(blackbox_file_t *log, const char *path, void *chunk, uint32_t size)
+{
+    FRESULT res;
+    uint32_t pos, step;
+
+    log->chunk = (uint8_t *)chunk;
+    log->chunk_len = 0;
+    log->bytes_written = 0;
+    log->full = false;
+
+    res = f_open(&log->file, path, FA_WRITE | FA_CREATE_ALWAYS);
+    if (res != FR_OK) {
+        return res;
+    }
+
+    /* Seeking past the end in write mode allocates the clusters. It stops
+     * early if the card is full. */
+    size -= size % BLACKBOX_CHUNK_SIZE;
+    for (pos = 0; pos < size; pos += step) {
+        step = size - pos;
+        if (step > BLACKBOX_PREALLOCATION_STEP) {
+            step = BLACKBOX_PREALLOCATION_STEP;
+        }
+
+        res = f_lseek(&log->file, pos + step);
+        if (res != FR_OK) {
+            f_close(&log->file);
+            return res;
+        }
+        if (f_tell(&log->file) != pos + step) {
+            break;
+        }
+    }
+    log->capacity = f_tell(&log->file) - f_tell(&log->file) % BLACKBOX_CHUNK_SIZE;
+
+    res = f_lseek(&log->file, 0);
+    if (res == FR_OK) {
+        /* Writes the cluster chain to the card. */
+        res = f_sync(&log->file);
+    }
+    if (res != FR_OK) {
+        f_close(&log->file);
+        return res;
+    }
+
+    log->full = log->capacity == 0;
+
+    return FR_OK;
+}
+
+static FRESULT blackbox_file_write_chunk(blackbox_file_t *log)
+{
+    FRESULT res;
+    UINT written;
+
+    res = f_write(&log->file, log->chunk, log->chunk_len, &written);
+    log->bytes_written += written;
+
+    if (res == FR_OK && written != log->chunk_len) {
+        res = FR_DENIED;
+    }
+
+    log->chunk_len = 0;
+    if (log->bytes_written + BLACKBOX_CHUNK_SIZE > log->capacity) {
+        log->full = true;
+    }
+
+    return res;
+}
+
+FRESULT blackbox_file_drain(blackbox_file_t *log, blackbox_ring_t *rings, size_t count)
+{
+    blackbox_ring_t *ring;
+    size_t i, used, offset, n;
+    FRESULT res;
+
+    for (i = 0; i < count; i++) {
+        ring = &rings[i];
+
+        /* Only whole records are visible, so this ends on a record boundary. */
+        used = blackbox_ring_used(ring);
+
+        while (used > 0) {
+            if (log->full) {
+                return FR_OK;
+            }
+
+            offset = ring->tail & (ring->size - 1);
+            n = used;
+            if (n > ring->size - offset) {
+                n = ring->size - offset;
+            }
+            if (n > BLACKBOX_CHUNK_SIZE - log->chunk_len) {
+                n = BLACKBOX_CHUNK_SIZE - log->chunk_len;
+            }
+
+            memcpy(&log->chunk[log->chunk_len], &ring->buffer[offset], n);
+            log->chunk_len += n;
+            used -= n;
+
+            /* The copy must be done before the producer reuses the space. */
+            __sync_synchronize();
+            ring->tail += n;
+
+            if (log->chunk_len == BLACKBOX_CHUNK_SIZE) {
+                res = blackbox_file_write_chunk(log);
+                if (res != FR_OK) {
+                    return res;
+                }
+            }
+        }
+    }
+
+    return FR_OK;
+}
+
+FRESULT blackbox_file_close(blackbox_file_t *log)
+{
+    FRESULT res = FR_OK;
+
+    if (log->chunk_len > 0) {
+        res = blackbox_file_write_chunk(log);
+    }
+
+    /* Drops the preallocated space which was not used. */
+    if (res == FR_OK) {
+        res = f_truncate(&log->file);
+    }
+
+    if (res == FR_OK) {
+        res = f_close(&log->file);
+    } else {
+        f_close(&log->file);
+    }
+
+    return res;
+}
@@ -0,0 +1,94 @@
+#ifndef BLACKBOX_H
+#define BLACKBOX_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <ff.h>
+#include "cmp/cmp.h"
+
+/** Size of the writes to the log file, a multiple of the sector size. */
+#define BLACKBOX_CHUNK_SIZE 4096
+
+/** Largest encoded record. */
+#define BLACKBOX_RECORD_MAX 256
+
+/** Lock free queue of encoded records, with a single producer and a single
+ * consumer.
+ *
+ * head is only written by the producer and tail by the consumer. Both are
+ * free running, so head - tail is the number of bytes queued.
+ */
+typedef struct {
+    uint8_t *buffer;
+    uint32_t size; /**< Power of two. */
+    volatile uint32_t head;
+    volatile uint32_t tail;
+    volatile uint32_t dropped; /**< Records which did not fit. */
+} blackbox_ring_t;
+
+/** Writes the fields of a message, see blackbox_record(). */
+typedef bool (*blackbox_serializer_t)(cmp_ctx_t *cmp, const void *msg);
+
+/** Log file being filled from rings. */
+typedef struct {
+    FIL file;
+    uint8_t *chunk; /**< BLACKBOX_CHUNK_SIZE bytes. */
+    size_t chunk_len;
+    uint32_t capacity; /**< Preallocated size of the file. */
+    uint32_t bytes_written;
+    bool full;
+} blackbox_file_t;
+
+/** Initializes an empty ring using the given buffer, whose size must be a
+ * power of two.
+ */
+void blackbox_ring_init(blackbox_ring_t *ring, void *buffer, size_t size);
+
+/** Queues len bytes, atomically for the consumer.
+ *
+ * @returns false and counts a dropped record if there is not enough room.
+ */
+bool blackbox_ring_push(blackbox_ring_t *ring, const void *data, size_t len);
+
+/** Returns the number of bytes queued. */
+size_t blackbox_ring_used(blackbox_ring_t *ring);
+
+/** Queues a record holding a timestamp in microseconds, the id of the topic
+ * and the fields written by serialize, as a MessagePack array.
+ */
+bool blackbox_record(blackbox_ring_t *ring, uint32_t timestamp, uint8_t id,
+                     blackbox_serializer_t serialize, const void *msg);
+
+/** Creates the log file and preallocates size bytes, so that the clusters are
+ * allocated once and consecutive on an unfragmented card. The file is
+ * extended one megabyte at a time, releasing the volume lock in between, so
+ * that other threads can keep using the card meanwhile.
+ *
+ * chunk must be BLACKBOX_CHUNK_SIZE bytes, aligned for the card's DMA.
+ */
+FRESULT blackbox_file_open(blackbox_file_t *log, const char *path, void *chunk, uint32_t size);
+
+/** Moves the queued records of every ring to the file.
+ *
+ * The records of a ring are copied up to the last complete one, so that
+ * records of different rings are never interleaved. Data only reaches the
+ * card in writes of BLACKBOX_CHUNK_SIZE at chunk aligned offsets, which FatFs
+ * passes to the card as multiple block writes.
+ *
+ * Once the file is full, records are left in the rings.
+ */
+FRESULT blackbox_file_drain(blackbox_file_t *log, blackbox_ring_t *rings, size_t count);
+
+/** Writes what is left, truncates the file to the data written and closes it. */
+FRESULT blackbox_file_close(blackbox_file_t *log);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BLACKBOX_H */
@@ -0,0 +1,314 @@
+#include <ch.h>
+#include <hal.h>
+#include <stdio.h>
+#include <chprintf.h>
+#include <ff.h>
+#include "main.h"
+#include "sdcard.h"
+#include "motor_controller.h"
+#include "sensors/imu.h"
+#include "sensors/encoder.h"
+#include "sensors/motor_current.h"
+#include "sensors/proximity.h"
+#include "blackbox.h"
+#include "blackbox_thread.h"
+
+/* Size of the queue of each topic, enough for a few drain periods. */
+#define BLACKBOX_RING_SIZE 4096
+
+/* Space reserved on the card when a file is created. */
+#define BLACKBOX_FILE_SIZE (32 * 1024 * 1024)
+
+#define BLACKBOX_DRAIN_PERIOD_MS 50
+
+#define BLACKBOX_MAX_FILES 100000
+
+/* Topic ids, as written in the records. */
+enum {
+    BLACKBOX_IMU = 0,
+    BLACKBOX_MOTOR_CURRENT,
+    BLACKBOX_WHEEL_VELOCITIES,
+    BLACKBOX_MOTOR_VOLTAGE,
+    BLACKBOX_PROXIMITY,
+    BLACKBOX_TOPIC_COUNT
+};
+
+typedef union {
+    imu_msg_t imu;
+    motor_current_msg_t current;
+    wheel_velocities_msg_t velocities;
+    motor_voltage_msg_t voltage;
+    proximity_msg_t proximity;
+} blackbox_msg_t;
+
+typedef struct {
+    const char *topic;
+    size_t msg_size;
+    blackbox_serializer_t serialize;
+} blackbox_source_t;
+
+static parameter_namespace_t blackbox_ns;
+static parameter_t blackbox_enabled;
+
+static blackbox_ring_t blackbox_rings[BLACKBOX_TOPIC_COUNT];
+static uint8_t blackbox_ring_buffers[BLACKBOX_TOPIC_COUNT][BLACKBOX_RING_SIZE];
+
+static struct {
+    char name[13];
+    bool open;
+    FRESULT error;
+    uint32_t bytes_written;
+    systime_t write_time; /**< Time spent draining to the file. */
+} blackbox_stats;
+
+static bool blackbox_write_floats(cmp_ctx_t *cmp, const float *values, uint32_t count)
+{
+    uint32_t i;
+
+    if (!cmp_write_array(cmp, count)) {
+        return false;
+    }
+
+    for (i = 0; i < count; i++) {
+        if (!cmp_write_float(cmp, values[i])) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool blackbox_write_uints(cmp_ctx_t *cmp, const unsigned int *values, uint32_t count)
+{
+    uint32_t i;
+
+    if (!cmp_write_array(cmp, count)) {
+        return false;
+    }
+
+    for (i = 0; i < count; i++) {
+        if (!cmp_write_uint(cmp, values[i])) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/* [[acceleration], [roll rate], theta] */
+static bool blackbox_write_imu(cmp_ctx_t *cmp, const void *p)
+{
+    const imu_msg_t *msg = p;
+
+    return cmp_write_array(cmp, 3)
+           && blackbox_write_floats(cmp, msg->acceleration, 3)
+           && blackbox_write_floats(cmp, msg->roll_rate, 3)
+           && cmp_write_float(cmp, msg->theta);
+}
+
+/* [left, right] */
+static bool blackbox_write_motor_current(cmp_ctx_t *cmp, const void *p)
+{
+    const motor_current_msg_t *msg = p;
+    const float values[] = {msg->left, msg->right};
+
+    return blackbox_write_floats(cmp, values, 2);
+}
+
+/* [left, right] */
+static bool blackbox_write_wheel_velocities(cmp_ctx_t *cmp, const void *p)
+{
+    const wheel_velocities_msg_t *msg = p;
+    const float values[] = {msg->left, msg->right};
+
+    return blackbox_write_floats(cmp, values, 2);
+}
+
+/* [left, right] */
+static bool blackbox_write_motor_voltage(cmp_ctx_t *cmp, const void *p)
+{
+    const motor_voltage_msg_t *msg = p;
+    const float values[] = {msg->left, msg->right};
+
+    return blackbox_write_floats(cmp, values, 2);
+}
+
+/* [[ambient], [reflected], [delta]] */
+static bool blackbox_write_proximity(cmp_ctx_t *cmp, const void *p)
+{
+    const proximity_msg_t *msg = p;
+
+    return cmp_write_array(cmp, 3)
+           && blackbox_write_uints(cmp, msg->ambient, PROXIMITY_NB_CHANNELS)
+           && blackbox_write_uints(cmp, msg->reflected, PROXIMITY_NB_CHANNELS)
+           && blackbox_write_uints(cmp, msg->delta, PROXIMITY_NB_CHANNELS);
+}
+
+/* Indexed by topic id. */
+static const blackbox_source_t blackbox_sources[BLACKBOX_TOPIC_COUNT] = {
+    {"/imu", sizeof(imu_msg_t), blackbox_write_imu},
+    {"/motors/current", sizeof(motor_current_msg_t), blackbox_write_motor_current},
+    {"/wheel_velocities", sizeof(wheel_velocities_msg_t), blackbox_write_wheel_velocities},
+    {"/motors/voltage", sizeof(motor_voltage_msg_t), blackbox_write_motor_voltage},
+    {"/proximity", sizeof(proximity_msg_t), blackbox_write_proximity},
+};
+
+static THD_FUNCTION(blackbox_topic_thd, arg)
+{
+    const uint8_t id = (uintptr_t)arg;
+    const blackbox_source_t *source = &blackbox_sources[id];
+    messagebus_topic_t *topic;
+    blackbox_msg_t msg;
+    uint32_t timestamp;
+
+    chRegSetThreadName(source->topic);
+
+    topic = messagebus_find_topic_blocking(&bus, source->topic);
+
+    while (true) {
+        messagebus_topic_wait(topic, &msg, source->msg_size);
+
+        if (!parameter_boolean_get(&blackbox_enabled)) {
+            continue;
+        }
+
+        /* In microseconds, wraps around like the IMU timestamps. */
+        timestamp = (uint64_t)chVTGetSystemTimeX() * 1000000 / CH_CFG_ST_FREQUENCY;
+
+        blackbox_record(&blackbox_rings[id], timestamp, id, source->serialize, &msg);
+    }
+}
+
+/* Picks the first unused LOGnnnnn.BIN name after the previous one. */
+static FRESULT blackbox_next_file_name(char *name, size_t size)
+{
+    static unsigned int next = 0;
+    FILINFO info;
+    FRESULT res;
+
+    for (; next < BLACKBOX_MAX_FILES; next++) {
+        snprintf(name, size, "LOG%05u.BIN", next);
+
+        res = f_stat(name, &info);
+        if (res == FR_NO_FILE) {
+            next++;
+            return FR_OK;
+        }
+        if (res != FR_OK) {
+            return res;
+        }
+    }
+
+    return FR_DENIED;
+}
+
+/* Fills a file until recording is disabled, the card is removed or the file is
+ * full. */
+static FRESULT blackbox_record_file(void)
+{
+    static blackbox_file_t log;
+    static uint8_t chunk[BLACKBOX_CHUNK_SIZE] __attribute__((aligned(4)));
+    systime_t start;
+    FRESULT res, close_res;
+
+    res = blackbox_next_file_name(blackbox_stats.name, sizeof(blackbox_stats.name));
+    if (res != FR_OK) {
+        return res;
+    }
+
+    res = blackbox_file_open(&log, blackbox_stats.name, chunk, BLACKBOX_FILE_SIZE);
+    if (res != FR_OK) {
+        return res;
+    }
+
+    blackbox_stats.bytes_written = 0;
+    blackbox_stats.write_time = 0;
+    blackbox_stats.open = true;
+
+    /* Drains once more after recording is disabled. */
+    do {
+        chThdSleepMilliseconds(BLACKBOX_DRAIN_PERIOD_MS);
+
+        start = chVTGetSystemTime();
+        res = blackbox_file_drain(&log, blackbox_rings, BLACKBOX_TOPIC_COUNT);
+        blackbox_stats.write_time += chVTTimeElapsedSinceX(start);
+        blackbox_stats.bytes_written = log.bytes_written;
+    } while (res == FR_OK && !log.full && parameter_boolean_get(&blackbox_enabled));
+
+    start = chVTGetSystemTime();
+    close_res = blackbox_file_close(&log);
+    blackbox_stats.write_time += chVTTimeElapsedSinceX(start);
+    blackbox_stats.bytes_written = log.bytes_written;
+    blackbox_stats.open = false;
+
+    return res != FR_OK ? res : close_res;
+}
+
+static THD_FUNCTION(blackbox_drain_thd, arg)
+{
+    (void)arg;
+    chRegSetThreadName(__FUNCTION__);
+
+    while (true) {
+        if (!parameter_boolean_get(&blackbox_enabled) || !sdcard_wait_for_mount()) {
+            chThdSleepMilliseconds(BLACKBOX_DRAIN_PERIOD_MS);
+            continue;
+        }
+
+        blackbox_stats.error = blackbox_record_file();
+
+        /* Do not retry right away, for example if the card is full. */
+        if (blackbox_stats.error != FR_OK) {
+            chThdSleepMilliseconds(1000);
+        }
+    }
+}
+
+void blackbox_start(void)
+{
+    static THD_WORKING_AREA(blackbox_topic_thd_wa[BLACKBOX_TOPIC_COUNT], 768);
+    static THD_WORKING_AREA(blackbox_drain_thd_wa, 1024);
+    uintptr_t i;
+
+    parameter_namespace_declare(&blackbox_ns, &parameter_root, "blackbox");
+    parameter_boolean_declare_with_default(&blackbox_enabled, &blackbox_ns, "enabled", false);
+
+    for (i = 0; i < BLACKBOX_TOPIC_COUNT; i++) {
+        blackbox_ring_init(&blackbox_rings[i], blackbox_ring_buffers[i], BLACKBOX_RING_SIZE);
+        chThdCreateStatic(blackbox_topic_thd_wa[i], sizeof(blackbox_topic_thd_wa[i]),
+                          NORMALPRIO, blackbox_topic_thd, (void *)i);
+    }
+
+    /* Writing to the card can take long, so it must not delay the recording. */
+    chThdCreateStatic(blackbox_drain_thd_wa, sizeof(blackbox_drain_thd_wa), LOWPRIO,
+                      blackbox_drain_thd, NULL);
+}
+
+void blackbox_print_stats(BaseSequentialStream *chp)
+{
+    uint32_t time_ms = ST2MS(blackbox_stats.write_time);
+    int i;
+
+    if (blackbox_stats.name[0] == '\0') {
+        chprintf(chp, "no file written\r\n");
+    } else {
+        chprintf(chp, "%s%s: %lu bytes", blackbox_stats.name,
+                 blackbox_stats.open ? " (open)" : "",
+                 (unsigned long)blackbox_stats.bytes_written);
+        if (time_ms > 0) {
+            chprintf(chp, ", %lu kB/s",
+                     (unsigned long)(blackbox_stats.bytes_written / time_ms));
+        }
+        chprintf(chp, "\r\n");
+    }
+
+    if (blackbox_stats.error != FR_OK) {
+        chprintf(chp, "last error: %d\r\n", blackbox_stats.error);
+    }
+
+    for (i = 0; i < BLACKBOX_TOPIC_COUNT; i++) {
+        chprintf(chp, "%-20s %6u bytes queued, %lu dropped\r\n", blackbox_sources[i].topic,
+                 (unsigned int)blackbox_ring_used(&blackbox_rings[i]),
+                 (unsigned long)blackbox_rings[i].dropped);
+    }
+}
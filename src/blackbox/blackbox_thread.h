@@ -0,0 +1,27 @@
+#ifndef BLACKBOX_THREAD_H
+#define BLACKBOX_THREAD_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <hal.h>
+
+/** Starts the threads recording the main topics to a file on the SD card.
+ *
+ * Recording is controlled by the blackbox/enabled parameter, so this must run
+ * before the config is loaded. Each time it is enabled, a new LOGnnnnn.BIN
+ * file is created. It holds a sequence of MessagePack arrays of the form
+ * [timestamp in us, topic id, [fields...]], see blackbox_thread.c for the ids.
+ */
+void blackbox_start(void);
+
+/** Prints the current file, its throughput and the dropped records. */
+void blackbox_print_stats(BaseSequentialStream *chp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BLACKBOX_THREAD_H */
@@ -3,6 +3,7 @@
 #include <ch.h>
 #include <hal.h>
 #include "body_leds.h"
+#include "led_animation.h"
 #include "main.h"
 
 /** Address of the LTC3220 LED driver. */
@@ -10,6 +11,12 @@
 
 #define LED_BRIGHNESS_MAX_VALUE 31
 
+/** Number of outputs of the LED driver. */
+#define LED_DRIVER_OUTPUT_COUNT 18
+
+/** Period at which LED values are refreshed and animation frames computed. */
+#define LED_FRAME_PERIOD_MS 10
+
 /** Mapping from LED number to driver outputs. */
 static int led_output_mapping[] = {
     16,
@@ -33,6 +40,16 @@ static struct {
     body_led_msg_t value;
 } led_topics[BODY_LED_COUNT];
 
+/** Last value written to each driver output, used to skip redundant writes. */
+static int led_output_value[LED_DRIVER_OUTPUT_COUNT];
+
+static MUTEX_DECL(animation_lock);
+static led_animation_t animation;
+static bool animation_running = false;
+static systime_t animation_start;
+
+static BSEMAPHORE_DECL(frame_sem, true);
+
 /** Sets a body LED to a given value.
  *
  * @param [in] led Led index, between 0 and 18.
@@ -50,6 +67,43 @@ static void led_set(int led, int value)
     i2cReleaseBus(&I2CD1);
 }
 
+/** Sets a body LED output, only talking to the driver if the value changed. */
+static void led_update(int led, int value)
+{
+    if (led_output_value[led] != value) {
+        led_output_value[led] = value;
+        led_set(led, value);
+    }
+}
+
+static void frame_timer_cb(void *p)
+{
+    virtual_timer_t *vt = (virtual_timer_t *)p;
+
+    chSysLockFromISR();
+    chBSemSignalI(&frame_sem);
+    chVTSetI(vt, MS2ST(LED_FRAME_PERIOD_MS), frame_timer_cb, p);
+    chSysUnlockFromISR();
+}
+
+/** Renders the current animation frame, returns false if none is running. */
+static bool animation_frame(uint8_t *levels)
+{
+    bool running;
+
+    chMtxLock(&animation_lock);
+    running = animation_running;
+    if (running) {
+        /* ST2MS() overflows 32 bits after a few minutes at 10 kHz. */
+        uint32_t time_ms = (uint64_t)chVTTimeElapsedSinceX(animation_start) * 1000
+                           / CH_CFG_ST_FREQUENCY;
+        led_animation_render(&animation, time_ms, levels);
+    }
+    chMtxUnlock(&animation_lock);
+
+    return running;
+}
+
 static THD_FUNCTION(body_led_thd, arg)
 {
     (void) arg;
@@ -59,7 +113,8 @@ static THD_FUNCTION(body_led_thd, arg)
 
     memset(led_topics, 0, sizeof(led_topics));
 
-    for (int i = 0; i < 18; i++) {
+    for (int i = 0; i < LED_DRIVER_OUTPUT_COUNT; i++) {
+        led_output_value[i] = 0;
         led_set(i, 0);
     }
 
@@ -77,19 +132,52 @@ static THD_FUNCTION(body_led_thd, arg)
         messagebus_advertise_topic(&bus, &led_topics[i].topic, name);
     }
 
+    static virtual_timer_t frame_timer;
+    chVTSet(&frame_timer, MS2ST(LED_FRAME_PERIOD_MS), frame_timer_cb, (void *)&frame_timer);
+
     while (true) {
         body_led_msg_t msg;
+        uint8_t levels[BODY_LED_COUNT];
+
+        chBSemWait(&frame_sem);
+
+        /* A running animation owns the LEDs, topic values are applied again
+         * once it is stopped. */
+        if (animation_frame(levels)) {
+            for (int i = 0; i < BODY_LED_COUNT; i++) {
+                int value = (levels[i] * LED_BRIGHNESS_MAX_VALUE + LED_ANIMATION_LEVEL_MAX / 2)
+                            / LED_ANIMATION_LEVEL_MAX;
+                led_update(led_output_mapping[i], value);
+            }
+            continue;
+        }
+
         for (int i = 0; i < BODY_LED_COUNT; i++) {
+            int value = 0;
             if (messagebus_topic_read(&led_topics[i].topic, &msg, sizeof(msg))) {
-                int output = led_output_mapping[i];
-                int value = (int)(msg.value * LED_BRIGHNESS_MAX_VALUE);
-                led_set(output, value);
+                value = (int)(msg.value * LED_BRIGHNESS_MAX_VALUE);
             }
+            led_update(led_output_mapping[i], value);
         }
-        chThdSleepMilliseconds(10);
     }
 }
 
+void body_leds_animation_start(const led_animation_desc_t *desc)
+{
+    chMtxLock(&animation_lock);
+    led_animation_init(&animation, desc);
+    animation_start = chVTGetSystemTime();
+    animation_running = true;
+    chMtxUnlock(&animation_lock);
+}
+
+void body_leds_animation_stop(void)
+{
+    chMtxLock(&animation_lock);
+    animation_running = false;
+    chMtxUnlock(&animation_lock);
+}
+
 void body_leds_start(void)
 {
     static THD_WORKING_AREA(body_led_thd_wa, 1024);
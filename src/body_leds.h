@@ -11,8 +11,21 @@ typedef struct {
     float value; /** Led value, between 0 and 1. */
 } body_led_msg_t;
 
+struct led_animation_desc_s;
+
 void body_leds_start(void);
 
+/** Starts playing the given animation on the body LEDs.
+ *
+ * Frames are computed locally by the LED thread, replacing any running
+ * animation. Values published on the /body_leds/N topics are ignored until
+ * the animation is stopped.
+ */
+void body_leds_animation_start(const struct led_animation_desc_s *desc);
+
+/** Stops the running animation, if any. */
+void body_leds_animation_stop(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,163 @@
+#include <string.h>
+#include <ch.h>
+#include <hal.h>
+#include <chprintf.h>
+#include "main.h"
+#include "boot.h"
+
+/* Period at which the topics steps are waiting for are checked. */
+#define BOOT_POLL_MS 1
+
+static boot_step_t *boot_steps;
+static size_t boot_step_count;
+
+static boot_step_t *boot_find(const char *name)
+{
+    size_t i;
+
+    for (i = 0; i < boot_step_count; i++) {
+        if (!strcmp(boot_steps[i].name, name)) {
+            return &boot_steps[i];
+        }
+    }
+
+    return NULL;
+}
+
+static bool boot_topics_advertised(const char *const *topics)
+{
+    if (topics == NULL) {
+        return true;
+    }
+
+    for (; *topics != NULL; topics++) {
+        if (messagebus_find_topic(&bus, *topics) == NULL) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool boot_steps_done(const char *const *names)
+{
+    boot_step_t *step;
+
+    if (names == NULL) {
+        return true;
+    }
+
+    for (; *names != NULL; names++) {
+        step = boot_find(*names);
+        if (step == NULL) {
+            chSysHalt("Unknown boot step");
+        }
+        if (step->state != BOOT_STEP_DONE) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void boot_step_run(boot_step_t *step)
+{
+    step->state = BOOT_STEP_RUNNING;
+    step->run_time = chVTGetSystemTime();
+
+    if (step->run != NULL) {
+        step->run();
+    }
+}
+
+/* Returns true if the step made progress. */
+static bool boot_step_update(boot_step_t *step)
+{
+    bool progress = false;
+
+    if (step->state == BOOT_STEP_WAITING) {
+        if (!boot_steps_done(step->after) || !boot_topics_advertised(step->topics)) {
+            return false;
+        }
+        boot_step_run(step);
+        progress = true;
+    }
+
+    if (step->state == BOOT_STEP_RUNNING) {
+        if (step->done_topic != NULL && messagebus_find_topic(&bus, step->done_topic) == NULL) {
+            return progress;
+        }
+        step->state = BOOT_STEP_DONE;
+        step->done_time = chVTGetSystemTime();
+        progress = true;
+    }
+
+    return progress;
+}
+
+void boot_run(boot_step_t *steps, size_t count)
+{
+    systime_t start = chVTGetSystemTime();
+    bool done, progress;
+    size_t i;
+
+    boot_steps = steps;
+    boot_step_count = count;
+
+    do {
+        done = true;
+        progress = false;
+
+        /* Steps only depend on earlier ones, so a single pass usually starts
+         * everything that can be started. */
+        for (i = 0; i < count; i++) {
+            progress |= boot_step_update(&steps[i]);
+            done &= steps[i].state == BOOT_STEP_DONE;
+        }
+
+        if (done || progress) {
+            continue;
+        }
+
+        if (chVTTimeElapsedSinceX(start) >= MS2ST(BOOT_TIMEOUT_MS)) {
+            /* Whatever is still starting keeps doing so in its own thread. */
+            for (i = 0; i < count; i++) {
+                if (steps[i].state == BOOT_STEP_WAITING) {
+                    steps[i].late = true;
+                    boot_step_run(&steps[i]);
+                }
+            }
+            return;
+        }
+
+        chThdSleepMilliseconds(BOOT_POLL_MS);
+    } while (!done);
+}
+
+void boot_print(BaseSequentialStream *chp)
+{
+    boot_step_t *step;
+    size_t i;
+
+    chprintf(chp, "%-20s %8s %8s\r\n", "step", "run [ms]", "done [ms]");
+
+    for (i = 0; i < boot_step_count; i++) {
+        step = &boot_steps[i];
+
+        chprintf(chp, "%-20s ", step->name);
+
+        if (step->state == BOOT_STEP_WAITING) {
+            chprintf(chp, "%8s ", "-");
+        } else {
+            chprintf(chp, "%8lu ", (unsigned long)ST2MS(step->run_time));
+        }
+
+        if (step->state == BOOT_STEP_DONE) {
+            chprintf(chp, "%8lu", (unsigned long)ST2MS(step->done_time));
+        } else {
+            chprintf(chp, "%8s", "-");
+        }
+
+        chprintf(chp, "%s\r\n", step->late ? " (late)" : "");
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef BOOT_H
+#define BOOT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <ch.h>
+#include <hal.h>
+
+/** Upper bound on the time spent waiting for a step's requirements.
+ *
+ * Once it expires, the remaining steps are run anyway, so that a missing
+ * sensor does not keep the robot from booting.
+ */
+#define BOOT_TIMEOUT_MS 3000
+
+/** Builds the NULL terminated name lists of boot_step_t. */
+#define BOOT_LIST(...) ((const char *const[]){__VA_ARGS__, NULL})
+
+typedef enum {
+    BOOT_STEP_WAITING = 0,
+    BOOT_STEP_RUNNING,
+    BOOT_STEP_DONE,
+} boot_step_state_t;
+
+/** A subsystem to bring up during boot.
+ *
+ * A step runs as soon as every step it comes after is done and every topic it
+ * needs is advertised. It is done when run returns or, if done_topic is
+ * given, once that topic is advertised by the threads it started.
+ */
+typedef struct {
+    const char *name;
+    void (*run)(void);
+    const char *const *after; /**< Names of steps, NULL terminated, can be NULL. */
+    const char *const *topics; /**< Topics it needs, NULL terminated, can be NULL. */
+    const char *done_topic; /**< Topic showing the step is ready, can be NULL. */
+
+    /* Filled by boot_run(). */
+    boot_step_state_t state;
+    bool late; /**< Run after the timeout, without its requirements. */
+    systime_t run_time;
+    systime_t done_time;
+} boot_step_t;
+
+/** Runs the given steps, starting each one as soon as its requirements are
+ * met, and returns once they are all done.
+ */
+void boot_run(boot_step_t *steps, size_t count);
+
+/** Prints when each step was run and done, in milliseconds since reset. */
+void boot_print(BaseSequentialStream *chp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BOOT_H */
@@ -0,0 +1,249 @@
+#include <string.h>
+#include "bytecode_store.h"
+#include "flash/flash.h"
+#include "crc32_fast.h"
+
+#define BYTECODE_STORE_MAGIC 0x45444f43 /* "CODE" */
+#define BYTECODE_STORE_CRC_SEED 0xdeadbeef
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t size; /**< Of the data following the header, in bytes. */
+    uint32_t sequence; /**< Incremented by each save, the highest is the newest. */
+    uint32_t crc; /**< Of the fields above and of the data. */
+} bytecode_store_header_t;
+
+static uint8_t *bytecode_store_sector(bytecode_store_t *store, unsigned i)
+{
+    return store->start + i * store->sector_size;
+}
+
+/* Images start on a word boundary. */
+static size_t bytecode_store_image_size(size_t size)
+{
+    return BYTECODE_STORE_HEADER_SIZE + ((size + 3) & ~(size_t)3);
+}
+
+static uint32_t bytecode_store_crc(const bytecode_store_header_t *header, const uint8_t *data)
+{
+    uint32_t crc = crc32_fast(BYTECODE_STORE_CRC_SEED, header,
+                              offsetof(bytecode_store_header_t, crc));
+    return crc32_fast(crc, data, header->size);
+}
+
+static bool bytecode_store_is_blank(const uint8_t *p, const uint8_t *end)
+{
+    while (p < end) {
+        if (*p++ != 0xff) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Reads the header of the image at p, returns false if it is not a valid
+ * image ending before end. */
+static bool bytecode_store_image_read(const uint8_t *p, const uint8_t *end,
+                                      bytecode_store_header_t *header)
+{
+    if ((size_t)(end - p) < BYTECODE_STORE_HEADER_SIZE) {
+        return false;
+    }
+
+    memcpy(header, p, sizeof(*header));
+
+    if (header->magic != BYTECODE_STORE_MAGIC || header->version != BYTECODE_STORE_VERSION) {
+        return false;
+    }
+
+    if (bytecode_store_image_size(header->size) > (size_t)(end - p)) {
+        return false;
+    }
+
+    return header->crc == bytecode_store_crc(header, p + BYTECODE_STORE_HEADER_SIZE);
+}
+
+/* Returns the address following the last valid image of the sector, which
+ * is stored in *last, NULL if there is none. */
+static uint8_t *bytecode_store_walk(bytecode_store_t *store, uint8_t *sector, uint8_t **last)
+{
+    uint8_t *end = sector + store->sector_size;
+    uint8_t *image = sector;
+    bytecode_store_header_t header;
+
+    *last = NULL;
+
+    /* An image interrupted by a power loss has an invalid checksum, and
+     * nothing is ever appended after it. */
+    while (bytecode_store_image_read(image, end, &header)) {
+        *last = image;
+        image += bytecode_store_image_size(header.size);
+    }
+
+    return image;
+}
+
+/* Returns the sector of the newest image, stored in *newest, -1 if there is
+ * none. */
+static int bytecode_store_newest(bytecode_store_t *store, uint8_t **newest)
+{
+    int active = -1;
+    uint32_t active_seq = 0;
+    bytecode_store_header_t header;
+    uint8_t *last;
+    unsigned i;
+
+    *newest = NULL;
+
+    for (i = 0; i < store->sector_count; i++) {
+        bytecode_store_walk(store, bytecode_store_sector(store, i), &last);
+        if (last == NULL) {
+            continue;
+        }
+
+        memcpy(&header, last, sizeof(header));
+        if (active < 0 || header.sequence > active_seq) {
+            active = i;
+            active_seq = header.sequence;
+            *newest = last;
+        }
+    }
+
+    return active;
+}
+
+void bytecode_store_init(bytecode_store_t *store, void *start, size_t sector_size,
+                         unsigned sector_count)
+{
+    store->start = (uint8_t *)start;
+    store->sector_size = sector_size;
+    store->sector_count = sector_count;
+}
+
+int bytecode_store_active_sector(bytecode_store_t *store)
+{
+    uint8_t *newest;
+
+    return bytecode_store_newest(store, &newest);
+}
+
+bool bytecode_store_load(bytecode_store_t *store, void *buffer, size_t size)
+{
+    bytecode_store_header_t header;
+    uint8_t *newest;
+
+    if (bytecode_store_newest(store, &newest) < 0) {
+        return false;
+    }
+
+    memcpy(&header, newest, sizeof(header));
+    if (header.size > size) {
+        return false;
+    }
+
+    memcpy(buffer, newest + BYTECODE_STORE_HEADER_SIZE, header.size);
+    memset((uint8_t *)buffer + header.size, 0, size - header.size);
+
+    return true;
+}
+
+bool bytecode_store_save(bytecode_store_t *store, const void *data, size_t size)
+{
+    const uint8_t *bytes = (const uint8_t *)data;
+    bytecode_store_header_t header;
+    uint8_t *newest, *last, *sector, *image;
+    unsigned target = 0;
+    int active;
+
+    /* They are restored by the load. */
+    while (size > 0 && bytes[size - 1] == 0) {
+        size--;
+    }
+
+    if (size > UINT16_MAX || bytecode_store_image_size(size) > store->sector_size) {
+        return false;
+    }
+
+    header.sequence = 0;
+    active = bytecode_store_newest(store, &newest);
+
+    if (active >= 0) {
+        memcpy(&header, newest, sizeof(header));
+        if (header.size == size
+            && memcmp(newest + BYTECODE_STORE_HEADER_SIZE, bytes, size) == 0) {
+            return true;
+        }
+        target = active;
+    }
+
+    header.magic = BYTECODE_STORE_MAGIC;
+    header.version = BYTECODE_STORE_VERSION;
+    header.size = size;
+    header.sequence++;
+    header.crc = bytecode_store_crc(&header, bytes);
+
+    sector = bytecode_store_sector(store, target);
+    image = bytecode_store_walk(store, sector, &last);
+
+    flash_unlock();
+
+    /* Moves to the next sector if the image does not fit after the last one,
+     * which only holds older images. */
+    if (image + bytecode_store_image_size(size) > sector + store->sector_size
+        || !bytecode_store_is_blank(image, image + bytecode_store_image_size(size))) {
+        if (active >= 0) {
+            target = (active + 1) % store->sector_count;
+        }
+        sector = bytecode_store_sector(store, target);
+        if (!bytecode_store_is_blank(sector, sector + store->sector_size)) {
+            flash_sector_erase(sector);
+        }
+        image = sector;
+    }
+
+    /* The checksum is written last, so that an interrupted image is never
+     * valid. */
+    flash_write(image, &header, offsetof(bytecode_store_header_t, crc));
+    flash_write(image + BYTECODE_STORE_HEADER_SIZE, bytes, size);
+    flash_write(image + offsetof(bytecode_store_header_t, crc), &header.crc, sizeof(header.crc));
+
+    flash_lock();
+
+    return bytecode_store_image_read(image, sector + store->sector_size, &header)
+           && memcmp(image + BYTECODE_STORE_HEADER_SIZE, bytes, size) == 0;
+}
+
+bool bytecode_store_legacy_load(const void *image, uint16_t *buffer, size_t words)
+{
+    const uint8_t *p = (const uint8_t *)image;
+    uint16_t size, vectors, word;
+    size_t i;
+
+    memcpy(&size, p, sizeof(size));
+    p += sizeof(size);
+
+    /* Erased flash reads as 0xffff, which is odd. */
+    if (size == 0 || size % 2 != 0 || size / 2 > words) {
+        return false;
+    }
+
+    /* The table holds one event and address pair per event after its own
+     * size, and the code follows it. */
+    memcpy(&vectors, p, sizeof(vectors));
+    if (vectors % 2 != 1 || vectors > size / 2) {
+        return false;
+    }
+
+    for (i = 2; i < vectors; i += 2) {
+        memcpy(&word, p + i * sizeof(uint16_t), sizeof(word));
+        if (word < vectors || word >= size / 2) {
+            return false;
+        }
+    }
+
+    memcpy(buffer, p, size);
+    memset(&buffer[size / 2], 0, (words - size / 2) * sizeof(uint16_t));
+
+    return true;
+}
@@ -0,0 +1,76 @@
+#ifndef BYTECODE_STORE_H
+#define BYTECODE_STORE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** Version of the image format, images of other versions are ignored. */
+#define BYTECODE_STORE_VERSION 1
+
+/** Size of the header before the data of each image. */
+#define BYTECODE_STORE_HEADER_SIZE 16
+
+/** Aseba bytecode images kept in two flash sectors.
+ *
+ * Each image is appended after the previous one in the active sector, with
+ * a header holding the format version, its size, a sequence number and a
+ * CRC of the whole image. Trailing zeros of the bytecode are not stored.
+ *
+ * Once the active sector is full, the image is written to the other sector,
+ * which is erased first. The previous image stays in the active sector
+ * until the new one is complete, so a power loss during an upload leaves
+ * either the previous or the new bytecode.
+ */
+typedef struct {
+    uint8_t *start;
+    size_t sector_size;
+    unsigned sector_count; /**< At least two for power loss safety. */
+} bytecode_store_t;
+
+/** Describes a store made of sector_count consecutive sectors at start. */
+void bytecode_store_init(bytecode_store_t *store, void *start, size_t sector_size,
+                         unsigned sector_count);
+
+/** Loads the newest valid image in buffer, filling the rest of its size
+ * bytes with zeros.
+ *
+ * @returns false if there is no valid image, or if it does not fit.
+ */
+bool bytecode_store_load(bytecode_store_t *store, void *buffer, size_t size);
+
+/** Saves size bytes of bytecode as the newest image and reads it back.
+ *
+ * Nothing is written if the newest image already holds the same bytecode.
+ *
+ * @returns false if the image does not fit in a sector or did not read back
+ * correctly.
+ */
+bool bytecode_store_save(bytecode_store_t *store, const void *data, size_t size);
+
+/** Returns the index of the sector holding the newest image, -1 if the store
+ * is empty. */
+int bytecode_store_active_sector(bytecode_store_t *store);
+
+/** Loads the bytecode written by firmwares older than the store, its size in
+ * bytes followed by the bytecode, in buffer of the given number of words.
+ * The rest of buffer is filled with zeros.
+ *
+ * That format has no checksum, so the event vector table at the start of the
+ * bytecode is checked instead, which flash holding anything else hardly ever
+ * passes.
+ *
+ * @returns false if image does not hold such bytecode, in which case buffer
+ * is left untouched.
+ */
+bool bytecode_store_legacy_load(const void *image, uint16_t *buffer, size_t words);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BYTECODE_STORE_H */
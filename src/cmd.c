@@ -9,15 +9,22 @@
 #include "sensors/imu.h"
 #include "sensors/encoder.h"
 #include "sensors/range.h"
-#include "config_flash_storage.h"
+#include "config_journal.h"
+#include "flash/flash_service.h"
 #include "sensors/proximity.h"
 #include "sensors/battery_level.h"
 #include "sensors/imu.h"
 #include "sensors/motor_current.h"
 #include "motor_pid_thread.h"
+#include "audio/audio_synth.h"
 #include "audio/audio_thread.h"
 #include "main.h"
 #include "body_leds.h"
+#include "led_animation.h"
+#include "boot.h"
+#include "blackbox/blackbox_thread.h"
+#include "sdcard.h"
+#include "aseba_vm/aseba_can_interface.h"
 
 #define TEST_WA_SIZE        THD_WORKING_AREA_SIZE(256)
 #define SHELL_WA_SIZE       THD_WORKING_AREA_SIZE(2048)
@@ -340,7 +347,7 @@ static void cmd_config_set(BaseSequentialStream *chp, int argc, char **argv)
         return;
     }
 
-    param = parameter_find(&parameter_root, argv[0]);
+    param = parameter_index_find(&parameter_index, argv[0]);
 
     if (param == NULL) {
         chprintf(chp, "Could not find parameter \"%s\"\r\n", argv[0]);
@@ -394,24 +401,21 @@ static void cmd_config_erase(BaseSequentialStream *chp, int argc, char **argv)
     (void) argc;
     (void) argv;
     (void) chp;
-    extern uint8_t _config_start;
 
-    config_erase(&_config_start);
+    flash_service_config_erase(&config_journal);
 }
 
 static void cmd_config_save(BaseSequentialStream *chp, int argc, char **argv)
 {
     (void) argc;
     (void) argv;
-    extern uint8_t _config_start, _config_end;
-    size_t len = (size_t)(&_config_end - &_config_start);
     bool success;
 
     // First write the config to flash
-    config_save(&_config_start, len, &parameter_root);
+    success = flash_service_config_save(&config_journal, &parameter_root);
 
     // Second try to read it back, see if we failed
-    success = config_load(&parameter_root, &_config_start);
+    success = success && config_journal_load(&config_journal, &parameter_root);
 
     if (success) {
         chprintf(chp, "OK.\r\n");
@@ -424,10 +428,9 @@ static void cmd_config_load(BaseSequentialStream *chp, int argc, char **argv)
 {
     (void) argc;
     (void) argv;
-    extern uint8_t _config_start;
     bool success;
 
-    success = config_load(&parameter_root, &_config_start);
+    success = config_journal_load(&config_journal, &parameter_root);
 
     if (success) {
         chprintf(chp, "OK.\r\n");
@@ -467,6 +470,27 @@ static void cmd_leds(BaseSequentialStream *chp, int argc, char **argv)
     }
 }
 
+static void cmd_led_animation(BaseSequentialStream *chp, int argc, char **argv)
+{
+    const char *usage = "Usage: led_animation breathing|chase|blink|stop";
+    int id;
+
+    if (argc != 1) {
+        chprintf(chp, "%s\r\n", usage);
+        return;
+    }
+
+    id = led_animation_find(argv[0]);
+
+    if (id < 0) {
+        chprintf(chp, "%s\r\n", usage);
+    } else if (id == LED_ANIMATION_NONE) {
+        body_leds_animation_stop();
+    } else {
+        body_leds_animation_start(led_animation_builtin(id));
+    }
+}
+
 static void cmd_current(BaseSequentialStream *chp, int argc, char *argv[])
 {
     (void) argc;
@@ -481,6 +505,54 @@ static void cmd_current(BaseSequentialStream *chp, int argc, char *argv[])
     chprintf(chp, "left=%.2f\r\nright=%.2f\r\n", msg.left, msg.right);
 }
 
+static void cmd_boot(BaseSequentialStream *chp, int argc, char *argv[])
+{
+    (void) argc;
+    (void) argv;
+
+    boot_print(chp);
+}
+
+static void cmd_sdcard_cache(BaseSequentialStream *chp, int argc, char *argv[])
+{
+    sector_cache_stats_t *stats = &sdcard_cache.stats;
+    uint32_t total;
+
+    if (argc == 1 && !strcmp(argv[0], "reset")) {
+        sector_cache_reset_stats(&sdcard_cache);
+        return;
+    } else if (argc != 0) {
+        chprintf(chp, "Usage: sdcard_cache [reset]\r\n");
+        return;
+    }
+
+    total = stats->hits + stats->misses;
+
+    chprintf(chp, "hits:     %lu sectors\r\n", (unsigned long)stats->hits);
+    chprintf(chp, "misses:   %lu sectors\r\n", (unsigned long)stats->misses);
+    chprintf(chp, "commands: %lu\r\n", (unsigned long)stats->commands);
+    chprintf(chp, "read:     %lu bytes\r\n", (unsigned long)stats->bytes);
+    if (total > 0) {
+        chprintf(chp, "hit rate: %lu%%\r\n", (unsigned long)(100ULL * stats->hits / total));
+    }
+}
+
+static void cmd_blackbox(BaseSequentialStream *chp, int argc, char *argv[])
+{
+    (void) argc;
+    (void) argv;
+
+    blackbox_print_stats(chp);
+}
+
+static void cmd_can(BaseSequentialStream *chp, int argc, char *argv[])
+{
+    (void) argc;
+    (void) argv;
+
+    aseba_can_print_stats(chp);
+}
+
 /* MPU test functions are marked as not optimized because GCC can detect and
  * optimize their faulty behaviour away. */
 __attribute__((optimize("O0"), noinline))
@@ -518,36 +590,65 @@ static void cmd_mpu_test(BaseSequentialStream *chp, int argc, char *argv[])
 
 static void cmd_play(BaseSequentialStream *chp, int argc, char *argv[])
 {
-    messagebus_topic_t *req_topic, *res_topic;
-    req_topic = messagebus_find_topic(&bus, "/audio/play/request");
-    res_topic = messagebus_find_topic(&bus, "/audio/play/result");
+    audio_play_request_t request;
+    memset(&request, 0, sizeof(request));
 
-    if (req_topic == NULL || res_topic == NULL) {
-        chprintf(chp, "Cannot find topics. Is audio thread running?\r\n");
+    if (argc == 1) {
+        strncpy(request.path, argv[0], sizeof(request.path) - 1);
+    } else if (argc == 3 && !strcmp(argv[0], "tone")) {
+        request.frequency = atoi(argv[1]);
+        request.duration = atoi(argv[2]);
+    } else if (argc >= 3 && argc - 2 <= AUDIO_PLAY_MAX_NOTES && !strcmp(argv[0], "notes") &&
+               audio_synth_instrument_find(argv[1]) >= 0) {
+        request.instrument = audio_synth_instrument_find(argv[1]);
+        /* Each note is written key:length_ms. */
+        for (int i = 2; i < argc; i++) {
+            char *separator = strchr(argv[i], ':');
+            int key = atoi(argv[i]);
+            int length = separator ? atoi(separator + 1) : -1;
+            if (key < 0 || key > AUDIO_SYNTH_KEY_MAX || length < 0 ||
+                length > AUDIO_SYNTH_NOTE_LENGTH_MAX_MS) {
+                chprintf(chp, "Invalid note %s\r\n", argv[i]);
+                return;
+            }
+            request.notes[request.note_count++] = AUDIO_SYNTH_NOTE(key, length);
+        }
+    } else {
+        chprintf(chp, "Usage: play file.wav\r\n");
+        chprintf(chp, "       play tone frequency_hz duration_ms\r\n");
+        chprintf(chp, "       play notes beep|chime|organ|buzz key:length_ms...\r\n");
+        chprintf(chp, "Keys are MIDI numbers (69 is A4 at 440 Hz), 0 is a rest.\r\n");
         return;
     }
 
-    if (argc != 1) {
-        chprintf(chp, "Usage: play file.wav\r\n");
+    /* The sound plays in the background, mixed with the others. */
+    if (!audio_play(&request)) {
+        chprintf(chp, "Queue full.\r\n");
         return;
     }
 
-    /* Send the request */
-    audio_play_request_t request;
-    memset(&request, 0, sizeof(request));
-    strncpy(request.path, argv[0], sizeof(request.path) - 1);
-    chprintf(chp, "Playing %s...\r\n", request.path);
-    messagebus_topic_publish(req_topic, &request, sizeof(request));
+    chprintf(chp, "Queued, %lu underruns since boot.\r\n",
+             (unsigned long)audio_underrun_count());
+}
 
-    /* Wait for the reply. */
-    audio_play_result_t result;
-    messagebus_topic_wait(res_topic, &result, sizeof(result));
+static void cmd_audio_latency(BaseSequentialStream *chp, int argc, char *argv[])
+{
+    audio_latency_t ram, card;
 
-    if (result.status == AUDIO_OK) {
-        chprintf(chp, "Done.\r\n");
-    } else {
-        chprintf(chp, "Error: %d\r\n", result.status);
+    if (argc == 1 && !strcmp(argv[0], "reset")) {
+        audio_latency_reset();
+        return;
+    } else if (argc != 0) {
+        chprintf(chp, "Usage: audio_latency [reset]\r\n");
+        return;
     }
+
+    /* From the request to the first samples in the DAC buffer. */
+    audio_latency_get(&ram, &card);
+    chprintf(chp, "RAM:  %lu sounds, last %lu us, max %lu us\r\n", (unsigned long)ram.count,
+             (unsigned long)ram.last_us, (unsigned long)ram.max_us);
+    chprintf(chp, "card: %lu sounds, last %lu us, max %lu us\r\n", (unsigned long)card.count,
+             (unsigned long)card.last_us, (unsigned long)card.max_us);
 }
 
 static ShellCommand shell_commands[] = {
@@ -571,8 +672,14 @@ static ShellCommand shell_commands[] = {
     {"config_erase", cmd_config_erase},
     {"shutdown", cmd_shutdown},
     {"leds", cmd_leds},
+    {"led_animation", cmd_led_animation},
     {"mpu_test", cmd_mpu_test},
     {"play", cmd_play},
+    {"boot", cmd_boot},
+    {"blackbox", cmd_blackbox},
+    {"can", cmd_can},
+    {"sdcard_cache", cmd_sdcard_cache},
+    {"audio_latency", cmd_audio_latency},
 
     {NULL, NULL}
 };
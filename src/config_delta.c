@@ -0,0 +1,225 @@
+#include <string.h>
+#include "config_delta.h"
+#include "config_flash_storage_private.h"
+#include "cmp_mem_access/cmp_mem_access.h"
+#include "crc32_fast.h"
+
+/* Large enough for any scalar, integer or boolean value. */
+#define CONFIG_DELTA_VALUE_MAX_SIZE 16
+
+/* Serializes the value of p the way it is saved, returns its size or 0 if the
+ * parameter type is not supported. */
+static size_t config_delta_encode(parameter_t *p, uint8_t *buf)
+{
+    cmp_ctx_t cmp;
+    cmp_mem_access_t mem;
+    bool ok;
+
+    cmp_mem_access_init(&cmp, &mem, buf, CONFIG_DELTA_VALUE_MAX_SIZE);
+
+    /* The read functions do not clear the changed flag, which belongs to the
+     * modules using the parameter. */
+    switch (p->type) {
+        case _PARAM_TYPE_SCALAR:
+            ok = cmp_write_float(&cmp, parameter_scalar_read(p));
+            break;
+
+        case _PARAM_TYPE_INTEGER:
+            ok = cmp_write_sint(&cmp, parameter_integer_read(p));
+            break;
+
+        case _PARAM_TYPE_BOOLEAN:
+            ok = cmp_write_bool(&cmp, parameter_boolean_read(p));
+            break;
+
+        default:
+            ok = false;
+            break;
+    }
+
+    return ok ? cmp_mem_access_get_pos(&mem) : 0;
+}
+
+/* Computes the digest of the parameter value, returns false if it cannot be
+ * tracked. */
+static bool config_delta_digest(parameter_t *p, config_delta_entry_t *entry)
+{
+    uint8_t buf[CONFIG_DELTA_VALUE_MAX_SIZE];
+    size_t len;
+
+    entry->defined = parameter_defined(p);
+    entry->digest = 0;
+
+    if (!entry->defined) {
+        return true;
+    }
+
+    len = config_delta_encode(p, buf);
+    if (len == 0) {
+        return false;
+    }
+
+    entry->digest = crc32_fast(CRC_INITIAL_VALUE, buf, len);
+    return true;
+}
+
+/* Returns 1 if the parameter at the given index changed, 0 if it did not and
+ * -1 if it cannot be tracked. Undefined parameters cannot be saved, so they
+ * are never reported as changed. */
+static int config_delta_is_changed(config_delta_t *delta, parameter_t *p, size_t index)
+{
+    config_delta_entry_t current;
+    config_delta_entry_t *saved = &delta->entries[index];
+
+    if (!config_delta_digest(p, &current)) {
+        return -1;
+    }
+
+    if (!current.defined) {
+        return 0;
+    }
+
+    return !saved->defined || current.digest != saved->digest;
+}
+
+/* Counts the changed parameters of ns and its subspaces. index is the index of
+ * the first parameter of ns and is advanced past the last one. */
+static int config_delta_count(config_delta_t *delta, parameter_namespace_t *ns, size_t *index)
+{
+    parameter_t *p;
+    parameter_namespace_t *sub;
+    int count = 0, res;
+
+    for (p = ns->parameter_list; p != NULL; p = p->next) {
+        if (*index >= delta->capacity) {
+            return -1;
+        }
+
+        res = config_delta_is_changed(delta, p, (*index)++);
+        if (res < 0) {
+            return -1;
+        }
+        count += res;
+    }
+
+    for (sub = ns->subspaces; sub != NULL; sub = sub->next) {
+        res = config_delta_count(delta, sub, index);
+        if (res < 0) {
+            return -1;
+        }
+        count += res;
+    }
+
+    return count;
+}
+
+/* Walks the tree in the same order as config_delta_count(). */
+static bool config_delta_store(config_delta_t *delta, parameter_namespace_t *ns, size_t *index)
+{
+    parameter_t *p;
+    parameter_namespace_t *sub;
+
+    for (p = ns->parameter_list; p != NULL; p = p->next) {
+        if (*index >= delta->capacity || !config_delta_digest(p, &delta->entries[*index])) {
+            return false;
+        }
+        (*index)++;
+    }
+
+    for (sub = ns->subspaces; sub != NULL; sub = sub->next) {
+        if (!config_delta_store(delta, sub, index)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool config_delta_write_ns(config_delta_t *delta, parameter_namespace_t *ns,
+                                  cmp_ctx_t *cmp, size_t *index)
+{
+    parameter_t *p;
+    parameter_namespace_t *sub;
+    uint8_t buf[CONFIG_DELTA_VALUE_MAX_SIZE];
+    uint32_t entries = 0;
+    size_t i = *index, len;
+
+    /* MessagePack needs the map size first, so count what will be written. */
+    for (p = ns->parameter_list; p != NULL; p = p->next) {
+        entries += config_delta_is_changed(delta, p, i++);
+    }
+
+    for (sub = ns->subspaces; sub != NULL; sub = sub->next) {
+        entries += config_delta_count(delta, sub, &i) > 0;
+    }
+
+    if (!cmp_write_map(cmp, entries)) {
+        return false;
+    }
+
+    for (p = ns->parameter_list; p != NULL; p = p->next) {
+        if (config_delta_is_changed(delta, p, (*index)++)) {
+            len = config_delta_encode(p, buf);
+            if (!cmp_write_str(cmp, p->id, strlen(p->id))
+                || cmp->write(cmp, buf, len) != len) {
+                return false;
+            }
+        }
+    }
+
+    for (sub = ns->subspaces; sub != NULL; sub = sub->next) {
+        i = *index;
+        if (config_delta_count(delta, sub, &i) == 0) {
+            *index = i;
+            continue;
+        }
+
+        if (!cmp_write_str(cmp, sub->id, strlen(sub->id))
+            || !config_delta_write_ns(delta, sub, cmp, index)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void config_delta_init(config_delta_t *delta, config_delta_entry_t *entries, size_t capacity)
+{
+    delta->entries = entries;
+    delta->capacity = capacity;
+    delta->valid = false;
+}
+
+void config_delta_mark_saved(config_delta_t *delta, parameter_namespace_t *ns)
+{
+    size_t index = 0;
+
+    delta->valid = config_delta_store(delta, ns, &index);
+}
+
+void config_delta_invalidate(config_delta_t *delta)
+{
+    delta->valid = false;
+}
+
+int config_delta_changed_count(config_delta_t *delta, parameter_namespace_t *ns)
+{
+    size_t index = 0;
+
+    if (!delta->valid) {
+        return -1;
+    }
+
+    return config_delta_count(delta, ns, &index);
+}
+
+bool config_delta_write(config_delta_t *delta, parameter_namespace_t *ns, cmp_ctx_t *cmp)
+{
+    size_t index = 0;
+
+    if (config_delta_changed_count(delta, ns) < 0) {
+        return false;
+    }
+
+    return config_delta_write_ns(delta, ns, cmp, &index);
+}
@@ -0,0 +1,59 @@
+#ifndef CONFIG_DELTA_H
+#define CONFIG_DELTA_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "parameter/parameter.h"
+#include "cmp/cmp.h"
+
+/** Tracks which parameters changed since the configuration was last saved.
+ *
+ * A checksum of each parameter value is kept, in the order the tree is
+ * walked, so the tree must not change after the first call to
+ * config_delta_mark_saved(). Only scalar, integer and boolean parameters can
+ * be tracked; with any other type in the tree the whole tree is always
+ * considered changed.
+ */
+/** Saved state of one parameter. */
+typedef struct {
+    uint32_t digest; /**< Checksum of the value, only meaningful if defined. */
+    bool defined; /**< False if the parameter had no value when saved. */
+} config_delta_entry_t;
+
+typedef struct {
+    config_delta_entry_t *entries;
+    size_t capacity;
+    bool valid; /**< True once the saved values are known. */
+} config_delta_t;
+
+/** Initializes change tracking with room for capacity parameters. */
+void config_delta_init(config_delta_t *delta, config_delta_entry_t *entries, size_t capacity);
+
+/** Records the current values of the tree as the saved ones. */
+void config_delta_mark_saved(config_delta_t *delta, parameter_namespace_t *ns);
+
+/** Forgets the saved values, for example after the flash was erased. */
+void config_delta_invalidate(config_delta_t *delta);
+
+/** Returns the number of parameters changed since the last save, or -1 if
+ * the changes are not known.
+ */
+int config_delta_changed_count(config_delta_t *delta, parameter_namespace_t *ns);
+
+/** Writes a MessagePack map holding only the changed parameters, nested in
+ * their namespaces like parameter_msgpack_write_cmp() does.
+ *
+ * @returns false if writing failed.
+ */
+bool config_delta_write(config_delta_t *delta, parameter_namespace_t *ns, cmp_ctx_t *cmp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
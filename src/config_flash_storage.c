@@ -1,3 +1,4 @@
+#include <stdint.h>
 #include <string.h>
 #include "config_flash_storage.h"
 #include "config_flash_storage_private.h"
@@ -5,23 +6,64 @@
 #include "parameter/parameter_msgpack.h"
 #include "cmp/cmp.h"
 #include "cmp_mem_access/cmp_mem_access.h"
-#include "crc/crc32.h"
+#include "crc32_fast.h"
 
-/* We cannot use a CRC start value of 0 because CRC(0, 0xffffffff) = 0xffffffff
- * which makes empty flash pages valid. */
-#define CRC_INITIAL_VALUE 0xdeadbeef
+/* MessagePack writes a few bytes at a time, so they are gathered before being
+ * programmed to make use of word parallel flash writes. */
+#define CONFIG_WRITE_BUFFER_SIZE 64
 
+typedef struct {
+    cmp_mem_access_t mem; /* Must be first, the cmp context points to it. */
+    uint8_t buffer[CONFIG_WRITE_BUFFER_SIZE];
+    size_t buffered;
+} config_flash_writer_t;
+
+static void config_flash_writer_flush(config_flash_writer_t *writer)
+{
+    if (writer->buffered > 0) {
+        flash_write(&writer->mem.buf[writer->mem.index - writer->buffered],
+                    writer->buffer, writer->buffered);
+        writer->buffered = 0;
+    }
+}
+
+/* Flushed chunks end on buffer sized boundaries of the flash, so that only the
+ * first and last ones need unaligned byte writes. */
+static size_t config_flash_writer_capacity(config_flash_writer_t *writer)
+{
+    uintptr_t start = (uintptr_t)&writer->mem.buf[writer->mem.index - writer->buffered];
+    return CONFIG_WRITE_BUFFER_SIZE - start % CONFIG_WRITE_BUFFER_SIZE;
+}
 
 static size_t cmp_flash_writer(struct cmp_ctx_s *ctx, const void *data, size_t len)
 {
-    cmp_mem_access_t *mem = (cmp_mem_access_t*)ctx->buf;
-    if (mem->index + len <= mem->size) {
-        flash_write(&mem->buf[mem->index], data, len);
-        mem->index += len;
-        return len;
-    } else {
+    config_flash_writer_t *writer = (config_flash_writer_t *)ctx->buf;
+    const uint8_t *src = (const uint8_t *)data;
+    size_t remaining = len;
+
+    if (writer->mem.index + len > writer->mem.size) {
         return 0;
     }
+
+    while (remaining > 0) {
+        size_t capacity = config_flash_writer_capacity(writer);
+        size_t chunk = capacity - writer->buffered;
+        if (chunk > remaining) {
+            chunk = remaining;
+        }
+
+        memcpy(&writer->buffer[writer->buffered], src, chunk);
+        writer->buffered += chunk;
+        writer->mem.index += chunk;
+        src += chunk;
+        remaining -= chunk;
+
+        if (writer->buffered == capacity) {
+            config_flash_writer_flush(writer);
+        }
+    }
+
+    return len;
 }
 
 void config_erase(void *dst)
@@ -40,73 +82,102 @@ static void err_mark_false(void *arg, const char *id, const char *err)
     *b = false;
 }
 
-void config_save(void *dst, size_t dst_len, parameter_namespace_t *ns)
+bool config_block_write_with(void *dst, size_t max_len, config_serializer_t serialize, void *arg)
 {
     cmp_ctx_t cmp;
-    cmp_mem_access_t mem;
-    uint32_t len;
-    bool success = true;
+    config_flash_writer_t writer;
+    uint8_t *block = (uint8_t *)dst;
 
-    void *orig_dst = dst;
-
-    flash_unlock();
-
-    /* If there is no valid block, erase flash just to start from a pristine
-     * state. */
-    if (config_block_find_last_used(dst) == NULL) {
-        flash_sector_erase(dst);
+    if (max_len <= CONFIG_HEADER_SIZE) {
+        return false;
     }
 
-    /* Find first available flash block. */
-    dst = config_block_find_first_free(dst);
+    cmp_mem_access_init(&cmp, &writer.mem, block + CONFIG_HEADER_SIZE,
+                        max_len - CONFIG_HEADER_SIZE);
+    writer.buffered = 0;
 
-    len = dst_len - (dst - orig_dst);
+    /* Replace the RAM writer with the special writer for flash. */
+    cmp.write = cmp_flash_writer;
 
-    /* If the destination is too small to fit even the header, erase the block. */
-    if (len <= CONFIG_HEADER_SIZE) {
-        flash_sector_erase(orig_dst);
-        dst = orig_dst;
-        len = dst_len;
+    if (!serialize(&cmp, arg)) {
+        return false;
     }
 
-    cmp_mem_access_init(&cmp, &mem,
-                        dst + CONFIG_HEADER_SIZE, len - CONFIG_HEADER_SIZE);
+    config_flash_writer_flush(&writer);
 
-    /* Replace the RAM writer with the special writer for flash. */
-    cmp.write = cmp_flash_writer;
+    config_write_block_header(block, cmp_mem_access_get_pos(&writer.mem));
+
+    return true;
+}
+
+static bool config_serialize_namespace(cmp_ctx_t *cmp, void *arg)
+{
+    bool success = true;
 
     /* Tries to write the config. If there is an error the callback will set
      * success to false. */
-    parameter_msgpack_write_cmp(ns, &cmp, err_mark_false, &success);
+    parameter_msgpack_write_cmp((parameter_namespace_t *)arg, cmp, err_mark_false, &success);
 
-    if (success == false) {
-        flash_sector_erase(orig_dst);
-        flash_lock();
-        return config_save(orig_dst, dst_len, ns);
+    return success;
+}
+
+bool config_block_write(void *dst, size_t max_len, parameter_namespace_t *ns)
+{
+    return config_block_write_with(dst, max_len, config_serialize_namespace, ns);
+}
+
+void config_save(void *dst, size_t dst_len, parameter_namespace_t *ns)
+{
+    uint8_t *area = (uint8_t *)dst;
+    uint8_t *area_end = area + config_data_area_size(dst_len);
+    uint8_t *block;
+
+    flash_unlock();
+
+    /* Find first available flash block. If there is no valid block, erase
+     * flash just to start from a pristine state. */
+    block = config_find_last_block(area, dst_len);
+    if (block == NULL) {
+        flash_sector_erase(dst);
+        block = area;
+    } else {
+        block += CONFIG_HEADER_SIZE + config_block_get_length(block);
     }
 
-    len = cmp_mem_access_get_pos(&mem);
+    /* If the destination is too small to fit even the header, erase the block. */
+    if (block + CONFIG_HEADER_SIZE >= area_end) {
+        flash_sector_erase(dst);
+        block = area;
+    }
 
-    config_write_block_header(dst, len);
+    if (!config_block_write(block, area_end - block, ns)) {
+        flash_sector_erase(dst);
+        flash_lock();
+        return config_save(dst, dst_len, ns);
+    }
+
+    /* Only index the block once it is complete. */
+    config_index_append(area, dst_len, block - area);
 
     flash_lock();
 }
 
-bool config_load(parameter_namespace_t *ns, void *src)
+bool config_load(parameter_namespace_t *ns, void *src, size_t src_len)
 {
     int res;
-    uint32_t src_len;
+    uint32_t block_len;
+    uint8_t *block;
 
-    src = config_block_find_last_used(src);
+    block = config_find_last_block(src, src_len);
 
     /* If no valid block was found signal an error. */
-    if (src == NULL) {
+    if (block == NULL) {
         return false;
     }
 
-    src_len = config_block_get_length(src);
+    block_len = config_block_get_length(block);
 
-    res = parameter_msgpack_read(ns, src + CONFIG_HEADER_SIZE, src_len,
+    res = parameter_msgpack_read(ns, (char *)block + CONFIG_HEADER_SIZE, block_len,
                                  NULL, NULL);
 
     if (res != 0) {
@@ -116,6 +187,136 @@ bool config_load(parameter_namespace_t *ns, void *src)
     return true;
 }
 
+size_t config_index_slot_count(size_t area_len)
+{
+    size_t count = area_len / CONFIG_INDEX_FRACTION / CONFIG_INDEX_SLOT_SIZE;
+
+    if (count == 0) {
+        count = 1;
+    }
+    return count;
+}
+
+size_t config_data_area_size(size_t area_len)
+{
+    return area_len - config_index_slot_count(area_len) * CONFIG_INDEX_SLOT_SIZE;
+}
+
+/* Slots are stored from the end of the area, growing backward. */
+static uint8_t *config_index_slot(uint8_t *area, size_t area_len, size_t i)
+{
+    return area + area_len - (i + 1) * CONFIG_INDEX_SLOT_SIZE;
+}
+
+static bool config_index_slot_is_empty(const uint8_t *slot)
+{
+    uint32_t words[2];
+
+    memcpy(words, slot, sizeof(words));
+    return words[0] == 0xffffffff && words[1] == 0xffffffff;
+}
+
+static bool config_index_slot_read(const uint8_t *slot, uint32_t *offset)
+{
+    uint32_t crc;
+
+    memcpy(offset, slot, sizeof(uint32_t));
+    memcpy(&crc, slot + sizeof(uint32_t), sizeof(uint32_t));
+
+    return crc == crc32_fast(CRC_INITIAL_VALUE, offset, sizeof(uint32_t));
+}
+
+size_t config_index_find_free_slot(void *area, size_t area_len)
+{
+    size_t low = 0, high = config_index_slot_count(area_len);
+
+    /* Slots are written in order, so the used ones form a prefix and we can
+     * binary search for the first empty one. */
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (config_index_slot_is_empty(config_index_slot(area, area_len, mid))) {
+            high = mid;
+        } else {
+            low = mid + 1;
+        }
+    }
+
+    return low;
+}
+
+void config_index_append(void *area, size_t area_len, uint32_t offset)
+{
+    size_t i = config_index_find_free_slot(area, area_len);
+    uint32_t slot[2];
+
+    /* When the index is full, blocks are still found by walking forward from
+     * the last indexed one. */
+    if (i == config_index_slot_count(area_len)) {
+        return;
+    }
+
+    slot[0] = offset;
+    slot[1] = crc32_fast(CRC_INITIAL_VALUE, &offset, sizeof(uint32_t));
+    flash_write(config_index_slot(area, area_len, i), slot, sizeof(slot));
+}
+
+bool config_block_header_is_valid(void *p, void *end)
+{
+    uint8_t *block = (uint8_t *)p;
+    uint32_t crc, length;
+
+    if (block + CONFIG_HEADER_SIZE > (uint8_t *)end) {
+        return false;
+    }
+
+    memcpy(&crc, &block[0], sizeof(crc));
+    memcpy(&length, &block[sizeof(crc)], sizeof(length));
+
+    if (crc != crc32_fast(CRC_INITIAL_VALUE, &length, sizeof(length))) {
+        return false;
+    }
+
+    return length <= (size_t)((uint8_t *)end - block - CONFIG_HEADER_SIZE);
+}
+
+void *config_find_last_block(void *area, size_t area_len)
+{
+    uint8_t *start = (uint8_t *)area;
+    uint8_t *end = start + config_data_area_size(area_len);
+    uint8_t *block, *last = NULL;
+    size_t i = config_index_find_free_slot(area, area_len);
+    uint32_t offset;
+
+    /* Start from the most recent index slot which is not corrupted. If there is
+     * none, we fall back to scanning the whole area. */
+    while (i-- > 0) {
+        if (config_index_slot_read(config_index_slot(area, area_len, i), &offset)
+            && offset < (size_t)(end - start)) {
+            start += offset;
+            break;
+        }
+    }
+
+    /* Blocks written after the last index slot (unindexed because of a power
+     * loss or a full index) are found by walking their headers only. */
+    for (block = start; config_block_header_is_valid(block, end);
+         block += CONFIG_HEADER_SIZE + config_block_get_length(block)) {
+        last = block;
+    }
+
+    /* The data checksum is only computed on the selected block. */
+    if (last != NULL && config_block_is_valid(last)) {
+        return last;
+    }
+
+    /* Something is corrupted, use the slow but safe full scan. */
+    last = config_block_find_last_used(area);
+    if (last != NULL && last + CONFIG_HEADER_SIZE + config_block_get_length(last) > end) {
+        return NULL;
+    }
+    return last;
+}
+
 bool config_block_is_valid(void *p)
 {
     uint8_t *block = (uint8_t *)p;
@@ -131,7 +332,7 @@ bool config_block_is_valid(void *p)
     offset += sizeof(length);
 
     /* Check that the length is valid. */
-    if (crc != crc32(CRC_INITIAL_VALUE, &length, sizeof(length))) {
+    if (crc != crc32_fast(CRC_INITIAL_VALUE, &length, sizeof(length))) {
         return false;
     }
 
@@ -140,7 +341,7 @@ bool config_block_is_valid(void *p)
     offset += sizeof(crc);
 
     /* Check that the data checksum is valid. */
-    if (crc != crc32(CRC_INITIAL_VALUE, &block[offset], length)) {
+    if (crc != crc32_fast(CRC_INITIAL_VALUE, &block[offset], length)) {
         return false;
     }
 
@@ -153,7 +354,7 @@ void config_write_block_header(void *dst, uint32_t len)
     size_t offset = 0;
 
     /* First write length checksum. */
-    crc = crc32(CRC_INITIAL_VALUE, &len, sizeof(uint32_t));
+    crc = crc32_fast(CRC_INITIAL_VALUE, &len, sizeof(uint32_t));
     flash_write(dst + offset, &crc, sizeof(uint32_t));
     offset += sizeof(uint32_t);
 
@@ -162,7 +363,7 @@ void config_write_block_header(void *dst, uint32_t len)
     offset += sizeof(uint32_t);
 
     /* Then write the data checksum. */
-    crc = crc32(CRC_INITIAL_VALUE, dst + CONFIG_HEADER_SIZE, len);
+    crc = crc32_fast(CRC_INITIAL_VALUE, dst + CONFIG_HEADER_SIZE, len);
     flash_write(dst + offset, &crc, sizeof(uint32_t));
 }
 
@@ -15,6 +15,9 @@ void config_erase(void *dst);
 
 /** Writes the given parameter namespace to flash , prepending it with a CRC
  * for integrity checks.
+ *
+ * The end of the area holds an index of the saved blocks, which keeps finding
+ * the latest one fast after many saves.
  */
 void config_save(void *dst, size_t dst_len, parameter_namespace_t *ns);
 
@@ -23,7 +26,7 @@ void config_save(void *dst, size_t dst_len, parameter_namespace_t *ns);
  * @returns true if the operation was successful.
  * @note If no valid block is found the parameter tree is unchanged.
  */
-bool config_load(parameter_namespace_t *ns, void *src);
+bool config_load(parameter_namespace_t *ns, void *src, size_t src_len);
 #ifdef __cplusplus
 }
 #endif
@@ -5,6 +5,16 @@
 extern "C" {
 #endif
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "parameter/parameter.h"
+#include "cmp/cmp.h"
+
+/* We cannot use a CRC start value of 0 because CRC(0, 0xffffffff) = 0xffffffff
+ * which makes empty flash pages valid. */
+#define CRC_INITIAL_VALUE 0xdeadbeef
+
 /** Returns true if the block at the given address has a valid checksum. */
 bool config_block_is_valid(void *block);
 
@@ -14,6 +24,32 @@ bool config_block_is_valid(void *block);
  * the checksum to the block. */
 void config_write_block_header(void *dst, uint32_t len);
 
+/** Returns true if the block header is valid and the block fits before end.
+ *
+ * @note The data checksum is not verified.
+ */
+bool config_block_header_is_valid(void *block, void *end);
+
+/** Function writing the content of a block, returns false on error. */
+typedef bool (*config_serializer_t)(cmp_ctx_t *cmp, void *arg);
+
+/** Writes a new block at dst, header included, with the data written by the
+ * given serializer.
+ *
+ * @returns false if the serializer failed or the block does not fit in
+ * max_len bytes. Part of the data might have been written to flash anyway.
+ * @note Flash must be unlocked.
+ */
+bool config_block_write_with(void *dst, size_t max_len, config_serializer_t serialize, void *arg);
+
+/** Serializes the namespace in a new block at dst, header included.
+ *
+ * @returns false if the block does not fit in max_len bytes. Part of the data
+ * might have been written to flash anyway.
+ * @note Flash must be unlocked.
+ */
+bool config_block_write(void *dst, size_t max_len, parameter_namespace_t *ns);
+
 /** Returns the length of the pointed block. */
 uint32_t config_block_get_length(void *block);
 
@@ -23,6 +59,35 @@ void *config_block_find_first_free(void *block);
 /** Returns a pointer to the last used block. */
 void *config_block_find_last_used(void *p);
 
+/** Size of an index slot: block offset followed by its CRC. */
+#define CONFIG_INDEX_SLOT_SIZE (2 * sizeof(uint32_t))
+
+/** The index takes this fraction of the config area, with at least one slot. */
+#define CONFIG_INDEX_FRACTION 16
+
+/** Returns the number of index slots at the end of a config area. */
+size_t config_index_slot_count(size_t area_len);
+
+/** Returns the size of the config area usable for blocks, before the index. */
+size_t config_data_area_size(size_t area_len);
+
+/** Returns the number of used index slots, found by binary search. */
+size_t config_index_find_free_slot(void *area, size_t area_len);
+
+/** Records that the latest block starts at the given offset in the area.
+ *
+ * @note Does nothing if the index is full.
+ */
+void config_index_append(void *area, size_t area_len, uint32_t offset);
+
+/** Returns the latest valid block using the index, NULL if there is none.
+ *
+ * Only the header of blocks written after the last indexed one is checked,
+ * while the data checksum is only verified on the returned block. If the index
+ * is corrupted, the whole area is scanned.
+ */
+void *config_find_last_block(void *area, size_t area_len);
+
 #ifdef __cplusplus
 }
 #endif
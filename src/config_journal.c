@@ -0,0 +1,339 @@
+#include <string.h>
+#include "config_journal.h"
+#include "config_flash_storage.h"
+#include "config_flash_storage_private.h"
+#include "flash/flash.h"
+#include "parameter/parameter_msgpack.h"
+#include "crc32_fast.h"
+
+#define CONFIG_JOURNAL_MAGIC 0x4c4e524a /* "JRNL" */
+
+static uint8_t *config_journal_sector(config_journal_t *journal, unsigned i)
+{
+    return journal->start + i * journal->sector_size;
+}
+
+static bool config_journal_header_read(const uint8_t *sector, uint32_t *seq)
+{
+    uint32_t header[3];
+
+    memcpy(header, sector, sizeof(header));
+
+    if (header[0] != CONFIG_JOURNAL_MAGIC) {
+        return false;
+    }
+
+    if (header[2] != crc32_fast(CRC_INITIAL_VALUE, header, 2 * sizeof(uint32_t))) {
+        return false;
+    }
+
+    *seq = header[1];
+    return true;
+}
+
+static void config_journal_header_write(uint8_t *sector, uint32_t seq)
+{
+    uint32_t header[3] = {CONFIG_JOURNAL_MAGIC, seq, 0};
+
+    header[2] = crc32_fast(CRC_INITIAL_VALUE, header, 2 * sizeof(uint32_t));
+    flash_write(sector, header, sizeof(header));
+}
+
+static bool config_journal_is_blank(const uint8_t *p, const uint8_t *end)
+{
+    while (p < end) {
+        if (*p++ != 0xff) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Calls fn on each record of the sector with a valid header, in order, and
+ * returns the address following the last one.
+ *
+ * Only the headers are checked, the data checksum is left to the callers
+ * actually reading the records. */
+static uint8_t *config_journal_walk(config_journal_t *journal, uint8_t *sector,
+                                    void (*fn)(uint8_t *record, void *arg), void *arg)
+{
+    uint8_t *end = sector + journal->sector_size;
+    uint8_t *record = sector + CONFIG_JOURNAL_HEADER_SIZE;
+
+    /* The data of a record is written first, then the checksum of its
+     * length, its length and the checksum of its data. A record interrupted
+     * by a power loss before its length is written has no valid header, and
+     * nothing is ever appended after it. One interrupted while writing its
+     * data checksum is walked past, and skipped when the data is checked. */
+    while (config_block_header_is_valid(record, end)) {
+        if (fn != NULL) {
+            fn(record, arg);
+        }
+        record += CONFIG_HEADER_SIZE + config_block_get_length(record);
+    }
+
+    return record;
+}
+
+void config_journal_init(config_journal_t *journal, void *start,
+                         size_t sector_size, unsigned sector_count)
+{
+    journal->start = (uint8_t *)start;
+    journal->sector_size = sector_size;
+    journal->sector_count = sector_count;
+    journal->delta = NULL;
+    journal->index = NULL;
+}
+
+void config_journal_track_changes(config_journal_t *journal, config_delta_t *delta)
+{
+    journal->delta = delta;
+}
+
+int config_journal_active_sector(config_journal_t *journal)
+{
+    int active = -1;
+    uint32_t active_seq = 0, seq;
+    unsigned i;
+
+    for (i = 0; i < journal->sector_count; i++) {
+        if (config_journal_header_read(config_journal_sector(journal, i), &seq)
+            && (active < 0 || seq > active_seq)) {
+            active = i;
+            active_seq = seq;
+        }
+    }
+
+    return active;
+}
+
+size_t config_journal_used(config_journal_t *journal)
+{
+    int active = config_journal_active_sector(journal);
+    uint8_t *sector;
+
+    if (active < 0) {
+        return 0;
+    }
+
+    sector = config_journal_sector(journal, active);
+    return config_journal_walk(journal, sector, NULL, NULL) - sector;
+}
+
+static unsigned config_journal_next_sector(config_journal_t *journal, int active)
+{
+    if (active < 0) {
+        return 0;
+    }
+    return (active + 1) % journal->sector_count;
+}
+
+struct config_journal_patch {
+    config_delta_t *delta;
+    parameter_namespace_t *ns;
+};
+
+static bool config_journal_write_patch(cmp_ctx_t *cmp, void *arg)
+{
+    struct config_journal_patch *patch = (struct config_journal_patch *)arg;
+    return config_delta_write(patch->delta, patch->ns, cmp);
+}
+
+static bool config_journal_append(config_journal_t *journal, int active,
+                                  parameter_namespace_t *ns)
+{
+    struct config_journal_patch patch = {journal->delta, ns};
+    uint8_t *sector = config_journal_sector(journal, active);
+    uint8_t *end = sector + journal->sector_size;
+    uint8_t *record = config_journal_walk(journal, sector, NULL, NULL);
+
+    /* Leftovers of an interrupted write cannot be programmed over, so we
+     * rotate instead. */
+    if (!config_journal_is_blank(record, end)) {
+        return false;
+    }
+
+    /* The snapshot at the start of the sector holds the other parameters. */
+    if (journal->delta != NULL && config_delta_changed_count(journal->delta, ns) >= 0) {
+        return config_block_write_with(record, end - record, config_journal_write_patch, &patch);
+    }
+
+    return config_block_write(record, end - record, ns);
+}
+
+static bool config_journal_rotate(config_journal_t *journal, int active,
+                                  parameter_namespace_t *ns)
+{
+    uint8_t *sector = config_journal_sector(journal, config_journal_next_sector(journal, active));
+    uint32_t seq = 0;
+
+    if (active >= 0) {
+        config_journal_header_read(config_journal_sector(journal, active), &seq);
+    }
+
+    /* Normally already done in the background. */
+    if (!config_journal_is_blank(sector, sector + journal->sector_size)) {
+        flash_sector_erase(sector);
+    }
+
+    if (!config_block_write(sector + CONFIG_JOURNAL_HEADER_SIZE,
+                            journal->sector_size - CONFIG_JOURNAL_HEADER_SIZE, ns)) {
+        return false;
+    }
+
+    /* The sector only becomes active once the snapshot is complete. */
+    config_journal_header_write(sector, seq + 1);
+
+    return true;
+}
+
+bool config_journal_save(config_journal_t *journal, parameter_namespace_t *ns)
+{
+    int active = config_journal_active_sector(journal);
+    bool success = false;
+
+    if (active >= 0 && journal->delta != NULL
+        && config_delta_changed_count(journal->delta, ns) == 0) {
+        return true;
+    }
+
+    flash_unlock();
+
+    if (active >= 0) {
+        success = config_journal_append(journal, active, ns);
+    }
+
+    if (!success) {
+        success = config_journal_rotate(journal, active, ns);
+    }
+
+    flash_lock();
+
+    if (success && journal->delta != NULL) {
+        config_delta_mark_saved(journal->delta, ns);
+    }
+
+    return success;
+}
+
+void config_journal_use_index(config_journal_t *journal, parameter_index_t *index)
+{
+    journal->index = index;
+}
+
+struct config_journal_load_ctx {
+    parameter_namespace_t *ns;
+    parameter_index_t *index;
+    bool success;
+};
+
+static void config_journal_apply(uint8_t *record, void *arg)
+{
+    struct config_journal_load_ctx *ctx = (struct config_journal_load_ctx *)arg;
+    char *data = (char *)record + CONFIG_HEADER_SIZE;
+    int res;
+
+    /* A power loss while writing the data checksum leaves a valid length.
+     * That save never completed, and the tree it was a patch of is the one
+     * loaded from the records before, so it is skipped. */
+    if (!config_block_is_valid(record)) {
+        return;
+    }
+
+    if (ctx->index != NULL) {
+        res = parameter_index_msgpack_read(ctx->index, data, config_block_get_length(record));
+    } else {
+        res = parameter_msgpack_read(ctx->ns, data, config_block_get_length(record), NULL, NULL);
+    }
+
+    if (res != 0) {
+        ctx->success = false;
+    }
+}
+
+bool config_journal_load(config_journal_t *journal, parameter_namespace_t *ns)
+{
+    struct config_journal_load_ctx ctx = {ns, NULL, true};
+    int active = config_journal_active_sector(journal);
+    unsigned i;
+
+    /* A legacy config is not in the journal yet, so the next save must write
+     * the whole tree. */
+    if (journal->delta != NULL) {
+        config_delta_invalidate(journal->delta);
+    }
+
+    if (active < 0) {
+        for (i = 0; i < journal->sector_count; i++) {
+            if (config_load(ns, config_journal_sector(journal, i), journal->sector_size)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    if (journal->index != NULL && journal->index->root == ns) {
+        ctx.index = journal->index;
+    }
+
+    config_journal_walk(journal, config_journal_sector(journal, active),
+                        config_journal_apply, &ctx);
+
+    /* The tree now matches the flash, unless a record could not be applied. */
+    if (ctx.success && journal->delta != NULL) {
+        config_delta_mark_saved(journal->delta, ns);
+    }
+
+    return ctx.success;
+}
+
+void config_journal_erase(config_journal_t *journal)
+{
+    unsigned i;
+    uint8_t *sector;
+
+    flash_unlock();
+
+    for (i = 0; i < journal->sector_count; i++) {
+        sector = config_journal_sector(journal, i);
+        if (!config_journal_is_blank(sector, sector + journal->sector_size)) {
+            flash_sector_erase(sector);
+        }
+    }
+
+    flash_lock();
+
+    if (journal->delta != NULL) {
+        config_delta_invalidate(journal->delta);
+    }
+}
+
+bool config_journal_next_sector_needs_erase(config_journal_t *journal)
+{
+    int active = config_journal_active_sector(journal);
+    uint8_t *next;
+
+    if (active < 0 || journal->sector_count < 2) {
+        return false;
+    }
+
+    if (config_journal_used(journal) < journal->sector_size / 2) {
+        return false;
+    }
+
+    next = config_journal_sector(journal, config_journal_next_sector(journal, active));
+    return !config_journal_is_blank(next, next + journal->sector_size);
+}
+
+void config_journal_erase_next_sector(config_journal_t *journal)
+{
+    int active = config_journal_active_sector(journal);
+
+    if (active < 0 || journal->sector_count < 2) {
+        return;
+    }
+
+    flash_unlock();
+    flash_sector_erase(config_journal_sector(journal, config_journal_next_sector(journal, active)));
+    flash_lock();
+}
@@ -0,0 +1,95 @@
+#ifndef CONFIG_JOURNAL_H
+#define CONFIG_JOURNAL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "parameter/parameter.h"
+#include "config_delta.h"
+#include "parameter_index.h"
+
+/** Size of the header at the start of each journal sector. */
+#define CONFIG_JOURNAL_HEADER_SIZE (3 * sizeof(uint32_t))
+
+/** Parameter store spread over several flash sectors.
+ *
+ * Each sector starts with a header holding a sequence number, followed by a
+ * snapshot of the whole parameter tree and by the records appended by later
+ * saves. Records are MessagePack maps which are merged in order on load, so
+ * when changes are tracked a record only holds the changed parameters.
+ *
+ * When the active sector is full, the tree is written to the next sector and
+ * its header is only written once the snapshot is complete. The sector with
+ * the highest sequence number is the active one, so a power loss at any point
+ * leaves either the previous or the new configuration.
+ */
+typedef struct {
+    uint8_t *start;
+    size_t sector_size;
+    unsigned sector_count; /**< At least two for power loss safety. */
+    config_delta_t *delta; /**< Changes since the last save, can be NULL. */
+    parameter_index_t *index; /**< Used to load records, can be NULL. */
+} config_journal_t;
+
+/** Describes a journal made of sector_count consecutive sectors at start. */
+void config_journal_init(config_journal_t *journal, void *start,
+                         size_t sector_size, unsigned sector_count);
+
+/** Saves only the parameters changed since the last save or load, using the
+ * given tracker. Without it, every save writes the whole tree.
+ */
+void config_journal_track_changes(config_journal_t *journal, config_delta_t *delta);
+
+/** Resolves the parameters of loaded records with the given index instead of
+ * walking the tree, see parameter_index_msgpack_read().
+ */
+void config_journal_use_index(config_journal_t *journal, parameter_index_t *index);
+
+/** Appends the parameter tree to the journal, rotating to the next sector
+ * if it does not fit in the active one.
+ *
+ * Nothing is written if no parameter changed since the last save.
+ *
+ * @returns false if the tree does not even fit in an empty sector.
+ */
+bool config_journal_save(config_journal_t *journal, parameter_namespace_t *ns);
+
+/** Loads the configuration from the journal.
+ *
+ * If no journal sector is found, settings saved in the single sector format
+ * used before are loaded instead.
+ *
+ * @returns true if the operation was successful.
+ */
+bool config_journal_load(config_journal_t *journal, parameter_namespace_t *ns);
+
+/** Erases every sector of the journal. */
+void config_journal_erase(config_journal_t *journal);
+
+/** Returns the index of the active sector, -1 if the journal is empty. */
+int config_journal_active_sector(config_journal_t *journal);
+
+/** Returns the number of bytes used in the active sector. */
+size_t config_journal_used(config_journal_t *journal);
+
+/** Returns true once the active sector is half full and the sector it will
+ * rotate to still has to be erased.
+ */
+bool config_journal_next_sector_needs_erase(config_journal_t *journal);
+
+/** Erases the sector the journal will rotate to, so that the next rotation
+ * only has to program flash.
+ *
+ * This is the slow part of the rotation, meant to be run in the background.
+ */
+void config_journal_erase_next_sector(config_journal_t *journal);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
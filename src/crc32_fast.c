@@ -0,0 +1,97 @@
+#include "crc32_fast.h"
+
+/* Reversed representation of the Ethernet / zlib polynomial. */
+#define CRC32_POLY_REVERSED 0xedb88320
+#define CRC32_POLY 0x04c11db7
+
+static const uint32_t nibble_table[16] = {
+    0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac,
+    0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+    0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c,
+    0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c,
+};
+
+static uint32_t byte_table[256];
+static int byte_table_ready = 0;
+
+static void byte_table_init(void)
+{
+    uint32_t i, j, crc;
+
+    for (i = 0; i < 256; i++) {
+        crc = i;
+        for (j = 0; j < 8; j++) {
+            crc = (crc >> 1) ^ (CRC32_POLY_REVERSED & -(crc & 1));
+        }
+        byte_table[i] = crc;
+    }
+
+    byte_table_ready = 1;
+}
+
+uint32_t crc32_nibble(uint32_t crc, const void *data, size_t len)
+{
+    const uint8_t *p = (const uint8_t *)data;
+
+    crc = ~crc;
+    while (len-- > 0) {
+        crc ^= *p++;
+        crc = (crc >> 4) ^ nibble_table[crc & 0x0f];
+        crc = (crc >> 4) ^ nibble_table[crc & 0x0f];
+    }
+
+    return ~crc;
+}
+
+uint32_t crc32_table(uint32_t crc, const void *data, size_t len)
+{
+    const uint8_t *p = (const uint8_t *)data;
+
+    if (!byte_table_ready) {
+        byte_table_init();
+    }
+
+    crc = ~crc;
+    while (len-- > 0) {
+        crc = (crc >> 8) ^ byte_table[(crc ^ *p++) & 0xff];
+    }
+
+    return ~crc;
+}
+
+static uint32_t bit_reverse(uint32_t x)
+{
+    x = ((x >> 1) & 0x55555555) | ((x & 0x55555555) << 1);
+    x = ((x >> 2) & 0x33333333) | ((x & 0x33333333) << 2);
+    x = ((x >> 4) & 0x0f0f0f0f) | ((x & 0x0f0f0f0f) << 4);
+    x = ((x >> 8) & 0x00ff00ff) | ((x & 0x00ff00ff) << 8);
+    return (x >> 16) | (x << 16);
+}
+
+uint32_t crc32_stm32_seed_word(uint32_t crc)
+{
+    /* State the peripheral must be in, MSB first. */
+    uint32_t state = bit_reverse(~crc);
+    int i;
+
+    /* Undo 32 steps of the MSB first shift register. A step shifts left and
+     * xors the polynomial if a 1 was shifted out, which sets bit 0 because the
+     * polynomial is odd. */
+    for (i = 0; i < 32; i++) {
+        if (state & 1) {
+            state = ((state ^ CRC32_POLY) >> 1) | 0x80000000;
+        } else {
+            state >>= 1;
+        }
+    }
+
+    /* The peripheral xors the input word with its reset state before
+     * shifting it. */
+    return state ^ 0xffffffff;
+}
+
+__attribute__((weak))
+uint32_t crc32_fast(uint32_t crc, const void *data, size_t len)
+{
+    return crc32_table(crc, data, len);
+}
@@ -0,0 +1,42 @@
+#ifndef CRC32_FAST_H
+#define CRC32_FAST_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** CRC32 of the given buffer, compatible with crc32() from the crc module.
+ *
+ * The crc argument is the CRC of the preceding data, which allows computing a
+ * CRC in several passes, or a custom initial value.
+ *
+ * Uses the CRC peripheral on target and a byte table on the host.
+ */
+uint32_t crc32_fast(uint32_t crc, const void *data, size_t len);
+
+/** Software implementation using a 16 entries table, processing 4 bits at a
+ * time. Slower than crc32_table() but only needs 64 bytes of flash. */
+uint32_t crc32_nibble(uint32_t crc, const void *data, size_t len);
+
+/** Software implementation using a 256 entries table, processing a byte at a
+ * time. */
+uint32_t crc32_table(uint32_t crc, const void *data, size_t len);
+
+/** Returns the value to write to the data register of a freshly reset STM32
+ * CRC peripheral so that its state corresponds to having computed the given
+ * crc.
+ *
+ * The peripheral always starts from 0xffffffff, so this is how a crc argument
+ * other than 0 is supported. Data words must then be written bit reversed, see
+ * crc32_fast_stm32.c.
+ */
+uint32_t crc32_stm32_seed_word(uint32_t crc);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CRC32_FAST_H */
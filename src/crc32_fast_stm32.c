@@ -0,0 +1,54 @@
+#include <string.h>
+#include <ch.h>
+#include <hal.h>
+#include "crc32_fast.h"
+
+/* The STM32F4 CRC unit computes the same polynomial as zlib, but MSB first,
+ * on 32 bit words, from a fixed 0xffffffff reset value and without final
+ * inversion. Input words are bit reversed to match the LSB first convention
+ * and the result is reversed and inverted back.
+ *
+ * DMA cannot be used because of the per word bit reversal. Writing words from
+ * the CPU keeps up with the unit anyway, which needs 4 AHB cycles per word.
+ */
+
+static MUTEX_DECL(crc_lock);
+static bool crc_clock_enabled = false;
+
+uint32_t crc32_fast(uint32_t crc, const void *data, size_t len)
+{
+    const uint8_t *p = (const uint8_t *)data;
+    size_t words = len / sizeof(uint32_t);
+    uint32_t word;
+
+    /* Not worth the setup for a few bytes. */
+    if (words < 2) {
+        return crc32_nibble(crc, data, len);
+    }
+
+    chMtxLock(&crc_lock);
+
+    if (!crc_clock_enabled) {
+        rccEnableAHB1(RCC_AHB1ENR_CRCEN, FALSE);
+        crc_clock_enabled = true;
+    }
+
+    CRC->CR = CRC_CR_RESET;
+
+    if (crc != 0) {
+        CRC->DR = crc32_stm32_seed_word(crc);
+    }
+
+    while (words-- > 0) {
+        memcpy(&word, p, sizeof(word));
+        CRC->DR = __RBIT(word);
+        p += sizeof(word);
+    }
+
+    crc = ~__RBIT(CRC->DR);
+
+    chMtxUnlock(&crc_lock);
+
+    /* Remaining bytes are done in software. */
+    return crc32_nibble(crc, p, len % sizeof(uint32_t));
+}
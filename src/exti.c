@@ -5,19 +5,33 @@
 
 event_source_t exti_events;
 
+static volatile unsigned mpu6000_watermark = 1;
+static unsigned mpu6000_int_count;
+
 static void gpio_exti_callback(EXTDriver *extp, expchannel_t channel)
 {
     (void)extp;
     if (channel == GPIOF_IMU_INT) {  // Channel MPU6000
+        /* Only wake up the IMU thread once enough samples are available. */
+        if (++mpu6000_int_count < mpu6000_watermark) {
+            return;
+        }
+        mpu6000_int_count = 0;
+
         chSysLockFromISR();
         chEvtBroadcastFlagsI(&exti_events, EXTI_EVENT_MPU6000_INT);
         chSysUnlockFromISR();
+    } else if (channel == GPIOF_SD_DETECT) {
+        /* The contacts bounce, the SD card thread filters it. */
+        chSysLockFromISR();
+        chEvtBroadcastFlagsI(&exti_events, EXTI_EVENT_SD_DETECT);
+        chSysUnlockFromISR();
     }
 }
 
 static const EXTConfig extcfg = {
     {
-        {EXT_CH_MODE_DISABLED, NULL},
+        {EXT_CH_MODE_BOTH_EDGES | EXT_CH_MODE_AUTOSTART | EXT_MODE_GPIOF, gpio_exti_callback}, // SD card detect
         {EXT_CH_MODE_DISABLED, NULL},
         {EXT_CH_MODE_DISABLED, NULL},
         {EXT_CH_MODE_DISABLED, NULL},
@@ -43,6 +57,14 @@ static const EXTConfig extcfg = {
     }
 };
 
+void exti_set_mpu6000_watermark(unsigned samples)
+{
+    if (samples == 0) {
+        samples = 1;
+    }
+    mpu6000_watermark = samples;
+}
+
 void exti_start(void)
 {
     chEvtObjectInit(&exti_events);
@@ -6,12 +6,21 @@ extern "C" {
 #endif
 
 #define EXTI_EVENT_MPU6000_INT     1
+#define EXTI_EVENT_SD_DETECT       2
 
 extern event_source_t exti_events;
 
 /** Starts the external interrupt processing service. */
 void exti_start(void);
 
+/** Only signals EXTI_EVENT_MPU6000_INT once every given number of data ready
+ * interrupts.
+ *
+ * The MPU6000 has no FIFO watermark interrupt, so counting data ready pulses
+ * is used instead to wake up the reader when a batch is in the FIFO.
+ */
+void exti_set_mpu6000_watermark(unsigned samples);
+
 
 #ifdef __cplusplus
 }
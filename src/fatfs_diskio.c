@@ -9,6 +9,7 @@
 #include "ffconf.h"
 #include "diskio.h"
 #include "sdcard.h"
+#include "sector_cache.h"
 
 #if HAL_USE_MMC_SPI && HAL_USE_SDC
 #error "cannot specify both MMC_SPI and SDC drivers"
@@ -26,6 +27,33 @@ extern SDCDriver SDCD1;
 extern RTCDriver RTCD1;
 #endif
 
+#if HAL_USE_SDC
+/* Read cache of the card, sized for WAV streaming: a miss reads 4kB ahead. */
+#define SDCARD_CACHE_LINES  2
+#define SDCARD_CACHE_WINDOW 8
+
+sector_cache_t sdcard_cache;
+static sector_cache_line_t sdcard_cache_lines[SDCARD_CACHE_LINES];
+static uint8_t sdcard_cache_buffer[SDCARD_CACHE_LINES * SDCARD_CACHE_WINDOW * MMCSD_BLOCK_SIZE]
+__attribute__((aligned(4)));
+
+static bool sdcard_cache_read(void *dev, uint32_t sector, uint8_t *buf, uint32_t count)
+{
+    return sdcRead((SDCDriver *)dev, sector, buf, count) == HAL_SUCCESS;
+}
+
+/* Called on every mount, the card might have changed. */
+static void sdcard_cache_reset(void)
+{
+    if (sdcard_cache.read == NULL) {
+        sector_cache_init(&sdcard_cache, sdcard_cache_lines, SDCARD_CACHE_LINES,
+                          sdcard_cache_buffer, SDCARD_CACHE_WINDOW, sdcard_cache_read, &SDCD1);
+    }
+    sector_cache_invalidate_all(&sdcard_cache);
+    sector_cache_set_sector_count(&sdcard_cache, mmcsdGetCardCapacity(&SDCD1));
+}
+#endif
+
 /*-----------------------------------------------------------------------*/
 /* Correspondence between physical drive number and physical drive.      */
 
@@ -66,6 +94,9 @@ DSTATUS disk_initialize(
             if (sdcIsWriteProtected(&SDCD1)) {
                 stat |=  STA_PROTECT;
             }
+            if (!(stat & STA_NOINIT)) {
+                sdcard_cache_reset();
+            }
             return stat;
 #endif
     }
@@ -150,7 +181,7 @@ DRESULT disk_read(
             if (blkGetDriverState(&SDCD1) != BLK_READY) {
                 return RES_NOTRDY;
             }
-            if (sdcRead(&SDCD1, sector, buff, count)) {
+            if (!sector_cache_read(&sdcard_cache, buff, sector, count)) {
                 return RES_ERROR;
             }
             sdcard_activity();
@@ -202,6 +233,7 @@ DRESULT disk_write(
             if (blkGetDriverState(&SDCD1) != BLK_READY) {
                 return RES_NOTRDY;
             }
+            sector_cache_invalidate(&sdcard_cache, sector, count);
             if (sdcWrite(&SDCD1, sector, buff, count)) {
                 return RES_ERROR;
             }
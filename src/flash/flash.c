@@ -1,6 +1,8 @@
 #include <stdint.h>
 #include <stddef.h>
+#include <string.h>
 #include "flash.h"
+#include "flash_program.h"
 
 /* Flash registers. Copied here to avoid dependencies on either libopencm3 or
  * ChibiOS. */
@@ -16,13 +18,19 @@
 #define FLASH_KEY2 0xCDEF89AB
 #define FLASH_CR_SNB_POS 3
 #define FLASH_CR_LOCK           (1 << 31)
-#define FLASH_CR_PSIZE          ((uint32_t)0x03 << 8)
+#define FLASH_CR_PSIZE_POS      8
+#define FLASH_CR_PSIZE          ((uint32_t)0x03 << FLASH_CR_PSIZE_POS)
 #define FLASH_CR_PG             (1 << 0)
 #define FLASH_CR_SNB            ((uint32_t)0x000000F8)
 #define FLASH_CR_SER            ((uint32_t)0x00000002)
 #define FLASH_CR_STRT           ((uint32_t)0x00010000)
+#define FLASH_CR_EOPIE          (1 << 24)
 
 #define FLASH_SR_BSY            (1 << 16)
+#define FLASH_SR_EOP            (1 << 0)
+
+/* Called while waiting for long operations, NULL to busy wait. */
+static void (*flash_wait_hook)(void) = NULL;
 
 uint8_t flash_addr_to_sector(void *p)
 {
@@ -58,6 +66,20 @@ void flash_unlock(void)
     FLASH_KEYR = FLASH_KEY2;
 }
 
+/* Safe default until the supply voltage is known. */
+static flash_psize_t flash_psize = FLASH_PSIZE_X8;
+
+void flash_set_supply_voltage(uint32_t millivolts)
+{
+    flash_psize = flash_psize_for_voltage(millivolts);
+}
+
+static void flash_set_parallelism(flash_psize_t psize)
+{
+    FLASH_CR &= ~FLASH_CR_PSIZE;
+    FLASH_CR |= ((uint32_t)psize << FLASH_CR_PSIZE_POS) & FLASH_CR_PSIZE;
+}
+
 static void flash_set_parallelism_8x(void)
 {
     // parallelism 8x, one byte write/erase
@@ -70,6 +92,27 @@ static void flash_wait_while_busy(void)
     }
 }
 
+void flash_set_wait_hook(void (*hook)(void))
+{
+    flash_wait_hook = hook;
+}
+
+void flash_clear_end_of_operation(void)
+{
+    // flag is cleared by writing 1
+    FLASH_SR = FLASH_SR_EOP;
+}
+
+/* Sector erases take up to seconds, let other threads run meanwhile. */
+static void flash_wait_while_erasing(void)
+{
+    while ((FLASH_SR & FLASH_SR_BSY) != 0) {
+        if (flash_wait_hook != NULL) {
+            flash_wait_hook();
+        }
+    }
+}
+
 static void flash_write_byte(uint8_t *flash, uint8_t byte)
 {
     // activate flash programming
@@ -80,20 +123,75 @@ static void flash_write_byte(uint8_t *flash, uint8_t byte)
     flash_wait_while_busy();
 }
 
-void flash_write(void *addr, const void *data, size_t len)
+static void flash_write_halfword(uint16_t *flash, uint16_t halfword)
+{
+    FLASH_CR |= FLASH_CR_PG;
+    *flash = halfword;
+
+    flash_wait_while_busy();
+}
+
+static void flash_write_word(uint32_t *flash, uint32_t word)
 {
+    FLASH_CR |= FLASH_CR_PG;
+    *flash = word;
+
     flash_wait_while_busy();
+}
 
-    /* Note:
-     * This is a possible point of optimization of energy/time consumption
-     * Different parallelism size of erase and write operations can be cosen
-     * depending on the supply voltage. */
-    flash_set_parallelism_8x();
+void flash_write(void *addr, const void *data, size_t len)
+{
+    flash_program_split_t split;
+    flash_psize_t psize = flash_psize;
+    size_t i;
+
+    /* x64 needs an external programming voltage. */
+    if (psize > FLASH_PSIZE_X32) {
+        psize = FLASH_PSIZE_X32;
+    }
+
+    flash_program_split((uintptr_t)addr, len, psize, &split);
+
+    flash_wait_while_busy();
 
     uint8_t *r = (uint8_t *)data;
     uint8_t *w = (uint8_t *)addr;
 
-    while (len-- > 0) {
+    /* Unaligned head, one byte at a time. */
+    flash_set_parallelism_8x();
+    for (i = 0; i < split.head; i++) {
+        flash_write_byte(w++, *r++);
+    }
+
+    /* Aligned body, one word at a time. The source buffer can be unaligned. */
+    if (split.body > 0) {
+        flash_set_parallelism(psize);
+        if (psize == FLASH_PSIZE_X32) {
+            for (i = 0; i < split.body; i += sizeof(uint32_t)) {
+                uint32_t word;
+                memcpy(&word, r, sizeof(word));
+                flash_write_word((uint32_t *)w, word);
+                r += sizeof(word);
+                w += sizeof(word);
+            }
+        } else if (psize == FLASH_PSIZE_X16) {
+            for (i = 0; i < split.body; i += sizeof(uint16_t)) {
+                uint16_t halfword;
+                memcpy(&halfword, r, sizeof(halfword));
+                flash_write_halfword((uint16_t *)w, halfword);
+                r += sizeof(halfword);
+                w += sizeof(halfword);
+            }
+        } else {
+            for (i = 0; i < split.body; i++) {
+                flash_write_byte(w++, *r++);
+            }
+        }
+        flash_set_parallelism_8x();
+    }
+
+    /* Unaligned tail, one byte at a time. */
+    for (i = 0; i < split.tail; i++) {
         flash_write_byte(w++, *r++);
     }
 
@@ -110,14 +208,21 @@ void flash_sector_erase(void *addr)
 
 void flash_sector_erase_number(uint8_t sector)
 {
-    flash_set_parallelism_8x();
+    /* Erase time shrinks with parallelism. */
+    flash_set_parallelism(flash_psize > FLASH_PSIZE_X32 ? FLASH_PSIZE_X32 : flash_psize);
 
     flash_wait_while_busy();
 
     FLASH_CR &= ~FLASH_CR_SNB;
     FLASH_CR |= (sector << FLASH_CR_SNB_POS) & FLASH_CR_SNB;
     FLASH_CR |= FLASH_CR_SER;
+    if (flash_wait_hook != NULL) {
+        flash_clear_end_of_operation();
+        FLASH_CR |= FLASH_CR_EOPIE;
+    }
     FLASH_CR |= FLASH_CR_STRT;
 
-    flash_wait_while_busy();
+    flash_wait_while_erasing();
+
+    FLASH_CR &= ~(FLASH_CR_EOPIE | FLASH_CR_SER);
 }
@@ -2,6 +2,7 @@
 #define FLASH_H
 
 #include <stddef.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -10,6 +11,11 @@ extern "C" {
 void flash_lock(void);
 void flash_unlock(void);
 
+/** Selects the widest program / erase parallelism allowed at the given MCU
+ * supply voltage. Until this is called, flash is programmed one byte at a time.
+ */
+void flash_set_supply_voltage(uint32_t millivolts);
+
 /* Write data of size len at addr.
  * Note: flash must be unlocket for this operation. */
 void flash_write(void *addr, const void *data, size_t len);
@@ -23,6 +29,17 @@ void flash_sector_erase(void *addr);
 uint8_t flash_addr_to_sector(void *p);
 void flash_sector_erase_number(uint8_t sector);
 
+/** Sets a function called repeatedly while waiting for a sector erase to
+ * complete, instead of busy waiting.
+ *
+ * When set, the end of operation interrupt is enabled during erases, so the
+ * hook can sleep until the flash interrupt fires.
+ */
+void flash_set_wait_hook(void (*hook)(void));
+
+/** Acknowledges the end of operation flag, to be called from the flash IRQ. */
+void flash_clear_end_of_operation(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,55 @@
+#include "flash_job.h"
+
+void flash_job_init(flash_job_t *job, flash_job_fn_t fn, void *arg,
+                    flash_job_done_cb_t done_cb, void *done_arg)
+{
+    job->fn = fn;
+    job->arg = arg;
+    job->done_cb = done_cb;
+    job->done_arg = done_arg;
+    job->done = false;
+    job->next = NULL;
+}
+
+void flash_job_queue_init(flash_job_queue_t *queue)
+{
+    queue->head = NULL;
+    queue->tail = NULL;
+}
+
+void flash_job_queue_push(flash_job_queue_t *queue, flash_job_t *job)
+{
+    job->next = NULL;
+
+    if (queue->tail != NULL) {
+        queue->tail->next = job;
+    } else {
+        queue->head = job;
+    }
+    queue->tail = job;
+}
+
+flash_job_t *flash_job_queue_pop(flash_job_queue_t *queue)
+{
+    flash_job_t *job = queue->head;
+
+    if (job != NULL) {
+        queue->head = job->next;
+        if (queue->head == NULL) {
+            queue->tail = NULL;
+        }
+        job->next = NULL;
+    }
+
+    return job;
+}
+
+void flash_job_run(flash_job_t *job)
+{
+    job->fn(job->arg);
+    job->done = true;
+
+    if (job->done_cb != NULL) {
+        job->done_cb(job, job->done_arg);
+    }
+}
@@ -0,0 +1,63 @@
+#ifndef FLASH_JOB_H
+#define FLASH_JOB_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct flash_job_s flash_job_t;
+
+/** Function doing the flash operations of a job. */
+typedef void (*flash_job_fn_t)(void *arg);
+
+/** Called once the job is done, from the thread servicing the queue. */
+typedef void (*flash_job_done_cb_t)(flash_job_t *job, void *arg);
+
+/** Flash operation waiting to be serviced.
+ *
+ * Jobs are owned by the submitter and must stay valid until they are done.
+ */
+struct flash_job_s {
+    flash_job_fn_t fn;
+    void *arg;
+    flash_job_done_cb_t done_cb;
+    void *done_arg;
+    volatile bool done;
+    flash_job_t *next;
+};
+
+/** FIFO of flash jobs. */
+typedef struct {
+    flash_job_t *head;
+    flash_job_t *tail;
+} flash_job_queue_t;
+
+/** Initializes a job running fn(arg), done_cb can be NULL. */
+void flash_job_init(flash_job_t *job, flash_job_fn_t fn, void *arg,
+                    flash_job_done_cb_t done_cb, void *done_arg);
+
+void flash_job_queue_init(flash_job_queue_t *queue);
+
+/** Appends a job at the end of the queue.
+ *
+ * @note Not thread safe, the caller is responsible for locking.
+ */
+void flash_job_queue_push(flash_job_queue_t *queue, flash_job_t *job);
+
+/** Removes the oldest job from the queue, returns NULL if it is empty.
+ *
+ * @note Not thread safe, the caller is responsible for locking.
+ */
+flash_job_t *flash_job_queue_pop(flash_job_queue_t *queue);
+
+/** Runs the job, marks it as done then calls its completion callback. */
+void flash_job_run(flash_job_t *job);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FLASH_JOB_H */
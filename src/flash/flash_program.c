@@ -0,0 +1,45 @@
+#include "flash_program.h"
+
+flash_psize_t flash_psize_for_voltage(uint32_t millivolts)
+{
+    /* Voltage ranges from the STM32F4 reference manual (RM0090, table 7). */
+    if (millivolts >= 2700) {
+        return FLASH_PSIZE_X32;
+    } else if (millivolts >= 2100) {
+        return FLASH_PSIZE_X16;
+    }
+    return FLASH_PSIZE_X8;
+}
+
+size_t flash_psize_width(flash_psize_t psize)
+{
+    return 1 << psize;
+}
+
+void flash_program_split(uintptr_t addr, size_t len, flash_psize_t psize,
+                         flash_program_split_t *split)
+{
+    size_t width = flash_psize_width(psize);
+    size_t misalignment = addr & (width - 1);
+
+    split->head = 0;
+    if (misalignment != 0) {
+        split->head = width - misalignment;
+    }
+
+    if (split->head >= len) {
+        split->head = len;
+        split->body = 0;
+        split->tail = 0;
+        return;
+    }
+
+    len -= split->head;
+    split->body = len - len % width;
+    split->tail = len % width;
+}
+
+size_t flash_program_operations(const flash_program_split_t *split, flash_psize_t psize)
+{
+    return split->head + split->body / flash_psize_width(psize) + split->tail;
+}
@@ -0,0 +1,47 @@
+#ifndef FLASH_PROGRAM_H
+#define FLASH_PROGRAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Program / erase parallelism, with the values of the FLASH_CR PSIZE field. */
+typedef enum {
+    FLASH_PSIZE_X8 = 0,
+    FLASH_PSIZE_X16 = 1,
+    FLASH_PSIZE_X32 = 2,
+    FLASH_PSIZE_X64 = 3,
+} flash_psize_t;
+
+/** Split of a write in byte programmed head and tail around a body programmed
+ * at full parallelism. */
+typedef struct {
+    size_t head; /**< Bytes before the first aligned word. */
+    size_t body; /**< Bytes programmed one word at a time. */
+    size_t tail; /**< Bytes after the last aligned word. */
+} flash_program_split_t;
+
+/** Returns the largest parallelism allowed at the given supply voltage.
+ *
+ * @note x64 requires an external programming voltage and is never returned.
+ */
+flash_psize_t flash_psize_for_voltage(uint32_t millivolts);
+
+/** Returns the number of bytes programmed at once with the given parallelism. */
+size_t flash_psize_width(flash_psize_t psize);
+
+/** Splits a write of len bytes at addr so that the body is word aligned. */
+void flash_program_split(uintptr_t addr, size_t len, flash_psize_t psize,
+                         flash_program_split_t *split);
+
+/** Returns the number of program operations required for the given split. */
+size_t flash_program_operations(const flash_program_split_t *split, flash_psize_t psize);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FLASH_PROGRAM_H */
@@ -0,0 +1,148 @@
+#include <ch.h>
+#include <hal.h>
+
+#include "flash.h"
+#include "flash_service.h"
+#include "config_journal.h"
+
+/* Below every sensor and control thread, so that a running save only uses
+ * idle CPU time. */
+#define FLASH_SERVICE_PRIO (LOWPRIO + 1)
+
+/* Upper bound on how long the erase wait sleeps if an interrupt was missed. */
+#define FLASH_ERASE_POLL_MS 10
+
+#define FLASH_IRQ_PRIORITY 12
+
+static flash_job_queue_t queue;
+static SEMAPHORE_DECL(pending_jobs, 0);
+static BSEMAPHORE_DECL(end_of_operation, true);
+static thread_t *flash_thread;
+
+CH_IRQ_HANDLER(Vector50) /* FLASH_IRQn */
+{
+    CH_IRQ_PROLOGUE();
+
+    flash_clear_end_of_operation();
+
+    chSysLockFromISR();
+    chBSemSignalI(&end_of_operation);
+    chSysUnlockFromISR();
+
+    CH_IRQ_EPILOGUE();
+}
+
+static void flash_wait_for_interrupt(void)
+{
+    chBSemWaitTimeout(&end_of_operation, MS2ST(FLASH_ERASE_POLL_MS));
+}
+
+static THD_FUNCTION(flash_service_thd, arg)
+{
+    (void) arg;
+    chRegSetThreadName(__FUNCTION__);
+
+    while (true) {
+        flash_job_t *job;
+
+        chSemWait(&pending_jobs);
+
+        chSysLock();
+        job = flash_job_queue_pop(&queue);
+        chSysUnlock();
+
+        if (job != NULL) {
+            flash_job_run(job);
+        }
+    }
+}
+
+void flash_service_start(void)
+{
+    static THD_WORKING_AREA(flash_service_thd_wa, 2048);
+
+    flash_job_queue_init(&queue);
+
+    flash_set_wait_hook(flash_wait_for_interrupt);
+    nvicEnableVector(FLASH_IRQn, FLASH_IRQ_PRIORITY);
+
+    flash_thread = chThdCreateStatic(flash_service_thd_wa, sizeof(flash_service_thd_wa),
+                                     FLASH_SERVICE_PRIO, flash_service_thd, NULL);
+}
+
+void flash_service_submit(flash_job_t *job)
+{
+    chSysLock();
+    flash_job_queue_push(&queue, job);
+    chSemSignalI(&pending_jobs);
+    chSchRescheduleS();
+    chSysUnlock();
+}
+
+static void signal_done(flash_job_t *job, void *arg)
+{
+    (void) job;
+    chBSemSignal((binary_semaphore_t *)arg);
+}
+
+void flash_service_run(flash_job_fn_t fn, void *arg)
+{
+    binary_semaphore_t done;
+    flash_job_t job;
+
+    if (chThdGetSelfX() == flash_thread) {
+        fn(arg);
+        return;
+    }
+
+    chBSemObjectInit(&done, true);
+    flash_job_init(&job, fn, arg, signal_done, &done);
+    flash_service_submit(&job);
+    chBSemWait(&done);
+}
+
+static void config_erase_job(void *arg)
+{
+    config_journal_erase((config_journal_t *)arg);
+}
+
+void flash_service_config_erase(config_journal_t *journal)
+{
+    flash_service_run(config_erase_job, journal);
+}
+
+static flash_job_t next_sector_job;
+static bool next_sector_job_queued;
+
+static void next_sector_erase_job(void *arg)
+{
+    config_journal_erase_next_sector((config_journal_t *)arg);
+    next_sector_job_queued = false;
+}
+
+struct config_save_args {
+    config_journal_t *journal;
+    parameter_namespace_t *ns;
+    bool success;
+};
+
+static void config_save_job(void *arg)
+{
+    struct config_save_args *args = (struct config_save_args *)arg;
+
+    args->success = config_journal_save(args->journal, args->ns);
+
+    /* Only touched from the flash thread, no locking needed. */
+    if (!next_sector_job_queued && config_journal_next_sector_needs_erase(args->journal)) {
+        next_sector_job_queued = true;
+        flash_job_init(&next_sector_job, next_sector_erase_job, args->journal, NULL, NULL);
+        flash_service_submit(&next_sector_job);
+    }
+}
+
+bool flash_service_config_save(config_journal_t *journal, parameter_namespace_t *ns)
+{
+    struct config_save_args args = {journal, ns, false};
+    flash_service_run(config_save_job, &args);
+    return args.success;
+}
@@ -0,0 +1,44 @@
+#ifndef FLASH_SERVICE_H
+#define FLASH_SERVICE_H
+
+#include <stddef.h>
+#include "flash_job.h"
+#include "parameter/parameter.h"
+#include "config_journal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Starts the low priority thread doing all the flash erase and write jobs. */
+void flash_service_start(void);
+
+/** Queues a job and returns immediately.
+ *
+ * The job's completion callback is called from the flash thread once it is
+ * done, and job->done becomes true.
+ */
+void flash_service_submit(flash_job_t *job);
+
+/** Queues fn(arg) and sleeps until the flash thread has run it.
+ *
+ * Can be called from the flash thread itself, in which case fn is run
+ * directly.
+ */
+void flash_service_run(flash_job_fn_t fn, void *arg);
+
+/** Erases the config journal from the flash thread. */
+void flash_service_config_erase(config_journal_t *journal);
+
+/** Saves the parameter tree from the flash thread, see config_journal_save().
+ *
+ * When the active journal sector gets full, the erase of the next one is
+ * queued after the save, so that it does not delay the caller.
+ */
+bool flash_service_config_save(config_journal_t *journal, parameter_namespace_t *ns);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FLASH_SERVICE_H */
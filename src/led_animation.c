@@ -0,0 +1,152 @@
+#include <string.h>
+#include "led_animation.h"
+
+#define ARRAY_LEN(a) (sizeof(a) / sizeof(a[0]))
+
+static const led_keyframe_t breathing_keyframes[] = {
+    {0, 0},
+    {1000, LED_ANIMATION_LEVEL_MAX},
+};
+
+static const led_keyframe_t chase_keyframes[] = {
+    {0, LED_ANIMATION_LEVEL_MAX},
+    {300, 0},
+    {1199, 0},
+};
+
+static const led_keyframe_t blink_keyframes[] = {
+    {0, LED_ANIMATION_LEVEL_MAX},
+    {249, LED_ANIMATION_LEVEL_MAX},
+    {250, 0},
+    {499, 0},
+};
+
+static const led_animation_desc_t builtin_animations[] = {
+    [LED_ANIMATION_BREATHING] = {
+        .keyframes = breathing_keyframes,
+        .keyframe_count = ARRAY_LEN(breathing_keyframes),
+        .period_ms = 2000,
+    },
+    [LED_ANIMATION_CHASE] = {
+        .keyframes = chase_keyframes,
+        .keyframe_count = ARRAY_LEN(chase_keyframes),
+        .period_ms = 1200,
+        /* One LED lights up every 100 ms, going around the robot. */
+        .phase_ms = {0, 100, 200, 300, 400, 500, 600, 700, 800, 900, 1000, 1100},
+    },
+    [LED_ANIMATION_BLINK] = {
+        .keyframes = blink_keyframes,
+        .keyframe_count = ARRAY_LEN(blink_keyframes),
+        .period_ms = 500,
+    },
+};
+
+static const char *builtin_names[] = {
+    [LED_ANIMATION_NONE] = "stop",
+    [LED_ANIMATION_BREATHING] = "breathing",
+    [LED_ANIMATION_CHASE] = "chase",
+    [LED_ANIMATION_BLINK] = "blink",
+};
+
+/** Evaluates the keyframe curve at the given time, using integer arithmetic only. */
+static uint8_t curve_level(const led_animation_desc_t *desc, uint32_t t)
+{
+    size_t i;
+    uint32_t t0, t1;
+    int32_t l0, l1;
+
+    /* Find the last keyframe before t. */
+    for (i = 0; i + 1 < desc->keyframe_count; i++) {
+        if (desc->keyframes[i + 1].time_ms > t) {
+            break;
+        }
+    }
+
+    t0 = desc->keyframes[i].time_ms;
+    l0 = desc->keyframes[i].level;
+
+    /* After the last keyframe we go back to the first one. */
+    if (i + 1 < desc->keyframe_count) {
+        t1 = desc->keyframes[i + 1].time_ms;
+        l1 = desc->keyframes[i + 1].level;
+    } else {
+        t1 = desc->period_ms;
+        l1 = desc->keyframes[0].level;
+    }
+
+    if (t1 <= t0 || t < t0) {
+        return l0;
+    }
+
+    return l0 + (l1 - l0) * (int32_t)(t - t0) / (int32_t)(t1 - t0);
+}
+
+void led_animation_init(led_animation_t *anim, const led_animation_desc_t *desc)
+{
+    int i;
+
+    memset(anim, 0, sizeof(led_animation_t));
+
+    if (desc == NULL || desc->keyframe_count == 0 || desc->period_ms == 0) {
+        return;
+    }
+
+    anim->period_ms = desc->period_ms;
+
+    for (i = 0; i < LED_ANIMATION_TABLE_SIZE; i++) {
+        uint32_t t = (uint32_t)i * desc->period_ms / LED_ANIMATION_TABLE_SIZE;
+        anim->table[i] = curve_level(desc, t);
+    }
+
+    for (i = 0; i < BODY_LED_COUNT; i++) {
+        anim->phase_ms[i] = desc->phase_ms[i] % desc->period_ms;
+    }
+}
+
+void led_animation_render(const led_animation_t *anim, uint32_t time_ms, uint8_t *levels)
+{
+    int i;
+
+    if (anim->period_ms == 0) {
+        memset(levels, 0, BODY_LED_COUNT);
+        return;
+    }
+
+    time_ms %= anim->period_ms;
+
+    for (i = 0; i < BODY_LED_COUNT; i++) {
+        uint32_t t = (time_ms + anim->period_ms - anim->phase_ms[i]) % anim->period_ms;
+
+        /* Table position in 24.8 fixed point. */
+        uint32_t pos = (t * LED_ANIMATION_TABLE_SIZE * 256) / anim->period_ms;
+        uint32_t index = pos >> 8;
+        int32_t frac = pos & 0xff;
+
+        int32_t a = anim->table[index];
+        int32_t b = anim->table[(index + 1) % LED_ANIMATION_TABLE_SIZE];
+
+        levels[i] = a + (((b - a) * frac) >> 8);
+    }
+}
+
+const led_animation_desc_t *led_animation_builtin(int id)
+{
+    if (id <= LED_ANIMATION_NONE || id >= LED_ANIMATION_BUILTIN_COUNT) {
+        return NULL;
+    }
+
+    return &builtin_animations[id];
+}
+
+int led_animation_find(const char *name)
+{
+    int i;
+
+    for (i = 0; i < LED_ANIMATION_BUILTIN_COUNT; i++) {
+        if (!strcmp(name, builtin_names[i])) {
+            return i;
+        }
+    }
+
+    return -1;
+}
@@ -0,0 +1,74 @@
+#ifndef LED_ANIMATION_H
+#define LED_ANIMATION_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+#include "body_leds.h"
+
+/** Number of entries in the precomputed brightness table of an animation. */
+#define LED_ANIMATION_TABLE_SIZE 64
+
+/** Brightness level corresponding to a fully lit LED. */
+#define LED_ANIMATION_LEVEL_MAX 255
+
+/** Builtin animations, usable from the shell and from Aseba. */
+enum {
+    LED_ANIMATION_NONE = 0,
+    LED_ANIMATION_BREATHING,
+    LED_ANIMATION_CHASE,
+    LED_ANIMATION_BLINK,
+    LED_ANIMATION_BUILTIN_COUNT
+};
+
+/** A point of the brightness curve. */
+typedef struct {
+    uint16_t time_ms; /**< Position in the period. */
+    uint8_t level; /**< Brightness, between 0 and LED_ANIMATION_LEVEL_MAX. */
+} led_keyframe_t;
+
+/** Compact description of an animation.
+ *
+ * The brightness curve is linearly interpolated between keyframes. After the
+ * last keyframe it goes back to the level of the first one at the end of the
+ * period, which makes every animation loop seamlessly.
+ */
+typedef struct led_animation_desc_s {
+    const led_keyframe_t *keyframes; /**< Sorted by time, the first one at 0. */
+    size_t keyframe_count;
+    uint16_t period_ms;
+    uint16_t phase_ms[BODY_LED_COUNT]; /**< Delay of each LED on the curve. */
+} led_animation_desc_t;
+
+/** Animation ready to be rendered. */
+typedef struct {
+    uint8_t table[LED_ANIMATION_TABLE_SIZE];
+    uint32_t period_ms;
+    uint32_t phase_ms[BODY_LED_COUNT];
+} led_animation_t;
+
+/** Precomputes the brightness table of the given animation descriptor. */
+void led_animation_init(led_animation_t *anim, const led_animation_desc_t *desc);
+
+/** Computes the brightness of every LED at the given time.
+ *
+ * @param [in] anim Animation, initialized with led_animation_init.
+ * @param [in] time_ms Time elapsed since the start of the animation.
+ * @param [out] levels Array of BODY_LED_COUNT brightness levels.
+ */
+void led_animation_render(const led_animation_t *anim, uint32_t time_ms, uint8_t *levels);
+
+/** Returns the descriptor of a builtin animation, NULL if it does not exist. */
+const led_animation_desc_t *led_animation_builtin(int id);
+
+/** Returns the id of the builtin animation with the given name, -1 if not found. */
+int led_animation_find(const char *name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LED_ANIMATION_H */
@@ -20,12 +20,15 @@
 #include "sensors/range.h"
 #include "sensors/encoder.h"
 #include "sensors/battery_level.h"
-#include "config_flash_storage.h"
+#include "config_journal.h"
+#include "flash/flash.h"
+#include "flash/flash_service.h"
 #include "sdcard.h"
 #include "sensors/motor_current.h"
 #include "body_leds.h"
 #include "motor_pid_thread.h"
 #include "audio/audio_thread.h"
+#include "blackbox/blackbox_thread.h"
 
 #include "aseba_vm/aseba_node.h"
 #include "aseba_vm/skel_user.h"
@@ -33,6 +36,7 @@
 
 #include "memory_protection.h"
 #include "battery_protection.h"
+#include "boot.h"
 
 messagebus_t bus;
 MUTEX_DECL(bus_lock);
@@ -40,6 +44,22 @@ CONDVAR_DECL(bus_condvar);
 
 parameter_namespace_t parameter_root, aseba_ns;
 
+/* Size of the flash sectors holding the config, see the linker script. */
+#define CONFIG_SECTOR_SIZE (128 * 1024)
+
+/* Upper bound on the number of parameters whose changes are tracked, so that
+ * saves only write the changed ones. */
+#define CONFIG_TRACKED_PARAMETERS 256
+
+/* Upper bound on the number of parameters in the path index. */
+#define PARAMETER_INDEX_SIZE 256
+
+config_journal_t config_journal;
+parameter_index_t parameter_index;
+static parameter_index_entry_t parameter_index_entries[PARAMETER_INDEX_SIZE];
+static config_delta_t config_delta;
+static config_delta_entry_t config_delta_entries[CONFIG_TRACKED_PARAMETERS];
+
 static THD_FUNCTION(blinker_thd, arg)
 {
     (void)arg;
@@ -78,6 +98,29 @@ void i2c_start(void)
     i2cStart(&I2CD1, &i2c_cfg);
 }
 
+static void aseba_parameters_start(void)
+{
+    parameter_namespace_declare(&aseba_ns, &parameter_root, "aseba");
+    aseba_declare_parameters(&aseba_ns);
+}
+
+static void config_start(void)
+{
+    /* Every parameter is declared by now. */
+    parameter_index_build(&parameter_index);
+
+    /* Load parameter tree from flash. */
+    config_journal_load(&config_journal, &parameter_root);
+}
+
+static void aseba_start(void)
+{
+    /* Initialise Aseba node (CAN and VM). */
+    aseba_vm_init();
+    aseba_can_start(&vmState);
+    aseba_vm_start();
+}
+
 /** Late init hook, called before c++ static constructors. */
 void __late_init(void)
 {
@@ -88,6 +131,49 @@ void __late_init(void)
     chSysInit();
 }
 
+/* Steps run in this order unless they have to wait for their
+ * requirements. The ones needed for driving come first. */
+static boot_step_t boot_steps[] = {
+    {.name = "i2c", .run = i2c_start},
+    {.name = "adc", .run = adc_start},
+#ifdef USE_SERIAL_IP
+    {.name = "ip", .run = ip_start},
+#else
+    {.name = "shell", .run = shell_start},
+#endif
+    {.name = "blinker", .run = blinker_start},
+    {.name = "battery_level", .run = battery_level_start,
+     .after = BOOT_LIST("adc"), .done_topic = "/battery_level"},
+    {.name = "battery_protection", .run = battery_protection_start,
+     .topics = BOOT_LIST("/battery_level")},
+    {.name = "motor_pwm", .run = motor_pwm_start},
+    {.name = "encoders", .run = encoder_start, .done_topic = "/wheel_velocities"},
+    {.name = "motor_current", .run = motor_current_start,
+     .after = BOOT_LIST("adc"), .done_topic = "/motors/current"},
+    {.name = "motor_pid", .run = motor_pid_start,
+     .after = BOOT_LIST("motor_pwm"),
+     .topics = BOOT_LIST("/motors/current", "/wheel_velocities", "/wheel_pos",
+                         "/battery_level"),
+     .done_topic = "/motors/setpoint"},
+    {.name = "body_leds", .run = body_leds_start},
+    {.name = "exti", .run = exti_start},
+    {.name = "imu", .run = imu_start, .after = BOOT_LIST("i2c", "exti"),
+     .done_topic = "/imu"},
+    {.name = "range", .run = range_start, .after = BOOT_LIST("i2c"), .done_topic = "/range"},
+    {.name = "proximity", .run = proximity_start, .after = BOOT_LIST("adc"),
+     .done_topic = "/proximity"},
+    {.name = "aseba_parameters", .run = aseba_parameters_start},
+    {.name = "blackbox", .run = blackbox_start},
+    /* Waits for every step declaring parameters. */
+    {.name = "config", .run = config_start,
+     .after = BOOT_LIST("motor_pwm", "encoders", "motor_current", "motor_pid", "imu",
+                        "aseba_parameters", "blackbox")},
+    {.name = "aseba", .run = aseba_start, .after = BOOT_LIST("config")},
+    {.name = "sdcard", .run = sdcard_start, .after = BOOT_LIST("aseba", "exti"),
+     .done_topic = "/sdcard/state"},
+    {.name = "audio", .run = audio_start, .after = BOOT_LIST("sdcard")},
+};
+
 int main(void)
 {
     usb_start();
@@ -96,59 +182,31 @@ int main(void)
     messagebus_init(&bus, &bus_lock, &bus_condvar);
 
     parameter_namespace_declare(&parameter_root, NULL, "");
+    parameter_index_init(&parameter_index, &parameter_root, parameter_index_entries,
+                         PARAMETER_INDEX_SIZE);
 
-    chprintf((BaseSequentialStream*)&SDU1, "boot");
-
-    i2c_start();
-
-    adc_start();
-
-    battery_level_start();
-    battery_protection_start();
-
-    motor_pwm_start();
-    encoder_start();
-
-#ifdef USE_SERIAL_IP
-    ip_start();
-#else
-    shell_start();
-#endif
-    blinker_start();
-    body_leds_start();
-
-    range_start();
-
-    proximity_start();
-    imu_start();
-    exti_start();
-    motor_current_start();
-    motor_pid_start();
-
-    // Initialise aseba parameters
-    parameter_namespace_declare(&aseba_ns, &parameter_root, "aseba");
-    aseba_declare_parameters(&aseba_ns);
+    /* STM32_VDD is given in hundredths of volt. */
+    flash_set_supply_voltage(STM32_VDD * 10);
+    flash_service_start();
 
-    /* Give enough time to make sure all services booted. */
-    chThdSleepMilliseconds(100);
+    /* Older firmwares kept the bytecode in the first sector of the config
+     * journal, which is erased by its first rotation. */
+    extern uint8_t _config_start, _config_end;
+    aseba_vm_migrate_legacy_bytecode(&_config_start);
 
-    /* Load parameter tree from flash. */
-    extern uint32_t _config_start;
-    config_load(&parameter_root, &_config_start);
+    config_journal_init(&config_journal, &_config_start, CONFIG_SECTOR_SIZE,
+                        (&_config_end - &_config_start) / CONFIG_SECTOR_SIZE);
+    config_delta_init(&config_delta, config_delta_entries, CONFIG_TRACKED_PARAMETERS);
+    config_journal_track_changes(&config_journal, &config_delta);
+    config_journal_use_index(&config_journal, &parameter_index);
 
-    sdcard_start();
-    sdcard_automount();
-
-    audio_start();
+    chprintf((BaseSequentialStream*)&SDU1, "boot");
 
-    // Initialise Aseba node (CAN and VM)
-    aseba_vm_init();
-    aseba_can_start(&vmState);
-    aseba_vm_start();
+    boot_run(boot_steps, sizeof(boot_steps) / sizeof(boot_steps[0]));
 
+    /* Everything else runs in its own thread. */
     while (TRUE) {
-        sdcard_automount();
-        chThdSleepMilliseconds(1000);
+        chThdSleep(TIME_INFINITE);
     }
 }
 
@@ -6,6 +6,8 @@ extern "C" {
 
 #include "msgbus/messagebus.h"
 #include "parameter/parameter.h"
+#include "config_journal.h"
+#include "parameter_index.h"
 
 /** Macro to declare a topic and associated locking constructs. */
 #define TOPIC_DECL(name, type) struct { \
@@ -26,6 +28,12 @@ extern messagebus_t bus;
 /** Robot wide parameter tree */
 extern parameter_namespace_t parameter_root;
 
+/** Fast path lookup in the parameter tree. */
+extern parameter_index_t parameter_index;
+
+/** Flash storage of the parameter tree. */
+extern config_journal_t config_journal;
+
 #ifdef __cplusplus
 }
 #endif
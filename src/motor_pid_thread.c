@@ -232,14 +232,6 @@ static void set_input_functions(motor_controller_t *controller, enum motor_enum
 
 }
 
-static void wait_for_services(void)
-{
-    messagebus_find_topic_blocking(&bus, "/motors/current");
-    messagebus_find_topic_blocking(&bus, "/wheel_velocities");
-    messagebus_find_topic_blocking(&bus, "/wheel_pos");
-    messagebus_find_topic_blocking(&bus, "/battery_level");
-}
-
 static BSEMAPHORE_DECL(timer_sem, true);
 
 static void timer_cb(void *p)
@@ -309,9 +301,6 @@ static THD_FUNCTION(motor_pid_thd, arg)
     TOPIC_DECL(wheels_setpoint_topic, wheels_setpoint_t);
     messagebus_advertise_topic(&bus, &wheels_setpoint_topic.topic, "/motors/setpoint");
 
-    /* Wait for needed services to come online. */
-    wait_for_services();
-
     static virtual_timer_t timer;
     chVTSet(&timer, CH_CFG_ST_FREQUENCY / CONTROL_FREQUENCY_HZ, timer_cb, (void *)&timer);
 
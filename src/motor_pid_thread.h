@@ -13,7 +13,11 @@ typedef struct {
     float right;
 } wheels_setpoint_t;
 
-/** Start wheel motor control. */
+/** Start wheel motor control.
+ *
+ * The /motors/current, /wheel_velocities, /wheel_pos and /battery_level
+ * topics must be advertised before.
+ */
 void motor_pid_start(void);
 
 #ifdef __cplusplus
@@ -0,0 +1,393 @@
+#include <stdlib.h>
+#include <string.h>
+#include "parameter_index.h"
+#include "cmp/cmp.h"
+#include "cmp_mem_access/cmp_mem_access.h"
+
+/* 32 bit FNV-1a, which can be computed incrementally while walking the tree. */
+#define FNV_OFFSET_BASIS 2166136261u
+#define FNV_PRIME 16777619u
+
+/* Longest string parameter value the MessagePack loader can set. */
+#define PARAMETER_INDEX_STRING_MAX 64
+
+static uint32_t hash_char(uint32_t hash, char c)
+{
+    return (hash ^ (uint8_t)c) * FNV_PRIME;
+}
+
+static uint32_t hash_segment(uint32_t hash, const char *id)
+{
+    hash = hash_char(hash, '/');
+    while (*id != '\0') {
+        hash = hash_char(hash, *id++);
+    }
+    return hash;
+}
+
+uint32_t parameter_index_hash(const char *path)
+{
+    if (*path == '/') {
+        path++;
+    }
+    return hash_segment(FNV_OFFSET_BASIS, path);
+}
+
+static bool parameter_index_add(parameter_index_t *index, parameter_namespace_t *ns, uint32_t hash)
+{
+    parameter_t *p;
+    parameter_namespace_t *sub;
+
+    for (p = ns->parameter_list; p != NULL; p = p->next) {
+        if (index->count == index->capacity) {
+            return false;
+        }
+        index->entries[index->count].hash = hash_segment(hash, p->id);
+        index->entries[index->count].param = p;
+        index->count++;
+    }
+
+    for (sub = ns->subspaces; sub != NULL; sub = sub->next) {
+        if (!parameter_index_add(index, sub, hash_segment(hash, sub->id))) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static int parameter_index_compare(const void *a, const void *b)
+{
+    uint32_t ha = ((const parameter_index_entry_t *)a)->hash;
+    uint32_t hb = ((const parameter_index_entry_t *)b)->hash;
+
+    return (ha > hb) - (ha < hb);
+}
+
+void parameter_index_init(parameter_index_t *index, parameter_namespace_t *root,
+                          parameter_index_entry_t *entries, size_t capacity)
+{
+    index->root = root;
+    index->entries = entries;
+    index->capacity = capacity;
+    index->count = 0;
+}
+
+bool parameter_index_build(parameter_index_t *index)
+{
+    index->count = 0;
+
+    if (!parameter_index_add(index, index->root, FNV_OFFSET_BASIS)) {
+        index->count = 0;
+        return false;
+    }
+
+    qsort(index->entries, index->count, sizeof(parameter_index_entry_t),
+          parameter_index_compare);
+
+    return true;
+}
+
+/* Checks that the path, of length len and without leading slash, is the one
+ * of p, comparing it from the end. */
+static bool parameter_index_matches(parameter_index_t *index, parameter_t *p,
+                                    const char *path, size_t len)
+{
+    parameter_namespace_t *ns;
+    size_t id_len = strlen(p->id);
+
+    if (id_len > len || memcmp(&path[len - id_len], p->id, id_len) != 0) {
+        return false;
+    }
+    len -= id_len;
+
+    for (ns = p->ns; ns != index->root; ns = ns->parent) {
+        /* Not part of the indexed tree. */
+        if (ns == NULL) {
+            return false;
+        }
+
+        id_len = strlen(ns->id);
+        if (id_len + 1 > len || path[len - 1] != '/'
+            || memcmp(&path[len - 1 - id_len], ns->id, id_len) != 0) {
+            return false;
+        }
+        len -= id_len + 1;
+    }
+
+    return len == 0;
+}
+
+/* Looks the path, of length len and without leading slash, up in the index. */
+static parameter_t *parameter_index_lookup(parameter_index_t *index, uint32_t hash,
+                                           const char *path, size_t len)
+{
+    size_t low = 0, high = index->count;
+
+    /* Find the first entry with the given hash. */
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (index->entries[mid].hash < hash) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    /* Different paths can share a hash, so the path is checked. */
+    for (; low < index->count && index->entries[low].hash == hash; low++) {
+        if (parameter_index_matches(index, index->entries[low].param, path, len)) {
+            return index->entries[low].param;
+        }
+    }
+
+    return NULL;
+}
+
+parameter_t *parameter_index_find(parameter_index_t *index, const char *path)
+{
+    const char *rel = *path == '/' ? path + 1 : path;
+    parameter_t *p;
+
+    p = parameter_index_lookup(index, parameter_index_hash(rel), rel, strlen(rel));
+    if (p != NULL) {
+        return p;
+    }
+
+    return parameter_find(index->root, path);
+}
+
+static bool skip_bytes(cmp_ctx_t *cmp, uint32_t len)
+{
+    char buf[16];
+
+    while (len > 0) {
+        uint32_t chunk = len < sizeof(buf) ? len : sizeof(buf);
+        if (!cmp->read(cmp, buf, chunk)) {
+            return false;
+        }
+        len -= chunk;
+    }
+
+    return true;
+}
+
+/* Skips the content of an object whose header was already read. */
+static bool skip_object(cmp_ctx_t *cmp, const cmp_object_t *obj)
+{
+    cmp_object_t child;
+    uint32_t i, count;
+
+    switch (obj->type) {
+        case CMP_TYPE_FIXMAP:
+        case CMP_TYPE_MAP16:
+        case CMP_TYPE_MAP32:
+        case CMP_TYPE_FIXARRAY:
+        case CMP_TYPE_ARRAY16:
+        case CMP_TYPE_ARRAY32:
+            if (obj->type == CMP_TYPE_FIXMAP || obj->type == CMP_TYPE_MAP16
+                || obj->type == CMP_TYPE_MAP32) {
+                count = 2 * obj->as.map_size;
+            } else {
+                count = obj->as.array_size;
+            }
+            for (i = 0; i < count; i++) {
+                if (!cmp_read_object(cmp, &child) || !skip_object(cmp, &child)) {
+                    return false;
+                }
+            }
+            return true;
+
+        case CMP_TYPE_FIXSTR:
+        case CMP_TYPE_STR8:
+        case CMP_TYPE_STR16:
+        case CMP_TYPE_STR32:
+            return skip_bytes(cmp, obj->as.str_size);
+
+        case CMP_TYPE_BIN8:
+        case CMP_TYPE_BIN16:
+        case CMP_TYPE_BIN32:
+            return skip_bytes(cmp, obj->as.bin_size);
+
+        case CMP_TYPE_FIXEXT1:
+        case CMP_TYPE_FIXEXT2:
+        case CMP_TYPE_FIXEXT4:
+        case CMP_TYPE_FIXEXT8:
+        case CMP_TYPE_FIXEXT16:
+        case CMP_TYPE_EXT8:
+        case CMP_TYPE_EXT16:
+        case CMP_TYPE_EXT32:
+            return skip_bytes(cmp, obj->as.ext.size);
+
+        default:
+            return true;
+    }
+}
+
+static bool object_as_integer(const cmp_object_t *obj, int64_t *value)
+{
+    switch (obj->type) {
+        case CMP_TYPE_POSITIVE_FIXNUM:
+        case CMP_TYPE_UINT8: *value = obj->as.u8; return true;
+        case CMP_TYPE_UINT16: *value = obj->as.u16; return true;
+        case CMP_TYPE_UINT32: *value = obj->as.u32; return true;
+        case CMP_TYPE_UINT64: *value = (int64_t)obj->as.u64; return true;
+        case CMP_TYPE_NEGATIVE_FIXNUM:
+        case CMP_TYPE_SINT8: *value = obj->as.s8; return true;
+        case CMP_TYPE_SINT16: *value = obj->as.s16; return true;
+        case CMP_TYPE_SINT32: *value = obj->as.s32; return true;
+        case CMP_TYPE_SINT64: *value = obj->as.s64; return true;
+        default: return false;
+    }
+}
+
+static bool object_as_float(const cmp_object_t *obj, float *value)
+{
+    int64_t i;
+
+    if (obj->type == CMP_TYPE_FLOAT) {
+        *value = obj->as.flt;
+        return true;
+    }
+
+    if (obj->type == CMP_TYPE_DOUBLE) {
+        *value = (float)obj->as.dbl;
+        return true;
+    }
+
+    if (object_as_integer(obj, &i)) {
+        *value = (float)i;
+        return true;
+    }
+
+    return false;
+}
+
+static bool read_string(cmp_ctx_t *cmp, const cmp_object_t *obj, parameter_t *p)
+{
+    char buf[PARAMETER_INDEX_STRING_MAX];
+    uint32_t len = obj->as.str_size;
+
+    if (len >= sizeof(buf)) {
+        return skip_bytes(cmp, len);
+    }
+
+    if (!cmp->read(cmp, buf, len)) {
+        return false;
+    }
+    buf[len] = '\0';
+    parameter_string_set(p, buf);
+
+    return true;
+}
+
+static bool read_value(cmp_ctx_t *cmp, const cmp_object_t *obj, parameter_t *p)
+{
+    int64_t i;
+    float f;
+
+    switch (p->type) {
+        case _PARAM_TYPE_SCALAR:
+            if (object_as_float(obj, &f)) {
+                parameter_scalar_set(p, f);
+            }
+            break;
+
+        case _PARAM_TYPE_INTEGER:
+            if (object_as_integer(obj, &i)) {
+                parameter_integer_set(p, (int32_t)i);
+            }
+            break;
+
+        case _PARAM_TYPE_BOOLEAN:
+            if (obj->type == CMP_TYPE_BOOLEAN) {
+                parameter_boolean_set(p, obj->as.boolean);
+            }
+            break;
+
+        case _PARAM_TYPE_STRING:
+            if (obj->type == CMP_TYPE_FIXSTR || obj->type == CMP_TYPE_STR8
+                || obj->type == CMP_TYPE_STR16 || obj->type == CMP_TYPE_STR32) {
+                return read_string(cmp, obj, p);
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    /* Whatever was not used above still has to be consumed. */
+    return skip_object(cmp, obj);
+}
+
+/* Reads the entries of a map whose header was already read. path holds the
+ * path of the map, of length len and whose hash is given. */
+static bool read_map(parameter_index_t *index, cmp_ctx_t *cmp, uint32_t size,
+                     char *path, size_t len, uint32_t hash)
+{
+    cmp_object_t obj;
+    parameter_t *p;
+    uint32_t i, key_len, key_hash;
+    char *key;
+
+    /* The root map is not prefixed by a separator. */
+    if (len > 0) {
+        path[len++] = '/';
+    }
+    key = &path[len];
+
+    for (i = 0; i < size; i++) {
+        /* Room for the terminating null. */
+        key_len = PARAMETER_INDEX_PATH_MAX - len;
+        if (!cmp_read_str(cmp, key, &key_len)) {
+            return false;
+        }
+        key_hash = hash_segment(hash, key);
+
+        if (!cmp_read_object(cmp, &obj)) {
+            return false;
+        }
+
+        if (obj.type == CMP_TYPE_FIXMAP || obj.type == CMP_TYPE_MAP16
+            || obj.type == CMP_TYPE_MAP32) {
+            if (!read_map(index, cmp, obj.as.map_size, path, len + key_len, key_hash)) {
+                return false;
+            }
+            continue;
+        }
+
+        p = parameter_index_lookup(index, key_hash, path, len + key_len);
+        if (p == NULL) {
+            p = parameter_find(index->root, path);
+        }
+        if (p == NULL) {
+            if (!skip_object(cmp, &obj)) {
+                return false;
+            }
+        } else if (!read_value(cmp, &obj, p)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int parameter_index_msgpack_read(parameter_index_t *index, const char *buf, size_t size)
+{
+    cmp_ctx_t cmp;
+    cmp_mem_access_t mem;
+    uint32_t map_size;
+    char path[PARAMETER_INDEX_PATH_MAX];
+
+    cmp_mem_access_ro_init(&cmp, &mem, buf, size);
+
+    if (!cmp_read_map(&cmp, &map_size)) {
+        return -1;
+    }
+
+    if (!read_map(index, &cmp, map_size, path, 0, FNV_OFFSET_BASIS)) {
+        return -1;
+    }
+
+    return 0;
+}
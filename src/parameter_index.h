@@ -0,0 +1,72 @@
+#ifndef PARAMETER_INDEX_H
+#define PARAMETER_INDEX_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "parameter/parameter.h"
+
+/** Longest parameter path, like "/left_wheel/control/current/kp", handled by
+ * the MessagePack loader. */
+#define PARAMETER_INDEX_PATH_MAX 96
+
+typedef struct {
+    uint32_t hash; /**< Hash of the full path of the parameter. */
+    parameter_t *param;
+} parameter_index_entry_t;
+
+/** Table of the parameters of a tree, sorted by the hash of their path.
+ *
+ * It replaces the string walk of parameter_find() by a binary search followed
+ * by a single path comparison.
+ */
+typedef struct {
+    parameter_namespace_t *root;
+    parameter_index_entry_t *entries;
+    size_t capacity;
+    size_t count;
+} parameter_index_t;
+
+/** Initializes an empty index of the given tree, with room for capacity
+ * parameters. Until it is built, lookups use parameter_find().
+ */
+void parameter_index_init(parameter_index_t *index, parameter_namespace_t *root,
+                          parameter_index_entry_t *entries, size_t capacity);
+
+/** Indexes every parameter of the tree, to be called once they are all
+ * declared.
+ *
+ * @returns false if the tree has more parameters than the index can hold, in
+ * which case lookups fall back to parameter_find().
+ */
+bool parameter_index_build(parameter_index_t *index);
+
+/** Returns the parameter at the given path, NULL if it does not exist.
+ *
+ * The leading slash is optional. Parameters declared after the index was built
+ * are still found, through parameter_find().
+ */
+parameter_t *parameter_index_find(parameter_index_t *index, const char *path);
+
+/** Applies the values of a MessagePack map, as written by
+ * parameter_msgpack_write_cmp(), to the indexed tree.
+ *
+ * The buffer is parsed in a single pass and each value is looked up in the
+ * index. Unknown parameters and values of the wrong type are skipped.
+ *
+ * @returns 0 on success, -1 if the buffer is not a valid map.
+ */
+int parameter_index_msgpack_read(parameter_index_t *index, const char *buf, size_t size);
+
+/** Returns the hash of the given path, as used by the index. */
+uint32_t parameter_index_hash(const char *path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
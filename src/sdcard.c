@@ -2,19 +2,20 @@
 #include <hal.h>
 #include <stdbool.h>
 #include <ff.h>
+#include "main.h"
+#include "exti.h"
 #include "sdcard.h"
 
+/* Time the card detect switch has to be stable before the card is mounted or
+ * unmounted. */
+#define SDCARD_DEBOUNCE_MS 20
+
 bool sdcard_mounted = false;
 static FATFS SDC_FS;
 
-void sdcard_start(void)
-{
-    static const SDCConfig sdc_config = {
-        NULL, /* not needed for SD cards */
-        SDC_MODE_4BIT
-    };
-    sdcStart(&SDCD1, &sdc_config);
-}
+static sdcard_state_t sdcard_state = SDCARD_REMOVED;
+static MUTEX_DECL(sdcard_state_lock);
+static CONDVAR_DECL(sdcard_state_changed);
 
 void sdcard_mount(void)
 {
@@ -58,3 +59,105 @@ void sdcard_activity(void)
 {
     palTogglePad(GPIOE, GPIOE_LED_SD);
 }
+
+static void sdcard_set_state(messagebus_topic_t *topic, sdcard_state_t state)
+{
+    sdcard_state_msg_t msg = {state};
+
+    chMtxLock(&sdcard_state_lock);
+    sdcard_state = state;
+    chCondBroadcast(&sdcard_state_changed);
+    chMtxUnlock(&sdcard_state_lock);
+
+    if (topic != NULL) {
+        messagebus_topic_publish(topic, &msg, sizeof(msg));
+    }
+}
+
+/* Waits until the card detect switch is stable. */
+static void sdcard_debounce(void)
+{
+    bool inserted;
+
+    do {
+        inserted = sdcIsCardInserted(&SDCD1);
+        chThdSleepMilliseconds(SDCARD_DEBOUNCE_MS);
+    } while (sdcIsCardInserted(&SDCD1) != inserted);
+}
+
+/* Mounts or unmounts the card to match the card detect switch. */
+static void sdcard_update(messagebus_topic_t *topic)
+{
+    sdcard_automount();
+
+    if (sdcard_mounted) {
+        sdcard_set_state(topic, SDCARD_MOUNTED);
+    } else if (sdcIsCardInserted(&SDCD1)) {
+        sdcard_set_state(topic, SDCARD_MOUNT_FAILED);
+    } else {
+        sdcard_set_state(topic, SDCARD_REMOVED);
+    }
+}
+
+static THD_FUNCTION(sdcard_thd, arg)
+{
+    (void)arg;
+    chRegSetThreadName(__FUNCTION__);
+
+    static TOPIC_DECL(state_topic, sdcard_state_msg_t);
+    event_listener_t sd_detect;
+
+    /* Registered first, so that no edge is missed while mounting. */
+    chEvtRegisterMaskWithFlags(&exti_events, &sd_detect, EVENT_MASK(0),
+                               (eventflags_t)EXTI_EVENT_SD_DETECT);
+
+    /* Readers started after the topic is advertised wait for the mount. */
+    if (sdcIsCardInserted(&SDCD1)) {
+        sdcard_set_state(NULL, SDCARD_INSERTED);
+    }
+    messagebus_advertise_topic(&bus, &state_topic.topic, "/sdcard/state");
+    sdcard_update(&state_topic.topic);
+
+    while (true) {
+        chEvtWaitAny(EVENT_MASK(0));
+
+        /* Readers wait for the mount from the first edge on. */
+        if (sdcIsCardInserted(&SDCD1) && !sdcard_mounted) {
+            sdcard_set_state(&state_topic.topic, SDCARD_INSERTED);
+        }
+
+        sdcard_debounce();
+
+        /* Drop the edges caused by the bouncing. */
+        chEvtGetAndClearEvents(EVENT_MASK(0));
+        chEvtGetAndClearFlags(&sd_detect);
+
+        sdcard_update(&state_topic.topic);
+    }
+}
+
+void sdcard_start(void)
+{
+    static const SDCConfig sdc_config = {
+        NULL, /* not needed for SD cards */
+        SDC_MODE_4BIT
+    };
+    static THD_WORKING_AREA(sdcard_thd_wa, 512);
+
+    sdcStart(&SDCD1, &sdc_config);
+    chThdCreateStatic(sdcard_thd_wa, sizeof(sdcard_thd_wa), NORMALPRIO, sdcard_thd, NULL);
+}
+
+bool sdcard_wait_for_mount(void)
+{
+    bool mounted;
+
+    chMtxLock(&sdcard_state_lock);
+    while (sdcard_state == SDCARD_INSERTED) {
+        chCondWait(&sdcard_state_changed);
+    }
+    mounted = sdcard_state == SDCARD_MOUNTED;
+    chMtxUnlock(&sdcard_state_lock);
+
+    return mounted;
+}
@@ -5,7 +5,36 @@
 extern "C" {
 #endif
 
+#include <stdbool.h>
+#include "sector_cache.h"
+
+typedef enum {
+    SDCARD_REMOVED = 0,
+    SDCARD_INSERTED, /**< Detected, but not mounted yet. */
+    SDCARD_MOUNTED,
+    SDCARD_MOUNT_FAILED,
+} sdcard_state_t;
+
+/** Message published on /sdcard/state when the card is inserted or removed. */
+typedef struct {
+    sdcard_state_t state;
+} sdcard_state_msg_t;
+
+/** Starts the thread mounting the card whenever it is inserted.
+ *
+ * exti_start() must be called before.
+ */
 void sdcard_start(void);
+
+/** Waits until a card which was just inserted is mounted.
+ *
+ * @returns true if a card is mounted.
+ */
+bool sdcard_wait_for_mount(void);
+
+/** Read cache of the card, used by FatFs. */
+extern sector_cache_t sdcard_cache;
+
 void sdcard_mount(void);
 void sdcard_unmount(void);
 void sdcard_automount(void);
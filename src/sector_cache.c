@@ -0,0 +1,188 @@
+#include <string.h>
+#include "sector_cache.h"
+
+void sector_cache_init(sector_cache_t *cache, sector_cache_line_t *lines, size_t line_count,
+                       void *buffer, uint32_t window, sector_cache_read_fn_t read, void *dev)
+{
+    size_t i;
+
+    cache->lines = lines;
+    cache->line_count = line_count;
+    cache->window = window;
+    cache->sector_count = 0;
+    cache->clock = 0;
+    cache->read = read;
+    cache->dev = dev;
+
+    for (i = 0; i < line_count; i++) {
+        lines[i].data = (uint8_t *)buffer + i * window * SECTOR_CACHE_SECTOR_SIZE;
+    }
+
+    sector_cache_invalidate_all(cache);
+    sector_cache_reset_stats(cache);
+}
+
+void sector_cache_set_sector_count(sector_cache_t *cache, uint32_t sector_count)
+{
+    cache->sector_count = sector_count;
+}
+
+static sector_cache_line_t *sector_cache_find(sector_cache_t *cache, uint32_t sector)
+{
+    sector_cache_line_t *line;
+    size_t i;
+
+    for (i = 0; i < cache->line_count; i++) {
+        line = &cache->lines[i];
+        if (sector >= line->first && sector - line->first < line->count) {
+            return line;
+        }
+    }
+
+    return NULL;
+}
+
+/* Returns an empty line, or the least recently used one. */
+static sector_cache_line_t *sector_cache_victim(sector_cache_t *cache)
+{
+    sector_cache_line_t *victim = &cache->lines[0];
+    size_t i;
+
+    for (i = 0; i < cache->line_count; i++) {
+        if (cache->lines[i].count == 0) {
+            return &cache->lines[i];
+        }
+        if (cache->lines[i].last_use < victim->last_use) {
+            victim = &cache->lines[i];
+        }
+    }
+
+    return victim;
+}
+
+static bool sector_cache_device_read(sector_cache_t *cache, uint32_t sector, uint8_t *buf,
+                                     uint32_t count)
+{
+    cache->stats.commands++;
+    cache->stats.bytes += count * SECTOR_CACHE_SECTOR_SIZE;
+
+    return cache->read(cache->dev, sector, buf, count);
+}
+
+/* Reads the window holding the given sector into a line. */
+static sector_cache_line_t *sector_cache_fill(sector_cache_t *cache, uint32_t sector)
+{
+    sector_cache_line_t *line = sector_cache_victim(cache);
+    uint32_t first = sector - sector % cache->window;
+    uint32_t count = cache->window;
+
+    /* Do not read ahead past the end of the card. */
+    if (cache->sector_count > sector && first + count > cache->sector_count) {
+        count = cache->sector_count - first;
+    }
+
+    line->count = 0;
+    if (!sector_cache_device_read(cache, first, line->data, count)) {
+        return NULL;
+    }
+    line->first = first;
+    line->count = count;
+
+    return line;
+}
+
+/* Returns how many sectors from the given one on, up to count, are not
+ * cached. */
+static uint32_t sector_cache_miss_run(sector_cache_t *cache, uint32_t sector, uint32_t count)
+{
+    uint32_t run = 0;
+
+    while (run < count && sector_cache_find(cache, sector + run) == NULL) {
+        run++;
+    }
+
+    return run;
+}
+
+bool sector_cache_read(sector_cache_t *cache, uint8_t *buf, uint32_t sector, uint32_t count)
+{
+    sector_cache_line_t *line;
+    uint32_t n, run;
+    bool missed;
+
+    while (count > 0) {
+        line = sector_cache_find(cache, sector);
+        missed = line == NULL;
+
+        if (line == NULL) {
+            run = sector_cache_miss_run(cache, sector, count);
+
+            /* Large reads would only flush the cache, so they bypass it. */
+            if (run >= cache->window && ((uintptr_t)buf & 3) == 0) {
+                cache->stats.misses += run;
+                if (!sector_cache_device_read(cache, sector, buf, run)) {
+                    return false;
+                }
+                buf += run * SECTOR_CACHE_SECTOR_SIZE;
+                sector += run;
+                count -= run;
+                continue;
+            }
+
+            line = sector_cache_fill(cache, sector);
+            if (line == NULL) {
+                return false;
+            }
+        }
+
+        n = line->first + line->count - sector;
+        if (n > count) {
+            n = count;
+        }
+
+        memcpy(buf, &line->data[(sector - line->first) * SECTOR_CACHE_SECTOR_SIZE],
+               n * SECTOR_CACHE_SECTOR_SIZE);
+        line->last_use = ++cache->clock;
+
+        if (missed) {
+            cache->stats.misses += n;
+        } else {
+            cache->stats.hits += n;
+        }
+
+        buf += n * SECTOR_CACHE_SECTOR_SIZE;
+        sector += n;
+        count -= n;
+    }
+
+    return true;
+}
+
+void sector_cache_invalidate(sector_cache_t *cache, uint32_t sector, uint32_t count)
+{
+    sector_cache_line_t *line;
+    size_t i;
+
+    for (i = 0; i < cache->line_count; i++) {
+        line = &cache->lines[i];
+        if (line->first < sector + count && sector < line->first + line->count) {
+            line->count = 0;
+        }
+    }
+}
+
+void sector_cache_invalidate_all(sector_cache_t *cache)
+{
+    size_t i;
+
+    for (i = 0; i < cache->line_count; i++) {
+        cache->lines[i].first = 0;
+        cache->lines[i].count = 0;
+        cache->lines[i].last_use = 0;
+    }
+}
+
+void sector_cache_reset_stats(sector_cache_t *cache)
+{
+    memset(&cache->stats, 0, sizeof(cache->stats));
+}
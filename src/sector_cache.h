@@ -0,0 +1,83 @@
+#ifndef SECTOR_CACHE_H
+#define SECTOR_CACHE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SECTOR_CACHE_SECTOR_SIZE 512
+
+/** Reads count consecutive sectors from the device in a single command.
+ *
+ * @returns false on error.
+ */
+typedef bool (*sector_cache_read_fn_t)(void *dev, uint32_t sector, uint8_t *buf, uint32_t count);
+
+typedef struct {
+    uint32_t first; /**< First sector held, a multiple of the window. */
+    uint32_t count; /**< Number of sectors held, 0 if empty. */
+    uint32_t last_use;
+    uint8_t *data;
+} sector_cache_line_t;
+
+typedef struct {
+    uint32_t hits; /**< Sectors served from the cache. */
+    uint32_t misses; /**< Sectors which had to be read. */
+    uint32_t commands; /**< Reads sent to the device. */
+    uint32_t bytes; /**< Bytes read from the device. */
+} sector_cache_stats_t;
+
+/** Read cache in front of a block device.
+ *
+ * A miss reads the whole aligned window of sectors around it, which reads
+ * ahead of sequential accesses like file streaming. Reads of at least a
+ * window which miss are sent to the device in a single command, straight to
+ * the caller's buffer when it is word aligned for DMA.
+ */
+typedef struct {
+    sector_cache_line_t *lines;
+    size_t line_count;
+    uint32_t window; /**< Sectors per line. */
+    uint32_t sector_count; /**< Size of the device, 0 if unknown. */
+    uint32_t clock;
+    sector_cache_read_fn_t read;
+    void *dev;
+    sector_cache_stats_t stats;
+} sector_cache_t;
+
+/** Initializes an empty cache.
+ *
+ * buffer holds line_count lines of window sectors each and must be word
+ * aligned. lines must have line_count entries.
+ */
+void sector_cache_init(sector_cache_t *cache, sector_cache_line_t *lines, size_t line_count,
+                       void *buffer, uint32_t window, sector_cache_read_fn_t read, void *dev);
+
+/** Sets the number of sectors of the device, so that read ahead stops at its
+ * end. */
+void sector_cache_set_sector_count(sector_cache_t *cache, uint32_t sector_count);
+
+/** Reads count sectors into buf, through the cache.
+ *
+ * @returns false if the device failed.
+ */
+bool sector_cache_read(sector_cache_t *cache, uint8_t *buf, uint32_t sector, uint32_t count);
+
+/** Drops the cached copies of the given sectors, to be called on writes. */
+void sector_cache_invalidate(sector_cache_t *cache, uint32_t sector, uint32_t count);
+
+/** Drops everything, for example when the card changes. */
+void sector_cache_invalidate_all(sector_cache_t *cache);
+
+/** Resets the statistics. */
+void sector_cache_reset_stats(sector_cache_t *cache);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SECTOR_CACHE_H */
@@ -1,5 +1,6 @@
 #include <ch.h>
 #include <hal.h>
+#include <string.h>
 #include "main.h"
 
 #include "exti.h"
@@ -8,34 +9,127 @@
 
 #define IMU_INTERRUPT_EVENT 1
 
+/** Default number of samples drained from the FIFO at each wakeup, 0 to read
+ * every sample as soon as it is ready without using the FIFO. Can be changed at
+ * runtime with the imu/fifo_watermark parameter. */
+#ifndef IMU_FIFO_WATERMARK
+#define IMU_FIFO_WATERMARK 4
+#endif
+
+#if IMU_FIFO_WATERMARK > IMU_BATCH_MAX_SAMPLES
+#error "IMU_FIFO_WATERMARK must not be larger than IMU_BATCH_MAX_SAMPLES"
+#endif
+
+/*
+ * SPI1 configuration structure for MPU6000 register writes and FIFO reads.
+ * SPI1 is on APB2 @ 84MHz / 128 = 656.25kHz, the MPU6000 accepts at most 1MHz.
+ * CPHA=1, CPOL=1, 8bits frames, MSb transmitted first.
+ */
+static const SPIConfig spi_cfg = {
+    .end_cb = NULL,
+    .ssport = GPIOF,
+    .sspad = GPIOF_MPU_CS,
+    .cr1 = SPI_CR1_BR_2 | SPI_CR1_BR_1 | SPI_CR1_CPOL | SPI_CR1_CPHA
+};
+
+/*
+ * SPI1 configuration structure for MPU6000 sensor and interrupt status reads.
+ * SPI1 is on APB2 @ 84MHz / 8 = 10.5MHz, the MPU6000 accepts at most 20MHz for
+ * those registers only.
+ */
+static const SPIConfig spi_burst_cfg = {
+    .end_cb = NULL,
+    .ssport = GPIOF,
+    .sspad = GPIOF_MPU_CS,
+    .cr1 = SPI_CR1_BR_1 | SPI_CR1_CPOL | SPI_CR1_CPHA
+};
+
+static parameter_namespace_t imu_ns;
+static struct {
+    parameter_t sample_rate;
+    parameter_t low_pass_filter;
+    parameter_t acc_range;
+    parameter_t gyro_range;
+    parameter_t fifo_watermark;
+} imu_params;
+
+static void imu_declare_parameters(void)
+{
+    parameter_namespace_declare(&imu_ns, &parameter_root, "imu");
+
+    /* Sampling frequency, in Hz. */
+    parameter_integer_declare_with_default(&imu_params.sample_rate, &imu_ns,
+                                           "sample_rate", 1000);
+    /* Digital low pass filter setting, from 0 (260Hz) to 6 (5Hz). */
+    parameter_integer_declare_with_default(&imu_params.low_pass_filter, &imu_ns,
+                                           "low_pass_filter", 6);
+    /* Accelerometer full range, in g. */
+    parameter_integer_declare_with_default(&imu_params.acc_range, &imu_ns,
+                                           "acc_range", 2);
+    /* Gyroscope full range, in degrees per second. */
+    parameter_integer_declare_with_default(&imu_params.gyro_range, &imu_ns,
+                                           "gyro_range", 250);
+    /* Samples read from the FIFO at each wakeup, 0 disables the FIFO. */
+    parameter_integer_declare_with_default(&imu_params.fifo_watermark, &imu_ns,
+                                           "fifo_watermark", IMU_FIFO_WATERMARK);
+}
 
-/** Inits all the IMU peripherals. */
-static void imu_low_level_init(mpu60X0_t *mpu)
+/** Returns true if any of the IMU parameters changed since they were last read. */
+static bool imu_parameters_changed(void)
+{
+    return parameter_namespace_contains_changed(&imu_ns);
+}
+
+/** Returns the FIFO watermark set in the parameters, 0 if the FIFO is disabled. */
+static int imu_fifo_watermark(void)
+{
+    int watermark = parameter_integer_get(&imu_params.fifo_watermark);
+
+    if (watermark < 0) {
+        return 0;
+    }
+    if (watermark > IMU_BATCH_MAX_SAMPLES) {
+        return IMU_BATCH_MAX_SAMPLES;
+    }
+    return watermark;
+}
+
+/** Configures the MPU6000 according to the parameters. */
+static void imu_configure(mpu60X0_t *mpu)
 {
-    /*
-     * SPI1 configuration structure for MPU6000.
-     * SPI1 is on APB2 @ 84MHz / 128 = 656.25kHz
-     * CPHA=1, CPOL=1, 8bits frames, MSb transmitted first.
-     */
-    static SPIConfig spi_cfg = {
-        .end_cb = NULL,
-        .ssport = GPIOF,
-        .sspad = GPIOF_MPU_CS,
-        .cr1 = SPI_CR1_BR_2 | SPI_CR1_BR_1 | SPI_CR1_CPOL | SPI_CR1_CPHA
+    mpu60X0_settings_t settings = {
+        .acc_range_g = parameter_integer_get(&imu_params.acc_range),
+        .gyro_range_dps = parameter_integer_get(&imu_params.gyro_range),
+        .sample_rate_hz = parameter_integer_get(&imu_params.sample_rate),
+        .low_pass_filter = parameter_integer_get(&imu_params.low_pass_filter),
+        .fifo_enable = imu_fifo_watermark() > 0,
     };
+    int watermark = imu_fifo_watermark();
 
+    /* Do not wake up on every sample while the device is reset. */
+    exti_set_mpu6000_watermark(watermark > 0 ? watermark : 1);
+    mpu60X0_setup(mpu, mpu60X0_config_make(&settings));
+}
+
+/** Inits all the IMU peripherals. */
+static void imu_low_level_init(mpu60X0_t *mpu)
+{
     spiStart(&SPID1, &spi_cfg);
 
     mpu60X0_init_using_spi(mpu, &SPID1);
+    mpu60X0_set_spi_configs(mpu, &spi_cfg, &spi_burst_cfg);
 
     while (!mpu60X0_ping(mpu)) {
         chThdSleepMilliseconds(10);
     }
 
-    mpu60X0_setup(mpu, MPU60X0_ACC_FULL_RANGE_2G
-                  | MPU60X0_GYRO_FULL_RANGE_250DPS
-                  | MPU60X0_SAMPLE_RATE_DIV(10)
-                  | MPU60X0_LOW_PASS_FILTER_6);
+    imu_configure(mpu);
+}
+
+/** Returns the current system time in microseconds, wrapping around. */
+static uint32_t imu_time_us(void)
+{
+    return (uint32_t)chVTGetSystemTime() * (1000000 / CH_CFG_ST_FREQUENCY);
 }
 
 static THD_FUNCTION(imu_reader_thd, arg)
@@ -55,27 +149,70 @@ static THD_FUNCTION(imu_reader_thd, arg)
                                (eventmask_t)IMU_INTERRUPT_EVENT,
                                (eventflags_t)EXTI_EVENT_MPU6000_INT);
 
-    /* Declares the topic on the bus. */
+    /* Declares the topics on the bus. */
     TOPIC_DECL(imu_topic, imu_msg_t);
     messagebus_advertise_topic(&bus, &imu_topic.topic, "/imu");
 
-    while (true) {
-        imu_msg_t msg;
-
-        /* Wait for a measurement to come. */
-        chEvtWaitAny(IMU_INTERRUPT_EVENT);
+    TOPIC_DECL(imu_batch_topic, imu_batch_msg_t);
+    messagebus_advertise_topic(&bus, &imu_batch_topic.topic, "/imu/batch");
 
-        /* Read the incoming measurement. */
-        mpu60X0_read(&dev, msg.roll_rate, msg.acceleration, NULL);
+    static imu_batch_msg_t batch;
+    float gyro[IMU_BATCH_MAX_SAMPLES][3];
+    float acc[IMU_BATCH_MAX_SAMPLES][3];
 
-        /* Publish it on the bus. */
-        messagebus_topic_publish(&imu_topic.topic, &msg, sizeof(msg));
+    while (true) {
+        int i, n;
+        uint32_t now, period_us;
+
+        /* Wait for measurements to come, the timeout makes sure parameter
+         * changes are applied even if the IMU stopped sending interrupts. */
+        eventmask_t events = chEvtWaitAnyTimeout(IMU_INTERRUPT_EVENT, MS2ST(100));
+
+        if (imu_parameters_changed()) {
+            imu_configure(&dev);
+            continue;
+        }
+
+        if (events == 0) {
+            continue;
+        }
+
+        if (dev.config & MPU60X0_FIFO_ENABLE) {
+            /* Drain the FIFO in a single transfer. */
+            n = mpu60X0_fifo_read(&dev, gyro, acc, IMU_BATCH_MAX_SAMPLES);
+        } else {
+            /* Read the incoming measurement. */
+            mpu60X0_read(&dev, gyro[0], acc[0], NULL);
+            n = 1;
+        }
+        now = imu_time_us();
+        if (n <= 0) {
+            continue;
+        }
+
+        /* The last sample was just taken, the others are one period apart. */
+        period_us = mpu60X0_sample_period_us(&dev);
+        batch.count = n;
+        for (i = 0; i < n; i++) {
+            imu_msg_t *msg = &batch.samples[i];
+            memcpy(msg->acceleration, acc[i], sizeof(msg->acceleration));
+            memcpy(msg->roll_rate, gyro[i], sizeof(msg->roll_rate));
+            msg->theta = 0;
+            msg->timestamp = now - (n - 1 - i) * period_us;
+        }
+
+        /* Publish them on the bus. */
+        messagebus_topic_publish(&imu_batch_topic.topic, &batch, sizeof(batch));
+        messagebus_topic_publish(&imu_topic.topic, &batch.samples[n - 1], sizeof(imu_msg_t));
     }
 }
 
 void imu_start(void)
 {
-    static THD_WORKING_AREA(imu_reader_thd_wa, 2048);
+    static THD_WORKING_AREA(imu_reader_thd_wa, 3072);
+
+    imu_declare_parameters();
+
     chThdCreateStatic(imu_reader_thd_wa, sizeof(imu_reader_thd_wa), NORMALPRIO, imu_reader_thd,
                       NULL);
 }
@@ -4,14 +4,31 @@
 extern "C" {
 #endif
 
+#include <stdint.h>
+
+/** Maximum number of samples in a batch read from the IMU FIFO. */
+#define IMU_BATCH_MAX_SAMPLES 16
+
 /** Message containing one measurement from the IMU. */
 typedef struct {
     float acceleration[3];
     float roll_rate[3];
     float theta;
+    uint32_t timestamp; /**< Sampling time in microseconds, wraps around. */
 } imu_msg_t;
 
-/** Starts the Inertial Motion Unit (IMU) publisher. */
+/** Message containing all the measurements read from the IMU at once, oldest
+ * first. */
+typedef struct {
+    unsigned count;
+    imu_msg_t samples[IMU_BATCH_MAX_SAMPLES];
+} imu_batch_msg_t;
+
+/** Starts the Inertial Motion Unit (IMU) publisher.
+ *
+ * The latest measurement is published on /imu. When the FIFO is used, every
+ * measurement of a batch is also published on /imu/batch.
+ */
 void imu_start(void);
 
 #ifdef __cplusplus
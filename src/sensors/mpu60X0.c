@@ -1,18 +1,35 @@
 #include <stdint.h>
-#include <math.h>
 
 #include "sensors/mpu60X0.h"
 #include "sensors/mpu60X0_registers.h"
 
-#define STANDARD_GRAVITY 9.80665f
-#define DEG2RAD(deg) (deg / 180 * M_PI)
+// maximum number of FIFO samples read in a single SPI transfer
+#define FIFO_BURST_MAX_SAMPLES 32
+
+#if HAL_USE_SPI
+static void mpu60X0_spi_select(mpu60X0_t *dev, const SPIConfig *cfg)
+{
+    if (cfg != NULL && dev->spi->config != cfg) {
+        spiStart(dev->spi, cfg);
+    }
+    spiSelect(dev->spi);
+}
+
+static const SPIConfig *mpu60X0_spi_burst_cfg(mpu60X0_t *dev)
+{
+    if (dev->spi_burst_cfg != NULL) {
+        return dev->spi_burst_cfg;
+    }
+    return dev->spi_cfg;
+}
+#endif
 
 static uint8_t mpu60X0_reg_read(mpu60X0_t *dev, uint8_t reg)
 {
     uint8_t ret = 0;
     if (dev->spi) {
 #if HAL_USE_SPI
-        spiSelect(dev->spi);
+        mpu60X0_spi_select(dev, dev->spi_cfg);
         reg |= 0x80;
         spiSend(dev->spi, 1, &reg);
         spiReceive(dev->spi, 1, &ret);
@@ -32,7 +49,7 @@ static void mpu60X0_reg_write(mpu60X0_t *dev, uint8_t reg, uint8_t val)
     uint8_t buf[] = {reg, val};
     if (dev->spi) {
 #if HAL_USE_SPI
-        spiSelect(dev->spi);
+        mpu60X0_spi_select(dev, dev->spi_cfg);
         spiSend(dev->spi, 2, buf);
         spiUnselect(dev->spi);
 #endif
@@ -44,11 +61,13 @@ static void mpu60X0_reg_write(mpu60X0_t *dev, uint8_t reg, uint8_t val)
     }
 }
 
-static void mpu60X0_reg_read_multi(mpu60X0_t *dev, uint8_t reg, uint8_t *buf, int8_t len)
+// fast is only allowed for the sensor and interrupt registers, the datasheet
+// limits the SPI clock to 1MHz for all the others, FIFO included
+static void mpu60X0_reg_read_multi(mpu60X0_t *dev, uint8_t reg, uint8_t *buf, size_t len, bool fast)
 {
     if (dev->spi) {
 #if HAL_USE_SPI
-        spiSelect(dev->spi);
+        mpu60X0_spi_select(dev, fast ? mpu60X0_spi_burst_cfg(dev) : dev->spi_cfg);
         reg |= 0x80;
         spiSend(dev->spi, 1, &reg);
         spiReceive(dev->spi, len, buf);
@@ -78,8 +97,18 @@ static void mpu60X0_reg_write_multi(mpu60X0_t *dev, uint8_t reg, const uint8_t *
 void mpu60X0_init_using_spi(mpu60X0_t *dev, SPIDriver *spi_dev)
 {
     dev->spi = spi_dev;
+    dev->spi_cfg = NULL;
+    dev->spi_burst_cfg = NULL;
     dev->i2c = NULL;
     dev->config = 0;
+    dev->acc_scale = mpu60X0_config_acc_scale(0);
+    dev->gyro_scale = mpu60X0_config_gyro_scale(0);
+}
+
+void mpu60X0_set_spi_configs(mpu60X0_t *dev, const SPIConfig *cfg, const SPIConfig *burst_cfg)
+{
+    dev->spi_cfg = cfg;
+    dev->spi_burst_cfg = burst_cfg;
 }
 #endif
 
@@ -89,6 +118,8 @@ void mpu60X0_init_using_i2c(mpu60X0_t *dev, I2CDriver *i2c_dev, int ad0_pin_valu
     dev->i2c = i2c_dev;
     dev->spi = NULL;
     dev->config = 0;
+    dev->acc_scale = mpu60X0_config_acc_scale(0);
+    dev->gyro_scale = mpu60X0_config_gyro_scale(0);
     if (ad0_pin_value == 0) {
         dev->i2c_address = 0x68;
     } else {
@@ -100,6 +131,8 @@ void mpu60X0_init_using_i2c(mpu60X0_t *dev, I2CDriver *i2c_dev, int ad0_pin_valu
 void mpu60X0_setup(mpu60X0_t *dev, int config)
 {
     dev->config = config;
+    dev->acc_scale = mpu60X0_config_acc_scale(config);
+    dev->gyro_scale = mpu60X0_config_gyro_scale(config);
     // reset device
     mpu60X0_reg_write(dev, MPU60X0_RA_PWR_MGMT_1, 0x80);
     chThdSleepMilliseconds(1);
@@ -111,7 +144,7 @@ void mpu60X0_setup(mpu60X0_t *dev, int config)
     mpu60X0_reg_write(dev, MPU60X0_RA_PWR_MGMT_1, MPU60X0_CLOCK_PLL_XGYRO);
     chThdSleepMilliseconds(1);
     if (dev->spi) { // disable I2C interface
-        mpu60X0_reg_write(dev, MPU60X0_RA_USER_CTRL, MPU60X0_USERCTRL_I2C_IF_DIS_BIT);
+        mpu60X0_reg_write(dev, MPU60X0_RA_USER_CTRL, MPU60X0_USERCTRL_I2C_IF_DIS);
         chThdSleepMilliseconds(1);
     }
     // gyro full scale
@@ -129,6 +162,13 @@ void mpu60X0_setup(mpu60X0_t *dev, int config)
     // low pass filter config, FSYNC disabled
     mpu60X0_reg_write(dev, MPU60X0_RA_CONFIG, (config >> 16) & 0x07);
     chThdSleepMilliseconds(1);
+    if (config & MPU60X0_FIFO_ENABLE) {
+        // queue accel and gyro samples, temperature is left out
+        mpu60X0_reg_write(dev, MPU60X0_RA_FIFO_EN, MPU60X0_ACCEL_FIFO_EN
+                          | MPU60X0_XG_FIFO_EN | MPU60X0_YG_FIFO_EN | MPU60X0_ZG_FIFO_EN);
+        chThdSleepMilliseconds(1);
+        mpu60X0_fifo_reset(dev);
+    }
 }
 
 bool mpu60X0_ping(mpu60X0_t *dev)
@@ -151,27 +191,78 @@ static int32_t read_word(const uint8_t *buf) // signed int16
 
 void mpu60X0_read(mpu60X0_t *dev, float *gyro, float *acc, float *temp)
 {
-    static const float gyro_res[] = { DEG2RAD(1 / 131.f),
-                                      DEG2RAD(1 / 65.5f),
-                                      DEG2RAD(1 / 32.8f),
-                                      DEG2RAD(1 / 16.4f) }; // rad/s/LSB
-    static const float acc_res[] = { STANDARD_GRAVITY / 16384.f,
-                                     STANDARD_GRAVITY / 8192.f,
-                                     STANDARD_GRAVITY / 4096.f,
-                                     STANDARD_GRAVITY / 2048.f }; // m/s^2 / LSB
     uint8_t buf[1 + 6 + 2 + 6]; // interrupt status, accel, temp, gyro
-    mpu60X0_reg_read_multi(dev, MPU60X0_RA_INT_STATUS, buf, sizeof(buf));
+    mpu60X0_reg_read_multi(dev, MPU60X0_RA_INT_STATUS, buf, sizeof(buf), true);
     if (acc) {
-        acc[0] = (float)read_word(&buf[1]) * acc_res[dev->config & 0x3];
-        acc[1] = (float)read_word(&buf[3]) * acc_res[dev->config & 0x3];
-        acc[2] = (float)read_word(&buf[5]) * acc_res[dev->config & 0x3];
+        acc[0] = (float)read_word(&buf[1]) * dev->acc_scale;
+        acc[1] = (float)read_word(&buf[3]) * dev->acc_scale;
+        acc[2] = (float)read_word(&buf[5]) * dev->acc_scale;
     }
     if (temp) {
         *temp = (float)read_word(&buf[7]) / 340.0f + 36.53f;
     }
     if (gyro) {
-        gyro[0] = (float)read_word(&buf[9]) * gyro_res[(dev->config >> 2) & 0x3];
-        gyro[1] = (float)read_word(&buf[11]) * gyro_res[(dev->config >> 2) & 0x3];
-        gyro[2] = (float)read_word(&buf[13]) * gyro_res[(dev->config >> 2) & 0x3];
+        gyro[0] = (float)read_word(&buf[9]) * dev->gyro_scale;
+        gyro[1] = (float)read_word(&buf[11]) * dev->gyro_scale;
+        gyro[2] = (float)read_word(&buf[13]) * dev->gyro_scale;
+    }
+}
+
+uint32_t mpu60X0_sample_period_us(mpu60X0_t *dev)
+{
+    return mpu60X0_config_sample_period_us(dev->config);
+}
+
+void mpu60X0_fifo_reset(mpu60X0_t *dev)
+{
+    uint8_t user_ctrl = MPU60X0_USERCTRL_FIFO_EN | MPU60X0_USERCTRL_FIFO_RESET;
+    if (dev->spi) {
+        user_ctrl |= MPU60X0_USERCTRL_I2C_IF_DIS;
+    }
+    mpu60X0_reg_write(dev, MPU60X0_RA_USER_CTRL, user_ctrl);
+}
+
+int mpu60X0_fifo_read(mpu60X0_t *dev, float (*gyro)[3], float (*acc)[3], int max_samples)
+{
+    uint8_t buf[FIFO_BURST_MAX_SAMPLES * MPU60X0_FIFO_SAMPLE_SIZE];
+    uint8_t count_buf[2];
+    int count, i;
+
+    mpu60X0_reg_read_multi(dev, MPU60X0_RA_FIFO_COUNTH, count_buf, sizeof(count_buf), false);
+    count = count_buf[0] << 8 | count_buf[1];
+
+    // once full the FIFO overwrites the oldest bytes and loses sample alignment
+    if (count > MPU60X0_FIFO_SIZE - MPU60X0_FIFO_SAMPLE_SIZE) {
+        mpu60X0_fifo_reset(dev);
+        return -1;
+    }
+
+    count /= MPU60X0_FIFO_SAMPLE_SIZE;
+    if (count > max_samples) {
+        count = max_samples;
+    }
+    if (count > FIFO_BURST_MAX_SAMPLES) {
+        count = FIFO_BURST_MAX_SAMPLES;
     }
+    if (count == 0) {
+        return 0;
+    }
+
+    mpu60X0_reg_read_multi(dev, MPU60X0_RA_FIFO_R_W, buf, count * MPU60X0_FIFO_SAMPLE_SIZE, false);
+
+    for (i = 0; i < count; i++) {
+        const uint8_t *sample = &buf[i * MPU60X0_FIFO_SAMPLE_SIZE];
+        if (acc) {
+            acc[i][0] = (float)read_word(&sample[0]) * dev->acc_scale;
+            acc[i][1] = (float)read_word(&sample[2]) * dev->acc_scale;
+            acc[i][2] = (float)read_word(&sample[4]) * dev->acc_scale;
+        }
+        if (gyro) {
+            gyro[i][0] = (float)read_word(&sample[6]) * dev->gyro_scale;
+            gyro[i][1] = (float)read_word(&sample[8]) * dev->gyro_scale;
+            gyro[i][2] = (float)read_word(&sample[10]) * dev->gyro_scale;
+        }
+    }
+
+    return count;
 }
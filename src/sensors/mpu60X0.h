@@ -3,11 +3,16 @@
 
 #include <hal.h>
 #include <stdint.h>
+#include "sensors/mpu60X0_config.h"
 
 typedef struct {
     uint32_t config;
+    float acc_scale; // m/s^2 / LSB, cached by mpu60X0_setup()
+    float gyro_scale; // rad/s / LSB, cached by mpu60X0_setup()
 #if HAL_USE_SPI
     SPIDriver *spi;
+    const SPIConfig *spi_cfg; // used for register writes, NULL to leave SPI untouched
+    const SPIConfig *spi_burst_cfg; // used for sensor reads, NULL to use spi_cfg
 #else
     void *spi;
 #endif
@@ -20,26 +25,18 @@ typedef struct {
 } mpu60X0_t;
 
 
-// mpu60X0_setup() config options
-#define MPU60X0_ACC_FULL_RANGE_2G           (0 << 0)
-#define MPU60X0_ACC_FULL_RANGE_4G           (1 << 0)
-#define MPU60X0_ACC_FULL_RANGE_8G           (2 << 0)
-#define MPU60X0_ACC_FULL_RANGE_16G          (3 << 0)
-#define MPU60X0_GYRO_FULL_RANGE_250DPS      (0 << 2)
-#define MPU60X0_GYRO_FULL_RANGE_500DPS      (1 << 2)
-#define MPU60X0_GYRO_FULL_RANGE_1000DPS     (2 << 2)
-#define MPU60X0_GYRO_FULL_RANGE_2000DPS     (3 << 2)
-#define MPU60X0_SAMPLE_RATE_DIV(x)          ((0xff & x) << 8) // sample rate is gyro Fs divided by x+1, x in [0, 255]
-#define MPU60X0_LOW_PASS_FILTER_0           (0 << 16) // acc: BW=260Hz, delay=   0ms, Fs=1kHz gyro: BW=256Hz, delay=0.98ms, Fs=8kHz
-#define MPU60X0_LOW_PASS_FILTER_1           (1 << 16) // acc: BW=184Hz, delay= 2.0ms, Fs=1kHz gyro: BW=188Hz, delay= 1.9ms, Fs=1kHz
-#define MPU60X0_LOW_PASS_FILTER_2           (2 << 16) // acc: BW= 94Hz, delay= 3.0ms, Fs=1kHz gyro: BW= 98Hz, delay= 2.8ms, Fs=1kHz
-#define MPU60X0_LOW_PASS_FILTER_3           (3 << 16) // acc: BW= 44Hz, delay= 4.9ms, Fs=1kHz gyro: BW= 42Hz, delay= 4.8ms, Fs=1kHz
-#define MPU60X0_LOW_PASS_FILTER_4           (4 << 16) // acc: BW= 21Hz, delay= 8.5ms, Fs=1kHz gyro: BW= 20Hz, delay= 8.3ms, Fs=1kHz
-#define MPU60X0_LOW_PASS_FILTER_5           (5 << 16) // acc: BW= 10Hz, delay=13.8ms, Fs=1kHz gyro: BW= 10Hz, delay=13.4ms, Fs=1kHz
-#define MPU60X0_LOW_PASS_FILTER_6           (6 << 16) // acc: BW=  5Hz, delay=19.0ms, Fs=1kHz gyro: BW=  5Hz, delay=18.6ms, Fs=1kHz
+// Size of one accel + gyro sample in the FIFO, in bytes
+#define MPU60X0_FIFO_SAMPLE_SIZE            12
+// Size of the on-chip FIFO, in bytes
+#define MPU60X0_FIFO_SIZE                   1024
 
 #if HAL_USE_SPI
 void mpu60X0_init_using_spi(mpu60X0_t *dev, SPIDriver *spi_dev);
+/* The datasheet limits the SPI clock to 1MHz, except for reading the sensor
+ * and interrupt registers which can be done at up to 20MHz. burst_cfg is only
+ * used for those, the FIFO is read with cfg. When set, the driver switches the
+ * SPI configuration before each transfer. */
+void mpu60X0_set_spi_configs(mpu60X0_t *dev, const SPIConfig *cfg, const SPIConfig *burst_cfg);
 #endif
 #if HAL_USE_I2C
 void mpu60X0_init_using_i2c(mpu60X0_t *dev, I2CDriver *i2c_dev, int ad0_pin_value);
@@ -48,5 +45,12 @@ void mpu60X0_setup(mpu60X0_t *dev, int config);
 bool mpu60X0_ping(mpu60X0_t *dev);
 bool mpu60X0_self_test(mpu60X0_t *dev);
 void mpu60X0_read(mpu60X0_t *dev, float *gyro, float *acc, float *temp);
+// period between two samples in microseconds, as configured by mpu60X0_setup()
+uint32_t mpu60X0_sample_period_us(mpu60X0_t *dev);
+// drops all the samples queued in the FIFO
+void mpu60X0_fifo_reset(mpu60X0_t *dev);
+// reads up to max_samples samples from the FIFO in a single transfer, oldest first
+// returns the number of samples read, or -1 if the FIFO overflowed and was reset
+int mpu60X0_fifo_read(mpu60X0_t *dev, float (*gyro)[3], float (*acc)[3], int max_samples);
 
 #endif // MPU60X0_H
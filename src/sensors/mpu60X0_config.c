@@ -0,0 +1,81 @@
+#include <math.h>
+
+#include "sensors/mpu60X0_config.h"
+
+#define STANDARD_GRAVITY 9.80665f
+#define DEG2RAD(deg) (deg / 180 * M_PI)
+
+static const float gyro_res[] = { DEG2RAD(1 / 131.f),
+                                  DEG2RAD(1 / 65.5f),
+                                  DEG2RAD(1 / 32.8f),
+                                  DEG2RAD(1 / 16.4f) }; // rad/s/LSB
+static const float acc_res[] = { STANDARD_GRAVITY / 16384.f,
+                                 STANDARD_GRAVITY / 8192.f,
+                                 STANDARD_GRAVITY / 4096.f,
+                                 STANDARD_GRAVITY / 2048.f }; // m/s^2 / LSB
+
+// gyro output rate is 8kHz when the low pass filter is disabled, 1kHz otherwise
+static uint32_t gyro_output_rate(int low_pass)
+{
+    return (low_pass == 0 || low_pass == 7) ? 8000 : 1000;
+}
+
+// index of the smallest full range covering the given value, ranges doubling from base
+static int range_index(int value, int base)
+{
+    int i = 0;
+    while (i < 3 && value > (base << i)) {
+        i++;
+    }
+    return i;
+}
+
+uint32_t mpu60X0_config_make(const mpu60X0_settings_t *settings)
+{
+    uint32_t config = 0;
+    int low_pass = settings->low_pass_filter;
+    int rate = settings->sample_rate_hz;
+    int divider;
+
+    if (low_pass < 0) {
+        low_pass = 0;
+    } else if (low_pass > 6) {
+        low_pass = 6;
+    }
+
+    if (rate < 1) {
+        rate = 1;
+    }
+    divider = ((int)gyro_output_rate(low_pass) + rate / 2) / rate - 1;
+    if (divider < 0) {
+        divider = 0;
+    } else if (divider > 255) {
+        divider = 255;
+    }
+
+    config |= range_index(settings->acc_range_g, 2);
+    config |= range_index(settings->gyro_range_dps, 250) << 2;
+    config |= MPU60X0_SAMPLE_RATE_DIV(divider);
+    config |= (uint32_t)low_pass << 16;
+    if (settings->fifo_enable) {
+        config |= MPU60X0_FIFO_ENABLE;
+    }
+
+    return config;
+}
+
+float mpu60X0_config_acc_scale(uint32_t config)
+{
+    return acc_res[config & 0x3];
+}
+
+float mpu60X0_config_gyro_scale(uint32_t config)
+{
+    return gyro_res[(config >> 2) & 0x3];
+}
+
+uint32_t mpu60X0_config_sample_period_us(uint32_t config)
+{
+    uint32_t divider = ((config >> 8) & 0xff) + 1;
+    return divider * 1000000 / gyro_output_rate((config >> 16) & 0x07);
+}
@@ -0,0 +1,51 @@
+#ifndef MPU60X0_CONFIG_H
+#define MPU60X0_CONFIG_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+// mpu60X0_setup() config options
+#define MPU60X0_ACC_FULL_RANGE_2G           (0 << 0)
+#define MPU60X0_ACC_FULL_RANGE_4G           (1 << 0)
+#define MPU60X0_ACC_FULL_RANGE_8G           (2 << 0)
+#define MPU60X0_ACC_FULL_RANGE_16G          (3 << 0)
+#define MPU60X0_GYRO_FULL_RANGE_250DPS      (0 << 2)
+#define MPU60X0_GYRO_FULL_RANGE_500DPS      (1 << 2)
+#define MPU60X0_GYRO_FULL_RANGE_1000DPS     (2 << 2)
+#define MPU60X0_GYRO_FULL_RANGE_2000DPS     (3 << 2)
+#define MPU60X0_SAMPLE_RATE_DIV(x)          ((0xff & x) << 8) // sample rate is gyro Fs divided by x+1, x in [0, 255]
+#define MPU60X0_LOW_PASS_FILTER_0           (0 << 16) // acc: BW=260Hz, delay=   0ms, Fs=1kHz gyro: BW=256Hz, delay=0.98ms, Fs=8kHz
+#define MPU60X0_LOW_PASS_FILTER_1           (1 << 16) // acc: BW=184Hz, delay= 2.0ms, Fs=1kHz gyro: BW=188Hz, delay= 1.9ms, Fs=1kHz
+#define MPU60X0_LOW_PASS_FILTER_2           (2 << 16) // acc: BW= 94Hz, delay= 3.0ms, Fs=1kHz gyro: BW= 98Hz, delay= 2.8ms, Fs=1kHz
+#define MPU60X0_LOW_PASS_FILTER_3           (3 << 16) // acc: BW= 44Hz, delay= 4.9ms, Fs=1kHz gyro: BW= 42Hz, delay= 4.8ms, Fs=1kHz
+#define MPU60X0_LOW_PASS_FILTER_4           (4 << 16) // acc: BW= 21Hz, delay= 8.5ms, Fs=1kHz gyro: BW= 20Hz, delay= 8.3ms, Fs=1kHz
+#define MPU60X0_LOW_PASS_FILTER_5           (5 << 16) // acc: BW= 10Hz, delay=13.8ms, Fs=1kHz gyro: BW= 10Hz, delay=13.4ms, Fs=1kHz
+#define MPU60X0_LOW_PASS_FILTER_6           (6 << 16) // acc: BW=  5Hz, delay=19.0ms, Fs=1kHz gyro: BW=  5Hz, delay=18.6ms, Fs=1kHz
+#define MPU60X0_FIFO_ENABLE                 (1 << 24) // accel and gyro samples are queued in the on-chip FIFO
+
+// Human readable settings, converted to config options by mpu60X0_config_make()
+typedef struct {
+    int acc_range_g; // rounded up to 2, 4, 8 or 16
+    int gyro_range_dps; // rounded up to 250, 500, 1000 or 2000
+    int sample_rate_hz; // rounded to the closest rate the device supports
+    int low_pass_filter; // index of MPU60X0_LOW_PASS_FILTER_x, in [0, 6]
+    int fifo_enable;
+} mpu60X0_settings_t;
+
+// builds the mpu60X0_setup() config options, out of range values are clamped
+uint32_t mpu60X0_config_make(const mpu60X0_settings_t *settings);
+// accelerometer resolution in m/s^2 / LSB
+float mpu60X0_config_acc_scale(uint32_t config);
+// gyro resolution in rad/s / LSB
+float mpu60X0_config_gyro_scale(uint32_t config);
+// period between two samples in microseconds
+uint32_t mpu60X0_config_sample_period_us(uint32_t config);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MPU60X0_CONFIG_H
@@ -0,0 +1,237 @@
+#include <string.h>
+#include "vector_math.h"
+
+static inline int16_t saturate(int64_t x)
+{
+    if (x > INT16_MAX) {
+        return INT16_MAX;
+    } else if (x < INT16_MIN) {
+        return INT16_MIN;
+    }
+    return x;
+}
+
+/* Pairs of elements, the first one in the low half. memcpy compiles to
+ * single loads and stores, which the Cortex-M4 allows unaligned. */
+static inline uint32_t load_pair(const int16_t *p)
+{
+    uint32_t x;
+    memcpy(&x, p, sizeof(x));
+    return x;
+}
+
+static inline void store_pair(int16_t *p, uint32_t x)
+{
+    memcpy(p, &x, sizeof(x));
+}
+
+static inline uint32_t pack(int16_t first, int16_t second)
+{
+    return (uint16_t)first | (uint32_t)(uint16_t)second << 16;
+}
+
+static inline int16_t low_half(uint32_t x)
+{
+    return (int16_t)x;
+}
+
+static inline int16_t high_half(uint32_t x)
+{
+    return (int16_t)(x >> 16);
+}
+
+static inline uint32_t qadd16(uint32_t a, uint32_t b)
+{
+#if defined(__ARM_FEATURE_DSP) && __ARM_FEATURE_DSP
+    uint32_t sum;
+    __asm__("qadd16 %0, %1, %2" : "=r"(sum) : "r"(a), "r"(b));
+    return sum;
+#else
+    return pack(saturate(low_half(a) + low_half(b)), saturate(high_half(a) + high_half(b)));
+#endif
+}
+
+static inline uint32_t qsub16(uint32_t a, uint32_t b)
+{
+#if defined(__ARM_FEATURE_DSP) && __ARM_FEATURE_DSP
+    uint32_t difference;
+    __asm__("qsub16 %0, %1, %2" : "=r"(difference) : "r"(a), "r"(b));
+    return difference;
+#else
+    return pack(saturate(low_half(a) - low_half(b)), saturate(high_half(a) - high_half(b)));
+#endif
+}
+
+/* The subtraction sets the GE flags where a >= b, which select from b. */
+static inline uint32_t min16(uint32_t a, uint32_t b)
+{
+#if defined(__ARM_FEATURE_DSP) && __ARM_FEATURE_DSP
+    uint32_t result;
+    __asm__("ssub16 %0, %1, %2\n\t"
+            "sel %0, %2, %1" : "=&r"(result) : "r"(a), "r"(b) : "cc");
+    return result;
+#else
+    int16_t first = low_half(a) < low_half(b) ? low_half(a) : low_half(b);
+    int16_t second = high_half(a) < high_half(b) ? high_half(a) : high_half(b);
+    return pack(first, second);
+#endif
+}
+
+static inline uint32_t max16(uint32_t a, uint32_t b)
+{
+#if defined(__ARM_FEATURE_DSP) && __ARM_FEATURE_DSP
+    uint32_t result;
+    __asm__("ssub16 %0, %1, %2\n\t"
+            "sel %0, %1, %2" : "=&r"(result) : "r"(a), "r"(b) : "cc");
+    return result;
+#else
+    int16_t first = low_half(a) > low_half(b) ? low_half(a) : low_half(b);
+    int16_t second = high_half(a) > high_half(b) ? high_half(a) : high_half(b);
+    return pack(first, second);
+#endif
+}
+
+/* Adds the products of two pairs of elements to a 64 bit acc. */
+static inline int64_t smlald(uint32_t a, uint32_t b, int64_t acc)
+{
+#if defined(__ARM_FEATURE_DSP) && __ARM_FEATURE_DSP
+    __asm__("smlald %Q0, %R0, %1, %2" : "+r"(acc) : "r"(a), "r"(b));
+    return acc;
+#else
+    return acc + (int32_t)low_half(a) * low_half(b) + (int32_t)high_half(a) * high_half(b);
+#endif
+}
+
+void vector_math_fill(int16_t *dest, int16_t value, size_t len)
+{
+    uint32_t pair = pack(value, value);
+    size_t i;
+
+    for (i = 0; i + 1 < len; i += 2) {
+        store_pair(&dest[i], pair);
+    }
+    if (i < len) {
+        dest[i] = value;
+    }
+}
+
+void vector_math_copy(int16_t *dest, const int16_t *src, size_t len)
+{
+    memmove(dest, src, len * sizeof(int16_t));
+}
+
+void vector_math_add(int16_t *dest, const int16_t *a, const int16_t *b, size_t len)
+{
+    size_t i;
+
+    for (i = 0; i + 1 < len; i += 2) {
+        store_pair(&dest[i], qadd16(load_pair(&a[i]), load_pair(&b[i])));
+    }
+    if (i < len) {
+        dest[i] = saturate(a[i] + b[i]);
+    }
+}
+
+void vector_math_sub(int16_t *dest, const int16_t *a, const int16_t *b, size_t len)
+{
+    size_t i;
+
+    for (i = 0; i + 1 < len; i += 2) {
+        store_pair(&dest[i], qsub16(load_pair(&a[i]), load_pair(&b[i])));
+    }
+    if (i < len) {
+        dest[i] = saturate(a[i] - b[i]);
+    }
+}
+
+void vector_math_mul(int16_t *dest, const int16_t *a, const int16_t *b, unsigned shift,
+                     size_t len)
+{
+    size_t i;
+
+    /* There is no SIMD multiplication keeping 16 bits, this compiles to
+     * single cycle 16 bit multiplies. */
+    for (i = 0; i < len; i++) {
+        dest[i] = saturate(((int32_t)a[i] * b[i]) >> shift);
+    }
+}
+
+int16_t vector_math_dot(const int16_t *a, const int16_t *b, unsigned shift, size_t len)
+{
+    int64_t acc = 0;
+    size_t i;
+
+    for (i = 0; i + 1 < len; i += 2) {
+        acc = smlald(load_pair(&a[i]), load_pair(&b[i]), acc);
+    }
+    if (i < len) {
+        acc += (int32_t)a[i] * b[i];
+    }
+
+    return saturate(acc >> shift);
+}
+
+void vector_math_min(int16_t *dest, const int16_t *a, const int16_t *b, size_t len)
+{
+    size_t i;
+
+    for (i = 0; i + 1 < len; i += 2) {
+        store_pair(&dest[i], min16(load_pair(&a[i]), load_pair(&b[i])));
+    }
+    if (i < len) {
+        dest[i] = a[i] < b[i] ? a[i] : b[i];
+    }
+}
+
+void vector_math_max(int16_t *dest, const int16_t *a, const int16_t *b, size_t len)
+{
+    size_t i;
+
+    for (i = 0; i + 1 < len; i += 2) {
+        store_pair(&dest[i], max16(load_pair(&a[i]), load_pair(&b[i])));
+    }
+    if (i < len) {
+        dest[i] = a[i] > b[i] ? a[i] : b[i];
+    }
+}
+
+size_t vector_math_argmax(const int16_t *a, size_t len)
+{
+    size_t i, index = 0;
+
+    for (i = 1; i < len; i++) {
+        if (a[i] > a[index]) {
+            index = i;
+        }
+    }
+
+    return index;
+}
+
+void vector_math_weighted_sum(int16_t *dest, const int16_t *a, const int16_t *b,
+                              int16_t weight_a, int16_t weight_b, unsigned shift, size_t len)
+{
+    uint32_t weights = pack(weight_a, weight_b);
+    size_t i;
+
+    /* Each element of a is paired with the one of b, to be multiplied by
+     * both weights at once. */
+    for (i = 0; i < len; i++) {
+        dest[i] = saturate(smlald(pack(a[i], b[i]), weights, 0) >> shift);
+    }
+}
+
+void vector_math_clamp(int16_t *dest, const int16_t *a, int16_t low, int16_t high, size_t len)
+{
+    uint32_t lows = pack(low, low);
+    uint32_t highs = pack(high, high);
+    size_t i;
+
+    for (i = 0; i + 1 < len; i += 2) {
+        store_pair(&dest[i], min16(max16(load_pair(&a[i]), lows), highs));
+    }
+    if (i < len) {
+        int16_t x = a[i] > low ? a[i] : low;
+        dest[i] = x < high ? x : high;
+    }
+}
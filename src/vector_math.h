@@ -0,0 +1,59 @@
+#ifndef VECTOR_MATH_H
+#define VECTOR_MATH_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** Operations on arrays of 16 bit integers, such as the proximity readings.
+ *
+ * Pairs of elements are processed with the Cortex-M4 SIMD instructions,
+ * with a portable fallback on other targets. Results which do not fit in
+ * 16 bits saturate instead of wrapping around. dest may be one of the
+ * sources, but must not partially overlap them. Shifts must be below 32.
+ */
+
+/** Sets every element of dest to value. */
+void vector_math_fill(int16_t *dest, int16_t value, size_t len);
+
+/** Copies src to dest, which may overlap. */
+void vector_math_copy(int16_t *dest, const int16_t *src, size_t len);
+
+/** dest = a + b */
+void vector_math_add(int16_t *dest, const int16_t *a, const int16_t *b, size_t len);
+
+/** dest = a - b */
+void vector_math_sub(int16_t *dest, const int16_t *a, const int16_t *b, size_t len);
+
+/** dest = (a * b) >> shift */
+void vector_math_mul(int16_t *dest, const int16_t *a, const int16_t *b, unsigned shift,
+                     size_t len);
+
+/** Returns the sum of a * b, shifted right by shift. */
+int16_t vector_math_dot(const int16_t *a, const int16_t *b, unsigned shift, size_t len);
+
+/** dest = min(a, b) */
+void vector_math_min(int16_t *dest, const int16_t *a, const int16_t *b, size_t len);
+
+/** dest = max(a, b) */
+void vector_math_max(int16_t *dest, const int16_t *a, const int16_t *b, size_t len);
+
+/** Returns the index of the largest element, the first one if there are
+ * several. len must not be 0. */
+size_t vector_math_argmax(const int16_t *a, size_t len);
+
+/** dest = (a * weight_a + b * weight_b) >> shift */
+void vector_math_weighted_sum(int16_t *dest, const int16_t *a, const int16_t *b,
+                              int16_t weight_a, int16_t weight_b, unsigned shift, size_t len);
+
+/** dest = a, limited to [low, high] */
+void vector_math_clamp(int16_t *dest, const int16_t *a, int16_t low, int16_t high, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* VECTOR_MATH_H */
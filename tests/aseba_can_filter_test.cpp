@@ -0,0 +1,262 @@
+#include <CppUTest/TestHarness.h>
+#include <cstdint>
+#include <deque>
+#include <random>
+#include <set>
+#include <vector>
+#include "aseba_vm/aseba_can_filter.h"
+
+static const uint16_t node_id = 7;
+
+/* Mirrors AsebaVMShouldDropPacket(), with the set of events the loaded
+ * bytecode handles. */
+static uint16_t should_drop(void *arg, uint16_t source, const uint8_t *data)
+{
+    const std::set<uint16_t> *handled = static_cast<const std::set<uint16_t> *>(arg);
+    uint16_t type = data[0] | data[1] << 8;
+    uint16_t dest = data[2] | data[3] << 8;
+
+    (void)source;
+
+    if (type < 0x8000) {
+        return handled->count(type) == 0;
+    } else if (type >= 0xa000) {
+        if (type == 0xa000) {
+            return 0;
+        }
+        return dest != node_id;
+    }
+    return 1;
+}
+
+struct bus_frame {
+    uint16_t id;
+    bool ide;
+    bool rtr;
+    uint8_t len;
+    uint8_t data[8];
+    bool for_us; /**< Part of a packet Aseba would accept. */
+};
+
+/* Frames of 20 nodes and an IDE sending packets at the same time, so that
+ * their frames are interleaved, plus traffic of another protocol. */
+struct bus_generator {
+    std::mt19937 rng;
+    std::vector<std::deque<bus_frame> > pending;
+    const std::set<uint16_t> *handled;
+
+    bus_generator(const std::set<uint16_t> *handled) : rng(1234), pending(21), handled(handled)
+    {
+    }
+
+    int random(int max)
+    {
+        return std::uniform_int_distribution<int>(0, max - 1)(rng);
+    }
+
+    void queue_packet(uint16_t source, const std::vector<uint8_t> &packet)
+    {
+        bool for_us = !should_drop(const_cast<std::set<uint16_t> *>(handled), source,
+                                   packet.data());
+        size_t pos = 0;
+
+        do {
+            bus_frame frame = {0, false, false, 0, {0}, for_us};
+            size_t left = packet.size() - pos;
+            uint16_t type;
+
+            if (packet.size() <= 8) {
+                type = ASEBA_CAN_TYPE_SMALL;
+            } else if (pos == 0) {
+                type = ASEBA_CAN_TYPE_START;
+            } else if (left <= 8) {
+                type = ASEBA_CAN_TYPE_STOP;
+            } else {
+                type = ASEBA_CAN_TYPE_NORMAL;
+            }
+
+            frame.id = type << 8 | source;
+            frame.len = left < 8 ? left : 8;
+            for (int i = 0; i < frame.len; i++) {
+                frame.data[i] = packet[pos + i];
+            }
+            pos += frame.len;
+            pending[source].push_back(frame);
+        } while (pos < packet.size());
+    }
+
+    std::vector<uint8_t> message(uint16_t type, size_t words)
+    {
+        std::vector<uint8_t> packet = {(uint8_t)type, (uint8_t)(type >> 8)};
+        for (size_t i = 0; i < words; i++) {
+            packet.push_back(random(256));
+            packet.push_back(random(256));
+        }
+        return packet;
+    }
+
+    void new_packet(uint16_t source)
+    {
+        std::vector<uint8_t> packet;
+
+        if (source == 0) {
+            /* IDE commands to any node, or descriptions requests. */
+            uint16_t dest = 1 + random(20);
+            switch (random(3)) {
+                case 0: packet = message(0xa000, 1); break;
+                case 1: packet = message(0xa001, 1 + random(40)); break;
+                default: packet = message(0xa002 + random(6), 0); break;
+            }
+            if (packet.size() >= 4) {
+                packet[2] = dest;
+                packet[3] = 0;
+            } else {
+                packet.push_back(dest);
+                packet.push_back(0);
+            }
+        } else if (random(2)) {
+            /* User events. */
+            packet = message(random(16), random(8));
+        } else {
+            /* Replies of the nodes to the IDE. */
+            packet = message(0x9000 + random(16), 1 + random(30));
+        }
+
+        queue_packet(source, packet);
+    }
+
+    bus_frame next()
+    {
+        bus_frame frame = {0, false, false, 8, {0}, false};
+
+        /* Another protocol on the same bus. */
+        switch (random(20)) {
+            case 0: frame.id = random(0x800); frame.ide = true; return frame;
+            case 1: frame.id = random(0x800); frame.rtr = true; return frame;
+            case 2: frame.id = 0x400 + random(0x400); return frame;
+        }
+
+        uint16_t source = random(pending.size());
+        if (source == node_id) {
+            source = 0;
+        }
+        if (pending[source].empty()) {
+            new_packet(source);
+        }
+        frame = pending[source].front();
+        pending[source].pop_front();
+        return frame;
+    }
+};
+
+TEST_GROUP(AsebaCanFilterTestGroup)
+{
+    aseba_can_filter_t banks[ASEBA_CAN_FILTER_COUNT];
+    aseba_can_demux_t demux;
+    std::set<uint16_t> handled = {1, 4};
+
+    void setup()
+    {
+        aseba_can_filter_banks(banks);
+        aseba_can_demux_init(&demux, should_drop, &handled);
+    }
+
+    int match(uint16_t id, bool ide = false, bool rtr = false)
+    {
+        return aseba_can_filter_match(banks, ASEBA_CAN_FILTER_COUNT, id, ide, rtr);
+    }
+
+    bool accept(uint16_t id, std::vector<uint8_t> data)
+    {
+        data.resize(8);
+        return aseba_can_demux_accept(&demux, match(id), id, data.data(), data.size());
+    }
+};
+
+TEST(AsebaCanFilterTestGroup, BanksSortFramesByType)
+{
+    for (uint16_t source = 0; source < 256; source++) {
+        CHECK_EQUAL(ASEBA_CAN_FILTER_SMALL, match(0x300 | source));
+        CHECK_EQUAL(ASEBA_CAN_FILTER_START, match(0x100 | source));
+        CHECK_EQUAL(ASEBA_CAN_FILTER_CONTINUATION, match(0x000 | source));
+        CHECK_EQUAL(ASEBA_CAN_FILTER_CONTINUATION, match(0x200 | source));
+    }
+}
+
+TEST(AsebaCanFilterTestGroup, BanksRejectOtherFrames)
+{
+    for (uint16_t id = 0; id < 0x800; id++) {
+        CHECK_EQUAL(-1, match(id, true, false));
+        CHECK_EQUAL(-1, match(id, false, true));
+        if (id >= 0x400) {
+            CHECK_EQUAL(-1, match(id));
+        }
+    }
+}
+
+TEST(AsebaCanFilterTestGroup, SmallPacketsAreChecked)
+{
+    CHECK_TRUE(accept(0x303, {1, 0}));
+    CHECK_FALSE(accept(0x303, {2, 0}));
+    CHECK_TRUE(accept(0x300, {0x00, 0xa0}));
+    CHECK_TRUE(accept(0x300, {0x02, 0xa0, node_id, 0}));
+    CHECK_FALSE(accept(0x300, {0x02, 0xa0, node_id + 1, 0}));
+
+    CHECK_EQUAL(3, demux.stats.accepted);
+    CHECK_EQUAL(2, demux.stats.dropped);
+    CHECK_EQUAL(5, demux.stats.filter_hits[ASEBA_CAN_FILTER_SMALL]);
+}
+
+TEST(AsebaCanFilterTestGroup, PacketFollowsItsFirstFrame)
+{
+    CHECK_FALSE(accept(0x103, {2, 0}));
+    CHECK_TRUE(accept(0x104, {4, 0}));
+    CHECK_FALSE(accept(0x003, {4, 0}));
+    CHECK_TRUE(accept(0x004, {2, 0}));
+    CHECK_FALSE(accept(0x203, {}));
+    CHECK_TRUE(accept(0x204, {}));
+
+    /* The next packet of the source is checked again. */
+    CHECK_TRUE(accept(0x103, {4, 0}));
+    CHECK_TRUE(accept(0x203, {}));
+
+    CHECK_EQUAL(3, demux.stats.filter_hits[ASEBA_CAN_FILTER_START]);
+    CHECK_EQUAL(5, demux.stats.filter_hits[ASEBA_CAN_FILTER_CONTINUATION]);
+}
+
+TEST(AsebaCanFilterTestGroup, ShortFramesAreLeftToAseba)
+{
+    uint8_t data[8] = {2};
+
+    CHECK_TRUE(aseba_can_demux_accept(&demux, ASEBA_CAN_FILTER_SMALL, 0x303, data, 1));
+}
+
+TEST(AsebaCanFilterTestGroup, TwentyNodeBus)
+{
+    const uint32_t frame_count = 200000;
+    bus_generator bus(&handled);
+    uint32_t hits[ASEBA_CAN_FILTER_COUNT] = {0};
+    uint32_t rejected = 0, for_us = 0;
+
+    for (uint32_t i = 0; i < frame_count; i++) {
+        bus_frame frame = bus.next();
+        int filter = match(frame.id, frame.ide, frame.rtr);
+
+        if (filter < 0) {
+            CHECK_TRUE(frame.ide || frame.rtr || frame.id >= 0x400);
+            rejected++;
+            continue;
+        }
+
+        hits[filter]++;
+        for_us += frame.for_us;
+        CHECK_EQUAL(frame.for_us, aseba_can_demux_accept(&demux, filter, frame.id, frame.data,
+                                                         frame.len));
+    }
+
+    for (int i = 0; i < ASEBA_CAN_FILTER_COUNT; i++) {
+        CHECK_EQUAL(hits[i], demux.stats.filter_hits[i]);
+    }
+    CHECK_EQUAL(for_us, demux.stats.accepted);
+    CHECK_EQUAL(frame_count - rejected - for_us, demux.stats.dropped);
+}
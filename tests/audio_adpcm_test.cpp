@@ -0,0 +1,444 @@
+#include <CppUTest/TestHarness.h>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <ff.h>
+#include "audio/audio_adpcm.h"
+#include "audio/audio_bank.h"
+#include "audio/audio_wav.h"
+#include "fatfs_image_mock.h"
+
+/* Reference data, encoded and decoded by the IMA ADPCM codec of Python's
+ * audioop module, starting from a zero state: a 440Hz sine, a loud 2500Hz
+ * burst and a full scale square wave. Nibbles are in WAV order. */
+static const uint8_t reference_codes[80] = {
+    0x70, 0x77, 0x77, 0x77, 0x81, 0x80, 0x89, 0x9a, 0xba, 0xbb, 0xcb, 0xab,
+    0xab, 0x89, 0x10, 0x52, 0x53, 0x34, 0x34, 0x33, 0x24, 0x22, 0x11, 0x98,
+    0xba, 0xbe, 0xbd, 0xdb, 0xba, 0xbb, 0xf7, 0xff, 0x45, 0xb0, 0x8d, 0x42,
+    0x91, 0xac, 0x41, 0x02, 0xbc, 0x20, 0x05, 0xba, 0x2a, 0x34, 0xca, 0x0b,
+    0x34, 0xc0, 0x8c, 0x42, 0x91, 0xac, 0x41, 0x88, 0x00, 0x08, 0x08, 0x80,
+    0x08, 0x08, 0x88, 0x88, 0x88, 0xff, 0x37, 0x00, 0xaf, 0x08, 0x17, 0x00,
+    0xaf, 0x80, 0x27, 0x00, 0xaf, 0x80, 0x27, 0x00
+};
+
+static const int16_t reference_samples[160] = {
+    0, 11, 41, 104, 240, 533, 1164, 2521, 3103, 2927,
+    3087, 2942, 2545, 2425, 1878, 1580, 1128, 553, 31, -445,
+    -876, -1381, -1857, -2165, -2557, -2812, -2950, -2992, -2954, -2851,
+    -2694, -2379, -2085, -1664, -1159, -683, -128, 394, 870, 1301,
+    1806, 2146, 2454, 2734, 2887, 3025, 2983, 2869, 2696, 2476,
+    2103, 1746, 1237, 761, 330, -287, -698, -1220, -1696, -2127,
+    -1286, -3090, -6963, -15265, -2213, 13423, 15525, 2148, -16962, -19505,
+    -7943, 10977, 18607, 11670, -7250, -19968, -13031, 5889, 18607, 20919,
+    1999, -15806, -13494, -2983, 18039, 20837, 8119, -8068, -18579, -9024,
+    6612, 21327, 11772, -3864, -18579, -16668, -1032, 13683, 15594, -42,
+    -18962, -21505, -9943, 8977, 16607, 9670, -9250, -21968, -15031, 3889,
+    1346, -966, 1136, 3047, 1310, 2889, 1454, 2759, 3945, 2867,
+    1887, 2778, 1968, 2704, 2035, 1427, 874, 371, -86, -501,
+    -6171, -18328, 7731, 32767, 32767, 32767, -9204, -29682, -32768, -29383,
+    16783, 29069, 32767, 32767, -13399, -32768, -29044, -32429, 13737, 32767,
+    32767, 32767, -13399, -32768, -29044, -32429, 13737, 32767, 32767, 32767
+};
+
+/* Compressed data read from memory in pieces of at most max_len bytes. */
+struct memory_source {
+    const uint8_t *data;
+    size_t left;
+    size_t max_len;
+};
+
+static size_t memory_read(void *arg, uint8_t *buffer, size_t len)
+{
+    memory_source *source = static_cast<memory_source *>(arg);
+
+    if (len > source->max_len) {
+        len = source->max_len;
+    }
+    if (len > source->left) {
+        len = source->left;
+    }
+
+    memcpy(buffer, source->data, len);
+    source->data += len;
+    source->left -= len;
+    return len;
+}
+
+/* Appends a block made of a zero state header and the reference codes. */
+static void append_reference_block(std::vector<uint8_t> &data)
+{
+    const uint8_t header[AUDIO_ADPCM_BLOCK_HEADER] = {0, 0, 0, 0};
+
+    data.insert(data.end(), header, header + sizeof(header));
+    data.insert(data.end(), reference_codes, reference_codes + sizeof(reference_codes));
+}
+
+/* Block of the reference data, as decoded. */
+static int16_t reference_block_sample(size_t i)
+{
+    return i == 0 ? 0 : reference_samples[i - 1];
+}
+
+static const uint32_t reference_block_align = AUDIO_ADPCM_BLOCK_HEADER + 80;
+
+TEST_GROUP(AudioAdpcmTestGroup)
+{
+};
+
+TEST(AudioAdpcmTestGroup, MatchesReferenceDecoder)
+{
+    audio_adpcm_state_t state = {0, 0};
+    int16_t out[160];
+
+    audio_adpcm_decode(&state, reference_codes, out, 160);
+
+    for (int i = 0; i < 160; i++) {
+        CHECK_EQUAL(reference_samples[i], out[i]);
+    }
+}
+
+TEST(AudioAdpcmTestGroup, StateIsKeptBetweenCalls)
+{
+    audio_adpcm_state_t state = {0, 0};
+    int16_t out[160];
+
+    audio_adpcm_decode(&state, reference_codes, out, 60);
+    audio_adpcm_decode(&state, &reference_codes[30], &out[60], 100);
+
+    for (int i = 0; i < 160; i++) {
+        CHECK_EQUAL(reference_samples[i], out[i]);
+    }
+}
+
+TEST(AudioAdpcmTestGroup, SampleCount)
+{
+    CHECK_EQUAL(1017, AUDIO_ADPCM_SAMPLES_PER_BLOCK(512));
+    CHECK_EQUAL(2 * 1017, audio_adpcm_sample_count(512, 1024));
+
+    /* A last block which is shorter. */
+    CHECK_EQUAL(1017 + 3, audio_adpcm_sample_count(512, 512 + 5));
+    CHECK_EQUAL(1017, audio_adpcm_sample_count(512, 512 + 3));
+
+    CHECK_EQUAL(0, audio_adpcm_sample_count(4, 1024));
+}
+
+TEST_GROUP(AudioAdpcmDecoderTestGroup)
+{
+    std::vector<uint8_t> data;
+    memory_source source;
+    audio_adpcm_decoder_t decoder;
+    int16_t out[400];
+
+    void start(size_t max_len = SIZE_MAX, uint32_t block_align = reference_block_align)
+    {
+        source.data = data.data();
+        source.left = data.size();
+        source.max_len = max_len;
+        audio_adpcm_decoder_init(&decoder, block_align, data.size(), memory_read,
+                                 &source);
+    }
+};
+
+TEST(AudioAdpcmDecoderTestGroup, DecodesBlocks)
+{
+    size_t n;
+
+    append_reference_block(data);
+    append_reference_block(data);
+    start();
+
+    CHECK_TRUE(audio_adpcm_decoder_read(&decoder, out, 400, &n));
+    CHECK_EQUAL(2 * 161, n);
+
+    /* Every block starts from its own header. */
+    for (size_t i = 0; i < n; i++) {
+        CHECK_EQUAL(reference_block_sample(i % 161), out[i]);
+    }
+}
+
+TEST(AudioAdpcmDecoderTestGroup, OddReadSizes)
+{
+    const size_t sizes[] = {1, 2, 3, 7, 64, 5, 1, 300};
+    size_t pos = 0, n;
+    bool end = false;
+
+    append_reference_block(data);
+    append_reference_block(data);
+    start(9);
+
+    for (size_t i = 0; !end; i++) {
+        CHECK(i < sizeof(sizes) / sizeof(sizes[0]));
+        end = audio_adpcm_decoder_read(&decoder, &out[pos], sizes[i], &n);
+        CHECK(n <= sizes[i]);
+        if (!end) {
+            CHECK_EQUAL(sizes[i], n);
+        }
+        pos += n;
+    }
+
+    CHECK_EQUAL(2 * 161, pos);
+    for (size_t i = 0; i < pos; i++) {
+        CHECK_EQUAL(reference_block_sample(i % 161), out[i]);
+    }
+}
+
+TEST(AudioAdpcmDecoderTestGroup, ShorterLastBlock)
+{
+    size_t n;
+
+    append_reference_block(data);
+    append_reference_block(data);
+    data.resize(reference_block_align + AUDIO_ADPCM_BLOCK_HEADER + 10);
+    start();
+
+    CHECK_TRUE(audio_adpcm_decoder_read(&decoder, out, 400, &n));
+    CHECK_EQUAL(161 + 21, n);
+    CHECK_EQUAL(audio_adpcm_sample_count(reference_block_align, data.size()), n);
+    CHECK_EQUAL(reference_block_sample(20), out[161 + 20]);
+}
+
+TEST(AudioAdpcmDecoderTestGroup, InvalidHeaderEndsTheSound)
+{
+    size_t n;
+
+    append_reference_block(data);
+    append_reference_block(data);
+    data[reference_block_align + 2] = 89;
+    start();
+
+    CHECK_TRUE(audio_adpcm_decoder_read(&decoder, out, 400, &n));
+    CHECK_EQUAL(161, n);
+}
+
+TEST(AudioAdpcmDecoderTestGroup, ReadErrorEndsTheSound)
+{
+    size_t n;
+
+    append_reference_block(data);
+    start();
+    source.left = 30;
+
+    CHECK_TRUE(audio_adpcm_decoder_read(&decoder, out, 400, &n));
+    CHECK_EQUAL(1 + 2 * 26, n);
+}
+
+TEST(AudioAdpcmDecoderTestGroup, CompressedBankClip)
+{
+    uint32_t pool[100];
+    audio_bank_entry_t entries[1];
+    audio_bank_t bank;
+    audio_clip_t clip;
+    size_t n;
+
+    append_reference_block(data);
+    start();
+    audio_bank_init(&bank, reinterpret_cast<uint8_t *>(pool), sizeof(pool), entries, 1);
+
+    /* Stored as a quarter of the decoded size. */
+    CHECK_TRUE(audio_bank_load(&bank, "/p0.wav", 16000, reference_block_align, data.size(),
+                               memory_read, &source));
+    CHECK_EQUAL(reference_block_align, bank.used);
+
+    audio_clip_init(&clip, &bank, audio_bank_find(&bank, "/p0.wav"));
+    CHECK_FALSE(audio_clip_read(&clip, out, 100, &n));
+    CHECK_EQUAL(100, n);
+    CHECK_TRUE(audio_clip_read(&clip, &out[100], 100, &n));
+    CHECK_EQUAL(61, n);
+
+    for (size_t i = 0; i < 161; i++) {
+        CHECK_EQUAL(reference_block_sample(i), out[i]);
+    }
+}
+
+/* Only prints the throughput on the host, ignored unless the tests are run
+ * with -ri. */
+IGNORE_TEST(AudioAdpcmDecoderTestGroup, DecodeBenchmark)
+{
+    /* Blocks of 256 bytes, as written by common encoders at 16kHz. */
+    const uint32_t block_align = 256;
+    const int rounds = 2000;
+    static int16_t samples[AUDIO_ADPCM_SAMPLES_PER_BLOCK(256) * 16];
+    uint64_t ns = 0;
+    size_t n = 0;
+
+    data.resize(block_align * 16);
+    for (size_t i = 0; i < data.size(); i++) {
+        data[i] = reference_codes[i % sizeof(reference_codes)];
+        if (i % block_align == 2) {
+            data[i] = 40;
+        }
+    }
+
+    for (int round = 0; round < rounds; round++) {
+        start(SIZE_MAX, block_align);
+        auto begin = std::chrono::steady_clock::now();
+        audio_adpcm_decoder_read(&decoder, samples, sizeof(samples) / sizeof(samples[0]), &n);
+        auto end = std::chrono::steady_clock::now();
+        ns += std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count();
+    }
+
+    CHECK_EQUAL(sizeof(samples) / sizeof(samples[0]), n);
+    printf("\nIMA ADPCM: %.2f ns per sample on the host, %u instead of %u bytes per second "
+           "read from the card at 16kHz\n",
+           (double)ns / rounds / n,
+           (unsigned)(16000 * block_align / AUDIO_ADPCM_SAMPLES_PER_BLOCK(block_align)),
+           (unsigned)(16000 * sizeof(int16_t)));
+}
+
+/* Writes a mono WAV file with the given format chunk and data, with an
+ * unknown chunk of odd size before the data. */
+static void write_wav(const char *path, const uint8_t *format, size_t format_len,
+                      const uint8_t *data, size_t data_len)
+{
+    std::vector<uint8_t> file;
+    FIL fil;
+    UINT n;
+
+    auto append = [&file](const void *bytes, size_t len) {
+        const uint8_t *p = static_cast<const uint8_t *>(bytes);
+        file.insert(file.end(), p, p + len);
+    };
+    auto append_u32 = [&file](uint32_t value) {
+        for (int i = 0; i < 4; i++) {
+            file.push_back(value >> (8 * i));
+        }
+    };
+
+    append("RIFF", 4);
+    append_u32(0);
+    append("WAVE", 4);
+    append("fmt ", 4);
+    append_u32(format_len);
+    append(format, format_len);
+    append("LIST", 4);
+    append_u32(3);
+    append("abc\0", 4);
+    append("data", 4);
+    append_u32(data_len);
+    append(data, data_len);
+
+    CHECK_EQUAL(FR_OK, f_open(&fil, path, FA_WRITE | FA_CREATE_ALWAYS));
+    CHECK_EQUAL(FR_OK, f_write(&fil, file.data(), file.size(), &n));
+    CHECK_EQUAL(file.size(), n);
+    CHECK_EQUAL(FR_OK, f_close(&fil));
+}
+
+TEST_GROUP(AudioWavTestGroup)
+{
+    FIL file;
+    struct wav_data wav;
+    int16_t out[400];
+
+    void setup()
+    {
+        fatfs_image_mock_create(1024);
+    }
+
+    void teardown()
+    {
+        fatfs_image_mock_destroy();
+    }
+
+    void open(const char *path)
+    {
+        CHECK_EQUAL(FR_OK, f_open(&file, path, FA_READ));
+    }
+
+    /* Reads the whole file in pieces of len samples. */
+    size_t read_all(size_t len)
+    {
+        size_t pos = 0, n;
+        bool end;
+
+        do {
+            end = wav_read_cb(&wav, &out[pos], len, &n);
+            pos += n;
+        } while (!end && pos + len <= 400);
+
+        return pos;
+    }
+};
+
+TEST(AudioWavTestGroup, Pcm)
+{
+    const uint8_t format[16] = {
+        1, 0, 1, 0, 0x80, 0x3e, 0, 0, 0, 0x7d, 0, 0, 2, 0, 16, 0,
+    };
+    int16_t samples[100];
+
+    for (int i = 0; i < 100; i++) {
+        samples[i] = 100 * i - 5000;
+    }
+    write_wav("/pcm.wav", format, sizeof(format), reinterpret_cast<uint8_t *>(samples),
+              sizeof(samples));
+    open("/pcm.wav");
+
+    CHECK_EQUAL(0, wav_read_header(&wav, &file));
+    CHECK_EQUAL(WAV_FORMAT_PCM, wav.format);
+    CHECK_EQUAL(16000, wav.sample_rate);
+    CHECK_EQUAL(100, wav_sample_count(&wav));
+
+    CHECK_EQUAL(100, read_all(33));
+    for (int i = 0; i < 100; i++) {
+        CHECK_EQUAL(samples[i], out[i]);
+    }
+}
+
+TEST(AudioWavTestGroup, ImaAdpcm)
+{
+    /* Longer format chunk holding the samples per block. */
+    const uint8_t format[20] = {
+        0x11, 0, 1, 0, 0x40, 0x1f, 0, 0, 0, 0x10, 0, 0, reference_block_align, 0, 4, 0,
+        2, 0, 161, 0,
+    };
+    std::vector<uint8_t> data;
+
+    append_reference_block(data);
+    append_reference_block(data);
+    write_wav("/adpcm.wav", format, sizeof(format), data.data(), data.size());
+    open("/adpcm.wav");
+
+    CHECK_EQUAL(0, wav_read_header(&wav, &file));
+    CHECK_EQUAL(WAV_FORMAT_IMA_ADPCM, wav.format);
+    CHECK_EQUAL(8000, wav.sample_rate);
+    CHECK_EQUAL(2 * 161, wav_sample_count(&wav));
+
+    CHECK_EQUAL(2 * 161, read_all(51));
+    for (size_t i = 0; i < 2 * 161; i++) {
+        CHECK_EQUAL(reference_block_sample(i % 161), out[i]);
+    }
+}
+
+TEST(AudioWavTestGroup, UnsupportedFormats)
+{
+    /* 8 bit PCM. */
+    const uint8_t pcm8[16] = {
+        1, 0, 1, 0, 0x80, 0x3e, 0, 0, 0x80, 0x3e, 0, 0, 1, 0, 8, 0,
+    };
+    /* Stereo. */
+    const uint8_t stereo[16] = {
+        1, 0, 2, 0, 0x80, 0x3e, 0, 0, 0, 0xfa, 0, 0, 4, 0, 16, 0,
+    };
+    /* No sample rate. */
+    const uint8_t no_rate[16] = {
+        1, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 0, 16, 0,
+    };
+    const uint8_t data[4] = {0};
+
+    write_wav("/pcm8.wav", pcm8, sizeof(pcm8), data, sizeof(data));
+    write_wav("/stereo.wav", stereo, sizeof(stereo), data, sizeof(data));
+    write_wav("/norate.wav", no_rate, sizeof(no_rate), data, sizeof(data));
+
+    open("/pcm8.wav");
+    CHECK_EQUAL(-1, wav_read_header(&wav, &file));
+    f_close(&file);
+
+    open("/stereo.wav");
+    CHECK_EQUAL(-1, wav_read_header(&wav, &file));
+    f_close(&file);
+
+    open("/norate.wav");
+    CHECK_EQUAL(-1, wav_read_header(&wav, &file));
+}
@@ -0,0 +1,187 @@
+#include <CppUTest/TestHarness.h>
+#include <cstdint>
+#include <cstring>
+#include "audio/audio_bank.h"
+#include "audio/audio_mixer.h"
+
+/* Data of a 16 bit PCM file holding a ramp, ending after a given number of
+ * samples. */
+struct ramp_source {
+    int16_t next;
+    size_t left;
+    size_t calls;
+};
+
+static size_t ramp_read(void *arg, uint8_t *buffer, size_t len)
+{
+    ramp_source *ramp = static_cast<ramp_source *>(arg);
+    size_t i;
+
+    len /= sizeof(int16_t);
+    if (len > ramp->left) {
+        len = ramp->left;
+    }
+
+    for (i = 0; i < len; i++) {
+        buffer[2 * i] = ramp->next & 0xff;
+        buffer[2 * i + 1] = (uint16_t)ramp->next >> 8;
+        ramp->next++;
+    }
+
+    ramp->left -= len;
+    ramp->calls++;
+    return len * sizeof(int16_t);
+}
+
+TEST_GROUP(AudioBankTestGroup)
+{
+    uint32_t pool[500];
+    audio_bank_entry_t entries[3];
+    audio_bank_t bank;
+    ramp_source ramp;
+
+    void setup()
+    {
+        audio_bank_init(&bank, reinterpret_cast<uint8_t *>(pool), 2000, entries, 3);
+        ramp.next = 0;
+        ramp.left = 1000;
+        ramp.calls = 0;
+    }
+
+    int16_t *samples()
+    {
+        return reinterpret_cast<int16_t *>(pool);
+    }
+};
+
+TEST(AudioBankTestGroup, StartsEmpty)
+{
+    POINTERS_EQUAL(NULL, audio_bank_find(&bank, "/p0.wav"));
+}
+
+TEST(AudioBankTestGroup, LoadedClipsAreFound)
+{
+    CHECK_TRUE(audio_bank_load(&bank, "/p0.wav", 16000, 0, 600, ramp_read, &ramp));
+    CHECK_TRUE(audio_bank_load(&bank, "/p1.wav", 8000, 0, 400, ramp_read, &ramp));
+
+    const audio_bank_entry_t *entry = audio_bank_find(&bank, "/p1.wav");
+    CHECK(entry != NULL);
+    CHECK_EQUAL(8000, entry->sample_rate);
+    CHECK_EQUAL(600, entry->offset);
+    CHECK_EQUAL(400, entry->size);
+
+    CHECK_EQUAL(300, samples()[300]);
+    CHECK_EQUAL(499, samples()[499]);
+}
+
+TEST(AudioBankTestGroup, NamesIgnoreCase)
+{
+    audio_bank_load(&bank, "/p0.wav", 16000, 0, 20, ramp_read, &ramp);
+
+    CHECK(audio_bank_find(&bank, "/P0.WAV") != NULL);
+    POINTERS_EQUAL(NULL, audio_bank_find(&bank, "/p0.wa"));
+    POINTERS_EQUAL(NULL, audio_bank_find(&bank, "/p0.wavx"));
+}
+
+TEST(AudioBankTestGroup, SourceIsReadInChunks)
+{
+    ramp.left = 1000;
+
+    CHECK_TRUE(audio_bank_load(&bank, "/p0.wav", 16000, 0, 2000, ramp_read, &ramp));
+
+    CHECK(ramp.calls > 1);
+    for (int i = 0; i < 1000; i++) {
+        CHECK_EQUAL(i, samples()[i]);
+    }
+}
+
+TEST(AudioBankTestGroup, TooLongClipIsNotLoaded)
+{
+    audio_bank_load(&bank, "/p0.wav", 16000, 0, 1800, ramp_read, &ramp);
+
+    CHECK_FALSE(audio_bank_load(&bank, "/p1.wav", 16000, 0, 202, ramp_read, &ramp));
+    POINTERS_EQUAL(NULL, audio_bank_find(&bank, "/p1.wav"));
+
+    /* A shorter one still fits. */
+    CHECK_TRUE(audio_bank_load(&bank, "/p2.wav", 16000, 0, 200, ramp_read, &ramp));
+}
+
+TEST(AudioBankTestGroup, IndexIsLimited)
+{
+    for (int i = 0; i < 3; i++) {
+        CHECK_TRUE(audio_bank_load(&bank, "/a.wav", 16000, 0, 2, ramp_read, &ramp));
+    }
+
+    CHECK_FALSE(audio_bank_load(&bank, "/b.wav", 16000, 0, 2, ramp_read, &ramp));
+}
+
+TEST(AudioBankTestGroup, LongNamesAreRejected)
+{
+    CHECK_FALSE(audio_bank_load(&bank, "/sound_12.wav", 16000, 0, 2, ramp_read, &ramp));
+}
+
+TEST(AudioBankTestGroup, ClipWithoutSampleRateIsRejected)
+{
+    CHECK_FALSE(audio_bank_load(&bank, "/p0.wav", 0, 0, 2, ramp_read, &ramp));
+
+    POINTERS_EQUAL(NULL, audio_bank_find(&bank, "/p0.wav"));
+}
+
+TEST(AudioBankTestGroup, TruncatedSourceIsNotLoaded)
+{
+    ramp.left = 299;
+
+    CHECK_FALSE(audio_bank_load(&bank, "/p0.wav", 16000, 0, 600, ramp_read, &ramp));
+
+    POINTERS_EQUAL(NULL, audio_bank_find(&bank, "/p0.wav"));
+    CHECK_EQUAL(0, bank.used);
+}
+
+TEST(AudioBankTestGroup, ClearRemovesEverything)
+{
+    audio_bank_load(&bank, "/p0.wav", 16000, 0, 1800, ramp_read, &ramp);
+
+    audio_bank_clear(&bank);
+
+    POINTERS_EQUAL(NULL, audio_bank_find(&bank, "/p0.wav"));
+    ramp.left = 1000;
+    CHECK_TRUE(audio_bank_load(&bank, "/p1.wav", 16000, 0, 2000, ramp_read, &ramp));
+}
+
+TEST(AudioBankTestGroup, ClipPlaysTheSamples)
+{
+    audio_clip_t clip;
+    int16_t out[64];
+    size_t n;
+
+    audio_bank_load(&bank, "/p0.wav", 16000, 0, 20, ramp_read, &ramp);
+    audio_bank_load(&bank, "/p1.wav", 16000, 0, 200, ramp_read, &ramp);
+    audio_clip_init(&clip, &bank, audio_bank_find(&bank, "/p1.wav"));
+
+    CHECK_FALSE(audio_clip_read(&clip, out, 64, &n));
+    CHECK_EQUAL(64, n);
+    CHECK_EQUAL(10, out[0]);
+
+    CHECK_TRUE(audio_clip_read(&clip, out, 64, &n));
+    CHECK_EQUAL(36, n);
+    CHECK_EQUAL(109, out[35]);
+}
+
+TEST(AudioBankTestGroup, ClipStartsOnTheNextDacBuffer)
+{
+    audio_mixer_t mixer;
+    audio_clip_t clip;
+    int16_t out[500];
+
+    audio_mixer_init(&mixer, 16000);
+    audio_bank_load(&bank, "/p0.wav", 16000, 0, 2000, ramp_read, &ramp);
+    audio_clip_init(&clip, &bank, audio_bank_find(&bank, "/p0.wav"));
+
+    /* Nothing has to be read from the card before playing. */
+    audio_mixer_play(&mixer, audio_mixer_reserve(&mixer), 0, 16000, NULL, audio_clip_read, &clip);
+    audio_mixer_render(&mixer, out, 500);
+
+    CHECK_EQUAL(500, mixer.voices[0].position);
+    CHECK_EQUAL(0, out[0]);
+    CHECK_EQUAL(499, out[499]);
+}
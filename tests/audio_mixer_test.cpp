@@ -0,0 +1,347 @@
+#include <CppUTest/TestHarness.h>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include "audio/audio_mixer.h"
+#include "audio/audio_pcm.h"
+#include "audio/audio_tone.h"
+
+/* Source producing a constant value for a given number of samples. */
+struct constant_source {
+    int16_t value;
+    size_t left;
+};
+
+static bool constant_read(void *arg, int16_t *buffer, size_t len, size_t *samples_read)
+{
+    constant_source *source = static_cast<constant_source *>(arg);
+    size_t i;
+
+    if (len > source->left) {
+        len = source->left;
+    }
+
+    for (i = 0; i < len; i++) {
+        buffer[i] = source->value;
+    }
+
+    source->left -= len;
+    *samples_read = len;
+    return source->left == 0;
+}
+
+static int16_t saturated_sum(int a, int b)
+{
+    int sum = a + b;
+
+    if (sum > INT16_MAX) {
+        return INT16_MAX;
+    }
+    if (sum < INT16_MIN) {
+        return INT16_MIN;
+    }
+    return sum;
+}
+
+TEST_GROUP(AudioPcmMixTestGroup)
+{
+};
+
+TEST(AudioPcmMixTestGroup, SaturatesLikeTheScalarSum)
+{
+    int16_t a[67], b[68], dst[67];
+
+    for (size_t i = 0; i < 67; i++) {
+        a[i] = rand();
+        b[i] = rand();
+    }
+    b[67] = rand();
+
+    /* Every length, and a source which is not word aligned. */
+    for (size_t len = 0; len <= 67; len++) {
+        memcpy(dst, a, sizeof(dst));
+        audio_pcm_mix(dst, &b[1], len);
+        for (size_t i = 0; i < len; i++) {
+            CHECK_EQUAL(saturated_sum(a[i], b[i + 1]), dst[i]);
+        }
+        for (size_t i = len; i < 67; i++) {
+            CHECK_EQUAL(a[i], dst[i]);
+        }
+    }
+}
+
+TEST(AudioPcmMixTestGroup, Extremes)
+{
+    int16_t dst[] = {INT16_MAX, INT16_MIN, 30000, -30000, 100};
+    int16_t src[] = {1, -1, 30000, -30000, -200};
+
+    audio_pcm_mix(dst, src, 5);
+
+    CHECK_EQUAL(INT16_MAX, dst[0]);
+    CHECK_EQUAL(INT16_MIN, dst[1]);
+    CHECK_EQUAL(INT16_MAX, dst[2]);
+    CHECK_EQUAL(INT16_MIN, dst[3]);
+    CHECK_EQUAL(-100, dst[4]);
+}
+
+TEST_GROUP(AudioToneTestGroup)
+{
+    audio_tone_t tone;
+    int16_t out[64];
+    size_t n;
+};
+
+TEST(AudioToneTestGroup, SquareWave)
+{
+    /* 4 samples per period. */
+    audio_tone_init(&tone, 4000, 1000, 16000, 100);
+
+    CHECK_FALSE(audio_tone_read(&tone, out, 8, &n));
+    CHECK_EQUAL(8, n);
+
+    int16_t expected[] = {100, 100, -100, -100, 100, 100, -100, -100};
+    for (int i = 0; i < 8; i++) {
+        CHECK_EQUAL(expected[i], out[i]);
+    }
+}
+
+TEST(AudioToneTestGroup, EndsAfterDuration)
+{
+    /* 2ms at 16kHz. */
+    audio_tone_init(&tone, 440, 2, 16000, 100);
+
+    CHECK_FALSE(audio_tone_read(&tone, out, 20, &n));
+    CHECK_TRUE(audio_tone_read(&tone, out, 64, &n));
+    CHECK_EQUAL(12, n);
+}
+
+TEST_GROUP(AudioMixerTestGroup)
+{
+    audio_mixer_t mixer;
+    int16_t out[1000];
+    constant_source sources[AUDIO_MIXER_VOICES];
+
+    void setup()
+    {
+        audio_mixer_init(&mixer, 16000);
+    }
+
+    audio_voice_t *play_constant(int16_t value, size_t len, uint32_t id)
+    {
+        audio_voice_t *voice = audio_mixer_reserve(&mixer);
+        constant_source *source = &sources[voice - mixer.voices];
+
+        source->value = value;
+        source->left = len;
+        audio_mixer_play(&mixer, voice, id, 16000, NULL, constant_read, source);
+        return voice;
+    }
+};
+
+TEST(AudioMixerTestGroup, SilentWithoutVoices)
+{
+    memset(out, 0x55, sizeof(out));
+
+    CHECK_EQUAL(0, audio_mixer_render(&mixer, out, 1000));
+    CHECK_FALSE(audio_mixer_is_playing(&mixer));
+
+    for (int i = 0; i < 1000; i++) {
+        CHECK_EQUAL(0, out[i]);
+    }
+}
+
+TEST(AudioMixerTestGroup, VoicesAreSummed)
+{
+    play_constant(100, 1000, 1);
+    play_constant(-30, 1000, 2);
+
+    audio_mixer_render(&mixer, out, 500);
+
+    for (int i = 0; i < 500; i++) {
+        CHECK_EQUAL(70, out[i]);
+    }
+    CHECK_TRUE(audio_mixer_is_playing(&mixer));
+}
+
+TEST(AudioMixerTestGroup, SumIsSaturated)
+{
+    play_constant(30000, 1000, 1);
+    play_constant(30000, 1000, 2);
+    play_constant(-1000, 1000, 3);
+
+    audio_mixer_render(&mixer, out, 500);
+
+    /* Summed in voice order: clipped, then reduced. */
+    CHECK_EQUAL(INT16_MAX - 1000, out[0]);
+}
+
+TEST(AudioMixerTestGroup, AllVoicesCanBeReserved)
+{
+    for (int i = 0; i < AUDIO_MIXER_VOICES; i++) {
+        CHECK(audio_mixer_reserve(&mixer) != NULL);
+    }
+
+    POINTERS_EQUAL(NULL, audio_mixer_reserve(&mixer));
+
+    audio_mixer_release(&mixer.voices[1]);
+    POINTERS_EQUAL(&mixer.voices[1], audio_mixer_reserve(&mixer));
+}
+
+TEST(AudioMixerTestGroup, ReservedVoicesAreNotRendered)
+{
+    audio_mixer_reserve(&mixer);
+
+    audio_mixer_render(&mixer, out, 10);
+
+    CHECK_FALSE(audio_mixer_is_playing(&mixer));
+    CHECK_EQUAL(0, out[0]);
+}
+
+TEST(AudioMixerTestGroup, FinishedVoicesAreReported)
+{
+    play_constant(100, 300, 1);
+    audio_voice_t *voice = play_constant(10, 1000, 2);
+
+    CHECK_EQUAL(1 << 0, audio_mixer_render(&mixer, out, 500));
+
+    /* The short voice stops in the middle of the buffer. */
+    CHECK_EQUAL(110, out[299]);
+    CHECK_EQUAL(10, out[300]);
+
+    CHECK_EQUAL(AUDIO_VOICE_FINISHED, mixer.voices[0].state);
+    CHECK_EQUAL(AUDIO_VOICE_PLAYING, voice->state);
+
+    /* A finished voice is not reused before being released. */
+    POINTERS_EQUAL(&mixer.voices[2], audio_mixer_reserve(&mixer));
+    POINTERS_EQUAL(NULL, audio_mixer_reserve(&mixer));
+    audio_mixer_release(&mixer.voices[0]);
+    POINTERS_EQUAL(&mixer.voices[0], audio_mixer_reserve(&mixer));
+}
+
+TEST(AudioMixerTestGroup, VoiceEndingOnBlockBoundary)
+{
+    play_constant(100, AUDIO_MIXER_BLOCK, 1);
+
+    CHECK_EQUAL(1, audio_mixer_render(&mixer, out, 500));
+    CHECK_FALSE(audio_mixer_is_playing(&mixer));
+}
+
+TEST(AudioMixerTestGroup, StreamVoice)
+{
+    int16_t buffer[1024];
+    audio_stream_t stream;
+    constant_source source = {200, 600};
+
+    audio_stream_init(&stream, buffer, 1024);
+    audio_stream_fill(&stream, constant_read, &source, 1024);
+
+    audio_mixer_play(&mixer, audio_mixer_reserve(&mixer), 1, 16000, &stream, NULL, NULL);
+    play_constant(-50, 2000, 2);
+
+    CHECK_EQUAL(0, audio_mixer_render(&mixer, out, 500));
+    CHECK_EQUAL(150, out[0]);
+    CHECK_EQUAL(150, out[499]);
+
+    CHECK_EQUAL(1, audio_mixer_render(&mixer, out, 500));
+    CHECK_EQUAL(150, out[99]);
+    CHECK_EQUAL(-50, out[100]);
+    CHECK_EQUAL(0, mixer.voices[0].underruns);
+}
+
+TEST(AudioMixerTestGroup, LateStreamIsSilentAndResumes)
+{
+    int16_t buffer[1024];
+    audio_stream_t stream;
+    constant_source source = {200, 1000};
+
+    audio_stream_init(&stream, buffer, 1024);
+    audio_stream_fill(&stream, constant_read, &source, 300);
+
+    audio_voice_t *voice = audio_mixer_reserve(&mixer);
+    audio_mixer_play(&mixer, voice, 1, 16000, &stream, NULL, NULL);
+
+    CHECK_EQUAL(0, audio_mixer_render(&mixer, out, 500));
+    CHECK_EQUAL(200, out[299]);
+    CHECK_EQUAL(0, out[300]);
+    CHECK_EQUAL(1, voice->underruns);
+
+    /* Nothing was skipped. */
+    audio_stream_fill(&stream, constant_read, &source, 1000);
+    CHECK_EQUAL(1, audio_mixer_render(&mixer, out, 800));
+    CHECK_EQUAL(200, out[699]);
+    CHECK_EQUAL(0, out[700]);
+    CHECK_EQUAL(1, voice->underruns);
+}
+
+TEST(AudioMixerTestGroup, TonesAreMixed)
+{
+    audio_tone_t low, high;
+    int16_t low_only[64], high_only[64];
+    size_t n;
+
+    audio_tone_init(&low, 500, 100, 16000, 1000);
+    audio_tone_read(&low, low_only, 64, &n);
+    audio_tone_init(&high, 2000, 100, 16000, 1000);
+    audio_tone_read(&high, high_only, 64, &n);
+
+    audio_tone_init(&low, 500, 100, 16000, 1000);
+    audio_tone_init(&high, 2000, 100, 16000, 1000);
+    audio_mixer_play(&mixer, audio_mixer_reserve(&mixer), 1, 16000, NULL, audio_tone_read, &low);
+    audio_mixer_play(&mixer, audio_mixer_reserve(&mixer), 2, 16000, NULL, audio_tone_read, &high);
+
+    audio_mixer_render(&mixer, out, 64);
+
+    for (int i = 0; i < 64; i++) {
+        CHECK_EQUAL(low_only[i] + high_only[i], out[i]);
+    }
+}
+
+/* Only prints the time on the host, ignored unless the tests are run with
+ * -ri. */
+IGNORE_TEST(AudioMixerTestGroup, RenderBenchmark)
+{
+    /* Worst case, all voices streaming. */
+    static int16_t buffers[AUDIO_MIXER_VOICES][1024];
+    audio_stream_t streams[AUDIO_MIXER_VOICES];
+    const int rounds = 20000;
+    const size_t len = 500; /* DAC_BUFFER_SIZE / 2 */
+    uint64_t ns = 0, cycles = 0;
+
+    for (int i = 0; i < AUDIO_MIXER_VOICES; i++) {
+        audio_stream_init(&streams[i], buffers[i], 1024);
+        audio_mixer_play(&mixer, audio_mixer_reserve(&mixer), i, 16000, &streams[i], NULL, NULL);
+    }
+
+    for (int round = 0; round < rounds; round++) {
+        for (int i = 0; i < AUDIO_MIXER_VOICES; i++) {
+            sources[i].value = rand();
+            sources[i].left = len;
+            streams[i].end = false;
+            audio_stream_fill(&streams[i], constant_read, &sources[i], len);
+        }
+
+        auto start = std::chrono::steady_clock::now();
+#if defined(__x86_64__) || defined(__i386__)
+        uint64_t start_cycles = __rdtsc();
+#endif
+        audio_mixer_render(&mixer, out, len);
+        audio_pcm_to_dac((audio_sample_t *)out, out, len);
+#if defined(__x86_64__) || defined(__i386__)
+        cycles += __rdtsc() - start_cycles;
+#endif
+        auto end = std::chrono::steady_clock::now();
+        ns += std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+    }
+
+    printf("\nMixing %d streams: %.2f ns, %.1f TSC cycles per output sample on the host\n",
+           AUDIO_MIXER_VOICES, (double)ns / rounds / len, (double)cycles / rounds / len);
+
+    for (int i = 0; i < AUDIO_MIXER_VOICES; i++) {
+        CHECK_EQUAL(0, mixer.voices[i].underruns);
+    }
+}
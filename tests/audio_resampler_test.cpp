@@ -0,0 +1,348 @@
+#include <CppUTest/TestHarness.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include "audio/audio_mixer.h"
+#include "audio/audio_resampler.h"
+
+static const uint32_t output_rate = 44100;
+
+/* Resamples the whole input, pushing at most chunk samples and computing at
+ * most block samples at once. */
+static std::vector<int16_t> resample(const std::vector<int16_t> &in, uint32_t in_rate,
+                                     size_t chunk = SIZE_MAX, size_t block = 128)
+{
+    audio_resampler_t resampler;
+    std::vector<int16_t> out;
+    int16_t buffer[128];
+    size_t pos = 0, n, len;
+    int16_t *input;
+    bool flushed = false;
+
+    CHECK_TRUE(audio_resampler_init(&resampler, in_rate, output_rate));
+
+    while (true) {
+        n = audio_resampler_process(&resampler, buffer, block);
+        out.insert(out.end(), buffer, buffer + n);
+        if (n == block) {
+            continue;
+        }
+
+        if (pos == in.size()) {
+            if (flushed) {
+                break;
+            }
+            audio_resampler_flush(&resampler);
+            flushed = true;
+            continue;
+        }
+
+        input = audio_resampler_input(&resampler, &len);
+        len = std::min(len, std::min(chunk, in.size() - pos));
+        memcpy(input, &in[pos], len * sizeof(int16_t));
+        audio_resampler_push(&resampler, len);
+        pos += len;
+    }
+
+    return out;
+}
+
+static std::vector<int16_t> sine(uint32_t rate, double frequency, double amplitude, size_t len)
+{
+    std::vector<int16_t> samples(len);
+
+    for (size_t i = 0; i < len; i++) {
+        samples[i] = std::lround(amplitude * std::sin(2 * M_PI * frequency * i / rate));
+    }
+
+    return samples;
+}
+
+/* Amplitude of the given frequency in the samples, ignoring the start and
+ * the end where the filter sees silence. */
+static double amplitude_at(const std::vector<int16_t> &samples, uint32_t rate, double frequency)
+{
+    const size_t margin = 200;
+    double re = 0, im = 0;
+    size_t count = 0;
+
+    /* A whole number of periods is not needed with this many of them. */
+    for (size_t i = margin; i + margin < samples.size(); i++) {
+        re += samples[i] * std::cos(2 * M_PI * frequency * i / rate);
+        im += samples[i] * std::sin(2 * M_PI * frequency * i / rate);
+        count++;
+    }
+
+    return 2 * std::sqrt(re * re + im * im) / count;
+}
+
+static double decibels(double ratio)
+{
+    return 20 * std::log10(ratio);
+}
+
+TEST_GROUP(AudioResamplerTestGroup)
+{
+    audio_resampler_t resampler;
+};
+
+TEST(AudioResamplerTestGroup, SupportedRates)
+{
+    CHECK_TRUE(audio_resampler_init(&resampler, 8000, output_rate));
+    CHECK_FALSE(audio_resampler_is_unity(&resampler));
+
+    CHECK_TRUE(audio_resampler_init(&resampler, 44100, output_rate));
+    CHECK_TRUE(audio_resampler_is_unity(&resampler));
+
+    CHECK_FALSE(audio_resampler_init(&resampler, 48000, output_rate));
+    CHECK_FALSE(audio_resampler_init(&resampler, 0, output_rate));
+}
+
+TEST(AudioResamplerTestGroup, LengthFollowsTheRatio)
+{
+    const uint32_t rates[] = {8000, 11025, 16000, 22050};
+
+    for (uint32_t rate : rates) {
+        std::vector<int16_t> in(rate / 10);
+        std::vector<int16_t> out = resample(in, rate);
+        size_t expected = in.size() * output_rate / rate;
+
+        /* Up to the last input sample. */
+        CHECK(out.size() <= expected);
+        CHECK(out.size() + output_rate / rate >= expected);
+    }
+}
+
+TEST(AudioResamplerTestGroup, UnityGainAtDc)
+{
+    std::vector<int16_t> in(800, 10000);
+    std::vector<int16_t> out = resample(in, 8000);
+
+    /* Every phase is scaled to a gain of exactly 1. */
+    for (size_t i = 100; i < out.size() - 100; i++) {
+        CHECK_EQUAL(10000, out[i]);
+    }
+}
+
+TEST(AudioResamplerTestGroup, FullScaleIsSaturated)
+{
+    std::vector<int16_t> in(800);
+
+    /* The ringing of a full scale square wave overshoots. */
+    for (size_t i = 0; i < in.size(); i++) {
+        in[i] = (i / 4) % 2 ? INT16_MIN : INT16_MAX;
+    }
+    std::vector<int16_t> out = resample(in, 8000);
+
+    CHECK_EQUAL(INT16_MAX, *std::max_element(out.begin(), out.end()));
+    CHECK_EQUAL(INT16_MIN, *std::min_element(out.begin(), out.end()));
+}
+
+TEST(AudioResamplerTestGroup, PiecesGiveTheSameOutput)
+{
+    std::vector<int16_t> in = sine(11025, 1000, 20000, 1000);
+    std::vector<int16_t> whole = resample(in, 11025);
+
+    CHECK(whole == resample(in, 11025, 1, 7));
+    CHECK(whole == resample(in, 11025, 13, 1));
+}
+
+TEST(AudioResamplerTestGroup, FrequencyResponse)
+{
+    const uint32_t rates[] = {8000, 11025, 16000, 22050};
+    const double amplitude = 16000;
+
+    for (uint32_t rate : rates) {
+        /* Up to 0.3 of the input rate, images start at 0.7 of it. */
+        for (double fraction = 0.05; fraction < 0.31; fraction += 0.05) {
+            double frequency = fraction * rate;
+            std::vector<int16_t> out = resample(sine(rate, frequency, amplitude, rate / 2),
+                                                rate);
+
+            double gain = decibels(amplitude_at(out, output_rate, frequency) / amplitude);
+            double image = decibels(amplitude_at(out, output_rate, rate - frequency) /
+                                    amplitude);
+            double second_image = decibels(amplitude_at(out, output_rate, rate + frequency) /
+                                           amplitude);
+
+            CHECK(std::fabs(gain) < 0.5);
+            CHECK(image < -50);
+            CHECK(second_image < -50);
+        }
+
+        /* Close to the Nyquist frequency of the input, the signal is cut. */
+        std::vector<int16_t> out = resample(sine(rate, 0.48 * rate, amplitude, rate / 2), rate);
+        CHECK(decibels(amplitude_at(out, output_rate, 0.48 * rate) / amplitude) < -3);
+    }
+}
+
+TEST(AudioResamplerTestGroup, SignalToNoise)
+{
+    const uint32_t rate = 8000;
+    const double amplitude = 20000, frequency = 1000;
+    std::vector<int16_t> out = resample(sine(rate, frequency, amplitude, 4000), rate);
+    double signal = 0, noise = 0, ideal, time;
+
+    /* At the exact times of the output samples, the step is rounded. */
+    audio_resampler_init(&resampler, rate, output_rate);
+
+    for (size_t i = 200; i < out.size() - 200; i++) {
+        time = (double)i * resampler.step / AUDIO_RESAMPLER_UNITY / rate;
+        ideal = amplitude * std::sin(2 * M_PI * frequency * time);
+        signal += ideal * ideal;
+        noise += (out[i] - ideal) * (out[i] - ideal);
+    }
+
+    /* Limited by the number of phases, the 12 bit DAC gives 72dB. */
+    CHECK(10 * std::log10(signal / noise) > 50);
+}
+
+/* Only prints the time on the host, ignored unless the tests are run with
+ * -ri. */
+IGNORE_TEST(AudioResamplerTestGroup, ProcessBenchmark)
+{
+    const uint32_t rates[] = {8000, 22050};
+    const int rounds = 200;
+
+    for (uint32_t rate : rates) {
+        std::vector<int16_t> in = sine(rate, 440, 10000, rate);
+        int16_t out[128];
+        uint64_t ns = 0, cycles = 0;
+        size_t count = 0, pos, len, n;
+        int16_t *input;
+
+        for (int round = 0; round < rounds; round++) {
+            audio_resampler_init(&resampler, rate, output_rate);
+            pos = 0;
+
+            while (pos < in.size()) {
+                input = audio_resampler_input(&resampler, &len);
+                len = std::min(len, in.size() - pos);
+                memcpy(input, &in[pos], len * sizeof(int16_t));
+                audio_resampler_push(&resampler, len);
+                pos += len;
+
+                auto start = std::chrono::steady_clock::now();
+#if defined(__x86_64__) || defined(__i386__)
+                uint64_t start_cycles = __rdtsc();
+#endif
+                do {
+                    n = audio_resampler_process(&resampler, out, 128);
+                    count += n;
+                } while (n == 128);
+#if defined(__x86_64__) || defined(__i386__)
+                cycles += __rdtsc() - start_cycles;
+#endif
+                auto end = std::chrono::steady_clock::now();
+                ns += std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+            }
+        }
+
+        printf("\nResampling %u to %u Hz: %.2f ns, %.1f TSC cycles per output sample on the host\n",
+               (unsigned)rate, (unsigned)output_rate, (double)ns / count, (double)cycles / count);
+    }
+}
+
+/* Source producing a sine at a given rate. */
+struct sine_source {
+    std::vector<int16_t> samples;
+    size_t pos;
+};
+
+static bool sine_read(void *arg, int16_t *buffer, size_t len, size_t *samples_read)
+{
+    sine_source *source = static_cast<sine_source *>(arg);
+
+    len = std::min(len, source->samples.size() - source->pos);
+    memcpy(buffer, &source->samples[source->pos], len * sizeof(int16_t));
+    source->pos += len;
+
+    *samples_read = len;
+    return source->pos == source->samples.size();
+}
+
+TEST_GROUP(AudioMixerResamplingTestGroup)
+{
+    audio_mixer_t mixer;
+    std::vector<int16_t> out;
+
+    void setup()
+    {
+        audio_mixer_init(&mixer, output_rate);
+        out.assign(output_rate, 0);
+    }
+
+    /* Renders in DAC half buffers until every voice finished. */
+    size_t render_all()
+    {
+        size_t pos = 0;
+
+        while (audio_mixer_is_playing(&mixer) && pos + 500 <= out.size()) {
+            audio_mixer_render(&mixer, &out[pos], 500);
+            pos += 500;
+        }
+
+        return pos;
+    }
+};
+
+TEST(AudioMixerResamplingTestGroup, VoicesAtDifferentRates)
+{
+    sine_source low = {sine(8000, 500, 8000, 4000), 0};
+    sine_source high = {sine(22050, 3000, 8000, 11025), 0};
+
+    CHECK_TRUE(audio_mixer_play(&mixer, audio_mixer_reserve(&mixer), 1, 8000, NULL, sine_read,
+                                &low));
+    CHECK_TRUE(audio_mixer_play(&mixer, audio_mixer_reserve(&mixer), 2, 22050, NULL, sine_read,
+                                &high));
+
+    render_all();
+
+    /* Both last 0.5s, at their own pitch. */
+    out.resize(output_rate / 2 - 100);
+    CHECK(std::fabs(decibels(amplitude_at(out, output_rate, 500) / 8000)) < 0.5);
+    CHECK(std::fabs(decibels(amplitude_at(out, output_rate, 3000) / 8000)) < 0.5);
+    CHECK_FALSE(audio_mixer_is_playing(&mixer));
+    CHECK(std::abs((int)mixer.voices[0].position - (int)output_rate / 2) < 10);
+    CHECK(std::abs((int)mixer.voices[1].position - (int)output_rate / 2) < 10);
+}
+
+TEST(AudioMixerResamplingTestGroup, HigherRateIsRefused)
+{
+    sine_source source = {sine(48000, 500, 8000, 100), 0};
+    audio_voice_t *voice = audio_mixer_reserve(&mixer);
+
+    CHECK_FALSE(audio_mixer_play(&mixer, voice, 1, 48000, NULL, sine_read, &source));
+    CHECK_EQUAL(AUDIO_VOICE_RESERVED, voice->state);
+}
+
+TEST(AudioMixerResamplingTestGroup, LateStreamResumes)
+{
+    int16_t buffer[1024];
+    audio_stream_t stream;
+    sine_source source = {std::vector<int16_t>(1000, 1000), 0};
+    audio_voice_t *voice = audio_mixer_reserve(&mixer);
+
+    audio_stream_init(&stream, buffer, 1024);
+    audio_stream_fill(&stream, sine_read, &source, 50);
+    audio_mixer_play(&mixer, voice, 1, 8000, &stream, NULL, NULL);
+
+    audio_mixer_render(&mixer, &out[0], 500);
+    CHECK_EQUAL(1, voice->underruns);
+    CHECK(voice->position < 50 * output_rate / 8000);
+    CHECK_EQUAL(0, out[499]);
+
+    /* Nothing was skipped. */
+    audio_stream_fill(&stream, sine_read, &source, 1000);
+    render_all();
+    CHECK_FALSE(audio_mixer_is_playing(&mixer));
+    CHECK(std::abs((int)voice->position - (int)(1000 * output_rate / 8000)) < 10);
+    CHECK_EQUAL(1, voice->underruns);
+}
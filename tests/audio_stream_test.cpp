@@ -0,0 +1,273 @@
+#include <CppUTest/TestHarness.h>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include "audio/audio_pcm.h"
+#include "audio/audio_stream.h"
+
+/* Source producing a ramp, optionally ending after a given number of
+ * samples. */
+struct ramp_source {
+    int16_t next;
+    size_t left;
+};
+
+static bool ramp_read(void *arg, int16_t *buffer, size_t len, size_t *samples_read)
+{
+    ramp_source *ramp = static_cast<ramp_source *>(arg);
+    size_t i;
+
+    if (len > ramp->left) {
+        len = ramp->left;
+    }
+
+    for (i = 0; i < len; i++) {
+        buffer[i] = ramp->next++;
+    }
+
+    ramp->left -= len;
+    *samples_read = len;
+    return ramp->left == 0;
+}
+
+TEST_GROUP(AudioPcmTestGroup)
+{
+};
+
+TEST(AudioPcmTestGroup, ConvertsLikeTheScalarOffset)
+{
+    int16_t src[67];
+    audio_sample_t dst[68];
+
+    for (size_t i = 0; i < 67; i++) {
+        src[i] = rand();
+    }
+
+    /* Every length, and a destination which is not word aligned. */
+    for (size_t len = 0; len <= 67; len++) {
+        audio_pcm_to_dac(&dst[1], src, len);
+        for (size_t i = 0; i < len; i++) {
+            CHECK_EQUAL((audio_sample_t)(src[i] - INT16_MIN), dst[i + 1]);
+        }
+    }
+}
+
+TEST(AudioPcmTestGroup, ConvertsInPlace)
+{
+    int16_t buf[20];
+
+    for (int i = 0; i < 20; i++) {
+        buf[i] = -10 * i;
+    }
+
+    audio_pcm_to_dac((audio_sample_t *)buf, buf, 20);
+
+    for (int i = 0; i < 20; i++) {
+        CHECK_EQUAL(0x8000 - 10 * i, (audio_sample_t)buf[i]);
+    }
+}
+
+TEST(AudioPcmTestGroup, Extremes)
+{
+    int16_t src[] = {INT16_MIN, -1, 0, INT16_MAX};
+    audio_sample_t dst[4];
+
+    audio_pcm_to_dac(dst, src, 4);
+
+    CHECK_EQUAL(0, dst[0]);
+    CHECK_EQUAL(0x7fff, dst[1]);
+    CHECK_EQUAL(0x8000, dst[2]);
+    CHECK_EQUAL(0xffff, dst[3]);
+}
+
+TEST_GROUP(AudioStreamTestGroup)
+{
+    int16_t buffer[16];
+    audio_stream_t stream;
+    ramp_source ramp;
+    audio_sample_t out[16];
+    size_t written;
+
+    void setup()
+    {
+        audio_stream_init(&stream, buffer, 16);
+        ramp.next = 0;
+        ramp.left = SIZE_MAX;
+    }
+};
+
+TEST(AudioStreamTestGroup, StartsEmpty)
+{
+    CHECK_EQUAL(0, audio_stream_available(&stream));
+    CHECK_EQUAL(16, audio_stream_space(&stream));
+}
+
+TEST(AudioStreamTestGroup, FillIsLimitedBySpace)
+{
+    CHECK_EQUAL(10, audio_stream_fill(&stream, ramp_read, &ramp, 10));
+    CHECK_EQUAL(6, audio_stream_fill(&stream, ramp_read, &ramp, 10));
+    CHECK_EQUAL(0, audio_stream_fill(&stream, ramp_read, &ramp, 10));
+
+    CHECK_EQUAL(16, audio_stream_available(&stream));
+}
+
+TEST(AudioStreamTestGroup, ReadConvertsSamplesInOrder)
+{
+    audio_stream_fill(&stream, ramp_read, &ramp, 16);
+
+    CHECK_FALSE(audio_stream_read_cb(&stream, out, 8, &written));
+    CHECK_EQUAL(8, written);
+
+    for (int i = 0; i < 8; i++) {
+        CHECK_EQUAL(0x8000 + i, out[i]);
+    }
+    CHECK_EQUAL(8, audio_stream_available(&stream));
+}
+
+TEST(AudioStreamTestGroup, WrapsAround)
+{
+    for (int round = 0; round < 10; round++) {
+        CHECK_EQUAL(10, audio_stream_fill(&stream, ramp_read, &ramp, 10));
+        CHECK_FALSE(audio_stream_read_cb(&stream, out, 10, &written));
+
+        for (int i = 0; i < 10; i++) {
+            CHECK_EQUAL(0x8000 + round * 10 + i, out[i]);
+        }
+    }
+
+    CHECK_EQUAL(0, stream.underruns);
+}
+
+TEST(AudioStreamTestGroup, UnderrunIsPaddedWithSilence)
+{
+    audio_stream_fill(&stream, ramp_read, &ramp, 3);
+
+    CHECK_FALSE(audio_stream_read_cb(&stream, out, 8, &written));
+
+    CHECK_EQUAL(8, written);
+    CHECK_EQUAL(0x8002, out[2]);
+    CHECK_EQUAL(AUDIO_DAC_MIDSCALE, out[3]);
+    CHECK_EQUAL(AUDIO_DAC_MIDSCALE, out[7]);
+    CHECK_EQUAL(1, stream.underruns);
+}
+
+TEST(AudioStreamTestGroup, EndOfSource)
+{
+    ramp.left = 5;
+
+    CHECK_EQUAL(5, audio_stream_fill(&stream, ramp_read, &ramp, 10));
+    CHECK_TRUE(stream.end);
+
+    /* Nothing more is read once the source ended. */
+    CHECK_EQUAL(0, audio_stream_fill(&stream, ramp_read, &ramp, 10));
+
+    CHECK_TRUE(audio_stream_read_cb(&stream, out, 8, &written));
+    CHECK_EQUAL(5, written);
+    CHECK_EQUAL(0, stream.underruns);
+}
+
+TEST(AudioStreamTestGroup, EndOnBufferBoundary)
+{
+    ramp.left = 8;
+    audio_stream_fill(&stream, ramp_read, &ramp, 8);
+
+    CHECK_TRUE(audio_stream_read_cb(&stream, out, 8, &written));
+    CHECK_EQUAL(8, written);
+}
+
+TEST(AudioStreamTestGroup, ResetKeepsUnderruns)
+{
+    CHECK_FALSE(audio_stream_read_cb(&stream, out, 8, &written));
+    ramp.left = 1;
+    audio_stream_fill(&stream, ramp_read, &ramp, 8);
+
+    audio_stream_reset(&stream);
+
+    CHECK_FALSE(stream.end);
+    CHECK_EQUAL(0, audio_stream_available(&stream));
+    CHECK_EQUAL(1, stream.underruns);
+}
+
+/* Replays card reads with latency spikes against a DAC consuming half buffers
+ * at a fixed rate, in 1ms steps. */
+TEST_GROUP(AudioStreamJitterTestGroup)
+{
+    static const int sample_rate = 16000;
+    static const int half_buffer = 500; /* DAC_BUFFER_SIZE / 2 */
+    static const int read_size = 1024; /* AUDIO_READ_SIZE */
+    static const int duration_ms = 120000;
+
+    /* Most reads take a few ms, but cards sometimes stall for garbage
+     * collection. */
+    int read_latency_ms()
+    {
+        if (rand() % 100 < 3) {
+            return 40 + rand() % 100;
+        }
+        return 2 + rand() % 3;
+    }
+
+    void setup()
+    {
+        srand(42);
+    }
+};
+
+TEST(AudioStreamJitterTestGroup, StreamHidesLatencySpikes)
+{
+    static int16_t buffer[4096];
+    static audio_sample_t dac[half_buffer];
+    audio_stream_t stream;
+    ramp_source ramp = {0, SIZE_MAX};
+    const double period_ms = 1000. * half_buffer / sample_rate;
+    double next_refill = period_ms;
+    int read_done = -1;
+    int16_t expected = 0;
+    size_t written;
+
+    audio_stream_init(&stream, buffer, 4096);
+
+    /* Prefilled like the audio thread does before starting the DAC. */
+    while (audio_stream_space(&stream) >= read_size) {
+        audio_stream_fill(&stream, ramp_read, &ramp, read_size);
+    }
+
+    for (int t = 0; t < duration_ms; t++) {
+        if (read_done >= 0 && t >= read_done) {
+            audio_stream_fill(&stream, ramp_read, &ramp, read_size);
+            read_done = -1;
+        }
+
+        if (t >= next_refill) {
+            audio_stream_read_cb(&stream, dac, half_buffer, &written);
+            next_refill += period_ms;
+
+            /* No sample lost or repeated. */
+            for (int i = 0; i < half_buffer; i++) {
+                CHECK_EQUAL((audio_sample_t)(expected++ - INT16_MIN), dac[i]);
+            }
+        }
+
+        if (read_done < 0 && audio_stream_space(&stream) >= read_size) {
+            read_done = t + read_latency_ms();
+        }
+    }
+
+    CHECK_EQUAL(0, stream.underruns);
+}
+
+TEST(AudioStreamJitterTestGroup, SynchronousReadsGlitch)
+{
+    /* Before, each half buffer was read from the card in the DAC callback,
+     * which had to finish before the DAC reached it. */
+    const double period_ms = 1000. * half_buffer / sample_rate;
+    int glitches = 0;
+
+    for (double t = 0; t < duration_ms; t += period_ms) {
+        if (read_latency_ms() > period_ms) {
+            glitches++;
+        }
+    }
+
+    CHECK(glitches > 0);
+}
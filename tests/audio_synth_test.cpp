@@ -0,0 +1,192 @@
+#include <CppUTest/TestHarness.h>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+#include "audio/audio_mixer.h"
+#include "audio/audio_synth.h"
+
+TEST_GROUP(AudioSynthTestGroup)
+{
+    audio_synth_t synth;
+    audio_synth_instrument_t instrument = {AUDIO_SYNTH_SQUARE, 10000, 0, 0, 100, 0};
+
+    /* Plays every note in pieces of chunk samples. */
+    std::vector<int16_t> play(const std::vector<uint16_t> &notes, uint32_t rate,
+                              size_t chunk = 100)
+    {
+        std::vector<int16_t> out;
+        int16_t buffer[512];
+        size_t n;
+        bool end;
+
+        audio_synth_init(&synth, &instrument, notes.data(), notes.size(), rate);
+
+        do {
+            end = audio_synth_read(&synth, buffer, chunk, &n);
+            out.insert(out.end(), buffer, buffer + n);
+            CHECK(end || n == chunk);
+        } while (!end);
+
+        return out;
+    }
+};
+
+TEST(AudioSynthTestGroup, BuiltinInstruments)
+{
+    CHECK_EQUAL(AUDIO_SYNTH_CHIME, audio_synth_instrument_find("chime"));
+    CHECK_EQUAL(-1, audio_synth_instrument_find("piano"));
+
+    CHECK(audio_synth_instrument_builtin(AUDIO_SYNTH_BEEP) != NULL);
+    POINTERS_EQUAL(NULL, audio_synth_instrument_builtin(AUDIO_SYNTH_INSTRUMENT_COUNT));
+    POINTERS_EQUAL(NULL, audio_synth_instrument_builtin(-1));
+}
+
+TEST(AudioSynthTestGroup, NoteFormat)
+{
+    uint16_t note = AUDIO_SYNTH_NOTE(69, 250);
+
+    CHECK_EQUAL(0x4519, note);
+    CHECK_EQUAL(69, AUDIO_SYNTH_NOTE_KEY(note));
+    CHECK_EQUAL(250, AUDIO_SYNTH_NOTE_LENGTH_MS(note));
+}
+
+TEST(AudioSynthTestGroup, NotesLastTheirLength)
+{
+    std::vector<int16_t> out = play({AUDIO_SYNTH_NOTE(69, 100),
+                                     AUDIO_SYNTH_NOTE(AUDIO_SYNTH_REST, 50),
+                                     AUDIO_SYNTH_NOTE(72, 30)}, 16000);
+
+    CHECK_EQUAL(1600 + 800 + 480, out.size());
+
+    /* The rest is silent. */
+    for (size_t i = 1600; i < 2400; i++) {
+        CHECK_EQUAL(0, out[i]);
+    }
+    CHECK(out[2401] != 0);
+}
+
+TEST(AudioSynthTestGroup, EmptySequenceEnds)
+{
+    CHECK_EQUAL(0, play({}, 16000).size());
+}
+
+TEST(AudioSynthTestGroup, ChunksDoNotMatter)
+{
+    std::vector<uint16_t> notes = {AUDIO_SYNTH_NOTE(60, 40), AUDIO_SYNTH_NOTE(64, 40)};
+
+    instrument = {AUDIO_SYNTH_TRIANGLE, 10000, 5, 10, 50, 10};
+
+    CHECK(play(notes, 16000, 512) == play(notes, 16000, 7));
+}
+
+TEST(AudioSynthTestGroup, PitchOfTheKeys)
+{
+    const int keys[] = {21, 60, 69, 81, 108};
+
+    for (int key : keys) {
+        std::vector<int16_t> out = play({AUDIO_SYNTH_NOTE(key, 1000)}, 44100);
+        double expected = 440 * std::pow(2, (key - 69) / 12.);
+        int rising = 0;
+
+        /* One rising edge per period. */
+        for (size_t i = 1; i < out.size(); i++) {
+            if (out[i - 1] < 0 && out[i] >= 0) {
+                rising++;
+            }
+        }
+
+        CHECK(std::fabs(rising - expected) <= 1);
+    }
+}
+
+TEST(AudioSynthTestGroup, InvalidKeyIsARest)
+{
+    std::vector<int16_t> out = play({AUDIO_SYNTH_NOTE(200, 10)}, 16000);
+
+    CHECK_EQUAL(160, out.size());
+    for (int16_t sample : out) {
+        CHECK_EQUAL(0, sample);
+    }
+}
+
+TEST(AudioSynthTestGroup, Waveforms)
+{
+    /* 100 samples per period. */
+    const double frequency = 440;
+    const uint32_t rate = 44000;
+
+    instrument.amplitude = INT16_MAX;
+
+    instrument.waveform = AUDIO_SYNTH_SINE;
+    std::vector<int16_t> sine = play({AUDIO_SYNTH_NOTE(69, 10)}, rate);
+    for (size_t i = 0; i < sine.size(); i++) {
+        double expected = INT16_MAX * std::sin(2 * M_PI * frequency * i / rate);
+        CHECK(std::fabs(sine[i] - expected) < 10);
+    }
+
+    instrument.waveform = AUDIO_SYNTH_TRIANGLE;
+    std::vector<int16_t> triangle = play({AUDIO_SYNTH_NOTE(69, 10)}, rate);
+    CHECK(std::abs(triangle[0]) < 10);
+    CHECK(triangle[25] > 32000);
+    CHECK(std::abs(triangle[50]) < 1400);
+    CHECK(triangle[75] < -32000);
+
+    instrument.waveform = AUDIO_SYNTH_SAWTOOTH;
+    std::vector<int16_t> sawtooth = play({AUDIO_SYNTH_NOTE(69, 10)}, rate);
+    for (int i = 1; i < 50; i++) {
+        CHECK(sawtooth[i] > sawtooth[i - 1]);
+    }
+    CHECK(sawtooth[51] < -31000);
+}
+
+TEST(AudioSynthTestGroup, Envelope)
+{
+    instrument = {AUDIO_SYNTH_SQUARE, 10000, 10, 10, 50, 10};
+
+    /* 1 sample per ms, the square wave is at full scale for 5 samples. */
+    std::vector<int16_t> out = play({AUDIO_SYNTH_NOTE(69, 100)}, 1000);
+    CHECK_EQUAL(100, out.size());
+
+    /* Attack up to the amplitude. */
+    CHECK(std::abs(out[5] - 5000) < 100);
+    CHECK(std::abs(std::abs(out[9]) - 9000) < 100);
+
+    /* Decay to the sustain level, which is held. */
+    CHECK(std::abs(std::abs(out[15]) - 7500) < 100);
+    CHECK(std::abs(std::abs(out[20]) - 5000) < 100);
+    CHECK(std::abs(std::abs(out[89]) - 5000) < 100);
+
+    /* Release with the note. */
+    CHECK(std::abs(std::abs(out[95]) - 2500) < 100);
+    CHECK(std::abs(out[99]) < 600);
+}
+
+TEST(AudioSynthTestGroup, ShortNoteIsReleasedRightAway)
+{
+    instrument = {AUDIO_SYNTH_SQUARE, 10000, 10, 10, 50, 20};
+
+    std::vector<int16_t> out = play({AUDIO_SYNTH_NOTE(69, 10), AUDIO_SYNTH_NOTE(69, 10)}, 1000);
+
+    CHECK_EQUAL(20, out.size());
+    for (int16_t sample : out) {
+        CHECK_EQUAL(0, sample);
+    }
+}
+
+TEST(AudioSynthTestGroup, PlaysFromTheFirstDacBuffer)
+{
+    audio_mixer_t mixer;
+    int16_t out[500];
+    std::vector<uint16_t> notes = {AUDIO_SYNTH_NOTE(69, 100)};
+
+    audio_mixer_init(&mixer, 44100);
+    audio_synth_init(&synth, audio_synth_instrument_builtin(AUDIO_SYNTH_BEEP), notes.data(),
+                     notes.size(), 44100);
+    audio_mixer_play(&mixer, audio_mixer_reserve(&mixer), 1, 44100, NULL, audio_synth_read,
+                     &synth);
+
+    CHECK_EQUAL(0, audio_mixer_render(&mixer, out, 500));
+    CHECK_EQUAL(500, mixer.voices[0].position);
+    CHECK(out[100] != 0);
+}
@@ -0,0 +1,325 @@
+#include <CppUTest/TestHarness.h>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "blackbox/blackbox.h"
+#include "cmp_mem_access/cmp_mem_access.h"
+#include "fatfs_image_mock.h"
+
+/* Serializer writing a single unsigned integer. */
+static bool write_counter(cmp_ctx_t *cmp, const void *msg)
+{
+    return cmp_write_array(cmp, 1) && cmp_write_uint(cmp, *(const uint32_t *)msg);
+}
+
+/* Serializer writing more than fits in a record. */
+static bool write_too_much(cmp_ctx_t *cmp, const void *msg)
+{
+    (void)msg;
+    static const uint8_t blob[BLACKBOX_RECORD_MAX] = {0};
+
+    return cmp_write_bin(cmp, blob, sizeof(blob));
+}
+
+TEST_GROUP(BlackboxRingTestGroup)
+{
+    blackbox_ring_t ring;
+    uint8_t buffer[16];
+
+    void setup()
+    {
+        blackbox_ring_init(&ring, buffer, sizeof(buffer));
+    }
+};
+
+TEST(BlackboxRingTestGroup, StartsEmpty)
+{
+    CHECK_EQUAL(0, blackbox_ring_used(&ring));
+    CHECK_EQUAL(0, ring.dropped);
+}
+
+TEST(BlackboxRingTestGroup, PushCountsBytes)
+{
+    CHECK_TRUE(blackbox_ring_push(&ring, "hello", 5));
+    CHECK_EQUAL(5, blackbox_ring_used(&ring));
+}
+
+TEST(BlackboxRingTestGroup, RecordsWhichDoNotFitAreDropped)
+{
+    CHECK_TRUE(blackbox_ring_push(&ring, "0123456789", 10));
+    CHECK_FALSE(blackbox_ring_push(&ring, "0123456789", 10));
+
+    CHECK_EQUAL(10, blackbox_ring_used(&ring));
+    CHECK_EQUAL(1, ring.dropped);
+}
+
+TEST(BlackboxRingTestGroup, PushWrapsAround)
+{
+    ring.head = ring.tail = 12;
+
+    CHECK_TRUE(blackbox_ring_push(&ring, "abcdefgh", 8));
+
+    MEMCMP_EQUAL("abcd", &buffer[12], 4);
+    MEMCMP_EQUAL("efgh", &buffer[0], 4);
+}
+
+TEST(BlackboxRingTestGroup, RecordIsMessagePackArray)
+{
+    uint32_t value = 42;
+    cmp_ctx_t cmp;
+    cmp_mem_access_t mem;
+    uint32_t size, timestamp, id, field;
+
+    uint8_t big_buffer[64];
+    blackbox_ring_init(&ring, big_buffer, sizeof(big_buffer));
+
+    CHECK_TRUE(blackbox_record(&ring, 123456, 3, write_counter, &value));
+
+    cmp_mem_access_ro_init(&cmp, &mem, big_buffer, blackbox_ring_used(&ring));
+    CHECK_TRUE(cmp_read_array(&cmp, &size));
+    CHECK_EQUAL(3, size);
+    CHECK_TRUE(cmp_read_uint(&cmp, &timestamp));
+    CHECK_EQUAL(123456, timestamp);
+    CHECK_TRUE(cmp_read_uint(&cmp, &id));
+    CHECK_EQUAL(3, id);
+    CHECK_TRUE(cmp_read_array(&cmp, &size));
+    CHECK_EQUAL(1, size);
+    CHECK_TRUE(cmp_read_uint(&cmp, &field));
+    CHECK_EQUAL(42, field);
+    CHECK_EQUAL(blackbox_ring_used(&ring), cmp_mem_access_get_pos(&mem));
+}
+
+TEST(BlackboxRingTestGroup, RecordTooLargeIsDropped)
+{
+    CHECK_FALSE(blackbox_record(&ring, 0, 0, write_too_much, NULL));
+
+    CHECK_EQUAL(0, blackbox_ring_used(&ring));
+    CHECK_EQUAL(1, ring.dropped);
+}
+
+TEST_GROUP(BlackboxFileTestGroup)
+{
+    static const int ring_count = 2;
+    static const uint32_t ring_size = 8192;
+
+    blackbox_file_t log;
+    uint8_t chunk[BLACKBOX_CHUNK_SIZE];
+    blackbox_ring_t rings[ring_count];
+    uint8_t ring_buffers[ring_count][ring_size];
+    uint32_t counters[ring_count];
+
+    void setup()
+    {
+        /* 8 MB card. */
+        fatfs_image_mock_create(16 * 1024);
+
+        for (int i = 0; i < ring_count; i++) {
+            blackbox_ring_init(&rings[i], ring_buffers[i], ring_size);
+            counters[i] = 0;
+        }
+    }
+
+    void teardown()
+    {
+        fatfs_image_mock_destroy();
+    }
+
+    /* Records count increasing values in the given ring. */
+    void record(int id, int count)
+    {
+        for (int i = 0; i < count; i++) {
+            CHECK_TRUE(blackbox_record(&rings[id], counters[id], id, write_counter,
+                                       &counters[id]));
+            counters[id]++;
+        }
+    }
+
+    std::vector<uint8_t> read_file(const char *path)
+    {
+        FIL file;
+        UINT n;
+        std::vector<uint8_t> content;
+
+        CHECK_EQUAL(FR_OK, f_open(&file, path, FA_READ));
+        content.resize(f_size(&file));
+        CHECK_EQUAL(FR_OK, f_read(&file, content.data(), content.size(), &n));
+        CHECK_EQUAL(content.size(), n);
+        f_close(&file);
+
+        return content;
+    }
+
+    /* Checks that the file holds exactly the recorded values of each ring, in
+     * order. */
+    void check_records(const std::vector<uint8_t> &content)
+    {
+        cmp_ctx_t cmp;
+        cmp_mem_access_t mem;
+        uint32_t expected[ring_count] = {0};
+        uint32_t size, timestamp, id, value;
+
+        cmp_mem_access_ro_init(&cmp, &mem, (void *)content.data(), content.size());
+
+        while (cmp_mem_access_get_pos(&mem) < content.size()) {
+            CHECK_TRUE(cmp_read_array(&cmp, &size));
+            CHECK_EQUAL(3, size);
+            CHECK_TRUE(cmp_read_uint(&cmp, &timestamp));
+            CHECK_TRUE(cmp_read_uint(&cmp, &id));
+            CHECK_TRUE(id < ring_count);
+            CHECK_TRUE(cmp_read_array(&cmp, &size));
+            CHECK_TRUE(cmp_read_uint(&cmp, &value));
+            CHECK_EQUAL(expected[id], value);
+            CHECK_EQUAL(expected[id], timestamp);
+            expected[id]++;
+        }
+
+        for (int i = 0; i < ring_count; i++) {
+            CHECK_EQUAL(counters[i], expected[i]);
+        }
+    }
+};
+
+TEST(BlackboxFileTestGroup, EmptyFile)
+{
+    CHECK_EQUAL(FR_OK, blackbox_file_open(&log, "LOG00000.BIN", chunk, 1024 * 1024));
+    CHECK_EQUAL(1024 * 1024, log.capacity);
+    CHECK_EQUAL(FR_OK, blackbox_file_close(&log));
+
+    CHECK_EQUAL(0, read_file("LOG00000.BIN").size());
+}
+
+TEST(BlackboxFileTestGroup, LockIsReleasedDuringPreallocation)
+{
+    CHECK_EQUAL(FR_OK, blackbox_file_open(&log, "LOG00000.BIN", chunk, 4 * 1024 * 1024));
+    CHECK_EQUAL(4 * 1024 * 1024, log.capacity);
+
+    /* Open, one seek per megabyte, rewind and sync. */
+    CHECK(fatfs_image_mock_lock_count() >= 1 + 4 + 2);
+
+    CHECK_EQUAL(FR_OK, blackbox_file_close(&log));
+}
+
+TEST(BlackboxFileTestGroup, RecordsAreWrittenInOrder)
+{
+    CHECK_EQUAL(FR_OK, blackbox_file_open(&log, "LOG00000.BIN", chunk, 1024 * 1024));
+
+    for (int i = 0; i < 100; i++) {
+        record(0, 50);
+        record(1, 30);
+        CHECK_EQUAL(FR_OK, blackbox_file_drain(&log, rings, ring_count));
+        CHECK_EQUAL(0, blackbox_ring_used(&rings[0]));
+        CHECK_EQUAL(0, blackbox_ring_used(&rings[1]));
+    }
+
+    CHECK_EQUAL(FR_OK, blackbox_file_close(&log));
+
+    std::vector<uint8_t> content = read_file("LOG00000.BIN");
+    CHECK_EQUAL(log.bytes_written, content.size());
+    check_records(content);
+}
+
+TEST(BlackboxFileTestGroup, RingsWhichWrappedAround)
+{
+    CHECK_EQUAL(FR_OK, blackbox_file_open(&log, "LOG00000.BIN", chunk, 1024 * 1024));
+
+    /* Odd sized batches, so that records straddle the end of the rings. */
+    for (int i = 0; i < 50; i++) {
+        record(0, 555);
+        record(1, 7);
+        CHECK_EQUAL(FR_OK, blackbox_file_drain(&log, rings, ring_count));
+    }
+
+    CHECK_EQUAL(FR_OK, blackbox_file_close(&log));
+
+    check_records(read_file("LOG00000.BIN"));
+    CHECK_EQUAL(0, rings[0].dropped);
+}
+
+TEST(BlackboxFileTestGroup, DataIsWrittenInChunks)
+{
+    CHECK_EQUAL(FR_OK, blackbox_file_open(&log, "LOG00000.BIN", chunk, 1024 * 1024));
+    fatfs_image_mock_reset_stats();
+
+    /* Writes nothing until a whole chunk is queued. */
+    record(0, 10);
+    CHECK_EQUAL(FR_OK, blackbox_file_drain(&log, rings, ring_count));
+    CHECK_EQUAL(0, fatfs_image_mock_write_count());
+
+    for (int i = 0; i < 200; i++) {
+        record(0, 100);
+        CHECK_EQUAL(FR_OK, blackbox_file_drain(&log, rings, ring_count));
+    }
+
+    CHECK_EQUAL(BLACKBOX_CHUNK_SIZE / FATFS_IMAGE_MOCK_SECTOR_SIZE,
+                fatfs_image_mock_typical_write_size());
+
+    /* Every write is a whole chunk, the FAT was written when preallocating. */
+    CHECK_EQUAL(log.bytes_written / BLACKBOX_CHUNK_SIZE, fatfs_image_mock_write_count());
+
+    CHECK_EQUAL(FR_OK, blackbox_file_close(&log));
+}
+
+TEST(BlackboxFileTestGroup, StopsWhenFileIsFull)
+{
+    CHECK_EQUAL(FR_OK, blackbox_file_open(&log, "LOG00000.BIN", chunk,
+                                          2 * BLACKBOX_CHUNK_SIZE + 100));
+    CHECK_EQUAL(2 * BLACKBOX_CHUNK_SIZE, log.capacity);
+
+    for (int i = 0; i < 10 && !log.full; i++) {
+        record(0, 200);
+        CHECK_EQUAL(FR_OK, blackbox_file_drain(&log, rings, ring_count));
+    }
+
+    CHECK_TRUE(log.full);
+    CHECK_EQUAL(2 * BLACKBOX_CHUNK_SIZE, log.bytes_written);
+
+    /* Records are kept until the next file. */
+    record(0, 10);
+    size_t queued = blackbox_ring_used(&rings[0]);
+    CHECK_EQUAL(FR_OK, blackbox_file_drain(&log, rings, ring_count));
+    CHECK_EQUAL(queued, blackbox_ring_used(&rings[0]));
+
+    CHECK_EQUAL(FR_OK, blackbox_file_close(&log));
+    CHECK_EQUAL(2 * BLACKBOX_CHUNK_SIZE, read_file("LOG00000.BIN").size());
+}
+
+TEST(BlackboxFileTestGroup, CapacityIsLimitedByFreeSpace)
+{
+    /* Larger than the card. */
+    CHECK_EQUAL(FR_OK, blackbox_file_open(&log, "LOG00000.BIN", chunk, 64 * 1024 * 1024));
+
+    CHECK_TRUE(log.capacity > 0);
+    CHECK_TRUE(log.capacity < 8 * 1024 * 1024);
+    CHECK_EQUAL(0, log.capacity % BLACKBOX_CHUNK_SIZE);
+
+    CHECK_EQUAL(FR_OK, blackbox_file_close(&log));
+}
+
+TEST(BlackboxFileTestGroup, UnusedSpaceIsFreedOnClose)
+{
+    FATFS *fs;
+    DWORD free_before, free_after;
+
+    CHECK_EQUAL(FR_OK, f_getfree("", &free_before, &fs));
+
+    CHECK_EQUAL(FR_OK, blackbox_file_open(&log, "LOG00000.BIN", chunk, 4 * 1024 * 1024));
+    record(0, 10);
+    CHECK_EQUAL(FR_OK, blackbox_file_drain(&log, rings, ring_count));
+    CHECK_EQUAL(FR_OK, blackbox_file_close(&log));
+
+    CHECK_EQUAL(FR_OK, f_getfree("", &free_after, &fs));
+    CHECK_EQUAL(free_before - 1, free_after);
+}
+
+TEST(BlackboxFileTestGroup, WriteErrorsAreReported)
+{
+    CHECK_EQUAL(FR_OK, blackbox_file_open(&log, "LOG00000.BIN", chunk, 1024 * 1024));
+
+    fatfs_image_mock_fail_writes(true);
+
+    /* More than a chunk. */
+    record(0, 600);
+    CHECK_EQUAL(FR_DISK_ERR, blackbox_file_drain(&log, rings, ring_count));
+
+    CHECK_TRUE(blackbox_file_close(&log) != FR_OK);
+}
@@ -0,0 +1,305 @@
+#include <CppUTest/TestHarness.h>
+#include <CppUTestExt/MockSupport.h>
+#include "bytecode_store.h"
+#include "flash_mock.h"
+#include <cstdint>
+#include <cstring>
+
+#define SECTOR_SIZE 256
+#define SECTOR_COUNT 2
+#define BYTECODE_SIZE 64
+
+TEST_GROUP(BytecodeStoreTestGroup)
+{
+    alignas(64) uint8_t flash[SECTOR_COUNT * SECTOR_SIZE];
+    bytecode_store_t store;
+    uint16_t bytecode[BYTECODE_SIZE];
+
+    void setup()
+    {
+        mock("flash").ignoreOtherCalls();
+        memset(flash, 0xff, sizeof(flash));
+        flash_mock_map(flash, SECTOR_SIZE, SECTOR_COUNT);
+        bytecode_store_init(&store, flash, SECTOR_SIZE, SECTOR_COUNT);
+    }
+
+    void teardown()
+    {
+        flash_mock_unmap();
+    }
+
+    /* A short program, the rest of the bytecode is zeros like in the VM. */
+    bool upload(uint16_t program)
+    {
+        memset(bytecode, 0, sizeof(bytecode));
+        for (int i = 0; i < 8; i++) {
+            bytecode[i] = program + i;
+        }
+        return bytecode_store_save(&store, bytecode, sizeof(bytecode));
+    }
+
+    /* Simulates a reboot, returns the first word of the loaded program. */
+    uint16_t reboot()
+    {
+        memset(bytecode, 0xaa, sizeof(bytecode));
+        CHECK_TRUE(bytecode_store_load(&store, bytecode, sizeof(bytecode)));
+        for (int i = 1; i < 8; i++) {
+            CHECK_EQUAL(bytecode[0] + i, bytecode[i]);
+        }
+        for (int i = 8; i < BYTECODE_SIZE; i++) {
+            CHECK_EQUAL(0, bytecode[i]);
+        }
+        return bytecode[0];
+    }
+};
+
+TEST(BytecodeStoreTestGroup, EmptyStoreHasNoBytecode)
+{
+    CHECK_EQUAL(-1, bytecode_store_active_sector(&store));
+    CHECK_FALSE(bytecode_store_load(&store, bytecode, sizeof(bytecode)));
+}
+
+TEST(BytecodeStoreTestGroup, SavedBytecodeIsLoaded)
+{
+    CHECK_TRUE(upload(100));
+
+    CHECK_EQUAL(0, bytecode_store_active_sector(&store));
+    CHECK_EQUAL(100, reboot());
+}
+
+TEST(BytecodeStoreTestGroup, TrailingZerosAreNotWritten)
+{
+    flash_mock_reset_time();
+    upload(100);
+
+    /* The high byte of the last word is a zero too. */
+    CHECK_EQUAL(BYTECODE_STORE_HEADER_SIZE + 8 * sizeof(uint16_t) - 1, flash_mock_program_bytes());
+}
+
+TEST(BytecodeStoreTestGroup, UnchangedBytecodeIsNotWritten)
+{
+    upload(100);
+
+    flash_mock_reset_time();
+    CHECK_TRUE(upload(100));
+
+    CHECK_EQUAL(0, flash_mock_program_bytes());
+    CHECK_EQUAL(0, flash_mock_erase_time_us());
+}
+
+TEST(BytecodeStoreTestGroup, UploadsAreAppendedWithoutErasing)
+{
+    upload(100);
+
+    flash_mock_reset_time();
+    upload(200);
+
+    CHECK_EQUAL(0, flash_mock_erase_time_us());
+    CHECK_EQUAL(0, bytecode_store_active_sector(&store));
+    CHECK_EQUAL(200, reboot());
+}
+
+TEST(BytecodeStoreTestGroup, FullSectorRotates)
+{
+    uint16_t program = 0;
+
+    /* Each image takes 32 bytes. */
+    for (int i = 0; i < SECTOR_SIZE / 32; i++) {
+        upload(++program);
+    }
+    CHECK_EQUAL(0, bytecode_store_active_sector(&store));
+
+    upload(++program);
+    CHECK_EQUAL(1, bytecode_store_active_sector(&store));
+    CHECK_EQUAL(program, reboot());
+
+    /* Rotation wraps around, erasing the oldest images. */
+    for (int i = 0; i < SECTOR_SIZE / 32; i++) {
+        upload(++program);
+    }
+    CHECK_EQUAL(0, bytecode_store_active_sector(&store));
+    CHECK_EQUAL(program, reboot());
+}
+
+TEST(BytecodeStoreTestGroup, BytecodeTooLargeIsRejected)
+{
+    uint8_t large[SECTOR_SIZE];
+
+    upload(100);
+    memset(large, 1, sizeof(large));
+
+    CHECK_FALSE(bytecode_store_save(&store, large, sizeof(large)));
+    CHECK_EQUAL(100, reboot());
+
+    /* As well as an image larger than the buffer. */
+    CHECK_TRUE(bytecode_store_save(&store, large, SECTOR_SIZE / 2));
+    CHECK_FALSE(bytecode_store_load(&store, bytecode, 16));
+}
+
+TEST(BytecodeStoreTestGroup, CorruptedImageIsIgnored)
+{
+    upload(100);
+    upload(200);
+
+    /* A bit flipped in the data of the newest image. */
+    flash[32 + BYTECODE_STORE_HEADER_SIZE + 3] ^= 0x10;
+
+    CHECK_EQUAL(100, reboot());
+}
+
+TEST(BytecodeStoreTestGroup, UnknownVersionIsIgnored)
+{
+    upload(100);
+    upload(200);
+
+    /* The version follows the magic number. */
+    flash[32 + 4] = BYTECODE_STORE_VERSION + 1;
+
+    CHECK_EQUAL(100, reboot());
+
+    /* The next upload does not overwrite it. */
+    CHECK_TRUE(upload(300));
+    CHECK_EQUAL(1, bytecode_store_active_sector(&store));
+    CHECK_EQUAL(300, reboot());
+}
+
+TEST(BytecodeStoreTestGroup, PowerCutAtAnyPointLeavesOldOrNewBytecode)
+{
+    uint8_t image[sizeof(flash)];
+    uint16_t program = 0;
+    size_t operations;
+
+    /* Make the next upload rotate, with a dirty sector to erase first. */
+    for (int i = 0; i < SECTOR_SIZE / 32; i++) {
+        upload(++program);
+    }
+    flash[SECTOR_SIZE + 100] = 0;
+    memcpy(image, flash, sizeof(flash));
+
+    /* Counts the operations of an upload. */
+    flash_mock_cut_power_after(SIZE_MAX);
+    upload(program + 1);
+    operations = flash_mock_operation_count();
+    CHECK_TRUE(operations > 1);
+
+    for (size_t cut = 0; cut < operations; cut++) {
+        memcpy(flash, image, sizeof(flash));
+
+        flash_mock_cut_power_after(cut);
+        CHECK_FALSE(upload(program + 1));
+        CHECK_TRUE(flash_mock_power_is_cut());
+        flash_mock_cut_power_after(SIZE_MAX);
+
+        uint16_t loaded = reboot();
+        CHECK_TRUE(loaded == program || loaded == program + 1);
+
+        /* The store is still usable after the power loss. */
+        CHECK_TRUE(upload(program + 2));
+        CHECK_EQUAL(program + 2, reboot());
+    }
+}
+
+TEST(BytecodeStoreTestGroup, FullVmBytecodeFitsInSector)
+{
+    /* Size of the e-puck2 VM bytecode, see aseba_node.c. */
+    static uint16_t vm_bytecode[766 + 768];
+    static uint8_t large_flash[2 * 128 * 1024];
+    bytecode_store_t large;
+
+    memset(large_flash, 0xff, sizeof(large_flash));
+    flash_mock_map(large_flash, 128 * 1024, 2);
+    bytecode_store_init(&large, large_flash, 128 * 1024, 2);
+
+    for (size_t i = 0; i < sizeof(vm_bytecode) / sizeof(uint16_t); i++) {
+        vm_bytecode[i] = i;
+    }
+
+    flash_mock_reset_time();
+    CHECK_TRUE(bytecode_store_save(&large, vm_bytecode, sizeof(vm_bytecode)));
+    uint64_t full_us = flash_mock_program_time_us();
+
+    /* A typical script only takes a few hundred words. */
+    memset(&vm_bytecode[300], 0, sizeof(vm_bytecode) - 300 * sizeof(uint16_t));
+    flash_mock_reset_time();
+    CHECK_TRUE(bytecode_store_save(&large, vm_bytecode, sizeof(vm_bytecode)));
+    uint64_t script_us = flash_mock_program_time_us();
+
+    flash_mock_reset_time();
+    CHECK_TRUE(bytecode_store_save(&large, vm_bytecode, sizeof(vm_bytecode)));
+    CHECK_EQUAL(0, flash_mock_program_time_us());
+
+    CHECK_TRUE(script_us < full_us);
+}
+
+TEST_GROUP(BytecodeStoreLegacyTestGroup)
+{
+    /* Size in bytes and bytecode, as written by older firmwares. */
+    uint16_t image[1 + BYTECODE_SIZE];
+    uint16_t bytecode[BYTECODE_SIZE];
+
+    void setup()
+    {
+        memset(image, 0xff, sizeof(image));
+        memset(bytecode, 0xaa, sizeof(bytecode));
+    }
+
+    /* A program handling two events, 12 words long. */
+    void write_program()
+    {
+        const uint16_t program[12] = {5, 0, 5, 3, 8, 1, 2, 3, 4, 5, 6, 7};
+
+        image[0] = sizeof(program);
+        memcpy(&image[1], program, sizeof(program));
+    }
+};
+
+TEST(BytecodeStoreLegacyTestGroup, ProgramIsLoaded)
+{
+    write_program();
+
+    CHECK_TRUE(bytecode_store_legacy_load(image, bytecode, BYTECODE_SIZE));
+
+    MEMCMP_EQUAL(&image[1], bytecode, image[0]);
+    for (int i = 12; i < BYTECODE_SIZE; i++) {
+        CHECK_EQUAL(0, bytecode[i]);
+    }
+}
+
+TEST(BytecodeStoreLegacyTestGroup, ErasedFlashIsNotLoaded)
+{
+    CHECK_FALSE(bytecode_store_legacy_load(image, bytecode, BYTECODE_SIZE));
+    CHECK_EQUAL(0xaaaa, bytecode[0]);
+}
+
+TEST(BytecodeStoreLegacyTestGroup, TooLargeSizeIsRejected)
+{
+    write_program();
+    image[0] = BYTECODE_SIZE * 2 + 2;
+
+    CHECK_FALSE(bytecode_store_legacy_load(image, bytecode, BYTECODE_SIZE));
+}
+
+TEST(BytecodeStoreLegacyTestGroup, InconsistentEventTableIsRejected)
+{
+    /* Even table size. */
+    write_program();
+    image[1] = 4;
+    CHECK_FALSE(bytecode_store_legacy_load(image, bytecode, BYTECODE_SIZE));
+
+    /* Table larger than the bytecode. */
+    write_program();
+    image[1] = 13;
+    CHECK_FALSE(bytecode_store_legacy_load(image, bytecode, BYTECODE_SIZE));
+
+    /* Event address in the table. */
+    write_program();
+    image[1 + 2] = 4;
+    CHECK_FALSE(bytecode_store_legacy_load(image, bytecode, BYTECODE_SIZE));
+
+    /* Event address past the end. */
+    write_program();
+    image[1 + 4] = 12;
+    CHECK_FALSE(bytecode_store_legacy_load(image, bytecode, BYTECODE_SIZE));
+
+    CHECK_EQUAL(0xaaaa, bytecode[0]);
+}
@@ -0,0 +1,234 @@
+#include <CppUTest/TestHarness.h>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include "aseba_vm/can_tx_queue.h"
+
+/* Controller with three transmit mailboxes, sent by order of arrival, on a
+ * 1Mbit bus. */
+struct can_controller {
+    static const int mailbox_count = 3;
+    can_tx_frame_t mailboxes[mailbox_count];
+    uint32_t arrival[mailbox_count];
+    bool busy[mailbox_count];
+    uint32_t arrivals;
+    std::vector<can_tx_frame_t> bus;
+    uint64_t bus_time_us;
+    int most_busy;
+
+    can_controller() : arrivals(0), bus_time_us(0), most_busy(0)
+    {
+        for (int i = 0; i < mailbox_count; i++) {
+            busy[i] = false;
+        }
+    }
+
+    int busy_count()
+    {
+        int count = 0;
+        for (int i = 0; i < mailbox_count; i++) {
+            count += busy[i];
+        }
+        return count;
+    }
+
+    /* Sends the oldest mailbox, returns false if they are all empty. */
+    bool complete()
+    {
+        int oldest = -1;
+
+        for (int i = 0; i < mailbox_count; i++) {
+            if (busy[i] && (oldest < 0 || arrival[i] < arrival[oldest])) {
+                oldest = i;
+            }
+        }
+        if (oldest < 0) {
+            return false;
+        }
+
+        /* Standard frame without stuff bits, plus the interframe space. */
+        bus_time_us += 47 + 8 * mailboxes[oldest].len;
+        bus.push_back(mailboxes[oldest]);
+        busy[oldest] = false;
+        return true;
+    }
+};
+
+static bool controller_transmit(void *arg, const can_tx_frame_t *frame)
+{
+    can_controller *controller = static_cast<can_controller *>(arg);
+
+    for (int i = 0; i < can_controller::mailbox_count; i++) {
+        if (!controller->busy[i]) {
+            controller->mailboxes[i] = *frame;
+            controller->arrival[i] = controller->arrivals++;
+            controller->busy[i] = true;
+            if (controller->busy_count() > controller->most_busy) {
+                controller->most_busy = controller->busy_count();
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+TEST_GROUP(CanTxQueueTestGroup)
+{
+    can_tx_frame_t frames[8];
+    can_tx_queue_t queue;
+    can_controller controller;
+
+    void setup()
+    {
+        can_tx_queue_init(&queue, frames, 8, controller_transmit, &controller);
+    }
+
+    can_tx_frame_t frame(uint16_t id)
+    {
+        can_tx_frame_t f = {id, 8, {1, 2, 3, 4, 5, 6, 7, 8}};
+        return f;
+    }
+
+    /* What the mailbox empty interrupt does. */
+    void complete()
+    {
+        CHECK_TRUE(controller.complete());
+        can_tx_queue_drain(&queue);
+    }
+
+    /* Sends frames until the bus is idle, with the sender keeping the queue
+     * full like Aseba does with its own queue. Returns the frames per second
+     * on the simulated bus. */
+    double send_frames(int frame_count)
+    {
+        can_tx_frame_t f = frame(0);
+        int pushed = 0;
+
+        while (pushed < frame_count || controller.busy_count() > 0) {
+            while (pushed < frame_count && can_tx_queue_space(&queue) > 0) {
+                f.id = pushed++ & 0x7ff;
+                can_tx_queue_push(&queue, &f);
+            }
+            complete();
+        }
+
+        return frame_count * 1e6 / controller.bus_time_us;
+    }
+};
+
+TEST(CanTxQueueTestGroup, StartsEmpty)
+{
+    CHECK_EQUAL(8, can_tx_queue_space(&queue));
+    CHECK_EQUAL(0, can_tx_queue_drain(&queue));
+}
+
+TEST(CanTxQueueTestGroup, FramesGoStraightToFreeMailboxes)
+{
+    for (uint16_t id = 0; id < 3; id++) {
+        can_tx_frame_t f = frame(id);
+        CHECK_TRUE(can_tx_queue_push(&queue, &f));
+    }
+
+    CHECK_EQUAL(3, controller.busy_count());
+    CHECK_EQUAL(8, can_tx_queue_space(&queue));
+    CHECK_EQUAL(3, queue.stats.sent);
+}
+
+TEST(CanTxQueueTestGroup, FramesWaitForAMailbox)
+{
+    for (uint16_t id = 0; id < 5; id++) {
+        can_tx_frame_t f = frame(id);
+        can_tx_queue_push(&queue, &f);
+    }
+
+    CHECK_EQUAL(6, can_tx_queue_space(&queue));
+
+    complete();
+
+    CHECK_EQUAL(7, can_tx_queue_space(&queue));
+    CHECK_EQUAL(3, controller.busy_count());
+}
+
+TEST(CanTxQueueTestGroup, HighWaterMarkIsKept)
+{
+    for (uint16_t id = 0; id < 5; id++) {
+        can_tx_frame_t f = frame(id);
+        can_tx_queue_push(&queue, &f);
+    }
+
+    CHECK_EQUAL(2, queue.stats.high_water);
+
+    complete();
+    complete();
+    CHECK_EQUAL(2, queue.stats.high_water);
+
+    for (uint16_t id = 0; id < 20; id++) {
+        can_tx_frame_t f = frame(id);
+        can_tx_queue_push(&queue, &f);
+    }
+    CHECK_EQUAL(8, queue.stats.high_water);
+}
+
+TEST(CanTxQueueTestGroup, FramesKeepTheirOrder)
+{
+    for (uint16_t id = 0; id < 11; id++) {
+        can_tx_frame_t f = frame(id);
+        CHECK_TRUE(can_tx_queue_push(&queue, &f));
+        if (id % 2) {
+            complete();
+        }
+    }
+    while (controller.complete()) {
+        can_tx_queue_drain(&queue);
+    }
+
+    CHECK_EQUAL(11, controller.bus.size());
+    for (uint16_t id = 0; id < 11; id++) {
+        CHECK_EQUAL(id, controller.bus[id].id);
+        CHECK_EQUAL(8, controller.bus[id].len);
+        CHECK_EQUAL(8, controller.bus[id].data[7]);
+    }
+}
+
+TEST(CanTxQueueTestGroup, FullQueueDropsTheFrame)
+{
+    can_tx_frame_t f = frame(0);
+
+    for (int i = 0; i < 11; i++) {
+        CHECK_TRUE(can_tx_queue_push(&queue, &f));
+    }
+
+    CHECK_EQUAL(0, can_tx_queue_space(&queue));
+    CHECK_FALSE(can_tx_queue_push(&queue, &f));
+    CHECK_EQUAL(1, queue.stats.dropped);
+
+    complete();
+    CHECK_TRUE(can_tx_queue_push(&queue, &f));
+}
+
+TEST(CanTxQueueTestGroup, BusIsNeverIdle)
+{
+    const int frame_count = 10000;
+    double frames_per_second = send_frames(frame_count);
+
+    CHECK_EQUAL(frame_count, controller.bus.size());
+    CHECK_EQUAL(3, controller.most_busy);
+
+    /* Against the 1000 frames/s of one frame per millisecond. */
+    CHECK(frames_per_second > 8000);
+}
+
+/* Only prints the throughput, ignored unless the tests are run with -ri. */
+IGNORE_TEST(CanTxQueueTestGroup, ThroughputBenchmark)
+{
+    const int frame_count = 100000;
+
+    auto start = std::chrono::steady_clock::now();
+    double frames_per_second = send_frames(frame_count);
+    auto end = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+
+    printf("\nCAN TX: %.0f frames/s at 1Mbit, %.1f ns per frame on the host\n",
+           frames_per_second, ns / frame_count);
+}
@@ -0,0 +1,350 @@
+#include <CppUTest/TestHarness.h>
+#include <CppUTestExt/MockSupport.h>
+#include "config_delta.h"
+#include "config_journal.h"
+#include "parameter/parameter_msgpack.h"
+#include "cmp_mem_access/cmp_mem_access.h"
+#include "flash_mock.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+TEST_GROUP(ConfigDeltaTestGroup)
+{
+    parameter_namespace_t root, left, right;
+    parameter_t left_kp, left_ki, right_kp, right_ki, id, enabled;
+    config_delta_t delta;
+    config_delta_entry_t entries[16];
+
+    void setup()
+    {
+        parameter_namespace_declare(&root, NULL, NULL);
+        parameter_namespace_declare(&left, &root, "left");
+        parameter_namespace_declare(&right, &root, "right");
+        parameter_scalar_declare_with_default(&left_kp, &left, "kp", 1.f);
+        parameter_scalar_declare_with_default(&left_ki, &left, "ki", 0.f);
+        parameter_scalar_declare_with_default(&right_kp, &right, "kp", 1.f);
+        parameter_scalar_declare_with_default(&right_ki, &right, "ki", 0.f);
+        parameter_integer_declare_with_default(&id, &root, "id", 1);
+        parameter_boolean_declare_with_default(&enabled, &root, "enabled", true);
+
+        config_delta_init(&delta, entries, 16);
+    }
+
+    /* Writes the changes to buf, returns the patch size. */
+    size_t write_patch(uint8_t *buf, size_t len)
+    {
+        cmp_ctx_t cmp;
+        cmp_mem_access_t mem;
+
+        cmp_mem_access_init(&cmp, &mem, buf, len);
+        CHECK_TRUE(config_delta_write(&delta, &root, &cmp));
+        return cmp_mem_access_get_pos(&mem);
+    }
+};
+
+TEST(ConfigDeltaTestGroup, ChangesAreUnknownUntilSaved)
+{
+    CHECK_EQUAL(-1, config_delta_changed_count(&delta, &root));
+
+    config_delta_mark_saved(&delta, &root);
+    CHECK_EQUAL(0, config_delta_changed_count(&delta, &root));
+
+    config_delta_invalidate(&delta);
+    CHECK_EQUAL(-1, config_delta_changed_count(&delta, &root));
+}
+
+TEST(ConfigDeltaTestGroup, CountsChangedParameters)
+{
+    config_delta_mark_saved(&delta, &root);
+
+    parameter_scalar_set(&left_kp, 3.f);
+    CHECK_EQUAL(1, config_delta_changed_count(&delta, &root));
+
+    parameter_scalar_set(&right_ki, 0.5f);
+    parameter_boolean_set(&enabled, false);
+    CHECK_EQUAL(3, config_delta_changed_count(&delta, &root));
+
+    config_delta_mark_saved(&delta, &root);
+    CHECK_EQUAL(0, config_delta_changed_count(&delta, &root));
+}
+
+TEST(ConfigDeltaTestGroup, SettingTheSameValueIsNotAChange)
+{
+    config_delta_mark_saved(&delta, &root);
+
+    parameter_scalar_set(&left_kp, 1.f);
+    parameter_integer_set(&id, 1);
+
+    CHECK_EQUAL(0, config_delta_changed_count(&delta, &root));
+}
+
+TEST(ConfigDeltaTestGroup, ParameterDefinedAfterSaveIsChanged)
+{
+    parameter_t gain;
+
+    parameter_scalar_declare(&gain, &root, "gain");
+    config_delta_mark_saved(&delta, &root);
+    CHECK_EQUAL(0, config_delta_changed_count(&delta, &root));
+
+    parameter_scalar_set(&gain, 2.f);
+    CHECK_EQUAL(1, config_delta_changed_count(&delta, &root));
+}
+
+TEST(ConfigDeltaTestGroup, ValueWithAZeroDigestIsChanged)
+{
+    /* The CRC of the encoding of this value is 0. */
+    const uint32_t bits = 0xe99c01f4;
+    float value;
+
+    memcpy(&value, &bits, sizeof(value));
+    config_delta_mark_saved(&delta, &root);
+
+    parameter_scalar_set(&left_kp, value);
+    CHECK_EQUAL(1, config_delta_changed_count(&delta, &root));
+}
+
+TEST(ConfigDeltaTestGroup, ChangedFlagIsLeftToTheUser)
+{
+    config_delta_mark_saved(&delta, &root);
+    parameter_scalar_set(&left_kp, 3.f);
+
+    config_delta_changed_count(&delta, &root);
+    config_delta_mark_saved(&delta, &root);
+
+    CHECK_TRUE(parameter_changed(&left_kp));
+}
+
+TEST(ConfigDeltaTestGroup, TooManyParametersCannotBeTracked)
+{
+    config_delta_init(&delta, entries, 4);
+    config_delta_mark_saved(&delta, &root);
+
+    CHECK_EQUAL(-1, config_delta_changed_count(&delta, &root));
+}
+
+TEST(ConfigDeltaTestGroup, PatchOnlyHoldsChangedParameters)
+{
+    uint8_t patch[64];
+    size_t len;
+
+    config_delta_mark_saved(&delta, &root);
+    parameter_scalar_set(&left_kp, 3.5f);
+    len = write_patch(patch, sizeof(patch));
+
+    /* Values not in the patch are left untouched when it is applied. */
+    parameter_scalar_set(&left_kp, 0.f);
+    parameter_scalar_set(&right_kp, 7.f);
+    parameter_integer_set(&id, 2);
+    CHECK_EQUAL(0, parameter_msgpack_read(&root, (char *)patch, len, NULL, NULL));
+
+    DOUBLES_EQUAL(3.5, parameter_scalar_get(&left_kp), 1e-6);
+    DOUBLES_EQUAL(7., parameter_scalar_get(&right_kp), 1e-6);
+    CHECK_EQUAL(2, parameter_integer_get(&id));
+}
+
+TEST(ConfigDeltaTestGroup, EmptyPatchIsAnEmptyMap)
+{
+    uint8_t patch[64];
+
+    config_delta_mark_saved(&delta, &root);
+
+    CHECK_EQUAL(1, write_patch(patch, sizeof(patch)));
+    CHECK_EQUAL(0x80, patch[0]);
+}
+
+/* Parameter tree similar to the one of the robot: the Aseba settings, a PID
+ * per control loop for each wheel and a few flags. */
+#define ASEBA_SETTINGS 32
+#define WHEELS 2
+#define LOOPS 3
+#define GAINS 4
+#define FLAGS 6
+
+#define SECTOR_SIZE 4096
+
+TEST_GROUP(ConfigDeltaSaveTestGroup)
+{
+    alignas(64) uint8_t flash[2 * SECTOR_SIZE];
+    config_journal_t journal;
+    config_delta_t delta;
+    config_delta_entry_t entries[128];
+
+    parameter_namespace_t root, aseba, wheels[WHEELS], loops[WHEELS][LOOPS];
+    parameter_t settings[ASEBA_SETTINGS], gains[WHEELS][LOOPS][GAINS], flags[FLAGS];
+    char settings_names[ASEBA_SETTINGS][4];
+
+    void setup()
+    {
+        static const char *wheel_names[WHEELS] = {"left_wheel", "right_wheel"};
+        static const char *loop_names[LOOPS] = {"position", "velocity", "current"};
+        static const char *gain_names[GAINS] = {"kp", "ki", "kd", "i_limit"};
+        static const char *flag_names[FLAGS] = {"a", "b", "c", "d", "e", "f"};
+
+        mock("flash").ignoreOtherCalls();
+        memset(flash, 0xff, sizeof(flash));
+        flash_mock_map(flash, SECTOR_SIZE, 2);
+
+        parameter_namespace_declare(&root, NULL, NULL);
+        parameter_namespace_declare(&aseba, &root, "aseba");
+        for (int i = 0; i < ASEBA_SETTINGS; i++) {
+            snprintf(settings_names[i], sizeof(settings_names[i]), "%d", i);
+            parameter_integer_declare_with_default(&settings[i], &aseba, settings_names[i], 0);
+        }
+
+        for (int w = 0; w < WHEELS; w++) {
+            parameter_namespace_declare(&wheels[w], &root, wheel_names[w]);
+            for (int l = 0; l < LOOPS; l++) {
+                parameter_namespace_declare(&loops[w][l], &wheels[w], loop_names[l]);
+                for (int g = 0; g < GAINS; g++) {
+                    parameter_scalar_declare_with_default(&gains[w][l][g], &loops[w][l],
+                                                          gain_names[g], 1.f);
+                }
+            }
+        }
+
+        for (int i = 0; i < FLAGS; i++) {
+            parameter_boolean_declare_with_default(&flags[i], &root, flag_names[i], true);
+        }
+
+        config_journal_init(&journal, flash, SECTOR_SIZE, 2);
+        config_delta_init(&delta, entries, 128);
+        config_journal_track_changes(&journal, &delta);
+    }
+
+    void teardown()
+    {
+        flash_mock_unmap();
+    }
+
+    uint64_t save(void)
+    {
+        flash_mock_reset_time();
+        CHECK_TRUE(config_journal_save(&journal, &root));
+        return flash_mock_program_bytes();
+    }
+
+    /* Returns the bytes written by the first save, then by tuning a gain from
+     * the tune_*_controller scripts and by tuning a whole PID. */
+    void save_tuning(uint64_t *full, uint64_t *one_gain, uint64_t *pid)
+    {
+        *full = save();
+
+        parameter_scalar_set(&gains[0][1][0], 2.f);
+        *one_gain = save();
+
+        for (int g = 0; g < GAINS; g++) {
+            parameter_scalar_set(&gains[1][1][g], 3.f);
+        }
+        *pid = save();
+    }
+};
+
+TEST(ConfigDeltaSaveTestGroup, UnchangedTreeIsNotWritten)
+{
+    save();
+
+    CHECK_EQUAL(0, save());
+}
+
+TEST(ConfigDeltaSaveTestGroup, LoadMergesPatchesOverSnapshot)
+{
+    save();
+    parameter_scalar_set(&gains[0][1][0], 2.5f);
+    save();
+    parameter_integer_set(&settings[3], 42);
+    save();
+
+    parameter_scalar_set(&gains[0][1][0], 0.f);
+    parameter_integer_set(&settings[3], 0);
+    CHECK_TRUE(config_journal_load(&journal, &root));
+
+    DOUBLES_EQUAL(2.5, parameter_scalar_get(&gains[0][1][0]), 1e-6);
+    CHECK_EQUAL(42, parameter_integer_get(&settings[3]));
+    DOUBLES_EQUAL(1., parameter_scalar_get(&gains[1][1][0]), 1e-6);
+}
+
+TEST(ConfigDeltaSaveTestGroup, LoadThroughParameterIndex)
+{
+    parameter_index_t index;
+    parameter_index_entry_t entries[128];
+
+    parameter_index_init(&index, &root, entries, 128);
+    parameter_index_build(&index);
+    config_journal_use_index(&journal, &index);
+
+    save();
+    parameter_scalar_set(&gains[1][2][3], 4.5f);
+    save();
+
+    parameter_scalar_set(&gains[1][2][3], 0.f);
+    parameter_boolean_set(&flags[2], false);
+    CHECK_TRUE(config_journal_load(&journal, &root));
+
+    DOUBLES_EQUAL(4.5, parameter_scalar_get(&gains[1][2][3]), 1e-6);
+    CHECK_TRUE(parameter_boolean_get(&flags[2]));
+    CHECK_EQUAL(0, config_delta_changed_count(&delta, &root));
+}
+
+TEST(ConfigDeltaSaveTestGroup, RotationWritesTheWholeTree)
+{
+    float kp = 1.f;
+
+    save();
+
+    while (config_journal_active_sector(&journal) == 0) {
+        kp += 1.f;
+        parameter_scalar_set(&gains[1][0][0], kp);
+        save();
+    }
+
+    /* Only the snapshot of the new sector is read. */
+    CHECK_EQUAL(1, config_journal_active_sector(&journal));
+    parameter_scalar_set(&gains[1][0][0], 0.f);
+    CHECK_TRUE(config_journal_load(&journal, &root));
+    DOUBLES_EQUAL(kp, parameter_scalar_get(&gains[1][0][0]), 1e-6);
+}
+
+TEST(ConfigDeltaSaveTestGroup, SaveAfterFailedLoadWritesTheWholeTree)
+{
+    uint64_t full = save();
+
+    config_delta_invalidate(&delta);
+
+    CHECK_EQUAL(full - CONFIG_JOURNAL_HEADER_SIZE, save());
+}
+
+TEST(ConfigDeltaSaveTestGroup, InterruptedPatchKeepsPreviousValue)
+{
+    save();
+    parameter_scalar_set(&gains[0][0][1], 0.25f);
+
+    flash_mock_cut_power_after(4);
+    config_journal_save(&journal, &root);
+    flash_mock_cut_power_after(SIZE_MAX);
+
+    parameter_scalar_set(&gains[0][0][1], 3.f);
+    CHECK_TRUE(config_journal_load(&journal, &root));
+    DOUBLES_EQUAL(1., parameter_scalar_get(&gains[0][0][1]), 1e-6);
+}
+
+TEST(ConfigDeltaSaveTestGroup, BytesWrittenPerSave)
+{
+    uint64_t full, one_gain, pid;
+
+    save_tuning(&full, &one_gain, &pid);
+
+    CHECK_TRUE(one_gain * 10 <= full);
+    CHECK_TRUE(pid < full / 4);
+}
+
+/* Prints the bytes written, ignored unless the tests are run with -ri. */
+IGNORE_TEST(ConfigDeltaSaveTestGroup, BytesWrittenPerSaveBenchmark)
+{
+    uint64_t full, one_gain, pid;
+
+    save_tuning(&full, &one_gain, &pid);
+
+    printf("\nBytes written per save: whole tree %d, one gain %d, one PID %d\n",
+           (int)full, (int)one_gain, (int)pid);
+}
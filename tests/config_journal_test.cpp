@@ -0,0 +1,275 @@
+#include <CppUTest/TestHarness.h>
+#include <CppUTestExt/MockSupport.h>
+#include "config_journal.h"
+#include "config_flash_storage.h"
+#include "flash_mock.h"
+#include <cstdint>
+#include <cstring>
+
+#define SECTOR_SIZE 256
+#define SECTOR_COUNT 2
+
+TEST_GROUP(ConfigJournalTestGroup)
+{
+    alignas(64) uint8_t flash[SECTOR_COUNT * SECTOR_SIZE];
+    config_journal_t journal;
+    parameter_namespace_t ns;
+    parameter_t foo, bar;
+
+    void setup()
+    {
+        mock("flash").ignoreOtherCalls();
+        memset(flash, 0xff, sizeof(flash));
+        flash_mock_map(flash, SECTOR_SIZE, SECTOR_COUNT);
+        config_journal_init(&journal, flash, SECTOR_SIZE, SECTOR_COUNT);
+
+        parameter_namespace_declare(&ns, NULL, NULL);
+        parameter_integer_declare(&foo, &ns, "foo");
+        parameter_integer_declare(&bar, &ns, "bar");
+        parameter_integer_set(&bar, 42);
+    }
+
+    void teardown()
+    {
+        flash_mock_unmap();
+    }
+
+    bool save(int value)
+    {
+        parameter_integer_set(&foo, value);
+        return config_journal_save(&journal, &ns);
+    }
+
+    /* Simulates a reboot: the RAM value is lost and the tree is reloaded. */
+    int reboot()
+    {
+        parameter_integer_set(&foo, -1);
+        CHECK_TRUE(config_journal_load(&journal, &ns));
+        return parameter_integer_get(&foo);
+    }
+
+    /* Saves until the next save would rotate to another sector, returns the
+     * last saved value. */
+    int fill_active_sector()
+    {
+        int value = 0;
+        int active = config_journal_active_sector(&journal);
+
+        if (active < 0) {
+            save(value);
+            active = config_journal_active_sector(&journal);
+        }
+
+        while (true) {
+            uint8_t backup[sizeof(flash)];
+            memcpy(backup, flash, sizeof(flash));
+            save(++value);
+            if (config_journal_active_sector(&journal) != active) {
+                memcpy(flash, backup, sizeof(flash));
+                return value - 1;
+            }
+        }
+    }
+};
+
+TEST(ConfigJournalTestGroup, EmptyJournalHasNoActiveSector)
+{
+    CHECK_EQUAL(-1, config_journal_active_sector(&journal));
+    CHECK_EQUAL(0, config_journal_used(&journal));
+    CHECK_FALSE(config_journal_load(&journal, &ns));
+}
+
+TEST(ConfigJournalTestGroup, FirstSaveStartsTheJournal)
+{
+    CHECK_TRUE(save(10));
+
+    CHECK_EQUAL(0, config_journal_active_sector(&journal));
+    CHECK_EQUAL(10, reboot());
+    CHECK_EQUAL(42, parameter_integer_get(&bar));
+}
+
+TEST(ConfigJournalTestGroup, SavesAreAppendedWithoutErasing)
+{
+    size_t used;
+
+    save(10);
+    used = config_journal_used(&journal);
+
+    flash_mock_reset_time();
+    save(20);
+
+    CHECK_EQUAL(0, config_journal_active_sector(&journal));
+    CHECK_EQUAL(2 * used - CONFIG_JOURNAL_HEADER_SIZE, config_journal_used(&journal));
+    CHECK_EQUAL(0, flash_mock_erase_time_us());
+    CHECK_EQUAL(20, reboot());
+}
+
+TEST(ConfigJournalTestGroup, FullSectorRotates)
+{
+    int value = fill_active_sector();
+
+    save(value + 1);
+
+    CHECK_EQUAL(1, config_journal_active_sector(&journal));
+    CHECK_EQUAL(value + 1, reboot());
+
+    /* The new sector only holds the snapshot. */
+    save(value + 2);
+    save(value + 3);
+    CHECK_EQUAL(value + 3, reboot());
+}
+
+TEST(ConfigJournalTestGroup, RotationWrapsAround)
+{
+    for (int i = 0; i < SECTOR_COUNT; i++) {
+        int value = fill_active_sector();
+        save(value + 1);
+    }
+
+    CHECK_EQUAL(0, config_journal_active_sector(&journal));
+    CHECK_TRUE(config_journal_used(&journal) < SECTOR_SIZE / 2);
+}
+
+TEST(ConfigJournalTestGroup, NextSectorIsErasedAheadOfRotation)
+{
+    int value = fill_active_sector();
+
+    /* Leave something to erase in the next sector. */
+    flash[SECTOR_SIZE + 100] = 0;
+    CHECK_TRUE(config_journal_next_sector_needs_erase(&journal));
+
+    config_journal_erase_next_sector(&journal);
+    CHECK_FALSE(config_journal_next_sector_needs_erase(&journal));
+
+    /* The rotation itself then only programs flash. */
+    flash_mock_reset_time();
+    save(value + 1);
+    CHECK_EQUAL(1, config_journal_active_sector(&journal));
+    CHECK_EQUAL(0, flash_mock_erase_time_us());
+}
+
+TEST(ConfigJournalTestGroup, NothingToEraseWhileSectorIsMostlyEmpty)
+{
+    flash[SECTOR_SIZE + 100] = 0;
+    save(10);
+
+    CHECK_FALSE(config_journal_next_sector_needs_erase(&journal));
+}
+
+TEST(ConfigJournalTestGroup, EraseClearsEverySector)
+{
+    fill_active_sector();
+    save(1000);
+
+    config_journal_erase(&journal);
+
+    CHECK_EQUAL(-1, config_journal_active_sector(&journal));
+    CHECK_FALSE(config_journal_load(&journal, &ns));
+}
+
+TEST(ConfigJournalTestGroup, LegacyConfigIsLoaded)
+{
+    /* Settings written by the previous single sector format. */
+    parameter_integer_set(&foo, 1234);
+    config_save(&flash[SECTOR_SIZE], SECTOR_SIZE, &ns);
+
+    CHECK_EQUAL(1234, reboot());
+
+    /* The first save starts the journal in the other sector. */
+    save(10);
+    CHECK_EQUAL(0, config_journal_active_sector(&journal));
+    CHECK_EQUAL(10, reboot());
+}
+
+TEST(ConfigJournalTestGroup, InterruptedAppendKeepsPreviousValue)
+{
+    save(10);
+
+    flash_mock_cut_power_after(5);
+    save(20);
+    CHECK_TRUE(flash_mock_power_is_cut());
+
+    flash_mock_cut_power_after(SIZE_MAX);
+    CHECK_EQUAL(10, reboot());
+
+    /* The leftovers are skipped by rotating to the next sector. */
+    CHECK_TRUE(save(30));
+    CHECK_EQUAL(1, config_journal_active_sector(&journal));
+    CHECK_EQUAL(30, reboot());
+}
+
+TEST(ConfigJournalTestGroup, RecordInterruptedInItsChecksumIsSkipped)
+{
+    uint8_t image[sizeof(flash)];
+    size_t operations;
+
+    save(10);
+    memcpy(image, flash, sizeof(flash));
+
+    flash_mock_cut_power_after(SIZE_MAX);
+    save(20);
+    operations = flash_mock_operation_count();
+
+    /* The data checksum is the last word written. */
+    memcpy(flash, image, sizeof(flash));
+    flash_mock_cut_power_after(operations - 2);
+    save(20);
+    flash_mock_cut_power_after(SIZE_MAX);
+
+    CHECK_EQUAL(10, reboot());
+
+    /* The next record is appended after it. */
+    CHECK_TRUE(save(30));
+    CHECK_EQUAL(0, config_journal_active_sector(&journal));
+    CHECK_EQUAL(30, reboot());
+}
+
+TEST(ConfigJournalTestGroup, PowerCutAtAnyPointLeavesOldOrNewConfig)
+{
+    uint8_t image[sizeof(flash)];
+    int old_value, new_value;
+    size_t operations;
+
+    /* Make the next save rotate, with a dirty sector to erase first. */
+    fill_active_sector();
+    flash[SECTOR_SIZE + 100] = 0;
+    old_value = reboot();
+    new_value = old_value + 1;
+    memcpy(image, flash, sizeof(flash));
+
+    /* Counts the operations of a save. */
+    flash_mock_cut_power_after(SIZE_MAX);
+    save(new_value);
+    operations = flash_mock_operation_count();
+    CHECK_TRUE(operations > 1);
+
+    for (size_t cut = 0; cut < operations; cut++) {
+        memcpy(flash, image, sizeof(flash));
+
+        flash_mock_cut_power_after(cut);
+        save(new_value);
+        CHECK_TRUE(flash_mock_power_is_cut());
+        flash_mock_cut_power_after(SIZE_MAX);
+
+        int value = reboot();
+        CHECK_TRUE(value == old_value || value == new_value);
+
+        /* The journal is still usable after the power loss. */
+        CHECK_TRUE(save(new_value + 1));
+        CHECK_EQUAL(new_value + 1, reboot());
+    }
+}
+
+TEST(ConfigJournalTestGroup, PowerCutDuringBackgroundEraseIsHarmless)
+{
+    int value = fill_active_sector();
+
+    flash[SECTOR_SIZE + 100] = 0;
+    flash_mock_cut_power_after(0);
+    config_journal_erase_next_sector(&journal);
+    flash_mock_cut_power_after(SIZE_MAX);
+
+    CHECK_EQUAL(value, reboot());
+    CHECK_TRUE(save(value + 1));
+    CHECK_EQUAL(value + 1, reboot());
+}
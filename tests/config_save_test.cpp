@@ -4,17 +4,21 @@
 #include "config_flash_storage_private.h"
 #include "parameter/parameter_msgpack.h"
 #include <cstdio>
+#include <chrono>
 #include <cstring>
 #include "crc/crc32.h"
 
 TEST_GROUP(ConfigSaveTestCase)
 {
-    uint8_t data[128];
+    // Aligned so that the number of flash writes does not depend on where the
+    // buffer lands in memory.
+    alignas(64) uint8_t data[128];
     parameter_namespace_t ns;
 
     void setup()
     {
         mock("flash").ignoreOtherCalls();
+        memset(data, 0xff, sizeof(data));
         parameter_namespace_declare(&ns, NULL, NULL);
     }
 };
@@ -37,6 +41,7 @@ TEST(ConfigSaveTestCase, SavingConfigLockUnlock)
     mock("flash").expectOneCall("write"); // CRC(len)
     mock("flash").expectOneCall("write"); // len
     mock("flash").expectOneCall("write"); // crc(data)
+    mock("flash").expectOneCall("write"); // index
     mock("flash").expectOneCall("lock");
 
     config_save(data, sizeof(data), &ns);
@@ -66,7 +71,7 @@ TEST(ConfigSaveTestCase, SavingConfigWorks)
     // Check that the flash writer is used
     // Number of expected written bytes is implementation-dependent
     // Change if if necessary
-    for (int i = 0; i < 8; i++) {
+    for (int i = 0; i < 5; i++) {
         mock("flash").expectOneCall("write");
     }
 
@@ -95,6 +100,7 @@ TEST_GROUP(ConfigLoadTestCase)
     void setup()
     {
         mock("flash").ignoreOtherCalls();
+        memset(data, 0xff, sizeof(data));
         parameter_namespace_declare(&ns, NULL, NULL);
         parameter_integer_declare(&foo, &ns, "foo");
     }
@@ -110,7 +116,7 @@ TEST(ConfigLoadTestCase, SimpleLoad)
     parameter_integer_set(&foo, 10);
 
     // Load the tree
-    auto res = config_load(&ns, data);
+    auto res = config_load(&ns, data, sizeof(data));
 
     // Value should be back to what it was
     CHECK_TRUE(res);
@@ -130,7 +136,7 @@ TEST(ConfigLoadTestCase, CRCIsChecked)
     data[0] ^= 0x40;
 
     // Load the tree
-    auto res = config_load(&ns, data);
+    auto res = config_load(&ns, data, sizeof(data));
 
     // Value should not have changed
     CHECK_FALSE(res);
@@ -151,7 +157,7 @@ TEST(ConfigLoadTestCase, InvalidConfigReturnsFalse)
     parameter_integer_declare(&foo, &ns, "bar");
 
     // Try to load it
-    auto res = config_load(&ns, data);
+    auto res = config_load(&ns, data, sizeof(data));
 
     CHECK_FALSE(res);
 }
@@ -259,6 +265,7 @@ TEST_GROUP(ConfigLoadBalancingTestGroup)
     void setup()
     {
         mock("flash").ignoreOtherCalls();
+        memset(block, 0xff, sizeof(block));
         parameter_namespace_declare(&ns, NULL, NULL);
     }
 
@@ -303,7 +310,7 @@ TEST(ConfigLoadBalancingTestGroup, CanLoadCorrectBlock)
     // Finally load it from flash and see if latest version was used
     parameter_integer_set(&p, 3);
 
-    auto res = config_load(&ns, block);
+    auto res = config_load(&ns, block, sizeof(block));
     CHECK_TRUE(res);
     CHECK_EQUAL(2, parameter_integer_get(&p));
 }
@@ -314,6 +321,7 @@ TEST(ConfigLoadBalancingTestGroup, CanErasePageIfNotenoughSpaceLeft)
     // to write the config header
 
     uint8_t block[30];
+    memset(block, 0xff, sizeof(block));
 
     parameter_t p;
     parameter_integer_declare(&p, &ns, "foo");
@@ -323,8 +331,8 @@ TEST(ConfigLoadBalancingTestGroup, CanErasePageIfNotenoughSpaceLeft)
 
     config_save(block, sizeof(block), &ns);
 
-    // We used 10 + CONFIG_HEADER_SIZE bytes, so there is not enough free space
-    // available for the header
+    // We used 10 + CONFIG_HEADER_SIZE bytes and the index slot, so there is
+    // not enough free space available for the header
     CHECK_EQUAL(10, config_block_get_length(block));
 
     mock("flash").expectOneCall("erase").withParameter("sector", block);
@@ -333,7 +341,10 @@ TEST(ConfigLoadBalancingTestGroup, CanErasePageIfNotenoughSpaceLeft)
 
 TEST(ConfigSaveTestCase, CanErasePageIfNotenoughSpaceLeftForData)
 {
-    uint8_t block[36];
+    // Enough space for a second header, but not its data once the index slot
+    // at the end is accounted for.
+    uint8_t block[48];
+    memset(block, 0xff, sizeof(block));
 
     parameter_t p;
     parameter_integer_declare(&p, &ns, "foo");
@@ -351,3 +362,170 @@ TEST(ConfigSaveTestCase, CanErasePageIfNotenoughSpaceLeftForData)
     mock("flash").expectOneCall("erase").withParameter("sector", block);
     config_save(block, sizeof(block), &ns);
 }
+
+TEST_GROUP(ConfigIndexTestGroup)
+{
+    parameter_namespace_t ns;
+    parameter_t foo;
+    uint8_t area[1024];
+
+    void setup()
+    {
+        mock("flash").ignoreOtherCalls();
+        memset(area, 0xff, sizeof(area));
+        parameter_namespace_declare(&ns, NULL, NULL);
+        parameter_integer_declare(&foo, &ns, "foo");
+    }
+
+    void save(int value)
+    {
+        parameter_integer_set(&foo, value);
+        config_save(area, sizeof(area), &ns);
+    }
+
+    uint8_t *slot(size_t i)
+    {
+        return &area[sizeof(area) - (i + 1) * CONFIG_INDEX_SLOT_SIZE];
+    }
+};
+
+TEST(ConfigIndexTestGroup, IndexIsAtTheEndOfTheArea)
+{
+    CHECK_EQUAL(8, config_index_slot_count(sizeof(area)));
+    CHECK_EQUAL(sizeof(area) - 8 * CONFIG_INDEX_SLOT_SIZE, config_data_area_size(sizeof(area)));
+}
+
+TEST(ConfigIndexTestGroup, EachSaveIsIndexed)
+{
+    CHECK_EQUAL(0, config_index_find_free_slot(area, sizeof(area)));
+
+    save(1);
+    save(2);
+    save(3);
+
+    CHECK_EQUAL(3, config_index_find_free_slot(area, sizeof(area)));
+}
+
+TEST(ConfigIndexTestGroup, IndexPointsToLastBlock)
+{
+    save(1);
+    save(2);
+    save(3);
+
+    POINTERS_EQUAL(config_block_find_last_used(area),
+                   config_find_last_block(area, sizeof(area)));
+}
+
+TEST(ConfigIndexTestGroup, EmptyAreaHasNoBlock)
+{
+    POINTERS_EQUAL(NULL, config_find_last_block(area, sizeof(area)));
+}
+
+TEST(ConfigIndexTestGroup, UnindexedBlockIsFound)
+{
+    save(1);
+    save(2);
+
+    // Simulate a power loss between writing the block and its index slot
+    memset(slot(1), 0xff, CONFIG_INDEX_SLOT_SIZE);
+
+    POINTERS_EQUAL(config_block_find_last_used(area),
+                   config_find_last_block(area, sizeof(area)));
+    parameter_integer_set(&foo, 0);
+    CHECK_TRUE(config_load(&ns, area, sizeof(area)));
+    CHECK_EQUAL(2, parameter_integer_get(&foo));
+}
+
+TEST(ConfigIndexTestGroup, CorruptedSlotIsSkipped)
+{
+    save(1);
+    save(2);
+
+    slot(1)[0] ^= 0x42;
+
+    parameter_integer_set(&foo, 0);
+    CHECK_TRUE(config_load(&ns, area, sizeof(area)));
+    CHECK_EQUAL(2, parameter_integer_get(&foo));
+}
+
+TEST(ConfigIndexTestGroup, CorruptedBlockFallsBackToScan)
+{
+    save(1);
+    save(2);
+
+    // Corrupt the data of the second block, the first one is still valid
+    uint8_t *last = (uint8_t *)config_find_last_block(area, sizeof(area));
+    last[CONFIG_HEADER_SIZE] ^= 0x42;
+
+    parameter_integer_set(&foo, 0);
+    CHECK_TRUE(config_load(&ns, area, sizeof(area)));
+    CHECK_EQUAL(1, parameter_integer_get(&foo));
+}
+
+TEST(ConfigIndexTestGroup, FullIndexStillFindsLastBlock)
+{
+    for (int i = 0; i < 20; i++) {
+        save(i);
+    }
+
+    CHECK_EQUAL(8, config_index_find_free_slot(area, sizeof(area)));
+    parameter_integer_set(&foo, 0);
+    CHECK_TRUE(config_load(&ns, area, sizeof(area)));
+    CHECK_EQUAL(19, parameter_integer_get(&foo));
+}
+
+TEST_GROUP(ConfigIndexManyBlocksTestGroup)
+{
+    static const int block_count = 400;
+
+    parameter_namespace_t ns;
+    parameter_t foo;
+    uint8_t area[64 * 1024];
+
+    void setup()
+    {
+        mock("flash").ignoreOtherCalls();
+        memset(area, 0xff, sizeof(area));
+        parameter_namespace_declare(&ns, NULL, NULL);
+        parameter_integer_declare(&foo, &ns, "foo");
+
+        for (int i = 0; i < block_count; i++) {
+            parameter_integer_set(&foo, i);
+            config_save(area, sizeof(area), &ns);
+        }
+    }
+};
+
+TEST(ConfigIndexManyBlocksTestGroup, IndexedLookupFindsTheLastBlock)
+{
+    POINTERS_EQUAL(config_block_find_last_used(area), config_find_last_block(area, sizeof(area)));
+
+    parameter_integer_set(&foo, 0);
+    CHECK_TRUE(config_load(&ns, area, sizeof(area)));
+    CHECK_EQUAL(block_count - 1, parameter_integer_get(&foo));
+}
+
+/* Only prints the time on the host, ignored unless the tests are run with
+ * -ri. */
+IGNORE_TEST(ConfigIndexManyBlocksTestGroup, LookupBenchmark)
+{
+    const int runs = 100;
+    void *volatile sink;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < runs; i++) {
+        sink = config_find_last_block(area, sizeof(area));
+    }
+    auto middle = std::chrono::steady_clock::now();
+    for (int i = 0; i < runs; i++) {
+        sink = config_block_find_last_used(area);
+    }
+    auto end = std::chrono::steady_clock::now();
+    (void)sink;
+
+    auto indexed_us = std::chrono::duration_cast<std::chrono::microseconds>(middle - start);
+    auto scanned_us = std::chrono::duration_cast<std::chrono::microseconds>(end - middle);
+
+    printf("\nFinding last of %d blocks: indexed %d us, scan %d us\n", block_count,
+           (int)(indexed_us.count() / runs), (int)(scanned_us.count() / runs));
+}
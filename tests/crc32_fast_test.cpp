@@ -0,0 +1,147 @@
+#include <CppUTest/TestHarness.h>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include "crc/crc32.h"
+#include "crc32_fast.h"
+
+#define CRC_INITIAL_VALUE 0xdeadbeef
+
+static uint32_t bit_reverse(uint32_t x)
+{
+    uint32_t r = 0;
+    for (int i = 0; i < 32; i++) {
+        r = (r << 1) | ((x >> i) & 1);
+    }
+    return r;
+}
+
+/* Software model of the STM32F4 CRC peripheral data register write. */
+static uint32_t stm32_crc_write(uint32_t state, uint32_t word)
+{
+    state ^= word;
+    for (int i = 0; i < 32; i++) {
+        state = (state & 0x80000000) ? (state << 1) ^ 0x04c11db7 : state << 1;
+    }
+    return state;
+}
+
+/* Same algorithm as crc32_fast_stm32.c, running on the model. */
+static uint32_t stm32_crc32(uint32_t crc, const uint8_t *data, size_t len)
+{
+    uint32_t state = 0xffffffff;
+    uint32_t word;
+    size_t i;
+
+    if (crc != 0) {
+        state = stm32_crc_write(state, crc32_stm32_seed_word(crc));
+    }
+
+    for (i = 0; i + sizeof(word) <= len; i += sizeof(word)) {
+        memcpy(&word, &data[i], sizeof(word));
+        state = stm32_crc_write(state, bit_reverse(word));
+    }
+
+    return crc32_nibble(~bit_reverse(state), &data[i], len - i);
+}
+
+TEST_GROUP(CRC32FastTestGroup)
+{
+    uint8_t data[1031];
+
+    void setup()
+    {
+        for (size_t i = 0; i < sizeof(data); i++) {
+            data[i] = (uint8_t)(i * 7 + (i >> 3));
+        }
+    }
+};
+
+TEST(CRC32FastTestGroup, KnownValue)
+{
+    CHECK_EQUAL(0xcbf43926, crc32_table(0, "123456789", 9));
+    CHECK_EQUAL(0xcbf43926, crc32_nibble(0, "123456789", 9));
+}
+
+TEST(CRC32FastTestGroup, CompatibleWithReferenceImplementation)
+{
+    for (size_t len = 0; len < 64; len++) {
+        uint32_t expected = crc32(CRC_INITIAL_VALUE, data, len);
+        CHECK_EQUAL(expected, crc32_nibble(CRC_INITIAL_VALUE, data, len));
+        CHECK_EQUAL(expected, crc32_table(CRC_INITIAL_VALUE, data, len));
+        CHECK_EQUAL(expected, crc32_fast(CRC_INITIAL_VALUE, data, len));
+    }
+
+    CHECK_EQUAL(crc32(0, data, sizeof(data)), crc32_fast(0, data, sizeof(data)));
+}
+
+TEST(CRC32FastTestGroup, CanBeComputedInSeveralPasses)
+{
+    uint32_t crc = crc32_table(CRC_INITIAL_VALUE, data, 100);
+    crc = crc32_table(crc, &data[100], sizeof(data) - 100);
+
+    CHECK_EQUAL(crc32(CRC_INITIAL_VALUE, data, sizeof(data)), crc);
+}
+
+TEST(CRC32FastTestGroup, EmptyFlashIsNotValid)
+{
+    /* Same property config_flash_storage relies on. */
+    uint32_t ff = 0xffffffff;
+    CHECK(crc32_fast(CRC_INITIAL_VALUE, &ff, sizeof(ff)) != ff);
+}
+
+TEST(CRC32FastTestGroup, HardwareSeedMatchesInitialValue)
+{
+    uint32_t inits[] = {0, CRC_INITIAL_VALUE, 0xffffffff, 0x12345678};
+
+    for (auto init : inits) {
+        for (size_t len = 0; len < 32; len++) {
+            CHECK_EQUAL(crc32(init, data, len), stm32_crc32(init, data, len));
+        }
+        CHECK_EQUAL(crc32(init, data, sizeof(data)), stm32_crc32(init, data, sizeof(data)));
+    }
+}
+
+/* Only prints the throughput on the host, ignored unless the tests are run
+ * with -ri. */
+TEST_GROUP(CRC32BenchmarkTestGroup)
+{
+    static const size_t max_size = 64 * 1024;
+    uint8_t buffer[max_size];
+
+    void setup()
+    {
+        for (size_t i = 0; i < max_size; i++) {
+            buffer[i] = (uint8_t)(i ^ (i >> 8));
+        }
+    }
+
+    double throughput(uint32_t (*fn)(uint32_t, const void *, size_t), size_t size)
+    {
+        const int runs = 20;
+        volatile uint32_t sink = 0;
+
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < runs; i++) {
+            sink = sink + fn(CRC_INITIAL_VALUE, buffer, size);
+        }
+        auto end = std::chrono::steady_clock::now();
+
+        double seconds = std::chrono::duration<double>(end - start).count();
+        return (double)size * runs / seconds / 1e6;
+    }
+};
+
+IGNORE_TEST(CRC32BenchmarkTestGroup, Throughput)
+{
+    printf("\nCRC32 throughput (MB/s):\n");
+    printf("%8s %10s %10s %10s\n", "size", "reference", "nibble", "table");
+
+    for (size_t size = 1024; size <= max_size; size *= 4) {
+        double reference = throughput(crc32, size);
+        double nibble = throughput(crc32_nibble, size);
+        double table = throughput(crc32_table, size);
+
+        printf("%7dK %10.1f %10.1f %10.1f\n", (int)(size / 1024), reference, nibble, table);
+    }
+}
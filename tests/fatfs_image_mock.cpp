@@ -0,0 +1,189 @@
+#include <CppUTest/TestHarness.h>
+/* f_mkfs() is only enabled in tests/fatfs_with_mkfs.c. */
+#define _USE_MKFS 1
+#include <ff.h>
+#include <diskio.h>
+#include <cstring>
+#include <map>
+#include <vector>
+#include "fatfs_image_mock.h"
+
+static std::vector<uint8_t> image;
+static FATFS image_fs;
+static bool image_fail_writes;
+static size_t image_write_count;
+static size_t image_sectors_written;
+static std::map<uint32_t, size_t> image_write_sizes;
+static size_t image_lock_count;
+
+void fatfs_image_mock_create(uint32_t sector_count)
+{
+    image.assign(sector_count * FATFS_IMAGE_MOCK_SECTOR_SIZE, 0);
+    image_fail_writes = false;
+
+    /* Mount first, f_mkfs() needs the work area of the volume. */
+    f_mount(&image_fs, "", 0);
+    CHECK_EQUAL(FR_OK, f_mkfs("", 1, 4096));
+
+    fatfs_image_mock_reset_stats();
+}
+
+void fatfs_image_mock_destroy(void)
+{
+    f_mount(NULL, "", 0);
+    image.clear();
+    image.shrink_to_fit();
+}
+
+void fatfs_image_mock_fail_writes(bool fail)
+{
+    image_fail_writes = fail;
+}
+
+void fatfs_image_mock_reset_stats(void)
+{
+    image_write_count = 0;
+    image_sectors_written = 0;
+    image_write_sizes.clear();
+    image_lock_count = 0;
+}
+
+size_t fatfs_image_mock_write_count(void)
+{
+    return image_write_count;
+}
+
+size_t fatfs_image_mock_sectors_written(void)
+{
+    return image_sectors_written;
+}
+
+size_t fatfs_image_mock_lock_count(void)
+{
+    return image_lock_count;
+}
+
+uint32_t fatfs_image_mock_typical_write_size(void)
+{
+    uint32_t size = 1;
+    size_t count = 0;
+
+    for (auto &entry : image_write_sizes) {
+        if (entry.first > 1 && entry.second > count) {
+            size = entry.first;
+            count = entry.second;
+        }
+    }
+
+    return size;
+}
+
+extern "C" {
+
+DSTATUS disk_initialize(BYTE pdrv)
+{
+    (void)pdrv;
+    return image.empty() ? STA_NODISK : 0;
+}
+
+DSTATUS disk_status(BYTE pdrv)
+{
+    (void)pdrv;
+    return image.empty() ? STA_NODISK : 0;
+}
+
+DRESULT disk_read(BYTE pdrv, BYTE *buff, DWORD sector, UINT count)
+{
+    (void)pdrv;
+
+    if ((sector + count) * FATFS_IMAGE_MOCK_SECTOR_SIZE > image.size()) {
+        return RES_PARERR;
+    }
+
+    memcpy(buff, &image[sector * FATFS_IMAGE_MOCK_SECTOR_SIZE],
+           count * FATFS_IMAGE_MOCK_SECTOR_SIZE);
+    return RES_OK;
+}
+
+DRESULT disk_write(BYTE pdrv, const BYTE *buff, DWORD sector, UINT count)
+{
+    (void)pdrv;
+
+    if (image_fail_writes) {
+        return RES_NOTRDY;
+    }
+
+    if ((sector + count) * FATFS_IMAGE_MOCK_SECTOR_SIZE > image.size()) {
+        return RES_PARERR;
+    }
+
+    memcpy(&image[sector * FATFS_IMAGE_MOCK_SECTOR_SIZE], buff,
+           count * FATFS_IMAGE_MOCK_SECTOR_SIZE);
+
+    image_write_count++;
+    image_sectors_written += count;
+    image_write_sizes[count]++;
+
+    return RES_OK;
+}
+
+DRESULT disk_ioctl(BYTE pdrv, BYTE cmd, void *buff)
+{
+    (void)pdrv;
+
+    switch (cmd) {
+        case CTRL_SYNC:
+            return RES_OK;
+        case GET_SECTOR_COUNT:
+            *(DWORD *)buff = image.size() / FATFS_IMAGE_MOCK_SECTOR_SIZE;
+            return RES_OK;
+        case GET_SECTOR_SIZE:
+            *(WORD *)buff = FATFS_IMAGE_MOCK_SECTOR_SIZE;
+            return RES_OK;
+        case GET_BLOCK_SIZE:
+            *(DWORD *)buff = 1;
+            return RES_OK;
+    }
+
+    return RES_PARERR;
+}
+
+DWORD get_fattime(void)
+{
+    return 0;
+}
+
+/* The tests are single threaded, the volume lock only has to be balanced. */
+static int image_lock;
+
+int ff_cre_syncobj(BYTE vol, _SYNC_t *sobj)
+{
+    (void)vol;
+    *sobj = &image_lock;
+    image_lock = 0;
+    return 1;
+}
+
+int ff_del_syncobj(_SYNC_t sobj)
+{
+    (void)sobj;
+    return 1;
+}
+
+int ff_req_grant(_SYNC_t sobj)
+{
+    int *lock = (int *)sobj;
+    CHECK_EQUAL(0, *lock);
+    (*lock)++;
+    image_lock_count++;
+    return 1;
+}
+
+void ff_rel_grant(_SYNC_t sobj)
+{
+    int *lock = (int *)sobj;
+    CHECK_EQUAL(1, *lock);
+    (*lock)--;
+}
+
+}
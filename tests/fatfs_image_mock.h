@@ -0,0 +1,36 @@
+#ifndef FATFS_IMAGE_MOCK_H
+#define FATFS_IMAGE_MOCK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** Sector size of the simulated card. */
+#define FATFS_IMAGE_MOCK_SECTOR_SIZE 512
+
+/** Replaces the SD card by a RAM image of the given number of sectors, which
+ * is formatted and mounted as FAT. */
+void fatfs_image_mock_create(uint32_t sector_count);
+
+/** Unmounts and frees the image. */
+void fatfs_image_mock_destroy(void);
+
+/** Makes every following write fail, as if the card was removed. */
+void fatfs_image_mock_fail_writes(bool fail);
+
+/** Resets the write statistics. */
+void fatfs_image_mock_reset_stats(void);
+
+/** Returns the number of disk_write() calls since last reset. */
+size_t fatfs_image_mock_write_count(void);
+
+/** Returns the number of sectors written since last reset. */
+size_t fatfs_image_mock_sectors_written(void);
+
+/** Returns the number of sectors per write which was the most common since
+ * last reset, ignoring single sector writes (FAT and directory updates). */
+uint32_t fatfs_image_mock_typical_write_size(void);
+
+/** Returns the number of times the volume lock was taken since last reset. */
+size_t fatfs_image_mock_lock_count(void);
+
+#endif /* FATFS_IMAGE_MOCK_H */
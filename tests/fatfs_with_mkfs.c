@@ -0,0 +1,4 @@
+/* FatFs as built for the unit tests, which format RAM images with f_mkfs().
+ * The firmware does not need it. */
+#define _USE_MKFS 1
+#include "ff.c"
@@ -0,0 +1,103 @@
+#include <CppUTest/TestHarness.h>
+#include <CppUTestExt/MockSupport.h>
+#include "flash/flash.h"
+#include "flash/flash_job.h"
+
+static void erase_job(void *arg)
+{
+    flash_unlock();
+    flash_sector_erase(arg);
+    flash_lock();
+}
+
+static void done_cb(flash_job_t *job, void *arg)
+{
+    CHECK_TRUE(job->done);
+    mock("flash").actualCall("job_done").withPointerParameter("arg", arg);
+}
+
+TEST_GROUP(FlashJobQueueTestGroup)
+{
+    flash_job_queue_t queue;
+    flash_job_t jobs[3];
+    uint8_t sectors[3][4];
+
+    void setup()
+    {
+        flash_job_queue_init(&queue);
+        for (int i = 0; i < 3; i++) {
+            flash_job_init(&jobs[i], erase_job, sectors[i], done_cb, &jobs[i]);
+        }
+    }
+
+    void run_all()
+    {
+        flash_job_t *job;
+        while ((job = flash_job_queue_pop(&queue)) != NULL) {
+            flash_job_run(job);
+        }
+    }
+};
+
+TEST(FlashJobQueueTestGroup, EmptyQueuePopsNothing)
+{
+    POINTERS_EQUAL(NULL, flash_job_queue_pop(&queue));
+}
+
+TEST(FlashJobQueueTestGroup, JobsArePoppedInSubmissionOrder)
+{
+    flash_job_queue_push(&queue, &jobs[0]);
+    flash_job_queue_push(&queue, &jobs[1]);
+    flash_job_queue_push(&queue, &jobs[2]);
+
+    POINTERS_EQUAL(&jobs[0], flash_job_queue_pop(&queue));
+    POINTERS_EQUAL(&jobs[1], flash_job_queue_pop(&queue));
+    POINTERS_EQUAL(&jobs[2], flash_job_queue_pop(&queue));
+    POINTERS_EQUAL(NULL, flash_job_queue_pop(&queue));
+}
+
+TEST(FlashJobQueueTestGroup, QueueCanBeReusedOnceEmpty)
+{
+    flash_job_queue_push(&queue, &jobs[0]);
+    flash_job_queue_pop(&queue);
+
+    flash_job_queue_push(&queue, &jobs[1]);
+    POINTERS_EQUAL(&jobs[1], flash_job_queue_pop(&queue));
+}
+
+TEST(FlashJobQueueTestGroup, JobIsNotDoneBeforeItRuns)
+{
+    flash_job_queue_push(&queue, &jobs[0]);
+    CHECK_FALSE(jobs[0].done);
+}
+
+TEST(FlashJobQueueTestGroup, RunningJobsDoesFlashOperationsInOrder)
+{
+    mock("flash").strictOrder();
+    for (int i = 0; i < 2; i++) {
+        mock("flash").expectOneCall("unlock");
+        mock("flash").expectOneCall("erase").withParameter("sector", sectors[i]);
+        mock("flash").expectOneCall("lock");
+        mock("flash").expectOneCall("job_done").withPointerParameter("arg", &jobs[i]);
+    }
+
+    flash_job_queue_push(&queue, &jobs[0]);
+    flash_job_queue_push(&queue, &jobs[1]);
+    run_all();
+
+    CHECK_TRUE(jobs[0].done);
+    CHECK_TRUE(jobs[1].done);
+
+    mock("flash").checkExpectations();
+}
+
+TEST(FlashJobQueueTestGroup, CallbackIsOptional)
+{
+    mock("flash").ignoreOtherCalls();
+    flash_job_init(&jobs[0], erase_job, sectors[0], NULL, NULL);
+
+    flash_job_queue_push(&queue, &jobs[0]);
+    run_all();
+
+    CHECK_TRUE(jobs[0].done);
+}
@@ -1,10 +1,158 @@
 #include <CppUTest/TestHarness.h>
 #include <CppUTestExt/MockSupport.h>
 #include "flash/flash.h"
+#include "flash/flash_program.h"
+#include "flash_mock.h"
+#include <cstdint>
 #include <cstring>
 
+/* Simulated flash controller state. Writes and erases are not timed by the
+ * mock expectations but accounted here, which allows benchmarking the number
+ * and width of program operations done by the code under test. */
+static flash_psize_t mock_psize = FLASH_PSIZE_X8;
+static uint64_t program_time_us;
+static uint64_t erase_time_us;
+static uint64_t program_bytes;
+
+/* RAM backed NOR flash simulator, see flash_mock_map(). */
+static uint8_t *sim_base;
+static size_t sim_sector_size;
+static unsigned sim_sector_count;
+static size_t sim_operations;
+static size_t sim_power_budget = SIZE_MAX;
+static bool sim_power_cut;
+
+static bool sim_contains(const void *p)
+{
+    const uint8_t *addr = static_cast<const uint8_t *>(p);
+    return sim_base != NULL && addr >= sim_base
+           && addr < sim_base + sim_sector_size * sim_sector_count;
+}
+
+/* Consumes one operation of the power budget, returns false once it is
+ * exhausted. */
+static bool sim_consume(void)
+{
+    if (sim_power_cut) {
+        return false;
+    }
+
+    if (sim_operations == sim_power_budget) {
+        sim_power_cut = true;
+        return false;
+    }
+
+    sim_operations++;
+    return true;
+}
+
+static void sim_erase(void *p)
+{
+    uint8_t *addr = static_cast<uint8_t *>(p);
+    uint8_t *sector = sim_base + (addr - sim_base) / sim_sector_size * sim_sector_size;
+
+    if (sim_power_cut) {
+        return;
+    }
+
+    /* Power lost in the middle of the erase. */
+    if (sim_operations == sim_power_budget) {
+        memset(sector, 0xff, sim_sector_size / 2);
+        sim_power_cut = true;
+        return;
+    }
+
+    sim_operations++;
+    memset(sector, 0xff, sim_sector_size);
+}
+
+static void sim_write(void *addr, const void *data, size_t len)
+{
+    uint8_t *dst = static_cast<uint8_t *>(addr);
+    const uint8_t *src = static_cast<const uint8_t *>(data);
+
+    for (size_t i = 0; i < len && sim_consume(); i++) {
+        /* Programming can only clear bits. */
+        dst[i] &= src[i];
+    }
+}
+
+void flash_mock_map(void *base, size_t sector_size, unsigned sector_count)
+{
+    sim_base = static_cast<uint8_t *>(base);
+    sim_sector_size = sector_size;
+    sim_sector_count = sector_count;
+    sim_operations = 0;
+    sim_power_budget = SIZE_MAX;
+    sim_power_cut = false;
+}
+
+void flash_mock_unmap(void)
+{
+    flash_mock_map(NULL, 0, 0);
+}
+
+void flash_mock_cut_power_after(size_t operations)
+{
+    sim_operations = 0;
+    sim_power_budget = operations;
+    sim_power_cut = false;
+}
+
+size_t flash_mock_operation_count(void)
+{
+    return sim_operations;
+}
+
+bool flash_mock_power_is_cut(void)
+{
+    return sim_power_cut;
+}
+
+static void account_erase(void)
+{
+    switch (mock_psize) {
+        case FLASH_PSIZE_X8:
+            erase_time_us += FLASH_MOCK_ERASE_128K_X8_MS * 1000;
+            break;
+        case FLASH_PSIZE_X16:
+            erase_time_us += FLASH_MOCK_ERASE_128K_X16_MS * 1000;
+            break;
+        default:
+            erase_time_us += FLASH_MOCK_ERASE_128K_X32_MS * 1000;
+            break;
+    }
+}
+
+void flash_mock_reset_time(void)
+{
+    program_time_us = 0;
+    erase_time_us = 0;
+    program_bytes = 0;
+}
+
+uint64_t flash_mock_program_bytes(void)
+{
+    return program_bytes;
+}
+
+uint64_t flash_mock_program_time_us(void)
+{
+    return program_time_us;
+}
+
+uint64_t flash_mock_erase_time_us(void)
+{
+    return erase_time_us;
+}
+
 extern "C" {
 
+void flash_set_supply_voltage(uint32_t millivolts)
+{
+    mock_psize = flash_psize_for_voltage(millivolts);
+}
+
 void flash_lock(void)
 {
     mock("flash").actualCall("lock");
@@ -18,6 +166,12 @@ void flash_unlock(void)
 void flash_sector_erase(void *p)
 {
     mock("flash").actualCall("erase").withParameter("sector", p);
+    account_erase();
+
+    if (sim_contains(p)) {
+        sim_erase(p);
+        return;
+    }
 
     /* At least invalid any checksum in that block. */
     memset(p, 0, 1);
@@ -25,8 +179,19 @@ void flash_sector_erase(void *p)
 
 void flash_write(void *addr, const void *data, size_t len)
 {
-    memcpy(addr, data, len);
+    flash_program_split_t split;
+
+    if (sim_contains(addr)) {
+        sim_write(addr, data, len);
+    } else {
+        memcpy(addr, data, len);
+    }
     mock("flash").actualCall("write");
+
+    program_bytes += len;
+    flash_program_split((uintptr_t)addr, len, mock_psize, &split);
+    program_time_us += flash_program_operations(&split, mock_psize)
+                       * FLASH_MOCK_PROGRAM_TIME_US;
 }
 
 uint8_t flash_addr_to_sector(void *addr)
@@ -38,6 +203,7 @@ uint8_t flash_addr_to_sector(void *addr)
 void flash_sector_erase_number(uint8_t number)
 {
     mock("flash").actualCall("erase").withParameter("sector_number", number);
+    account_erase();
 }
 
 }
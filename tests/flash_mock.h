@@ -0,0 +1,51 @@
+#ifndef FLASH_MOCK_H
+#define FLASH_MOCK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Timings of the STM32F407 datasheet (table 41), typical values. */
+#define FLASH_MOCK_PROGRAM_TIME_US 16
+#define FLASH_MOCK_ERASE_128K_X8_MS 2000
+#define FLASH_MOCK_ERASE_128K_X16_MS 1300
+#define FLASH_MOCK_ERASE_128K_X32_MS 1000
+
+/** Resets the simulated time spent programming and erasing flash, and the
+ * number of bytes programmed. */
+void flash_mock_reset_time(void);
+
+/** Returns the number of bytes programmed since last reset. */
+uint64_t flash_mock_program_bytes(void);
+
+/** Returns the simulated time spent programming flash since last reset. */
+uint64_t flash_mock_program_time_us(void);
+
+/** Returns the simulated time spent erasing flash since last reset. */
+uint64_t flash_mock_erase_time_us(void);
+
+/** Makes the given RAM buffer behave like NOR flash sectors.
+ *
+ * Erases inside the buffer set the whole sector to 0xff, and writes can only
+ * clear bits. Outside of it, the mock keeps its simpler behavior.
+ */
+void flash_mock_map(void *base, size_t sector_size, unsigned sector_count);
+
+/** Restores the default mock behavior and power. */
+void flash_mock_unmap(void);
+
+/** Simulates a power loss after the given number of operations, where each
+ * programmed byte and each erase count as one.
+ *
+ * The operation hitting the limit is only partially done: an erase only
+ * clears the first half of the sector. Everything after it is ignored.
+ * Passing SIZE_MAX restores power.
+ */
+void flash_mock_cut_power_after(size_t operations);
+
+/** Returns the number of operations since the map or the last power cut. */
+size_t flash_mock_operation_count(void);
+
+/** Returns true if a simulated power loss happened. */
+bool flash_mock_power_is_cut(void);
+
+#endif /* FLASH_MOCK_H */
@@ -0,0 +1,114 @@
+#include <CppUTest/TestHarness.h>
+#include <CppUTestExt/MockSupport.h>
+#include <cstdio>
+#include <cstring>
+#include "flash/flash.h"
+#include "flash/flash_program.h"
+#include "config_flash_storage.h"
+#include "flash_mock.h"
+
+TEST_GROUP(FlashProgramTestGroup)
+{
+    flash_program_split_t split;
+};
+
+TEST(FlashProgramTestGroup, PsizeDependsOnVoltage)
+{
+    CHECK_EQUAL(FLASH_PSIZE_X8, flash_psize_for_voltage(1800));
+    CHECK_EQUAL(FLASH_PSIZE_X16, flash_psize_for_voltage(2400));
+    CHECK_EQUAL(FLASH_PSIZE_X32, flash_psize_for_voltage(3300));
+}
+
+TEST(FlashProgramTestGroup, AlignedWriteIsAllBody)
+{
+    flash_program_split(0x1000, 64, FLASH_PSIZE_X32, &split);
+
+    CHECK_EQUAL(0, split.head);
+    CHECK_EQUAL(64, split.body);
+    CHECK_EQUAL(0, split.tail);
+    CHECK_EQUAL(16, flash_program_operations(&split, FLASH_PSIZE_X32));
+}
+
+TEST(FlashProgramTestGroup, UnalignedWriteHasHeadAndTail)
+{
+    flash_program_split(0x1001, 10, FLASH_PSIZE_X32, &split);
+
+    CHECK_EQUAL(3, split.head);
+    CHECK_EQUAL(4, split.body);
+    CHECK_EQUAL(3, split.tail);
+    CHECK_EQUAL(7, flash_program_operations(&split, FLASH_PSIZE_X32));
+}
+
+TEST(FlashProgramTestGroup, ShortWriteIsAllHead)
+{
+    flash_program_split(0x1001, 2, FLASH_PSIZE_X32, &split);
+
+    CHECK_EQUAL(2, split.head);
+    CHECK_EQUAL(0, split.body);
+    CHECK_EQUAL(0, split.tail);
+}
+
+TEST(FlashProgramTestGroup, ByteParallelismIsOneOperationPerByte)
+{
+    flash_program_split(0x1003, 17, FLASH_PSIZE_X8, &split);
+
+    CHECK_EQUAL(0, split.head);
+    CHECK_EQUAL(17, split.body);
+    CHECK_EQUAL(17, flash_program_operations(&split, FLASH_PSIZE_X8));
+}
+
+TEST_GROUP(FlashProgramBenchmarkTestGroup)
+{
+    static const int param_count = 64;
+
+    uint8_t data[4096];
+    parameter_namespace_t ns;
+    parameter_t params[param_count];
+    char names[param_count][16];
+
+    void setup()
+    {
+        mock("flash").ignoreOtherCalls();
+        memset(data, 0xff, sizeof(data));
+        parameter_namespace_declare(&ns, NULL, NULL);
+
+        for (int i = 0; i < param_count; i++) {
+            snprintf(names[i], sizeof(names[i]), "param%d", i);
+            parameter_scalar_declare(&params[i], &ns, names[i]);
+            parameter_scalar_set(&params[i], i * 0.5f);
+        }
+    }
+
+    void teardown()
+    {
+        flash_set_supply_voltage(0);
+    }
+
+    uint64_t save_time_us(uint32_t millivolts)
+    {
+        flash_set_supply_voltage(millivolts);
+        flash_mock_reset_time();
+        config_save(data, sizeof(data), &ns);
+
+        return flash_mock_program_time_us();
+    }
+};
+
+TEST(FlashProgramBenchmarkTestGroup, WordProgrammingMakesConfigSaveFaster)
+{
+    uint64_t x8 = save_time_us(1800);
+    uint64_t x32 = save_time_us(3300);
+
+    /* Only the block headers and the buffer edges are byte programmed. */
+    CHECK_TRUE(x32 * 3 < x8);
+}
+
+/* Prints the simulated programming times, ignored unless the tests are run
+ * with -ri. */
+IGNORE_TEST(FlashProgramBenchmarkTestGroup, ConfigSaveTime)
+{
+    uint64_t x8 = save_time_us(1800);
+    uint64_t x32 = save_time_us(3300);
+
+    printf("\nconfig_save programming time: x8 %d us, x32 %d us\n", (int)x8, (int)x32);
+}
@@ -0,0 +1,119 @@
+#include <CppUTest/TestHarness.h>
+#include "led_animation.h"
+
+/* Frame period used by the body LED thread. */
+#define FRAME_PERIOD_MS 10
+
+TEST_GROUP(LedAnimationTestGroup)
+{
+    led_animation_t anim;
+    uint8_t levels[BODY_LED_COUNT];
+};
+
+TEST(LedAnimationTestGroup, UnknownBuiltinIsNull)
+{
+    POINTERS_EQUAL(NULL, led_animation_builtin(LED_ANIMATION_NONE));
+    POINTERS_EQUAL(NULL, led_animation_builtin(LED_ANIMATION_BUILTIN_COUNT));
+}
+
+TEST(LedAnimationTestGroup, CanFindBuiltinByName)
+{
+    CHECK_EQUAL(LED_ANIMATION_NONE, led_animation_find("stop"));
+    CHECK_EQUAL(LED_ANIMATION_CHASE, led_animation_find("chase"));
+    CHECK_EQUAL(-1, led_animation_find("disco"));
+}
+
+TEST(LedAnimationTestGroup, TableFollowsKeyframes)
+{
+    led_animation_init(&anim, led_animation_builtin(LED_ANIMATION_BREATHING));
+
+    CHECK_EQUAL(0, anim.table[0]);
+    CHECK_EQUAL(LED_ANIMATION_LEVEL_MAX, anim.table[LED_ANIMATION_TABLE_SIZE / 2]);
+
+    /* Linear interpolation between the two keyframes. */
+    CHECK_EQUAL(LED_ANIMATION_LEVEL_MAX / 2, anim.table[LED_ANIMATION_TABLE_SIZE / 4]);
+}
+
+TEST(LedAnimationTestGroup, BreathingPeaksAtHalfPeriod)
+{
+    led_animation_init(&anim, led_animation_builtin(LED_ANIMATION_BREATHING));
+
+    led_animation_render(&anim, 0, levels);
+    CHECK_EQUAL(0, levels[0]);
+
+    led_animation_render(&anim, 1000, levels);
+    for (int i = 0; i < BODY_LED_COUNT; i++) {
+        CHECK_EQUAL(LED_ANIMATION_LEVEL_MAX, levels[i]);
+    }
+}
+
+TEST(LedAnimationTestGroup, RenderingIsPeriodic)
+{
+    uint8_t next_period[BODY_LED_COUNT];
+
+    led_animation_init(&anim, led_animation_builtin(LED_ANIMATION_CHASE));
+
+    for (uint32_t t = 0; t < 1200; t += 37) {
+        led_animation_render(&anim, t, levels);
+        led_animation_render(&anim, t + 3 * 1200, next_period);
+        MEMCMP_EQUAL(levels, next_period, sizeof(levels));
+    }
+}
+
+TEST(LedAnimationTestGroup, ChaseLedsPeakInSequence)
+{
+    led_animation_init(&anim, led_animation_builtin(LED_ANIMATION_CHASE));
+
+    for (int led = 0; led < BODY_LED_COUNT; led++) {
+        led_animation_render(&anim, led * 100, levels);
+        CHECK_EQUAL(LED_ANIMATION_LEVEL_MAX, levels[led]);
+
+        /* The LED before is already fading out. */
+        int previous = (led + BODY_LED_COUNT - 1) % BODY_LED_COUNT;
+        CHECK_TRUE(levels[previous] < LED_ANIMATION_LEVEL_MAX);
+    }
+}
+
+TEST(LedAnimationTestGroup, FramesHitPeakAtExpectedTime)
+{
+    /* Render frames the way the LED thread does and check at which frame the
+     * breathing animation reaches its peak. */
+    int peak_frame = -1;
+
+    led_animation_init(&anim, led_animation_builtin(LED_ANIMATION_BREATHING));
+
+    for (int frame = 0; frame < 2000 / FRAME_PERIOD_MS; frame++) {
+        led_animation_render(&anim, frame * FRAME_PERIOD_MS, levels);
+        if (levels[0] == LED_ANIMATION_LEVEL_MAX && peak_frame < 0) {
+            peak_frame = frame;
+        }
+    }
+
+    CHECK_EQUAL(1000 / FRAME_PERIOD_MS, peak_frame);
+}
+
+TEST(LedAnimationTestGroup, BlinkIsOnForHalfThePeriod)
+{
+    int frames_on = 0;
+
+    led_animation_init(&anim, led_animation_builtin(LED_ANIMATION_BLINK));
+
+    for (int frame = 0; frame < 500 / FRAME_PERIOD_MS; frame++) {
+        led_animation_render(&anim, frame * FRAME_PERIOD_MS, levels);
+        if (levels[0] > LED_ANIMATION_LEVEL_MAX / 2) {
+            frames_on++;
+        }
+    }
+
+    CHECK_EQUAL(25, frames_on);
+}
+
+TEST(LedAnimationTestGroup, EmptyAnimationRendersDark)
+{
+    led_animation_init(&anim, NULL);
+    led_animation_render(&anim, 1234, levels);
+
+    for (int i = 0; i < BODY_LED_COUNT; i++) {
+        CHECK_EQUAL(0, levels[i]);
+    }
+}
@@ -0,0 +1,90 @@
+#include <CppUTest/TestHarness.h>
+#include "sensors/mpu60X0_config.h"
+
+TEST_GROUP(MPU60X0ConfigTestGroup)
+{
+    mpu60X0_settings_t settings;
+
+    void setup(void)
+    {
+        settings.acc_range_g = 2;
+        settings.gyro_range_dps = 250;
+        settings.sample_rate_hz = 1000;
+        settings.low_pass_filter = 6;
+        settings.fifo_enable = 0;
+    }
+};
+
+TEST(MPU60X0ConfigTestGroup, DefaultSettings)
+{
+    uint32_t expected = MPU60X0_ACC_FULL_RANGE_2G
+                        | MPU60X0_GYRO_FULL_RANGE_250DPS
+                        | MPU60X0_SAMPLE_RATE_DIV(0)
+                        | MPU60X0_LOW_PASS_FILTER_6;
+
+    CHECK_EQUAL(expected, mpu60X0_config_make(&settings));
+}
+
+TEST(MPU60X0ConfigTestGroup, RangesAreRoundedUp)
+{
+    settings.acc_range_g = 5;
+    settings.gyro_range_dps = 2000;
+
+    uint32_t config = mpu60X0_config_make(&settings);
+
+    CHECK_EQUAL(MPU60X0_ACC_FULL_RANGE_8G, config & 0x3);
+    CHECK_EQUAL(MPU60X0_GYRO_FULL_RANGE_2000DPS, config & 0xc);
+}
+
+TEST(MPU60X0ConfigTestGroup, RangesAreClamped)
+{
+    settings.acc_range_g = 100;
+    settings.gyro_range_dps = 0;
+
+    uint32_t config = mpu60X0_config_make(&settings);
+
+    CHECK_EQUAL(MPU60X0_ACC_FULL_RANGE_16G, config & 0x3);
+    CHECK_EQUAL(MPU60X0_GYRO_FULL_RANGE_250DPS, config & 0xc);
+}
+
+TEST(MPU60X0ConfigTestGroup, SampleRateSetsDivider)
+{
+    settings.sample_rate_hz = 100;
+    CHECK_EQUAL(MPU60X0_SAMPLE_RATE_DIV(9), mpu60X0_config_make(&settings) & 0xff00);
+    CHECK_EQUAL(10000, mpu60X0_config_sample_period_us(mpu60X0_config_make(&settings)));
+}
+
+TEST(MPU60X0ConfigTestGroup, UnfilteredGyroRunsAt8kHz)
+{
+    settings.low_pass_filter = 0;
+    settings.sample_rate_hz = 2000;
+
+    uint32_t config = mpu60X0_config_make(&settings);
+
+    CHECK_EQUAL(MPU60X0_SAMPLE_RATE_DIV(3), config & 0xff00);
+    CHECK_EQUAL(500, mpu60X0_config_sample_period_us(config));
+}
+
+TEST(MPU60X0ConfigTestGroup, SampleRateIsClamped)
+{
+    settings.sample_rate_hz = 0;
+    CHECK_EQUAL(MPU60X0_SAMPLE_RATE_DIV(255), mpu60X0_config_make(&settings) & 0xff00);
+
+    settings.sample_rate_hz = 100000;
+    CHECK_EQUAL(MPU60X0_SAMPLE_RATE_DIV(0), mpu60X0_config_make(&settings) & 0xff00);
+}
+
+TEST(MPU60X0ConfigTestGroup, CanEnableFifo)
+{
+    settings.fifo_enable = 1;
+    CHECK_TRUE(mpu60X0_config_make(&settings) & MPU60X0_FIFO_ENABLE);
+}
+
+TEST(MPU60X0ConfigTestGroup, ScaleFactors)
+{
+    DOUBLES_EQUAL(9.80665 / 16384, mpu60X0_config_acc_scale(MPU60X0_ACC_FULL_RANGE_2G), 1e-9);
+    DOUBLES_EQUAL(9.80665 / 2048, mpu60X0_config_acc_scale(MPU60X0_ACC_FULL_RANGE_16G), 1e-9);
+    DOUBLES_EQUAL(3.14159265 / 180 / 131, mpu60X0_config_gyro_scale(MPU60X0_GYRO_FULL_RANGE_250DPS), 1e-9);
+    DOUBLES_EQUAL(3.14159265 / 180 / 16.4,
+                  mpu60X0_config_gyro_scale(MPU60X0_GYRO_FULL_RANGE_2000DPS), 1e-9);
+}
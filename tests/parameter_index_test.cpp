@@ -0,0 +1,347 @@
+#include <CppUTest/TestHarness.h>
+#include "parameter_index.h"
+#include "parameter/parameter_msgpack.h"
+#include "cmp_mem_access/cmp_mem_access.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+TEST_GROUP(ParameterIndexTestGroup)
+{
+    parameter_namespace_t root, left, right, control;
+    parameter_t left_kp, right_kp, control_kp, id, enabled;
+    parameter_index_t index;
+    parameter_index_entry_t entries[16];
+
+    void setup()
+    {
+        parameter_namespace_declare(&root, NULL, NULL);
+        parameter_namespace_declare(&left, &root, "left");
+        parameter_namespace_declare(&right, &root, "right");
+        parameter_namespace_declare(&control, &left, "control");
+        parameter_scalar_declare_with_default(&left_kp, &left, "kp", 1.f);
+        parameter_scalar_declare_with_default(&right_kp, &right, "kp", 2.f);
+        parameter_scalar_declare_with_default(&control_kp, &control, "kp", 3.f);
+        parameter_integer_declare_with_default(&id, &root, "id", 1);
+        parameter_boolean_declare_with_default(&enabled, &root, "enabled", true);
+
+        parameter_index_init(&index, &root, entries, 16);
+    }
+
+    /* Reads buf, as written by the given writer, into the indexed tree. */
+    int read(void (*fill)(cmp_ctx_t *cmp))
+    {
+        uint8_t buf[128];
+        cmp_ctx_t cmp;
+        cmp_mem_access_t mem;
+
+        cmp_mem_access_init(&cmp, &mem, buf, sizeof(buf));
+        fill(&cmp);
+        return parameter_index_msgpack_read(&index, (char *)buf, cmp_mem_access_get_pos(&mem));
+    }
+};
+
+TEST(ParameterIndexTestGroup, FindsParameters)
+{
+    CHECK_TRUE(parameter_index_build(&index));
+
+    POINTERS_EQUAL(&left_kp, parameter_index_find(&index, "/left/kp"));
+    POINTERS_EQUAL(&right_kp, parameter_index_find(&index, "/right/kp"));
+    POINTERS_EQUAL(&control_kp, parameter_index_find(&index, "/left/control/kp"));
+    POINTERS_EQUAL(&id, parameter_index_find(&index, "/id"));
+}
+
+TEST(ParameterIndexTestGroup, LeadingSlashIsOptional)
+{
+    parameter_index_build(&index);
+
+    POINTERS_EQUAL(&left_kp, parameter_index_find(&index, "left/kp"));
+    POINTERS_EQUAL(&enabled, parameter_index_find(&index, "enabled"));
+}
+
+TEST(ParameterIndexTestGroup, UnknownPathIsNotFound)
+{
+    parameter_index_build(&index);
+
+    POINTERS_EQUAL(NULL, parameter_index_find(&index, "/left/ki"));
+    POINTERS_EQUAL(NULL, parameter_index_find(&index, "/left"));
+    POINTERS_EQUAL(NULL, parameter_index_find(&index, "/control/kp"));
+}
+
+TEST(ParameterIndexTestGroup, HashIsOfTheWholePath)
+{
+    CHECK_EQUAL(parameter_index_hash("/left/kp"), parameter_index_hash("left/kp"));
+    CHECK_TRUE(parameter_index_hash("/left/kp") != parameter_index_hash("/right/kp"));
+    CHECK_TRUE(parameter_index_hash("/left/kp") != parameter_index_hash("/leftkp"));
+}
+
+TEST(ParameterIndexTestGroup, EntryWithSameHashIsChecked)
+{
+    parameter_index_build(&index);
+
+    /* Make the entry of /right/kp look like the one of /left/kp. */
+    for (size_t i = 0; i < index.count; i++) {
+        if (entries[i].param == &right_kp) {
+            entries[i].hash = parameter_index_hash("/left/kp");
+        }
+    }
+
+    POINTERS_EQUAL(&left_kp, parameter_index_find(&index, "/left/kp"));
+}
+
+TEST(ParameterIndexTestGroup, WorksBeforeBeingBuilt)
+{
+    POINTERS_EQUAL(&control_kp, parameter_index_find(&index, "/left/control/kp"));
+}
+
+TEST(ParameterIndexTestGroup, ParametersDeclaredLaterAreFound)
+{
+    parameter_t ki;
+
+    parameter_index_build(&index);
+    parameter_scalar_declare_with_default(&ki, &right, "ki", 0.f);
+
+    POINTERS_EQUAL(&ki, parameter_index_find(&index, "/right/ki"));
+}
+
+TEST(ParameterIndexTestGroup, TooManyParametersFallsBackToTree)
+{
+    parameter_index_init(&index, &root, entries, 3);
+
+    CHECK_FALSE(parameter_index_build(&index));
+    CHECK_EQUAL(0, index.count);
+    POINTERS_EQUAL(&control_kp, parameter_index_find(&index, "/left/control/kp"));
+}
+
+static void write_nested(cmp_ctx_t *cmp)
+{
+    cmp_write_map(cmp, 2);
+    cmp_write_str(cmp, "left", 4);
+    cmp_write_map(cmp, 2);
+    cmp_write_str(cmp, "kp", 2);
+    cmp_write_float(cmp, 10.f);
+    cmp_write_str(cmp, "control", 7);
+    cmp_write_map(cmp, 1);
+    cmp_write_str(cmp, "kp", 2);
+    cmp_write_float(cmp, 30.f);
+    cmp_write_str(cmp, "id", 2);
+    cmp_write_sint(cmp, -42);
+}
+
+TEST(ParameterIndexTestGroup, LoadsNestedMaps)
+{
+    parameter_index_build(&index);
+
+    CHECK_EQUAL(0, read(write_nested));
+
+    DOUBLES_EQUAL(10., parameter_scalar_get(&left_kp), 1e-6);
+    DOUBLES_EQUAL(30., parameter_scalar_get(&control_kp), 1e-6);
+    DOUBLES_EQUAL(2., parameter_scalar_get(&right_kp), 1e-6);
+    CHECK_EQUAL(-42, parameter_integer_get(&id));
+}
+
+static void write_unknown(cmp_ctx_t *cmp)
+{
+    cmp_write_map(cmp, 4);
+    cmp_write_str(cmp, "removed", 7);
+    cmp_write_map(cmp, 1);
+    cmp_write_str(cmp, "kp", 2);
+    cmp_write_float(cmp, 5.f);
+    cmp_write_str(cmp, "old", 3);
+    cmp_write_array(cmp, 2);
+    cmp_write_str(cmp, "a", 1);
+    cmp_write_sint(cmp, 1000);
+    cmp_write_str(cmp, "enabled", 7);
+    cmp_write_sint(cmp, 0);
+    cmp_write_str(cmp, "id", 2);
+    cmp_write_sint(cmp, 7);
+}
+
+TEST(ParameterIndexTestGroup, SkipsUnknownKeysAndWrongTypes)
+{
+    parameter_index_build(&index);
+
+    CHECK_EQUAL(0, read(write_unknown));
+
+    /* An integer is not a boolean. */
+    CHECK_TRUE(parameter_boolean_get(&enabled));
+    CHECK_EQUAL(7, parameter_integer_get(&id));
+}
+
+static void write_conversions(cmp_ctx_t *cmp)
+{
+    cmp_write_map(cmp, 2);
+    cmp_write_str(cmp, "right", 5);
+    cmp_write_map(cmp, 1);
+    cmp_write_str(cmp, "kp", 2);
+    cmp_write_sint(cmp, 300);
+    cmp_write_str(cmp, "enabled", 7);
+    cmp_write_bool(cmp, false);
+}
+
+TEST(ParameterIndexTestGroup, IntegersAreConvertedToScalars)
+{
+    parameter_index_build(&index);
+
+    CHECK_EQUAL(0, read(write_conversions));
+
+    DOUBLES_EQUAL(300., parameter_scalar_get(&right_kp), 1e-6);
+    CHECK_FALSE(parameter_boolean_get(&enabled));
+}
+
+static void write_truncated(cmp_ctx_t *cmp)
+{
+    cmp_write_map(cmp, 2);
+    cmp_write_str(cmp, "id", 2);
+    cmp_write_sint(cmp, 3);
+}
+
+TEST(ParameterIndexTestGroup, TruncatedBufferIsAnError)
+{
+    parameter_index_build(&index);
+
+    CHECK_EQUAL(-1, read(write_truncated));
+}
+
+/* Tree similar to the one of the robot: the sensor and motor settings of each
+ * side, the Aseba settings and a PID per control loop for each wheel.
+ *
+ * The benchmarks only print their timings, they are ignored unless the tests
+ * are run with -ri. */
+#define SIDES 2
+#define SENSORS 3
+#define SENSOR_SETTINGS 2
+#define WHEELS 2
+#define LOOPS 3
+#define GAINS 4
+#define ASEBA_SETTINGS 32
+#define REPEAT 2000
+
+TEST_GROUP(ParameterIndexBenchmarkTestGroup)
+{
+    parameter_namespace_t root, aseba, sensors[SENSORS], sides[SENSORS][SIDES];
+    parameter_namespace_t wheels[WHEELS], control[WHEELS], limits[WHEELS], loops[WHEELS][LOOPS];
+    parameter_t settings[ASEBA_SETTINGS], sensor_settings[SENSORS][SIDES][SENSOR_SETTINGS];
+    parameter_t limit_values[WHEELS][3], gains[WHEELS][LOOPS][GAINS];
+    char settings_names[ASEBA_SETTINGS][4];
+    char paths[WHEELS * LOOPS * GAINS][PARAMETER_INDEX_PATH_MAX];
+    parameter_index_t index;
+    parameter_index_entry_t entries[128];
+
+    void setup()
+    {
+        static const char *wheel_names[WHEELS] = {"left_wheel", "right_wheel"};
+        static const char *loop_names[LOOPS] = {"current", "velocity", "position"};
+        static const char *gain_names[GAINS] = {"kp", "ki", "kd", "i_limit"};
+        static const char *sensor_names[SENSORS] = {"current_sense", "encoders", "motors"};
+        static const char *side_names[SIDES] = {"left", "right"};
+        static const char *sensor_setting_names[SENSOR_SETTINGS] = {"gain", "offset"};
+        static const char *limit_names[3] = {"current", "velocity", "acceleration"};
+        int n = 0;
+
+        parameter_namespace_declare(&root, NULL, NULL);
+
+        for (int s = 0; s < SENSORS; s++) {
+            parameter_namespace_declare(&sensors[s], &root, sensor_names[s]);
+            for (int i = 0; i < SIDES; i++) {
+                parameter_namespace_declare(&sides[s][i], &sensors[s], side_names[i]);
+                for (int j = 0; j < SENSOR_SETTINGS; j++) {
+                    parameter_scalar_declare_with_default(&sensor_settings[s][i][j], &sides[s][i],
+                                                          sensor_setting_names[j], 0.f);
+                }
+            }
+        }
+
+        for (int w = 0; w < WHEELS; w++) {
+            parameter_namespace_declare(&wheels[w], &root, wheel_names[w]);
+            parameter_namespace_declare(&control[w], &wheels[w], "control");
+            parameter_namespace_declare(&limits[w], &control[w], "limits");
+            for (int i = 0; i < 3; i++) {
+                parameter_scalar_declare_with_default(&limit_values[w][i], &limits[w],
+                                                      limit_names[i], 1.f);
+            }
+            for (int l = 0; l < LOOPS; l++) {
+                parameter_namespace_declare(&loops[w][l], &control[w], loop_names[l]);
+                for (int g = 0; g < GAINS; g++) {
+                    parameter_scalar_declare_with_default(&gains[w][l][g], &loops[w][l],
+                                                          gain_names[g], 1.f);
+                    snprintf(paths[n++], PARAMETER_INDEX_PATH_MAX, "/%s/control/%s/%s",
+                             wheel_names[w], loop_names[l], gain_names[g]);
+                }
+            }
+        }
+
+        /* Declared last in main.c. */
+        parameter_namespace_declare(&aseba, &root, "aseba");
+        for (int i = 0; i < ASEBA_SETTINGS; i++) {
+            snprintf(settings_names[i], sizeof(settings_names[i]), "%d", i);
+            parameter_integer_declare_with_default(&settings[i], &aseba, settings_names[i], 0);
+        }
+
+        parameter_index_init(&index, &root, entries, 128);
+        CHECK_TRUE(parameter_index_build(&index));
+    }
+
+    double elapsed_us(std::chrono::steady_clock::time_point start)
+    {
+        std::chrono::duration<double, std::micro> d = std::chrono::steady_clock::now() - start;
+        return d.count();
+    }
+};
+
+IGNORE_TEST(ParameterIndexBenchmarkTestGroup, ControllerLookups)
+{
+    std::chrono::steady_clock::time_point start;
+    double walk, indexed;
+    uintptr_t sink = 0;
+
+    start = std::chrono::steady_clock::now();
+    for (int r = 0; r < REPEAT; r++) {
+        for (auto &path : paths) {
+            sink += (uintptr_t)parameter_find(&root, path);
+        }
+    }
+    walk = elapsed_us(start);
+
+    start = std::chrono::steady_clock::now();
+    for (int r = 0; r < REPEAT; r++) {
+        for (auto &path : paths) {
+            sink -= (uintptr_t)parameter_index_find(&index, path);
+        }
+    }
+    indexed = elapsed_us(start);
+
+    printf("\n%d controller lookups: parameter_find %.0f us, index %.0f us\n",
+           REPEAT * WHEELS * LOOPS * GAINS, walk, indexed);
+
+    CHECK_EQUAL(0, sink);
+}
+
+IGNORE_TEST(ParameterIndexBenchmarkTestGroup, ConfigLoad)
+{
+    static uint8_t buf[2048];
+    std::chrono::steady_clock::time_point start;
+    double walk, indexed;
+    cmp_ctx_t cmp;
+    cmp_mem_access_t mem;
+    size_t len;
+
+    cmp_mem_access_init(&cmp, &mem, buf, sizeof(buf));
+    parameter_msgpack_write_cmp(&root, &cmp, NULL, NULL);
+    len = cmp_mem_access_get_pos(&mem);
+
+    start = std::chrono::steady_clock::now();
+    for (int r = 0; r < REPEAT; r++) {
+        CHECK_EQUAL(0, parameter_msgpack_read(&root, (char *)buf, len, NULL, NULL));
+    }
+    walk = elapsed_us(start);
+
+    start = std::chrono::steady_clock::now();
+    for (int r = 0; r < REPEAT; r++) {
+        CHECK_EQUAL(0, parameter_index_msgpack_read(&index, (char *)buf, len));
+    }
+    indexed = elapsed_us(start);
+
+    printf("\n%d loads of a %d bytes config: parameter_msgpack_read %.0f us, index %.0f us\n",
+           REPEAT, (int)len, walk, indexed);
+}
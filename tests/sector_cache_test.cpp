@@ -0,0 +1,311 @@
+#include <CppUTest/TestHarness.h>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "sector_cache.h"
+
+/* Typical SD card timings on a 4 bit 24MHz SDIO bus. */
+#define COMMAND_LATENCY_US 300
+#define SECTOR_TRANSFER_US 43
+
+#define DEVICE_SECTORS 1024
+
+/* Block device backed by a temporary file, accounting for the time a card
+ * would take. */
+struct file_device {
+    FILE *file;
+    uint64_t time_us;
+    unsigned commands;
+    bool fail;
+};
+
+static bool file_device_read(void *arg, uint32_t sector, uint8_t *buf, uint32_t count)
+{
+    file_device *dev = static_cast<file_device *>(arg);
+
+    if (dev->fail || sector + count > DEVICE_SECTORS) {
+        return false;
+    }
+
+    fseek(dev->file, sector * SECTOR_CACHE_SECTOR_SIZE, SEEK_SET);
+    if (fread(buf, SECTOR_CACHE_SECTOR_SIZE, count, dev->file) != count) {
+        return false;
+    }
+
+    dev->commands++;
+    dev->time_us += COMMAND_LATENCY_US + count * SECTOR_TRANSFER_US;
+
+    return true;
+}
+
+/* Reads like sdcRead() without the cache: buffers which are not word aligned
+ * cannot be used for DMA and are read one sector at a time. */
+static bool uncached_read(file_device *dev, uint8_t *buf, uint32_t sector, uint32_t count)
+{
+    if (((uintptr_t)buf & 3) == 0) {
+        return file_device_read(dev, sector, buf, count);
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (!file_device_read(dev, sector + i, buf + i * SECTOR_CACHE_SECTOR_SIZE, 1)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+TEST_GROUP(SectorCacheTestGroup)
+{
+    static const size_t line_count = 2;
+    static const uint32_t window = 8;
+    static const size_t wav_size = DEVICE_SECTORS * SECTOR_CACHE_SECTOR_SIZE;
+    static const size_t wav_chunk = 2000;
+
+    file_device dev;
+    sector_cache_t cache;
+    sector_cache_line_t lines[line_count];
+    uint32_t buffer[line_count * window * SECTOR_CACHE_SECTOR_SIZE / 4];
+    uint8_t content[DEVICE_SECTORS * SECTOR_CACHE_SECTOR_SIZE];
+    uint32_t out[16 * SECTOR_CACHE_SECTOR_SIZE / 4 + 1];
+
+    void setup()
+    {
+        for (size_t i = 0; i < sizeof(content); i++) {
+            content[i] = rand();
+        }
+
+        dev.file = tmpfile();
+        CHECK(dev.file != NULL);
+        fwrite(content, 1, sizeof(content), dev.file);
+        dev.time_us = 0;
+        dev.commands = 0;
+        dev.fail = false;
+
+        sector_cache_init(&cache, lines, line_count, buffer, window, file_device_read, &dev);
+        sector_cache_set_sector_count(&cache, DEVICE_SECTORS);
+    }
+
+    void teardown()
+    {
+        fclose(dev.file);
+    }
+
+    void check_read(uint8_t *buf, uint32_t sector, uint32_t count)
+    {
+        CHECK_TRUE(sector_cache_read(&cache, buf, sector, count));
+        MEMCMP_EQUAL(&content[sector * SECTOR_CACHE_SECTOR_SIZE], buf,
+                     count * SECTOR_CACHE_SECTOR_SIZE);
+    }
+
+    /* Reads a file of the given size like FatFs does when f_read() is called
+     * with chunk bytes at a time: partial sectors go through the sector
+     * buffer of the file, whole ones straight to the destination, which is
+     * then usually not word aligned. */
+    template <typename Read>
+    void stream_file(size_t size, size_t chunk, Read read)
+    {
+        static uint32_t fil_buffer[SECTOR_CACHE_SECTOR_SIZE / 4];
+        static uint32_t destination[4096 / 4];
+        uint8_t *dst = reinterpret_cast<uint8_t *>(destination);
+        uint32_t buffered = UINT32_MAX;
+        size_t pos = 0, copied, n;
+
+        while (pos < size) {
+            for (copied = 0; copied < chunk && pos < size; copied += n, pos += n) {
+                uint32_t sector = pos / SECTOR_CACHE_SECTOR_SIZE;
+                size_t offset = pos % SECTOR_CACHE_SECTOR_SIZE;
+                size_t whole = (chunk - copied) / SECTOR_CACHE_SECTOR_SIZE;
+
+                if (whole > (size - pos) / SECTOR_CACHE_SECTOR_SIZE) {
+                    whole = (size - pos) / SECTOR_CACHE_SECTOR_SIZE;
+                }
+
+                if (offset == 0 && whole > 0) {
+                    CHECK_TRUE(read(&dst[copied], sector, whole));
+                    n = whole * SECTOR_CACHE_SECTOR_SIZE;
+                    continue;
+                }
+
+                if (sector != buffered) {
+                    CHECK_TRUE(read(reinterpret_cast<uint8_t *>(fil_buffer), sector, 1));
+                    buffered = sector;
+                }
+                n = SECTOR_CACHE_SECTOR_SIZE - offset;
+                if (n > chunk - copied) {
+                    n = chunk - copied;
+                }
+            }
+        }
+    }
+    /* Streams the whole device without then with the cache, in the 2000 byte
+     * reads audio_dac does at each half buffer. The device then holds the
+     * counters of the cached pass. */
+    void stream_wav(uint64_t *uncached_time, unsigned *uncached_commands)
+    {
+        stream_file(wav_size, wav_chunk, [this](uint8_t *buf, uint32_t sector, uint32_t count) {
+            return uncached_read(&dev, buf, sector, count);
+        });
+        *uncached_time = dev.time_us;
+        *uncached_commands = dev.commands;
+
+        dev.time_us = 0;
+        dev.commands = 0;
+        stream_file(wav_size, wav_chunk, [this](uint8_t *buf, uint32_t sector, uint32_t count) {
+            return sector_cache_read(&cache, buf, sector, count);
+        });
+    }
+};
+
+TEST(SectorCacheTestGroup, ReadsDeviceContent)
+{
+    uint8_t *buf = reinterpret_cast<uint8_t *>(out);
+
+    for (int i = 0; i < 1000; i++) {
+        uint32_t count = 1 + rand() % 16;
+        uint32_t sector = rand() % (DEVICE_SECTORS - count);
+
+        /* Word aligned or not. */
+        check_read(buf + (rand() % 2), sector, count);
+    }
+}
+
+TEST(SectorCacheTestGroup, MissReadsTheWholeWindow)
+{
+    uint8_t buf[SECTOR_CACHE_SECTOR_SIZE];
+
+    check_read(buf, 10, 1);
+    CHECK_EQUAL(1, dev.commands);
+    CHECK_EQUAL(window * SECTOR_CACHE_SECTOR_SIZE, cache.stats.bytes);
+
+    /* Sectors 8 to 15 are now cached. */
+    for (uint32_t sector = 8; sector < 16; sector++) {
+        check_read(buf, sector, 1);
+    }
+    CHECK_EQUAL(1, dev.commands);
+    CHECK_EQUAL(1, cache.stats.misses);
+    CHECK_EQUAL(8, cache.stats.hits);
+}
+
+TEST(SectorCacheTestGroup, LeastRecentlyUsedLineIsReplaced)
+{
+    uint8_t buf[SECTOR_CACHE_SECTOR_SIZE];
+
+    check_read(buf, 0, 1);
+    check_read(buf, 8, 1);
+    check_read(buf, 0, 1);
+    check_read(buf, 16, 1);
+    CHECK_EQUAL(3, dev.commands);
+
+    /* 8 was replaced, but not 0. */
+    check_read(buf, 0, 1);
+    CHECK_EQUAL(3, dev.commands);
+    check_read(buf, 8, 1);
+    CHECK_EQUAL(4, dev.commands);
+}
+
+TEST(SectorCacheTestGroup, LargeAlignedReadsBypassTheCache)
+{
+    check_read(reinterpret_cast<uint8_t *>(out), 3, 16);
+
+    CHECK_EQUAL(1, dev.commands);
+    CHECK_EQUAL(16 * SECTOR_CACHE_SECTOR_SIZE, cache.stats.bytes);
+
+    /* Nothing was cached. */
+    check_read(reinterpret_cast<uint8_t *>(out), 3, 1);
+    CHECK_EQUAL(2, dev.commands);
+}
+
+TEST(SectorCacheTestGroup, LargeUnalignedReadsAreMergedPerWindow)
+{
+    check_read(reinterpret_cast<uint8_t *>(out) + 2, 8, 16);
+
+    CHECK_EQUAL(2, dev.commands);
+}
+
+TEST(SectorCacheTestGroup, PartiallyCachedRead)
+{
+    uint8_t buf[SECTOR_CACHE_SECTOR_SIZE];
+
+    check_read(buf, 4, 1);
+    check_read(reinterpret_cast<uint8_t *>(out), 4, 12);
+
+    /* The cached part is copied, the rest read in one window. */
+    CHECK_EQUAL(2, dev.commands);
+}
+
+TEST(SectorCacheTestGroup, ReadAheadStopsAtTheEndOfTheDevice)
+{
+    uint8_t buf[SECTOR_CACHE_SECTOR_SIZE];
+
+    sector_cache_set_sector_count(&cache, DEVICE_SECTORS - 3);
+
+    check_read(buf, DEVICE_SECTORS - 6, 1);
+    CHECK_EQUAL(5 * SECTOR_CACHE_SECTOR_SIZE, cache.stats.bytes);
+}
+
+TEST(SectorCacheTestGroup, InvalidatedSectorsAreReadAgain)
+{
+    uint8_t buf[SECTOR_CACHE_SECTOR_SIZE];
+
+    check_read(buf, 0, 1);
+    check_read(buf, 8, 1);
+
+    sector_cache_invalidate(&cache, 7, 2);
+
+    check_read(buf, 8, 1);
+    CHECK_EQUAL(3, dev.commands);
+
+    /* Did not overlap. */
+    sector_cache_invalidate(&cache, 16, 2);
+    check_read(buf, 8, 1);
+    CHECK_EQUAL(3, dev.commands);
+
+    sector_cache_invalidate_all(&cache);
+    check_read(buf, 8, 1);
+    CHECK_EQUAL(4, dev.commands);
+}
+
+TEST(SectorCacheTestGroup, DeviceErrorIsReported)
+{
+    uint8_t buf[SECTOR_CACHE_SECTOR_SIZE];
+
+    dev.fail = true;
+    CHECK_FALSE(sector_cache_read(&cache, buf, 0, 1));
+
+    /* Nothing was cached from the failed read. */
+    dev.fail = false;
+    check_read(buf, 0, 1);
+    CHECK_EQUAL(1, dev.commands);
+}
+
+TEST(SectorCacheTestGroup, WavStreamingReadsEachSectorOnce)
+{
+    uint64_t uncached_time;
+    unsigned uncached_commands;
+
+    stream_wav(&uncached_time, &uncached_commands);
+
+    /* Every sector is read once, a window at a time. */
+    CHECK_EQUAL(DEVICE_SECTORS / window, dev.commands);
+    CHECK(dev.time_us < uncached_time / 2);
+}
+
+/* Prints the simulated card time, ignored unless the tests are run with
+ * -ri. */
+IGNORE_TEST(SectorCacheTestGroup, WavStreamingBenchmark)
+{
+    uint64_t uncached_time;
+    unsigned uncached_commands;
+
+    stream_wav(&uncached_time, &uncached_commands);
+
+    printf("\nStreaming %u kB in %u byte reads:\n", (unsigned)(wav_size / 1024),
+           (unsigned)wav_chunk);
+    printf("  uncached: %u commands, %u ms\n", uncached_commands,
+           (unsigned)(uncached_time / 1000));
+    printf("  cached:   %u commands, %u ms, %u%% hits\n", dev.commands,
+           (unsigned)(dev.time_us / 1000),
+           (unsigned)(100 * cache.stats.hits / (cache.stats.hits + cache.stats.misses)));
+}
@@ -0,0 +1,228 @@
+#include <CppUTest/TestHarness.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include "vector_math.h"
+
+static int16_t saturate(int64_t x)
+{
+    return x > INT16_MAX ? INT16_MAX : (x < INT16_MIN ? INT16_MIN : x);
+}
+
+TEST_GROUP(VectorMathTestGroup)
+{
+    std::mt19937 rng{42};
+
+    /* Random values, with a lot of them at the limits to check saturation. */
+    std::vector<int16_t> random_vector(size_t len)
+    {
+        std::vector<int16_t> v(len);
+        for (auto &x : v) {
+            switch (rng() % 4) {
+                case 0: x = INT16_MAX; break;
+                case 1: x = INT16_MIN; break;
+                default: x = rng(); break;
+            }
+        }
+        return v;
+    }
+};
+
+TEST(VectorMathTestGroup, FillAndCopy)
+{
+    for (size_t len = 0; len < 16; len++) {
+        std::vector<int16_t> dest(len + 1, 7);
+
+        vector_math_fill(dest.data(), -3, len);
+        for (size_t i = 0; i < len; i++) {
+            CHECK_EQUAL(-3, dest[i]);
+        }
+        CHECK_EQUAL(7, dest[len]);
+    }
+
+    int16_t v[] = {1, 2, 3, 4, 5};
+    vector_math_copy(&v[1], &v[0], 4);
+    CHECK_EQUAL(1, v[1]);
+    CHECK_EQUAL(4, v[4]);
+}
+
+TEST(VectorMathTestGroup, ElementWiseOperationsSaturate)
+{
+    for (size_t len = 0; len < 17; len++) {
+        /* Offset by one element to check unaligned pairs. */
+        std::vector<int16_t> a = random_vector(len + 1), b = random_vector(len + 1);
+        std::vector<int16_t> add(len + 1), sub(len + 1), mul(len + 1), min(len + 1),
+        max(len + 1), wsum(len + 1);
+
+        vector_math_add(&add[1], &a[1], &b[1], len);
+        vector_math_sub(&sub[1], &a[1], &b[1], len);
+        vector_math_mul(&mul[1], &a[1], &b[1], 10, len);
+        vector_math_min(&min[1], &a[1], &b[1], len);
+        vector_math_max(&max[1], &a[1], &b[1], len);
+        vector_math_weighted_sum(&wsum[1], &a[1], &b[1], -32768, 20000, 14, len);
+
+        for (size_t i = 1; i <= len; i++) {
+            CHECK_EQUAL(saturate(a[i] + b[i]), add[i]);
+            CHECK_EQUAL(saturate(a[i] - b[i]), sub[i]);
+            CHECK_EQUAL(saturate((a[i] * b[i]) >> 10), mul[i]);
+            CHECK_EQUAL(std::min(a[i], b[i]), min[i]);
+            CHECK_EQUAL(std::max(a[i], b[i]), max[i]);
+            CHECK_EQUAL(saturate(((int64_t)a[i] * -32768 + (int64_t)b[i] * 20000) >> 14),
+                        wsum[i]);
+        }
+    }
+}
+
+TEST(VectorMathTestGroup, DestinationCanBeASource)
+{
+    int16_t a[] = {1, 2, 3, 4, 5};
+    int16_t b[] = {10, 20, 30, 40, 50};
+
+    vector_math_add(a, a, b, 5);
+
+    CHECK_EQUAL(11, a[0]);
+    CHECK_EQUAL(55, a[4]);
+}
+
+TEST(VectorMathTestGroup, Dot)
+{
+    for (size_t len = 0; len < 17; len++) {
+        std::vector<int16_t> a = random_vector(len), b = random_vector(len);
+        int64_t sum = 0;
+
+        for (size_t i = 0; i < len; i++) {
+            sum += a[i] * b[i];
+        }
+
+        CHECK_EQUAL(saturate(sum >> 16), vector_math_dot(a.data(), b.data(), 16, len));
+        CHECK_EQUAL(saturate(sum), vector_math_dot(a.data(), b.data(), 0, len));
+    }
+
+    /* 13 products of the largest magnitude do not fit in 32 bits. */
+    std::vector<int16_t> min(13, INT16_MIN);
+    CHECK_EQUAL(13, vector_math_dot(min.data(), min.data(), 30, 13));
+}
+
+TEST(VectorMathTestGroup, ArgmaxTakesTheFirstLargest)
+{
+    int16_t v[] = {-5, 3, 9, -20, 9, 1};
+
+    CHECK_EQUAL(2, vector_math_argmax(v, 6));
+    CHECK_EQUAL(0, vector_math_argmax(v, 1));
+}
+
+TEST(VectorMathTestGroup, Clamp)
+{
+    for (size_t len = 0; len < 17; len++) {
+        std::vector<int16_t> a = random_vector(len), dest(len);
+
+        vector_math_clamp(dest.data(), a.data(), -1000, 2000, len);
+
+        for (size_t i = 0; i < len; i++) {
+            CHECK_EQUAL(std::max<int16_t>(-1000, std::min<int16_t>(2000, a[i])), dest[i]);
+        }
+    }
+}
+
+/* Model of the Aseba VM running
+ *     for i in 0:12 do
+ *         d[i] = a[i] + b[i]
+ *     end
+ * with the same kind of instructions as the compiled script: a dispatch
+ * per instruction, stack operands and bounds checked array accesses. */
+enum {
+    OP_PUSH, OP_LOAD, OP_STORE, OP_LOAD_INDIRECT, OP_STORE_INDIRECT, OP_ADD, OP_BRANCH_IF_GT,
+    OP_JUMP, OP_STOP
+};
+
+struct vm_instruction {
+    uint8_t op;
+    int16_t arg;
+    int16_t size;
+};
+
+static bool vm_run(const vm_instruction *code, int16_t *variables)
+{
+    int16_t stack[8];
+    int sp = 0, pc = 0;
+
+    while (true) {
+        const vm_instruction &in = code[pc++];
+        switch (in.op) {
+            case OP_PUSH: stack[sp++] = in.arg; break;
+            case OP_LOAD: stack[sp++] = variables[in.arg]; break;
+            case OP_STORE: variables[in.arg] = stack[--sp]; break;
+            case OP_LOAD_INDIRECT:
+                if ((uint16_t)stack[sp - 1] >= in.size) {
+                    return false;
+                }
+                stack[sp - 1] = variables[in.arg + stack[sp - 1]];
+                break;
+            case OP_STORE_INDIRECT:
+                if ((uint16_t)stack[sp - 1] >= in.size) {
+                    return false;
+                }
+                variables[in.arg + stack[sp - 1]] = stack[sp - 2];
+                sp -= 2;
+                break;
+            case OP_ADD: sp--; stack[sp - 1] += stack[sp]; break;
+            case OP_BRANCH_IF_GT:
+                sp -= 2;
+                if (stack[sp] > stack[sp + 1]) {
+                    pc = in.arg;
+                }
+                break;
+            case OP_JUMP: pc = in.arg; break;
+            default: return true;
+        }
+    }
+}
+
+/* Only prints the time on the host, ignored unless the tests are run with
+ * -ri. */
+IGNORE_TEST(VectorMathTestGroup, VmLoopBenchmark)
+{
+    const int len = 13, rounds = 100000;
+    enum { I = 0, A = 1, B = A + len, D = B + len, VARIABLES = D + len };
+    const vm_instruction loop[] = {
+        {OP_PUSH, 0, 0}, {OP_STORE, I, 0},
+        /* 2: */ {OP_LOAD, I, 0}, {OP_PUSH, len - 1, 0}, {OP_BRANCH_IF_GT, 17, 0},
+        {OP_LOAD, I, 0}, {OP_LOAD_INDIRECT, A, len},
+        {OP_LOAD, I, 0}, {OP_LOAD_INDIRECT, B, len},
+        {OP_ADD, 0, 0},
+        {OP_LOAD, I, 0}, {OP_STORE_INDIRECT, D, len},
+        {OP_LOAD, I, 0}, {OP_PUSH, 1, 0}, {OP_ADD, 0, 0}, {OP_STORE, I, 0},
+        {OP_JUMP, 2, 0},
+        /* 17: */ {OP_STOP, 0, 0},
+    };
+    std::vector<int16_t> variables = random_vector(VARIABLES);
+    volatile int16_t sink = 0;
+
+    for (int i = A; i < D; i++) {
+        variables[i] /= 4;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < rounds; round++) {
+        vm_run(loop, variables.data());
+        sink = sink + variables[D + round % len];
+    }
+    auto middle = std::chrono::steady_clock::now();
+    for (int round = 0; round < rounds; round++) {
+        vector_math_add(&variables[D], &variables[A], &variables[B], len);
+        sink = sink + variables[D + round % len];
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < len; i++) {
+        CHECK_EQUAL(variables[A + i] + variables[B + i], variables[D + i]);
+    }
+
+    double vm_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(middle - start).count();
+    double native_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - middle).count();
+    printf("\nAdding 13 element arrays: %.1f ns in a VM loop, %.1f ns native on the host\n",
+           vm_ns / rounds, native_ns / rounds);
+}